@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <stdarg.h>
+
 #include "common/mbuf.h"
 #include "common/mg_str.h"
 #include "common/platform.h"
@@ -28,6 +30,14 @@ extern "C" {
 
 int mg_json_printer_mbuf(struct json_out *, const char *, size_t);
 
+/*
+ * Appends JSON to an mbuf. Output is measured first, so the mbuf is grown
+ * at most once and the JSON is printed directly into it. Formatting runs
+ * twice, %M callbacks included, use JSON_OUT_MBUF to print in one pass.
+ */
+int mg_json_printf_mbuf(struct mbuf *mb, const char *fmt, ...);
+int mg_json_vprintf_mbuf(struct mbuf *mb, const char *fmt, va_list ap);
+
 /* Add quoted string into mbuf */
 void mg_json_emit_str(struct mbuf *b, const struct mg_str s, int quote);
 
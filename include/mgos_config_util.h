@@ -74,11 +74,45 @@ struct mgos_conf_entry {
   const char *key;
   uint16_t offset;
   uint16_t num_desc;
+  /*
+   * Objects only: number of direct children followed by their indices
+   * relative to this entry, sorted by key. Generated along with the schema;
+   * if NULL, lookups scan the entries instead.
+   */
+  const uint16_t *sorted_children;
 };
 
 /* Generated during build */
 struct mgos_config;
 
+/*
+ * Compiled ACL, for checking many keys against the same ACL.
+ * Literal keys, "prefix*" and "*" entries are matched without going through
+ * the glob matcher, and results for schema entries are computed once per
+ * schema and cached.
+ */
+struct mgos_conf_acl;
+
+/* Compiles an ACL. The string is copied. Returns NULL if out of memory. */
+struct mgos_conf_acl *mgos_conf_acl_compile(const struct mg_str acl);
+
+/* Returns the ACL string `acl` was compiled from. */
+struct mg_str mgos_conf_acl_get_src(const struct mgos_conf_acl *acl);
+
+/* Same as `mgos_conf_check_access()`, with a compiled ACL. */
+bool mgos_conf_acl_check(const struct mgos_conf_acl *acl,
+                         const struct mg_str key);
+
+/*
+ * Checks access to entry `e` of `schema`, with the key being the path of
+ * `e` relative to `schema`.
+ */
+bool mgos_conf_acl_check_entry(struct mgos_conf_acl *acl,
+                               const struct mgos_conf_entry *schema,
+                               const struct mgos_conf_entry *e);
+
+void mgos_conf_acl_free(struct mgos_conf_acl *acl);
+
 /*
  * Parses config `json` into `cfg` according to rules defined in `schema` and
  * checking keys against `acl`.
@@ -110,6 +144,46 @@ bool mgos_conf_parse_sub_msg(const struct mg_str json,
                              const struct mgos_conf_entry *sub_schema,
                              const char *acl, void *cfg, char **msg);
 
+/* Like `mgos_conf_parse_sub_msg()`, with a compiled ACL. */
+bool mgos_conf_parse_sub_acl(const struct mg_str json,
+                             const struct mgos_conf_entry *sub_schema,
+                             struct mgos_conf_acl *acl, void *cfg, char **msg);
+
+/*
+ * Like `mgos_conf_parse_sub_acl()`, but parses the contents of file `fname`.
+ * The file is read in small chunks, only the current token is kept in
+ * memory. Returns false if the file cannot be opened.
+ */
+bool mgos_conf_parse_file_acl(const char *fname,
+                              const struct mgos_conf_entry *sub_schema,
+                              struct mgos_conf_acl *acl, void *cfg,
+                              char **msg);
+
+/*
+ * Config journal: a sequence of records, each setting one value. Keys are
+ * stored as paths relative to the schema, so records stay valid when the
+ * struct layout changes. Each record has a CRC, so a record cut short by
+ * an interrupted append is detected.
+ */
+
+/*
+ * Appends a record to `out` for every value that differs between `cfg`
+ * and `base`. Returns the number of records appended, or -1 on error.
+ */
+int mgos_conf_journal_diff(const struct mgos_conf_entry *schema,
+                           const void *cfg, const void *base,
+                           struct mbuf *out);
+
+/*
+ * Applies journal records in `data` to `cfg`. Records for unknown keys,
+ * keys of a different type or not allowed by `acl` are skipped.
+ * Stops at the first damaged record, returns the length of the data up to
+ * that point (i.e. `data.len` if all the records are good).
+ */
+size_t mgos_conf_journal_apply(const struct mg_str data,
+                               const struct mgos_conf_entry *schema,
+                               struct mgos_conf_acl *acl, void *cfg);
+
 /*
  * Callback for `mgos_conf_emit_cb` (see below); `data` is the emitted data and
  * `param` is user-defined param given to `mgos_conf_emit_cb`.
@@ -151,6 +225,17 @@ bool mgos_conf_emit_json_out(const void *cfg, const void *base,
                              const struct mgos_conf_entry *schema, bool pretty,
                              struct json_out *out);
 
+/*
+ * Appends values of `entries` from `cfg` to `out` as a flat JSON object
+ * keyed by full paths, e.g. `{"wifi.ap.ssid":"foo","debug.level":2}`.
+ * Entries must belong to `schema`; returns false and leaves `out` unchanged
+ * if one does not.
+ */
+bool mgos_conf_emit_entries(const void *cfg,
+                            const struct mgos_conf_entry *schema,
+                            const struct mgos_conf_entry *const *entries,
+                            int num_entries, struct mbuf *out);
+
 /*
  * Copies a config struct from src to dst.
  * The copy is independent and needs to be freed.
@@ -163,6 +248,40 @@ bool mgos_conf_copy(const struct mgos_conf_entry *schema, const void *src,
  */
 void mgos_conf_free(const struct mgos_conf_entry *schema, void *cfg);
 
+/* Returns true if all the values in `cfg1` and `cfg2` are the same. */
+bool mgos_conf_equal(const struct mgos_conf_entry *schema, const void *cfg1,
+                     const void *cfg2);
+
+#define MGOS_CONF_SNAPSHOT_VERSION 1
+
+/*
+ * Returns a hash of the layout described by `schema`: keys, types and
+ * offsets of all the entries.
+ */
+uint32_t mgos_conf_schema_hash(const struct mgos_conf_entry *schema);
+
+/*
+ * Appends a binary snapshot of `cfg` to `out`. Values are stored in schema
+ * order in host byte order, so a snapshot is only good for the firmware that
+ * wrote it. `key` is stored in the header and should identify whatever
+ * `cfg` was built from, it must match when the snapshot is loaded.
+ * Strings longer than 65534 bytes are not supported.
+ */
+bool mgos_conf_snapshot_save(const struct mgos_conf_entry *schema,
+                             const void *cfg, uint32_t key, struct mbuf *out);
+
+/*
+ * Loads a snapshot produced by `mgos_conf_snapshot_save()` into `cfg`, which
+ * must be initialized (e.g. set to defaults). Strings equal to the ones
+ * already in `cfg` are not copied.
+ * Returns false without touching `cfg` if the snapshot is damaged or was
+ * made with a different version, schema or key. Returns false after a
+ * partial update if out of memory.
+ */
+bool mgos_conf_snapshot_load(const struct mg_str data,
+                             const struct mgos_conf_entry *schema,
+                             uint32_t key, void *cfg);
+
 /*
  * Finds a config schema entry by the "outer" entry (which has to describe an
  * object) and a path like "foo.bar.baz". If matching entry is not found,
@@ -201,12 +320,27 @@ void mgos_conf_set_str(const char **vp, const char *v);
 /* Returns true if the string is NULL or empty. */
 bool mgos_conf_str_empty(const char *s);
 
-/* Copies a string if necessary. */
+/*
+ * Copies a string if necessary. Values other than defaults are kept in
+ * a shared pool, copies of the same value share storage.
+ */
 bool mgos_conf_copy_str(const char *s, const char **copy);
 
-/* Frees a string if necessary. */
+/*
+ * Frees a string if necessary. Config strings must be freed with this,
+ * not free().
+ */
 void mgos_conf_free_str(const char **sp);
 
+struct mgos_conf_str_pool_stats {
+  int num_chunks;
+  size_t size; /* Total size of the chunks. */
+  size_t used; /* Including free slots in the middle of chunks. */
+  int num_strs;
+};
+
+void mgos_conf_str_pool_get_stats(struct mgos_conf_str_pool_stats *stats);
+
 /*
  * Returns a type of the value (this function is primarily for FFI)
  */
@@ -235,6 +369,36 @@ int mgos_conf_value_int(const void *cfg, const struct mgos_conf_entry *e);
  */
 double mgos_conf_value_double(const void *cfg, const struct mgos_conf_entry *e);
 
+/*
+ * Returns a float value from the config entry
+ */
+float mgos_conf_value_float(const void *cfg, const struct mgos_conf_entry *e);
+
+/*
+ * Typed setters. Together with the getters above, these allow accessing
+ * values by entries looked up once with `mgos_conf_find_schema_entry()`,
+ * without converting values to and from strings.
+ * Return false if the type of the entry does not match.
+ */
+
+/* Sets an int, unsigned int or bool value. */
+bool mgos_conf_value_set_int(void *cfg, const struct mgos_conf_entry *e,
+                             int v);
+
+/* Sets a float or double value. */
+bool mgos_conf_value_set_double(void *cfg, const struct mgos_conf_entry *e,
+                                double v);
+
+/* Sets a string value, the string is copied. */
+bool mgos_conf_value_set_string(void *cfg, const struct mgos_conf_entry *e,
+                                const char *v);
+
+/*
+ * Invoked by the typed setters after changing `cfg`. Does nothing by default,
+ * the system config uses it to notify watches.
+ */
+void mgos_conf_value_changed(const void *cfg);
+
 /*
  * Expands ? placeholders in str with characters from src, right to left.
  */
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * System config change notifications.
+ *
+ * A watch keeps a copy of the values it covers, changes are found by
+ * comparing the config with these copies. This happens after
+ * `mgos_config_apply()` and when `mgos_sys_config_notify_changes()` is called.
+ * `mgos_sys_config_set()`, the generated `mgos_sys_config_set_*()` setters
+ * and the typed setters (`mgos_conf_value_set_*()`) schedule a check from the
+ * main loop, so a series of changes is reported together. After changing
+ * `mgos_sys_config` in other ways, call `mgos_sys_config_changed()`.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "mgos_config_util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Invoked for a value that has changed. `key` is the full path of the value,
+ * e.g. "mqtt.server". `old_value` and `new_value` point to values of the type
+ * the struct uses for the entry: `int`, `float`, `double` or `const char *`.
+ * Strings may be NULL, which is the same as empty.
+ */
+typedef void (*mgos_config_watch_cb_t)(const char *key,
+                                       const struct mgos_conf_entry *e,
+                                       const void *old_value,
+                                       const void *new_value, void *arg);
+
+/*
+ * Invokes `cb` when the value of `key` changes. If `key` is a section
+ * (e.g. "mqtt"), `cb` is invoked for every value in it that has changed.
+ * Returns false if there is no such key.
+ */
+bool mgos_config_watch(const char *key, mgos_config_watch_cb_t cb, void *arg);
+
+/* Removes a watch added with the same arguments. */
+bool mgos_config_unwatch(const char *key, mgos_config_watch_cb_t cb,
+                         void *arg);
+
+/*
+ * Invokes callbacks for the values that changed since the last check.
+ * Cheap if nothing is watched. Callbacks may change the config further
+ * and add or remove watches, including their own.
+ */
+void mgos_sys_config_notify_changes(void);
+
+/*
+ * Schedules `mgos_sys_config_notify_changes()` to run from the main loop.
+ * Cheap to call repeatedly, changes are checked for once. Main task only.
+ */
+void mgos_sys_config_changed(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -23,6 +23,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -208,6 +209,59 @@ bool mgos_event_remove_handler(int ev, mgos_event_handler_t cb, void *userdata);
 bool mgos_event_remove_group_handler(int evgrp, mgos_event_handler_t cb,
                                      void *userdata);
 
+/* Max number of events waiting for delivery, see `mgos_event_post()`. */
+#ifndef MGOS_EVENT_QUEUE_LEN
+#define MGOS_EVENT_QUEUE_LEN 16
+#endif
+
+/* Max size of event data that can be posted with `mgos_event_post()`. */
+#ifndef MGOS_EVENT_POST_MAX_DATA_LEN
+#define MGOS_EVENT_POST_MAX_DATA_LEN 32
+#endif
+
+/*
+ * Flag for `mgos_event_post()`: if the same event posted with this flag is
+ * still waiting for delivery, replace its data instead of queueing another
+ * one (latest wins).
+ */
+#define MGOS_EVENT_POST_F_COALESCE (1 << 0)
+
+/*
+ * Queue event `ev` for delivery from the main loop and return immediately.
+ * Handlers are invoked later, in the order the events were posted, as if by
+ * `mgos_event_trigger()`.
+ *
+ * `ev_data_len` bytes of `ev_data` are copied into the queue and handlers get
+ * a pointer to the copy, so `ev_data` may be a stack variable. If `ev_data` is
+ * NULL, handlers get NULL.
+ *
+ * Returns false if the queue is full (the event is dropped) or `ev_data_len`
+ * exceeds `MGOS_EVENT_POST_MAX_DATA_LEN`.
+ *
+ * Can be called from any task, but not from an ISR.
+ *
+ * Example:
+ * ```c
+ * double delta = 10;
+ * mgos_event_post(MGOS_EVENT_TIME_CHANGED, &delta, sizeof(delta),
+ *                 MGOS_EVENT_POST_F_COALESCE);
+ * ```
+ */
+bool mgos_event_post(int ev, const void *ev_data, size_t ev_data_len,
+                     int flags);
+
+/* Event queue statistics, see `mgos_event_get_queue_stats()`. */
+struct mgos_event_queue_stats {
+  uint32_t num_posted;     /* Events accepted by mgos_event_post(). */
+  uint32_t num_coalesced;  /* Of those, merged with an already queued event. */
+  uint32_t num_dropped;    /* Events rejected because the queue was full. */
+  uint32_t num_delivered;  /* Events taken off the queue and triggered. */
+  uint16_t max_depth;      /* Max observed number of queued events. */
+};
+
+/* Get event queue statistics. */
+void mgos_event_get_queue_stats(struct mgos_event_queue_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Main loop latency profiler.
+ *
+ * Built when MGOS_ENABLE_LOOP_STATS is set. Keeps a histogram for each of
+ * the measured latencies. Bucket i counts values in [2^(i-1), 2^i)
+ * microseconds (bucket 0 is for 0), the last bucket takes everything above.
+ * Memory use is fixed and recording a value is a handful of instructions.
+ *
+ * Values can be recorded from any task: event handlers are timed on the task
+ * that triggers the event. Fields are updated with atomic adds, a reader may
+ * see a sample that is being recorded counted in some fields but not yet in
+ * others.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common/json_utils.h"
+
+#ifndef MGOS_ENABLE_LOOP_STATS
+#define MGOS_ENABLE_LOOP_STATS 0
+#endif
+
+#ifndef MGOS_LOOP_STATS_NUM_BUCKETS
+#define MGOS_LOOP_STATS_NUM_BUCKETS 24 /* Up to ~8 seconds. */
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum mgos_loop_stats_hist {
+  /* Time mongoose_poll() spends working: posted events, poll callbacks and
+   * mongoose handlers. Time blocked waiting for I/O is not included. */
+  MGOS_LOOP_STATS_ITER = 0,
+  /* How late software timers fire relative to their due time. */
+  MGOS_LOOP_STATS_TIMER_LATE = 1,
+  /* Time mgos_invoke_cb() callbacks spend waiting in the queue. */
+  MGOS_LOOP_STATS_INVOKE_WAIT = 2,
+  /* Duration of a single mgos_event_trigger() handler invocation. */
+  MGOS_LOOP_STATS_EVENT_HANDLER = 3,
+  /* Time mongoose_poll() spends blocked waiting for I/O. */
+  MGOS_LOOP_STATS_IDLE = 4,
+  MGOS_LOOP_STATS_NUM_HIST,
+};
+
+struct mgos_loop_stats_hist_data {
+  uint32_t count;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t buckets[MGOS_LOOP_STATS_NUM_BUCKETS];
+};
+
+#if MGOS_ENABLE_LOOP_STATS
+
+void mgos_loop_stats_record(enum mgos_loop_stats_hist h, uint32_t us);
+
+/*
+ * Clock that only advances while the main task is working, used to split
+ * mongoose_poll() time into work and idle. Defaults to mgos_uptime_micros(),
+ * which is right for platforms that poll with no timeout. Platforms where
+ * mg_mgr_poll() blocks override it, e.g. with thread CPU time.
+ */
+int64_t mgos_loop_stats_busy_micros(void);
+
+bool mgos_loop_stats_get(enum mgos_loop_stats_hist h,
+                         struct mgos_loop_stats_hist_data *data);
+
+/*
+ * Returns the value below which the given fraction (0-1) of samples lie,
+ * rounded up to a bucket boundary and capped at max_us.
+ */
+uint32_t mgos_loop_stats_percentile(
+    const struct mgos_loop_stats_hist_data *data, double p);
+
+/*
+ * Prints all the histograms as a JSON object keyed by histogram name.
+ * A json_printf %M callback, takes no arguments.
+ */
+int mgos_loop_stats_emit_json(struct json_out *out, va_list *ap);
+
+/* Returns the JSON as a heap-allocated string, caller must free() it. */
+char *mgos_loop_stats_to_json(void);
+
+void mgos_loop_stats_reset(void);
+
+#endif /* MGOS_ENABLE_LOOP_STATS */
+
+#ifdef __cplusplus
+}
+#endif
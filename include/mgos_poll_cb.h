@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Poll callbacks with priorities, rate limiting and timing.
+ *
+ * Poll callbacks run at the start of every main loop iteration, highest
+ * priority first. Each one is timed; the numbers can be read with
+ * `mgos_get_poll_cb_stats()` or logged periodically.
+ *
+ * If the callbacks of one iteration have already used up the budget
+ * (`mgos_set_poll_cb_budget()`), the remaining low priority ones are
+ * skipped, but never more than `MGOS_POLL_CB_MAX_SKIPS` times in a row.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mgos_mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MGOS_POLL_CB_BUDGET_US
+#define MGOS_POLL_CB_BUDGET_US 20000
+#endif
+
+#ifndef MGOS_POLL_CB_MAX_SKIPS
+#define MGOS_POLL_CB_MAX_SKIPS 10
+#endif
+
+enum mgos_poll_cb_prio {
+  MGOS_POLL_CB_PRIO_HIGH = 0,
+  MGOS_POLL_CB_PRIO_NORMAL = 1, /* What mgos_add_poll_cb() uses. */
+  /* Skipped when the loop is behind. */
+  MGOS_POLL_CB_PRIO_LOW = 2,
+};
+
+struct mgos_poll_cb_opts {
+  const char *name; /* For stats, must stay valid. May be NULL. */
+  enum mgos_poll_cb_prio prio;
+  /* Don't invoke more often than this. 0 - every iteration. */
+  int min_interval_ms;
+};
+
+/* Like mgos_add_poll_cb(), with options. */
+bool mgos_add_poll_cb_opt(mgos_poll_cb_t cb, void *cb_arg,
+                          const struct mgos_poll_cb_opts *opts);
+
+struct mgos_poll_cb_stats {
+  const char *name;
+  mgos_poll_cb_t cb;
+  void *cb_arg;
+  enum mgos_poll_cb_prio prio;
+  uint32_t num_calls;
+  uint32_t num_skipped; /* Because the loop was behind. */
+  uint64_t total_us;
+  uint32_t max_us;
+};
+
+/*
+ * Fills in stats for up to max_stats callbacks, in invocation order.
+ * Returns the total number of registered callbacks.
+ */
+int mgos_get_poll_cb_stats(struct mgos_poll_cb_stats *stats, int max_stats);
+
+void mgos_reset_poll_cb_stats(void);
+
+/*
+ * Sets the time poll callbacks may take per iteration before low priority
+ * ones are skipped. 0 disables skipping.
+ */
+void mgos_set_poll_cb_budget(int budget_us);
+
+/*
+ * Logs the stats (and resets them) every interval_ms milliseconds.
+ * 0 disables logging, which is the default.
+ */
+void mgos_set_poll_cb_stats_log_interval(int interval_ms);
+
+#ifdef __cplusplus
+}
+#endif
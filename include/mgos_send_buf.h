@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Zero-copy sending of large buffers.
+ *
+ * `mg_send()` copies data into the connection's send mbuf, so sending a
+ * large payload temporarily needs twice its size in heap. Instead, a buffer
+ * can be wrapped into a reference-counted `struct mgos_send_buf` and queued
+ * on one or more connections. It is written to the socket straight from the
+ * caller's memory (with `writev()` where available, otherwise in chunks of
+ * at most `MGOS_SEND_BUF_CHUNK_SIZE` through the send mbuf) and the free
+ * callback is invoked once the last connection is done with it.
+ *
+ * Only connections created with `mgos_connect*()` and `mgos_bind*()` are
+ * supported. Data queued this way is sent after whatever is already in the
+ * send mbuf; do not `mg_send()` more while `mgos_conn_get_send_pending()`
+ * is non-zero, or it may overtake the queued buffers.
+ *
+ * All the functions must be called from the main task.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mgos_mongoose.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef MGOS_SEND_BUF_CHUNK_SIZE
+#define MGOS_SEND_BUF_CHUNK_SIZE 1460
+#endif
+
+/* Max number of buffers written by a single `writev()` call. */
+#ifndef MGOS_SEND_BUF_MAX_IOV
+#define MGOS_SEND_BUF_MAX_IOV 16
+#endif
+
+struct mgos_send_buf;
+
+typedef void (*mgos_send_buf_free_cb_t)(void *data, void *arg);
+
+/*
+ * Wraps `len` bytes at `data` into a send buffer with a reference count of 1.
+ * `free_cb`, if not NULL, is called with `data` and `free_cb_arg` when the
+ * last reference is dropped. The data must not be modified until then.
+ */
+struct mgos_send_buf *mgos_send_buf_create(const void *data, size_t len,
+                                           mgos_send_buf_free_cb_t free_cb,
+                                           void *free_cb_arg);
+
+/* Adds a reference. Returns `b` for convenience. */
+struct mgos_send_buf *mgos_send_buf_ref(struct mgos_send_buf *b);
+
+/* Drops a reference, freeing the buffer when it was the last one. */
+void mgos_send_buf_unref(struct mgos_send_buf *b);
+
+/*
+ * Queues `len` bytes of `b` starting at `offset` to be sent on `c`.
+ * The connection takes its own reference, the caller keeps theirs.
+ */
+bool mgos_conn_send_buf(struct mg_connection *c, struct mgos_send_buf *b,
+                        size_t offset, size_t len);
+
+/*
+ * Shortcut for sending a single buffer: ownership of `data` is passed to
+ * the connection, `free_cb` is called when it has been sent or the
+ * connection is closed. If false is returned, `free_cb` has already been
+ * called.
+ */
+bool mgos_conn_send_owned(struct mg_connection *c, void *data, size_t len,
+                          mgos_send_buf_free_cb_t free_cb, void *free_cb_arg);
+
+/* Returns the number of queued bytes that are not yet written. */
+size_t mgos_conn_get_send_pending(struct mg_connection *c);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Read-only snapshots of the system config.
+ *
+ * For code that runs outside the main task (e.g. threads on Linux) or that
+ * needs a consistent view of the config while it is being changed.
+ * A snapshot is a single heap block with a copy of the config struct and
+ * of the strings it uses; default strings are shared. Snapshots are
+ * reference counted, getting one is O(1) and can be done from any task.
+ *
+ * Snapshots are opt-in: none exist until `mgos_sys_config_snapshot_publish()`
+ * is called. After that, a new snapshot is published whenever
+ * `mgos_sys_config_notify_changes()` finds the config changed, which includes
+ * every `mgos_config_apply()`.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mgos_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Returns a reference to the latest snapshot, NULL if none was published.
+ * Must be released with `mgos_sys_config_snapshot_put()`.
+ */
+const struct mgos_config *mgos_sys_config_snapshot_get(void);
+
+/* Releases a reference obtained with `mgos_sys_config_snapshot_get()`. */
+void mgos_sys_config_snapshot_put(const struct mgos_config *cfg);
+
+/*
+ * Returns generation number of the snapshot. It goes up by one every time
+ * a changed config is published.
+ */
+uint32_t mgos_sys_config_snapshot_gen(const struct mgos_config *cfg);
+
+/*
+ * Publishes the current `mgos_sys_config`, unless it is the same as the
+ * latest snapshot. Must be called from the main task.
+ */
+bool mgos_sys_config_snapshot_publish(void);
+
+#ifdef __cplusplus
+}
+#endif
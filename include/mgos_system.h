@@ -102,6 +102,37 @@ typedef void (*mgos_cb_t)(void *arg);
  */
 bool mgos_invoke_cb(mgos_cb_t cb, void *arg, uint32_t flags);
 
+/*
+ * Schedule a callback for execution on a background task, same as
+ * `mgos_invoke_cb()` with MGOS_INVOKE_CB_F_BG_TASK. Callbacks with the same
+ * non-zero `key` are executed one at a time and in the order they were
+ * scheduled, even if the platform runs background callbacks concurrently.
+ * Callbacks with key 0 have no ordering guarantees.
+ *
+ * Returns true if the callback has been scheduled for execution.
+ */
+bool mgos_invoke_cb_key(mgos_cb_t cb, void *arg, uintptr_t key);
+
+struct mgos_bg_cb_stats {
+  int num_workers;          /* Tasks running background callbacks. */
+  uint32_t queue_depth;     /* Callbacks waiting to run, all workers. */
+  uint32_t max_queue_depth; /* Highest depth of a single worker's queue. */
+  uint32_t num_submitted;
+  uint32_t num_rejected; /* Queue full. */
+  uint32_t num_run;
+  uint32_t num_stolen;  /* Run by a worker other than the one queued to. */
+  double wait_us_total; /* Time from submission to start of execution. */
+  double wait_us_max;
+  double run_us_total; /* Callback execution time. */
+  double run_us_max;
+};
+
+/*
+ * Get background callback queue stats.
+ * Returns false and zeroes `stats` if the platform does not keep them.
+ */
+bool mgos_get_bg_cb_stats(struct mgos_bg_cb_stats *stats);
+
 /* Get the CPU frequency in Hz */
 uint32_t mgos_get_cpu_freq(void);
 
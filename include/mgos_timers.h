@@ -139,6 +139,32 @@ struct mgos_timer_info {
 
 bool mgos_get_timer_info(mgos_timer_id id, struct mgos_timer_info *info);
 
+/*
+ * Set the max number of due software timers whose callbacks are invoked in
+ * one main loop iteration. Due timers are dispatched in deadline order;
+ * the rest are carried over to the next iteration so that a burst of timers
+ * does not starve network I/O. 0 means no limit.
+ */
+void mgos_set_sw_timer_dispatch_budget(int max_timers);
+
+/*
+ * Software timer dispatch statistics.
+ * A timer is considered late if it fired MGOS_SW_TIMER_LATE_MS (10 by default)
+ * or more milliseconds after its deadline.
+ */
+struct mgos_sw_timer_stats {
+  uint32_t num_fired;    /* Number of callbacks invoked. */
+  uint32_t num_late;     /* Number of those that fired late. */
+  double late_ms_total;  /* Total lateness of the late ones, in milliseconds. */
+  double late_ms_max;    /* Max lateness observed, in milliseconds. */
+};
+
+/* Get software timer dispatch statistics. */
+void mgos_get_sw_timer_stats(struct mgos_sw_timer_stats *stats);
+
+/* Reset software timer dispatch statistics. */
+void mgos_reset_sw_timer_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -91,6 +91,11 @@ void rpa_queue_destroy(rpa_queue_t * queue)
   pthread_cond_destroy(queue->not_empty);
   pthread_cond_destroy(queue->not_full);
   pthread_mutex_destroy(queue->one_big_mutex);
+  free(queue->not_empty);
+  free(queue->not_full);
+  free(queue->one_big_mutex);
+  free(queue->data);
+  free(queue);
 }
 
 /**
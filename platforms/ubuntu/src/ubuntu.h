@@ -31,6 +31,8 @@ struct ubuntu_flags {
   gid_t gid;
   char *chroot;
   int secure;
+  int loop_stats;
+  int bg_workers;
 };
 
 // Logging for the main process (using different colors)
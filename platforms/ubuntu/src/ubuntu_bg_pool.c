@@ -0,0 +1,345 @@
+/*
+ * Copyright 2019 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Every worker keeps two deques under its own mutex: "pinned" for callbacks
+// with an affinity key, which only the owner may run, and "shared" for the
+// rest. The owner takes from the front of whichever holds the older entry;
+// thieves take from the back of the shared deque, away from the owner.
+//
+// An idle worker only goes to sleep after checking, under its own lock, that
+// no stealable entries exist anywhere (num_shared). Submitters bump
+// num_shared before looking for a sleeper, and check the sleeping flag
+// under that worker's lock, so a wakeup can't fall in between.
+
+#include "ubuntu_bg_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct bg_item {
+  ubuntu_bg_cb_t cb;
+  void *arg;
+  uint64_t seq;
+  double enq_time;
+};
+
+struct bg_deque {
+  struct bg_item items[UBUNTU_BG_POOL_QUEUE_LEN];
+  int head, len;
+};
+
+struct bg_worker {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  struct bg_deque pinned;
+  struct bg_deque shared;
+  bool sleeping;
+  // Stats, protected by the lock.
+  uint32_t max_depth;
+  uint32_t num_run;
+  uint32_t num_stolen;
+  double wait_us_total, wait_us_max;
+  double run_us_total, run_us_max;
+};
+
+struct bg_pool {
+  int num_workers;
+  struct bg_worker *workers;
+  atomic_bool stopping;
+  atomic_int num_shared;
+  atomic_uint next_worker;
+  atomic_uint_fast64_t seq;
+  atomic_uint num_submitted;
+  atomic_uint num_rejected;
+};
+
+static struct bg_pool *s_pool = NULL;
+
+static double bg_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static bool bg_deque_push_back(struct bg_deque *d, const struct bg_item *it) {
+  if (d->len == UBUNTU_BG_POOL_QUEUE_LEN) return false;
+  d->items[(d->head + d->len) % UBUNTU_BG_POOL_QUEUE_LEN] = *it;
+  d->len++;
+  return true;
+}
+
+static void bg_deque_pop_front(struct bg_deque *d, struct bg_item *it) {
+  *it = d->items[d->head];
+  d->head = (d->head + 1) % UBUNTU_BG_POOL_QUEUE_LEN;
+  d->len--;
+}
+
+static void bg_deque_pop_back(struct bg_deque *d, struct bg_item *it) {
+  d->len--;
+  *it = d->items[(d->head + d->len) % UBUNTU_BG_POOL_QUEUE_LEN];
+}
+
+// Must be called with w->lock held.
+static bool bg_worker_take_own(struct bg_worker *w, struct bg_item *it) {
+  struct bg_deque *d = NULL;
+  if (w->pinned.len > 0) d = &w->pinned;
+  if (w->shared.len > 0 &&
+      (d == NULL ||
+       w->shared.items[w->shared.head].seq < d->items[d->head].seq)) {
+    d = &w->shared;
+  }
+  if (d == NULL) return false;
+  bg_deque_pop_front(d, it);
+  if (d == &w->shared) atomic_fetch_sub(&s_pool->num_shared, 1);
+  return true;
+}
+
+static bool bg_worker_steal(struct bg_worker *w, struct bg_item *it) {
+  int n = s_pool->num_workers;
+  int self = w - s_pool->workers;
+  for (int i = 1; i < n; i++) {
+    struct bg_worker *victim = &s_pool->workers[(self + i) % n];
+    bool ok = false;
+    pthread_mutex_lock(&victim->lock);
+    if (victim->shared.len > 0) {
+      bg_deque_pop_back(&victim->shared, it);
+      atomic_fetch_sub(&s_pool->num_shared, 1);
+      ok = true;
+    }
+    pthread_mutex_unlock(&victim->lock);
+    if (ok) return true;
+  }
+  return false;
+}
+
+// Returns false when the pool is stopping and there is nothing left to do.
+static bool bg_worker_next(struct bg_worker *w, struct bg_item *it,
+                           bool *stolen) {
+  for (;;) {
+    pthread_mutex_lock(&w->lock);
+    bool ok = bg_worker_take_own(w, it);
+    pthread_mutex_unlock(&w->lock);
+    if (ok) {
+      *stolen = false;
+      return true;
+    }
+    if (bg_worker_steal(w, it)) {
+      *stolen = true;
+      return true;
+    }
+    pthread_mutex_lock(&w->lock);
+    if (w->pinned.len == 0 && w->shared.len == 0 &&
+        atomic_load(&s_pool->num_shared) == 0) {
+      if (atomic_load(&s_pool->stopping)) {
+        pthread_mutex_unlock(&w->lock);
+        return false;
+      }
+      w->sleeping = true;
+      pthread_cond_wait(&w->cond, &w->lock);
+      w->sleeping = false;
+    }
+    pthread_mutex_unlock(&w->lock);
+  }
+}
+
+static void *bg_worker_main(void *arg) {
+  struct bg_worker *w = (struct bg_worker *) arg;
+  struct bg_item it;
+  bool stolen;
+  while (bg_worker_next(w, &it, &stolen)) {
+    double start = bg_now_us();
+    it.cb(it.arg);
+    double end = bg_now_us();
+    double wait_us = start - it.enq_time, run_us = end - start;
+    pthread_mutex_lock(&w->lock);
+    w->num_run++;
+    if (stolen) w->num_stolen++;
+    w->wait_us_total += wait_us;
+    if (wait_us > w->wait_us_max) w->wait_us_max = wait_us;
+    w->run_us_total += run_us;
+    if (run_us > w->run_us_max) w->run_us_max = run_us;
+    pthread_mutex_unlock(&w->lock);
+  }
+  return NULL;
+}
+
+// Wakes up w if it's sleeping. Returns true if it was.
+static bool bg_worker_wake(struct bg_worker *w) {
+  bool res;
+  pthread_mutex_lock(&w->lock);
+  res = w->sleeping;
+  if (res) pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->lock);
+  return res;
+}
+
+bool ubuntu_bg_pool_submit(ubuntu_bg_cb_t cb, void *arg,
+                           uintptr_t affinity_key) {
+  struct bg_pool *p = s_pool;
+  struct bg_worker *w = NULL;
+  if (p == NULL) return false;
+  struct bg_item it = {
+      .cb = cb,
+      .arg = arg,
+      .seq = atomic_fetch_add(&p->seq, 1),
+      .enq_time = bg_now_us(),
+  };
+  bool ok = false, was_sleeping = false;
+  int n = p->num_workers, i;
+  atomic_fetch_add(&p->num_submitted, 1);
+  if (affinity_key != 0) {
+    w = &p->workers[(affinity_key ^ (affinity_key >> 16)) % n];
+    pthread_mutex_lock(&w->lock);
+    ok = bg_deque_push_back(&w->pinned, &it);
+    if (ok && w->sleeping) {
+      pthread_cond_signal(&w->cond);
+      was_sleeping = true;
+    }
+  } else {
+    // Round-robin, skipping full queues.
+    unsigned int start = atomic_fetch_add(&p->next_worker, 1);
+    for (i = 0; i < n && !ok; i++) {
+      w = &p->workers[(start + i) % n];
+      pthread_mutex_lock(&w->lock);
+      ok = bg_deque_push_back(&w->shared, &it);
+      if (ok) {
+        atomic_fetch_add(&p->num_shared, 1);
+        if (w->sleeping) {
+          pthread_cond_signal(&w->cond);
+          was_sleeping = true;
+        }
+      } else {
+        pthread_mutex_unlock(&w->lock);
+      }
+    }
+  }
+  if (!ok) {
+    if (affinity_key != 0) pthread_mutex_unlock(&w->lock);
+    atomic_fetch_add(&p->num_rejected, 1);
+    return false;
+  }
+  uint32_t depth = w->pinned.len + w->shared.len;
+  if (depth > w->max_depth) w->max_depth = depth;
+  pthread_mutex_unlock(&w->lock);
+  // The target is busy, let someone else steal it.
+  if (affinity_key == 0 && !was_sleeping) {
+    for (i = 0; i < n; i++) {
+      if (&p->workers[i] != w && bg_worker_wake(&p->workers[i])) break;
+    }
+  }
+  return true;
+}
+
+// Stops and joins the first num_started workers, then frees the pool.
+static void bg_pool_destroy(struct bg_pool *p, int num_started) {
+  atomic_store(&p->stopping, true);
+  for (int i = 0; i < num_started; i++) {
+    bg_worker_wake(&p->workers[i]);
+  }
+  // Others may still be stealing from a worker that has exited, so nothing
+  // can be destroyed until all of them are done.
+  for (int i = 0; i < num_started; i++) {
+    pthread_join(p->workers[i].thread, NULL);
+  }
+  for (int i = 0; i < p->num_workers; i++) {
+    pthread_mutex_destroy(&p->workers[i].lock);
+    pthread_cond_destroy(&p->workers[i].cond);
+  }
+  s_pool = NULL;
+  free(p->workers);
+  free(p);
+}
+
+bool ubuntu_bg_pool_init(int num_workers) {
+  if (s_pool != NULL) return false;
+  // A single worker keeps the old semantics: callbacks run one at a time,
+  // in submission order. More workers must be asked for explicitly.
+  if (num_workers <= 0) num_workers = 1;
+  if (num_workers > UBUNTU_BG_POOL_MAX_WORKERS) {
+    num_workers = UBUNTU_BG_POOL_MAX_WORKERS;
+  }
+  struct bg_pool *p = (struct bg_pool *) calloc(1, sizeof(*p));
+  if (p == NULL) return false;
+  p->workers = (struct bg_worker *) calloc(num_workers, sizeof(*p->workers));
+  if (p->workers == NULL) {
+    free(p);
+    return false;
+  }
+  p->num_workers = num_workers;
+  for (int i = 0; i < num_workers; i++) {
+    pthread_mutex_init(&p->workers[i].lock, NULL);
+    pthread_cond_init(&p->workers[i].cond, NULL);
+  }
+  s_pool = p;
+  for (int i = 0; i < num_workers; i++) {
+    if (pthread_create(&p->workers[i].thread, NULL, bg_worker_main,
+                       &p->workers[i]) != 0) {
+      bg_pool_destroy(p, i);
+      return false;
+    }
+  }
+  return true;
+}
+
+void ubuntu_bg_pool_stop(void) {
+  if (s_pool == NULL) return;
+  bg_pool_destroy(s_pool, s_pool->num_workers);
+}
+
+void ubuntu_bg_pool_get_stats(struct ubuntu_bg_pool_stats *stats) {
+  struct bg_pool *p = s_pool;
+  memset(stats, 0, sizeof(*stats));
+  if (p == NULL) return;
+  stats->num_workers = p->num_workers;
+  stats->num_submitted = atomic_load(&p->num_submitted);
+  stats->num_rejected = atomic_load(&p->num_rejected);
+  for (int i = 0; i < p->num_workers; i++) {
+    struct bg_worker *w = &p->workers[i];
+    pthread_mutex_lock(&w->lock);
+    stats->queue_depth += w->pinned.len + w->shared.len;
+    if (w->max_depth > stats->max_queue_depth) {
+      stats->max_queue_depth = w->max_depth;
+    }
+    stats->num_run += w->num_run;
+    stats->num_stolen += w->num_stolen;
+    stats->wait_us_total += w->wait_us_total;
+    if (w->wait_us_max > stats->wait_us_max) {
+      stats->wait_us_max = w->wait_us_max;
+    }
+    stats->run_us_total += w->run_us_total;
+    if (w->run_us_max > stats->run_us_max) stats->run_us_max = w->run_us_max;
+    pthread_mutex_unlock(&w->lock);
+  }
+}
+
+void ubuntu_bg_pool_reset_stats(void) {
+  struct bg_pool *p = s_pool;
+  if (p == NULL) return;
+  atomic_store(&p->num_submitted, 0);
+  atomic_store(&p->num_rejected, 0);
+  for (int i = 0; i < p->num_workers; i++) {
+    struct bg_worker *w = &p->workers[i];
+    pthread_mutex_lock(&w->lock);
+    w->max_depth = w->num_run = w->num_stolen = 0;
+    w->wait_us_total = w->wait_us_max = 0;
+    w->run_us_total = w->run_us_max = 0;
+    pthread_mutex_unlock(&w->lock);
+  }
+}
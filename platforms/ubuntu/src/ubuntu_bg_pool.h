@@ -0,0 +1,79 @@
+/*
+ * Copyright 2019 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Pool of background workers that runs MGOS_INVOKE_CB_F_BG_TASK callbacks.
+//
+// Each worker has a deque of its own. Callbacks without an affinity key are
+// spread round-robin and idle workers steal them from the back of busy
+// workers' deques. Callbacks with the same non-zero affinity key always go
+// to the same worker and are never stolen, so they run one at a time and in
+// submission order.
+//
+// Apps reach it through mgos_invoke_cb(), mgos_invoke_cb_key() and
+// mgos_get_bg_cb_stats().
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#ifndef UBUNTU_BG_POOL_QUEUE_LEN
+#define UBUNTU_BG_POOL_QUEUE_LEN 64 /* Per worker */
+#endif
+
+#ifndef UBUNTU_BG_POOL_MAX_WORKERS
+#define UBUNTU_BG_POOL_MAX_WORKERS 64
+#endif
+
+typedef void (*ubuntu_bg_cb_t)(void *arg);
+
+// Starts the pool. num_workers <= 0 means 1.
+bool ubuntu_bg_pool_init(int num_workers);
+
+// Runs all the callbacks that have been submitted and stops the workers.
+void ubuntu_bg_pool_stop(void);
+
+// Queues cb for execution on a worker. Callbacks with the same non-zero
+// affinity_key are executed sequentially, in order.
+// Returns false if the target queue is full.
+bool ubuntu_bg_pool_submit(ubuntu_bg_cb_t cb, void *arg,
+                           uintptr_t affinity_key);
+
+struct ubuntu_bg_pool_stats {
+  int num_workers;
+  uint32_t queue_depth;     // Callbacks waiting to run, all workers.
+  uint32_t max_queue_depth; // Highest depth of a single worker's queue.
+  uint32_t num_submitted;
+  uint32_t num_rejected;    // Queue full.
+  uint32_t num_run;
+  uint32_t num_stolen;      // Run by a worker other than the one queued to.
+  double wait_us_total;     // Time from submission to start of execution.
+  double wait_us_max;
+  double run_us_total;      // Callback execution time.
+  double run_us_max;
+};
+
+void ubuntu_bg_pool_get_stats(struct ubuntu_bg_pool_stats *stats);
+
+void ubuntu_bg_pool_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
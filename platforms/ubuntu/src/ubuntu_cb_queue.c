@@ -0,0 +1,168 @@
+/*
+ * Copyright 2019 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Slots carry a sequence number (D. Vyukov's bounded queue): a slot at
+// position pos is free for a producer when seq == pos and holds data for the
+// consumer when seq == pos + 1. Producers claim positions with a CAS on tail;
+// the consumer is the only one moving head, so it needs no atomics there.
+
+#include "ubuntu_cb_queue.h"
+
+#include <poll.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "mgos_loop_stats.h"
+#if MGOS_ENABLE_LOOP_STATS
+#include "mgos_time.h"
+#endif
+
+struct ubuntu_cb_slot {
+  atomic_size_t seq;
+  ubuntu_cb_t cb;
+  void *arg;
+#if MGOS_ENABLE_LOOP_STATS
+  int64_t push_us;
+#endif
+};
+
+struct ubuntu_cb_queue {
+  // Producers and the consumer write to different cache lines.
+  _Alignas(64) atomic_size_t tail;
+  atomic_bool wakeup_pending;
+  _Alignas(64) size_t head;
+  size_t mask;
+  // Socket pair: wakeups are written to fds[1], fds[0] is polled. A socket
+  // rather than an eventfd so that mongoose can recv() from it.
+  int fds[2];
+  struct ubuntu_cb_slot slots[];
+};
+
+struct ubuntu_cb_queue *ubuntu_cb_queue_create(uint32_t capacity) {
+  size_t size = 1;
+  while (size < capacity) size <<= 1;
+  struct ubuntu_cb_queue *q = (struct ubuntu_cb_queue *) calloc(
+      1, sizeof(*q) + size * sizeof(q->slots[0]));
+  if (q == NULL) return NULL;
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                 q->fds) != 0) {
+    free(q);
+    return NULL;
+  }
+  q->mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&q->slots[i].seq, i);
+  }
+  atomic_init(&q->tail, 0);
+  atomic_init(&q->wakeup_pending, false);
+  return q;
+}
+
+bool ubuntu_cb_queue_wakeup(struct ubuntu_cb_queue *q) {
+  if (atomic_exchange(&q->wakeup_pending, true)) return false;
+  // Can only fail if the socket buffer is full, which still wakes us.
+  (void) !send(q->fds[1], "", 1, MSG_NOSIGNAL);
+  return true;
+}
+
+bool ubuntu_cb_queue_push(struct ubuntu_cb_queue *q, ubuntu_cb_t cb,
+                          void *arg) {
+  struct ubuntu_cb_slot *slot;
+  size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  for (;;) {
+    slot = &q->slots[pos & q->mask];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+              &q->tail, &pos, pos + 1, memory_order_relaxed,
+              memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false; /* Full */
+    } else {
+      pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+  }
+  slot->cb = cb;
+  slot->arg = arg;
+#if MGOS_ENABLE_LOOP_STATS
+  slot->push_us = mgos_uptime_micros();
+#endif
+  atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+  ubuntu_cb_queue_wakeup(q);
+  return true;
+}
+
+bool ubuntu_cb_queue_pop(struct ubuntu_cb_queue *q, ubuntu_cb_t *cb,
+                         void **arg) {
+  size_t pos = q->head;
+  struct ubuntu_cb_slot *slot = &q->slots[pos & q->mask];
+  size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+  if (seq != pos + 1) return false;
+  *cb = slot->cb;
+  *arg = slot->arg;
+#if MGOS_ENABLE_LOOP_STATS
+  mgos_loop_stats_record(MGOS_LOOP_STATS_INVOKE_WAIT,
+                         (uint32_t) (mgos_uptime_micros() - slot->push_us));
+#endif
+  atomic_store_explicit(&slot->seq, pos + q->mask + 1, memory_order_release);
+  q->head = pos + 1;
+  return true;
+}
+
+static bool ubuntu_cb_queue_empty(const struct ubuntu_cb_queue *q) {
+  const struct ubuntu_cb_slot *slot = &q->slots[q->head & q->mask];
+  return atomic_load_explicit(&slot->seq, memory_order_acquire) != q->head + 1;
+}
+
+int ubuntu_cb_queue_run(struct ubuntu_cb_queue *q) {
+  int n = 0;
+  char buf[16];
+  ubuntu_cb_t cb;
+  void *arg;
+  atomic_store(&q->wakeup_pending, false);
+  // Someone else (mongoose) may have read some or all of it already.
+  while (recv(q->fds[0], buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+  }
+  // Callbacks may enqueue more callbacks; don't let them starve the caller.
+  while (n <= (int) q->mask && ubuntu_cb_queue_pop(q, &cb, &arg)) {
+    cb(arg);
+    n++;
+  }
+  if (!ubuntu_cb_queue_empty(q)) ubuntu_cb_queue_wakeup(q);
+  return n;
+}
+
+int ubuntu_cb_queue_get_fd(const struct ubuntu_cb_queue *q) {
+  return q->fds[0];
+}
+
+void ubuntu_cb_queue_wait(struct ubuntu_cb_queue *q, int timeout_ms) {
+  struct pollfd pfd = {.fd = q->fds[0], .events = POLLIN};
+  poll(&pfd, 1, timeout_ms);
+}
+
+void ubuntu_cb_queue_destroy(struct ubuntu_cb_queue *q) {
+  if (q == NULL) return;
+  close(q->fds[0]);
+  close(q->fds[1]);
+  free(q);
+}
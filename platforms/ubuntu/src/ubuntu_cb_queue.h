@@ -0,0 +1,72 @@
+/*
+ * Copyright 2019 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Bounded lock-free multi-producer single-consumer queue of callbacks.
+//
+// Each slot holds the (cb, arg) pair inline, so pushing does not allocate.
+// Any thread may push; only one thread may pop. A socket becomes readable when
+// the queue goes from drained to non-empty, so the consumer can sleep in
+// poll() (or have mongoose do it) instead of spinning.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef void (*ubuntu_cb_t)(void *arg);
+
+struct ubuntu_cb_queue;
+
+// Creates a queue; capacity is rounded up to a power of 2.
+struct ubuntu_cb_queue *ubuntu_cb_queue_create(uint32_t capacity);
+
+// Enqueues a callback. Returns false if the queue is full.
+bool ubuntu_cb_queue_push(struct ubuntu_cb_queue *q, ubuntu_cb_t cb,
+                          void *arg);
+
+// Dequeues a callback. Must only be called from the consumer thread.
+// Returns false if the queue is empty.
+bool ubuntu_cb_queue_pop(struct ubuntu_cb_queue *q, ubuntu_cb_t *cb,
+                         void **arg);
+
+// Pops and runs all queued callbacks, re-arming the wakeup first so that
+// anything pushed concurrently either gets run now or signals the fd again.
+// Returns the number of callbacks run.
+int ubuntu_cb_queue_run(struct ubuntu_cb_queue *q);
+
+// Returns the socket which becomes readable when the queue needs draining.
+// Data read from it is irrelevant; it may be read by someone else, e.g. by
+// mongoose if added with mg_add_sock(), in which case the queue must not be
+// destroyed before the connection is closed.
+int ubuntu_cb_queue_get_fd(const struct ubuntu_cb_queue *q);
+
+// Blocks until the queue needs draining or timeout_ms expires (-1: forever).
+void ubuntu_cb_queue_wait(struct ubuntu_cb_queue *q, int timeout_ms);
+
+// Signals the socket without pushing anything, e.g. to make the consumer
+// re-run its loop. Wakeups are coalesced: only the first one after a drain
+// costs a syscall. Returns true if the fd was written to.
+bool ubuntu_cb_queue_wakeup(struct ubuntu_cb_queue *q);
+
+void ubuntu_cb_queue_destroy(struct ubuntu_cb_queue *q);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
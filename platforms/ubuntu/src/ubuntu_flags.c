@@ -32,6 +32,8 @@ static void ubuntu_flags_default(void) {
   Flags.chroot = realpath("./build/fs/", NULL);
 
   Flags.secure = true;
+  Flags.loop_stats = false;
+  Flags.bg_workers = 1;
   return;
 }
 
@@ -39,7 +41,8 @@ static void ubuntu_flags_usage(char *progname) {
   printf("Usage:\n");
   printf(
       "  %s [--secure|--insecure] [-u|--user <user>] [-g|--group <group>] "
-      "[-c|--chroot <dir>] [-h|--help]\n",
+      "[-c|--chroot <dir>] [-w|--bg-workers <n>] [--loop-stats] "
+      "[-h|--help]\n",
       basename(progname));
   printf("\n");
   printf(
@@ -55,6 +58,13 @@ static void ubuntu_flags_usage(char *progname) {
   printf(
       "  --insecure will allow to run without changing user, group, chroot, "
       "but this is not advised!\n");
+  printf(
+      "  --bg-workers <n> Number of threads running background "
+      "(MGOS_INVOKE_CB_F_BG_TASK) callbacks. Default: 1, which runs them "
+      "one at a time, in order. With more, they run concurrently.\n");
+  printf(
+      "  --loop-stats periodically logs main loop wakeups per second, to "
+      "check how much the process wakes up while idle.\n");
   printf("  --help prints this usage.\n");
   printf("\n");
   printf(
@@ -130,12 +140,14 @@ bool ubuntu_flags_init(int argc, char **argv) {
         {"chroot", required_argument, 0, 'c'},
         {"secure", no_argument, &Flags.secure, 1},
         {"insecure", no_argument, &Flags.secure, 0},
+        {"loop-stats", no_argument, &Flags.loop_stats, 1},
+        {"bg-workers", required_argument, 0, 'w'},
         {"help", no_argument, 0, 'h'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}};
     int option_index = 0;
 
-    c = getopt_long(argc, argv, "u:g:c:h", long_options, &option_index);
+    c = getopt_long(argc, argv, "u:g:c:w:h", long_options, &option_index);
 
     /* Detect the end of the options. */
     if (c == -1) {
@@ -193,6 +205,15 @@ bool ubuntu_flags_init(int argc, char **argv) {
         }
         break;
 
+      case 'w':
+        Flags.bg_workers = atoi(optarg);
+        if (Flags.bg_workers <= 0) {
+          printf("Invalid number of workers (you provided '%s').\n", optarg);
+          ok = false;
+          goto exit;
+        }
+        break;
+
       case 'h':
       case '?':
       default:
@@ -16,22 +16,26 @@
 
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
-#include "rpa_queue.h"
-
 #include "mgos_debug_internal.h"
 #include "mgos_init_internal.h"
+#include "mgos_loop_stats.h"
 #include "mgos_mongoose.h"
 #include "mgos_mongoose_internal.h"
 #include "mgos_net_hal.h"
 #include "mgos_sys_config.h"
+#include "mgos_time.h"
+#include "mgos_timers_internal.h"
 #include "mgos_uart_internal.h"
 #include "mgos_utils.h"
 #include "ubuntu.h"
+#include "ubuntu_bg_pool.h"
+#include "ubuntu_cb_queue.h"
 
 extern const char *build_version, *build_id;
 extern const char *mg_build_version, *mg_build_id;
@@ -41,13 +45,32 @@ struct ubuntu_flags Flags;
 static bool mongoose_running = false;
 static pid_t s_parent, s_child;
 
-struct cb_info {
-  void (*cb)(void *arg);
-  void *cb_arg;
+#ifndef UBUNTU_CB_QUEUE_LEN
+#define UBUNTU_CB_QUEUE_LEN 32
+#endif
+
+// Upper bound on how long the main loop sleeps when there's nothing to do.
+#ifndef UBUNTU_MAX_POLL_MS
+#define UBUNTU_MAX_POLL_MS 1000
+#endif
+
+#ifndef UBUNTU_LOOP_STATS_INTERVAL_MS
+#define UBUNTU_LOOP_STATS_INTERVAL_MS 10000
+#endif
+
+// Main loop wakeup accounting, only maintained with --loop-stats.
+struct ubuntu_loop_stats {
+  double start;
+  uint32_t num_wakeups;
+  uint32_t num_cb_wakeups;
+  uint32_t num_timer_wakeups;
+  uint32_t num_timers_fired;
+  atomic_uint num_poll_reqs;
+  atomic_uint num_poll_writes;
 };
+static struct ubuntu_loop_stats s_loop_stats;
 
-static rpa_queue_t *s_cbs_main = NULL;
-static rpa_queue_t *s_cbs_bg = NULL;
+static struct ubuntu_cb_queue *s_cbs_main = NULL;
 
 struct mgos_rlock_type *s_mgos_lock = NULL;
 
@@ -55,26 +78,63 @@ static void ubuntu_sigint_handler(int sig UNUSED_ARG) {
   mongoose_running = false;
 }
 
-static void *ubuntu_bg_task(void *arg UNUSED_ARG) {
-  LOG(LL_DEBUG, ("Background task started"));
-  struct cb_info *cbi = NULL;
-  while (rpa_queue_pop(s_cbs_bg, (void **) &cbi)) {
-    cbi->cb(cbi->cb_arg);
-    free(cbi);
+static void ubuntu_loop_stats_update(int num_cbs) {
+  struct ubuntu_loop_stats *ls = &s_loop_stats;
+  struct mgos_sw_timer_stats ts;
+  double now = mgos_uptime();
+  mgos_get_sw_timer_stats(&ts);
+  ls->num_wakeups++;
+  if (num_cbs > 0) {
+    ls->num_cb_wakeups++;
+  } else if (ts.num_fired != ls->num_timers_fired) {
+    ls->num_timer_wakeups++;
+  }
+  ls->num_timers_fired = ts.num_fired;
+  double elapsed = now - ls->start;
+  if (elapsed * 1000 < UBUNTU_LOOP_STATS_INTERVAL_MS) return;
+  uint32_t num_idle =
+      ls->num_wakeups - ls->num_cb_wakeups - ls->num_timer_wakeups;
+  LOG(LL_INFO,
+      ("Loop: %.1f wakeups/s (%.1f cb, %.1f timer, %.1f idle/io), "
+       "poll requests: %u, wakeup writes: %u",
+       ls->num_wakeups / elapsed, ls->num_cb_wakeups / elapsed,
+       ls->num_timer_wakeups / elapsed, num_idle / elapsed,
+       atomic_exchange(&ls->num_poll_reqs, 0),
+       atomic_exchange(&ls->num_poll_writes, 0)));
+  ls->start = now;
+  ls->num_wakeups = ls->num_cb_wakeups = ls->num_timer_wakeups = 0;
+}
+
+// The main queue's wakeup socket is added to the manager so that invoking a
+// callback from another thread wakes up mg_mgr_poll. The data read from it
+// is irrelevant, the queue itself is drained by the main loop.
+static void ubuntu_cbs_main_handler(struct mg_connection *nc, int ev,
+                                    void *ev_data UNUSED_ARG,
+                                    void *user_data UNUSED_ARG) {
+  if (ev == MG_EV_RECV) {
+    mbuf_remove(&nc->recv_mbuf, nc->recv_mbuf.len);
   }
-  LOG(LL_DEBUG, ("Background task exiting"));
-  return NULL;
 }
 
+#if MGOS_ENABLE_LOOP_STATS
+// mg_mgr_poll() sleeps in select(), so the work part of a main loop
+// iteration is measured with the main thread's CPU time.
+int64_t mgos_loop_stats_busy_micros(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
 static int ubuntu_mongoose(void) {
   enum mgos_init_result r;
-  pthread_t bg_task;
 
   s_mgos_lock = mgos_rlock_create();
 
-  assert(rpa_queue_create(&s_cbs_main, 32));
-  assert(rpa_queue_create(&s_cbs_bg, 32));
-  assert(pthread_create(&bg_task, NULL /* attr */, ubuntu_bg_task, NULL) == 0);
+  s_cbs_main = ubuntu_cb_queue_create(UBUNTU_CB_QUEUE_LEN);
+  if (s_cbs_main == NULL || !ubuntu_bg_pool_init(Flags.bg_workers)) {
+    return -1;
+  }
 
   ubuntu_set_boottime();
   ubuntu_set_nsleep100();
@@ -87,35 +147,58 @@ static int ubuntu_mongoose(void) {
     LOG(LL_ERROR,
         ("mongoose_init=%d (expecting %d), exiting", r, MGOS_INIT_OK));
     mgos_system_restart();
-    rpa_queue_term(s_cbs_bg);
-    pthread_join(bg_task, NULL /* retval */);
+    ubuntu_bg_pool_stop();
     return -3;
   }
+  mg_add_sock(mgos_get_mgr(), ubuntu_cb_queue_get_fd(s_cbs_main),
+              ubuntu_cbs_main_handler, NULL);
   mongoose_running = true;
   struct sigaction sa = {
       .sa_handler = ubuntu_sigint_handler,
   };
   sigaction(SIGINT, &sa, NULL);
+  s_loop_stats.start = mgos_uptime();
   while (mongoose_running) {
-    struct cb_info *cbi = NULL;
-    while (rpa_queue_trypop(s_cbs_main, (void **) &cbi)) {
-      cbi->cb(cbi->cb_arg);
-      free(cbi);
+    int num_cbs = ubuntu_cb_queue_run(s_cbs_main);
+    // Sleep until the next timer is due, a callback is invoked,
+    // mongoose_schedule_poll() is called or there's network activity.
+    int timeout_ms = mgos_get_sw_timer_next_due_ms();
+    if (timeout_ms < 0 || timeout_ms > UBUNTU_MAX_POLL_MS) {
+      timeout_ms = UBUNTU_MAX_POLL_MS;
     }
-    mongoose_poll(1);
+    mongoose_poll(timeout_ms);
+    if (Flags.loop_stats) ubuntu_loop_stats_update(num_cbs);
   }
-  rpa_queue_term(s_cbs_bg);
-  pthread_join(bg_task, NULL /* retval */);
+  ubuntu_bg_pool_stop();
   return 0;
 }
 
 bool mgos_invoke_cb(mgos_cb_t cb, void *arg, uint32_t flags) {
-  struct cb_info *cbi = (struct cb_info *) calloc(1, sizeof(*cbi));
-  if (cbi == NULL) return false;
-  cbi->cb = cb;
-  cbi->cb_arg = arg;
-  return rpa_queue_trypush(
-      ((flags & MGOS_INVOKE_CB_F_BG_TASK) ? s_cbs_bg : s_cbs_main), cbi);
+  if (flags & MGOS_INVOKE_CB_F_BG_TASK) {
+    return ubuntu_bg_pool_submit(cb, arg, 0 /* affinity_key */);
+  }
+  return ubuntu_cb_queue_push(s_cbs_main, cb, arg);
+}
+
+bool mgos_invoke_cb_key(mgos_cb_t cb, void *arg, uintptr_t key) {
+  return ubuntu_bg_pool_submit(cb, arg, key);
+}
+
+bool mgos_get_bg_cb_stats(struct mgos_bg_cb_stats *stats) {
+  struct ubuntu_bg_pool_stats st;
+  ubuntu_bg_pool_get_stats(&st);
+  stats->num_workers = st.num_workers;
+  stats->queue_depth = st.queue_depth;
+  stats->max_queue_depth = st.max_queue_depth;
+  stats->num_submitted = st.num_submitted;
+  stats->num_rejected = st.num_rejected;
+  stats->num_run = st.num_run;
+  stats->num_stolen = st.num_stolen;
+  stats->wait_us_total = st.wait_us_total;
+  stats->wait_us_max = st.wait_us_max;
+  stats->run_us_total = st.run_us_total;
+  stats->run_us_max = st.run_us_max;
+  return true;
 }
 
 static int ubuntu_main(void) {
@@ -189,16 +272,15 @@ int main(int argc, char *argv[]) {
   return ret;
 }
 
-static void dummy_handler(struct mg_connection *nc, int ev, void *ev_data,
-                          void *user_data) {
-  (void) nc;
-  (void) ev;
-  (void) ev_data;
-  (void) user_data;
-}
-
+// Requests made before the main loop drains the queue again are coalesced
+// into a single write to the wakeup socket.
 void mongoose_schedule_poll(bool from_isr) {
-  mg_broadcast(mgos_get_mgr(), dummy_handler, NULL, 0);
+  if (s_cbs_main == NULL) return;
+  bool written = ubuntu_cb_queue_wakeup(s_cbs_main);
+  if (Flags.loop_stats) {
+    atomic_fetch_add(&s_loop_stats.num_poll_reqs, 1);
+    if (written) atomic_fetch_add(&s_loop_stats.num_poll_writes, 1);
+  }
   (void) from_isr;
 }
 
@@ -32,3 +32,32 @@ int mg_json_printer_mbuf(struct json_out *out, const char *buf, size_t len) {
   mbuf_append((struct mbuf *) out->u.data, buf, len);
   return len;
 }
+
+int mg_json_vprintf_mbuf(struct mbuf *mb, const char *fmt, va_list ap) WEAK;
+int mg_json_vprintf_mbuf(struct mbuf *mb, const char *fmt, va_list ap) {
+  struct json_out out = JSON_OUT_MBUF(mb);
+  int n = json_vprintf_len(fmt, ap);
+  /* Grow once and print straight into the buffer (+1 for the NUL). */
+  if (n > 0 && mb->size - mb->len < (size_t) n + 1) {
+    mbuf_resize(mb, mb->len + n + 1);
+  }
+  if (n >= 0 && mb->size - mb->len >= (size_t) n + 1) {
+    struct json_out bout = JSON_OUT_BUF(mb->buf + mb->len, (size_t) n + 1);
+    if (json_vprintf(&bout, fmt, ap) == n) {
+      mb->len += n;
+      return n;
+    }
+  }
+  /* Out of memory or the output changed between the passes. */
+  return json_vprintf(&out, fmt, ap);
+}
+
+int mg_json_printf_mbuf(struct mbuf *mb, const char *fmt, ...) WEAK;
+int mg_json_printf_mbuf(struct mbuf *mb, const char *fmt, ...) {
+  int n;
+  va_list ap;
+  va_start(ap, fmt);
+  n = mg_json_vprintf_mbuf(mb, fmt, ap);
+  va_end(ap);
+  return n;
+}
@@ -84,6 +84,17 @@ struct frozen {
   size_t path_len;
   void *callback_data;
   json_walk_callback_t callback;
+  /* If set, the walk is stopped when the callback makes it non-zero. */
+  const int *stop;
+  int in_key;
+
+  /* See json_walk_nopath() */
+  int no_path;
+  /* See json_walk_paths() */
+  const char *const *filter;
+  int num_filter;
+  /* Paths are not built while longer than this, -1 if they are. */
+  int pruned_len;
 };
 
 struct fstate {
@@ -97,31 +108,74 @@ struct fstate {
 
 #define CALL_BACK(fr, tok, value, len)                                        \
   do {                                                                        \
-    if ((fr)->callback &&                                                     \
-        ((fr)->path_len == 0 || (fr)->path[(fr)->path_len - 1] != '.')) {     \
-      struct json_token t = {(value), (int) (len), (tok)};                    \
+    if ((fr)->callback && !(fr)->in_key) {                                    \
+      if ((fr)->filter == NULL || json_path_match(fr)) {                      \
+        struct json_token t = {(value), (int) (len), (tok)};                  \
                                                                               \
-      /* Call the callback with the given value and current name */           \
-      (fr)->callback((fr)->callback_data, (fr)->cur_name, (fr)->cur_name_len, \
-                     (fr)->path, &t);                                         \
+        /* Call the callback with the given value and current name */         \
+        (fr)->callback((fr)->callback_data, (fr)->cur_name,                   \
+                       (fr)->cur_name_len, (fr)->path, &t);                   \
+      }                                                                       \
                                                                               \
       /* Reset the name */                                                    \
       (fr)->cur_name = NULL;                                                  \
       (fr)->cur_name_len = 0;                                                 \
+      if ((fr)->stop != NULL && *(fr)->stop) return JSON_WALK_STOPPED;        \
     }                                                                         \
   } while (0)
 
+/* Not a parse error, returned when the walk is stopped by the callback. */
+#define JSON_WALK_STOPPED -100
+
+/* Returns true if the current path is one of the filter paths. */
+static int json_path_match(const struct frozen *f) {
+  int i;
+  if (f->pruned_len >= 0) return 0;
+  for (i = 0; i < f->num_filter; i++) {
+    if (strlen(f->filter[i]) == f->path_len &&
+        memcmp(f->filter[i], f->path, f->path_len) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Returns true if the current path leads to one of the filter paths. */
+static int json_path_prefix(const struct frozen *f) {
+  size_t n = f->path_len;
+  int i;
+  for (i = 0; i < f->num_filter; i++) {
+    const char *p = f->filter[i];
+    if (strncmp(p, f->path, n) == 0 &&
+        (p[n] == '\0' || p[n] == '.' || p[n] == '[' ||
+         (n > 0 && f->path[n - 1] == '.'))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 static int json_append_to_path(struct frozen *f, const char *str, int size) {
   int n = f->path_len;
   int left = sizeof(f->path) - n - 1;
+  if (f->no_path || f->pruned_len >= 0) return n;
   if (size > left) size = left;
   memcpy(f->path + n, str, size);
   f->path[n + size] = '\0';
   f->path_len += size;
+  /* Nothing below this path is wanted, stop building it. */
+  if (f->filter != NULL && size > 0 && !json_path_prefix(f)) {
+    f->pruned_len = n;
+  }
   return n;
 }
 
 static void json_truncate_path(struct frozen *f, size_t len) {
+  if (f->no_path) return;
+  if (f->pruned_len >= 0) {
+    if ((int) len > f->pruned_len) return;
+    f->pruned_len = -1;
+  }
   f->path_len = len;
   f->path[len] = '\0';
 }
@@ -150,7 +204,96 @@ static int json_isspace(int ch) {
   return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
 }
 
+#if JSON_ENABLE_SIMD
+#include <stdint.h>
+
+/*
+ * Each of the backends below provides a vector type, a load and byte-wise
+ * compares, and turns a compare result into a bit mask with
+ * JSON_SIMD_LANE_BITS bits per byte.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+typedef __m256i json_simd_t;
+#define JSON_SIMD_WIDTH 32
+#define JSON_SIMD_LANE_BITS 1
+#define json_simd_load(p) _mm256_loadu_si256((const __m256i *) (p))
+#define json_simd_eq(v, c) _mm256_cmpeq_epi8((v), _mm256_set1_epi8(c))
+#define json_simd_lt(v, c) _mm256_cmpgt_epi8(_mm256_set1_epi8(c), (v))
+#define json_simd_or(a, b) _mm256_or_si256((a), (b))
+#define json_simd_mask(v) ((uint64_t)(uint32_t) _mm256_movemask_epi8(v))
+#define JSON_SIMD_MASK_ALL 0xffffffffULL
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+typedef __m128i json_simd_t;
+#define JSON_SIMD_WIDTH 16
+#define JSON_SIMD_LANE_BITS 1
+#define json_simd_load(p) _mm_loadu_si128((const __m128i *) (p))
+#define json_simd_eq(v, c) _mm_cmpeq_epi8((v), _mm_set1_epi8(c))
+#define json_simd_lt(v, c) _mm_cmplt_epi8((v), _mm_set1_epi8(c))
+#define json_simd_or(a, b) _mm_or_si128((a), (b))
+#define json_simd_mask(v) ((uint64_t) _mm_movemask_epi8(v))
+#define JSON_SIMD_MASK_ALL 0xffffULL
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+typedef uint8x16_t json_simd_t;
+#define JSON_SIMD_WIDTH 16
+#define JSON_SIMD_LANE_BITS 4
+#define json_simd_load(p) vld1q_u8((const uint8_t *) (p))
+#define json_simd_eq(v, c) vceqq_u8((v), vdupq_n_u8(c))
+#define json_simd_lt(v, c) \
+  vcltq_s8(vreinterpretq_s8_u8(v), vdupq_n_s8(c))
+#define json_simd_or(a, b) vorrq_u8((a), (b))
+/* No movemask on NEON: narrow each byte to a nibble instead. */
+#define json_simd_mask(v)                                              \
+  vget_lane_u64(                                                       \
+      vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0)
+#define JSON_SIMD_MASK_ALL 0xffffffffffffffffULL
+#else
+#error JSON_ENABLE_SIMD is set but no SIMD instruction set is available
+#endif
+
+/* Returns the first non-whitespace character at or after `p`. */
+static const char *json_simd_skip_spaces(const char *p, const char *end) {
+  while (end - p >= JSON_SIMD_WIDTH) {
+    json_simd_t v = json_simd_load(p);
+    json_simd_t sp = json_simd_or(json_simd_or(json_simd_eq(v, ' '),
+                                               json_simd_eq(v, '\t')),
+                                  json_simd_or(json_simd_eq(v, '\r'),
+                                               json_simd_eq(v, '\n')));
+    uint64_t m = ~json_simd_mask(sp) & JSON_SIMD_MASK_ALL;
+    if (m != 0) return p + __builtin_ctzll(m) / JSON_SIMD_LANE_BITS;
+    p += JSON_SIMD_WIDTH;
+  }
+  return p;
+}
+
+/*
+ * Skips characters of a string that need no checks: printable ASCII except
+ * quote and backslash. Control and non-ASCII characters compare as less
+ * than 32 when signed.
+ */
+static const char *json_simd_skip_plain(const char *p, const char *end) {
+  while (end - p >= JSON_SIMD_WIDTH) {
+    json_simd_t v = json_simd_load(p);
+    json_simd_t sp = json_simd_or(json_simd_eq(v, '"'), json_simd_eq(v, '\\'));
+    sp = json_simd_or(sp, json_simd_lt(v, 32));
+    uint64_t m = json_simd_mask(sp);
+    if (m != 0) return p + __builtin_ctzll(m) / JSON_SIMD_LANE_BITS;
+    p += JSON_SIMD_WIDTH;
+  }
+  return p;
+}
+#endif /* JSON_ENABLE_SIMD */
+
 static void json_skip_whitespaces(struct frozen *f) {
+#if JSON_ENABLE_SIMD
+  /* Most runs are a single space, go wide only for longer ones. */
+  if (f->end - f->cur > 1 && json_isspace(f->cur[0]) &&
+      json_isspace(f->cur[1])) {
+    f->cur = json_simd_skip_spaces(f->cur, f->end);
+  }
+#endif
   while (f->cur < f->end && json_isspace(*f->cur)) f->cur++;
 }
 
@@ -237,6 +380,10 @@ static int json_parse_string(struct frozen *f) {
   {
     SET_STATE(f, f->cur, "", 0);
     for (; f->cur < f->end; f->cur += len) {
+#if JSON_ENABLE_SIMD
+      f->cur = json_simd_skip_plain(f->cur, f->end);
+      if (f->cur >= f->end) break;
+#endif
       ch = *(unsigned char *) f->cur;
       len = json_get_utf8_char_len((unsigned char) ch);
       EXPECT(ch >= 32 && len > 0, JSON_STRING_INVALID); /* No control chars */
@@ -300,12 +447,19 @@ static int json_parse_array(struct frozen *f) {
     {
       SET_STATE(f, f->cur - 1, "", 0);
       while (json_cur(f) != ']') {
-        snprintf(buf, sizeof(buf), "[%d]", i);
-        i++;
-        current_path_len = json_append_to_path(f, buf, strlen(buf));
-        f->cur_name =
-            f->path + strlen(f->path) - strlen(buf) + 1 /*opening brace*/;
-        f->cur_name_len = strlen(buf) - 2 /*braces*/;
+        /* "[i]", written backwards: this is too hot for snprintf. */
+        char *p = buf + sizeof(buf) - 1;
+        int j = i++;
+        *p = ']';
+        do {
+          *--p = '0' + j % 10;
+          j /= 10;
+        } while (j > 0);
+        *--p = '[';
+        current_path_len =
+            json_append_to_path(f, p, buf + sizeof(buf) - p);
+        f->cur_name = p + 1 /*opening brace*/;
+        f->cur_name_len = buf + sizeof(buf) - p - 2 /*braces*/;
         TRY(json_parse_value(f));
         json_truncate_path(f, current_path_len);
         if (json_cur(f) == ',') f->cur++;
@@ -383,6 +537,8 @@ static int json_parse_value(struct frozen *f) {
 /* key = identifier | string */
 static int json_parse_key(struct frozen *f) {
   int ch = json_cur(f);
+  /* Keys are not reported to the callback. */
+  f->in_key = 1;
   if (json_isalpha(ch)) {
     TRY(json_parse_identifier(f));
   } else if (ch == '"') {
@@ -390,6 +546,7 @@ static int json_parse_key(struct frozen *f) {
   } else {
     return ch == END_OF_STRING ? JSON_STRING_INCOMPLETE : JSON_STRING_INVALID;
   }
+  f->in_key = 0;
   return 0;
 }
 
@@ -442,6 +599,16 @@ int json_escape(struct json_out *out, const char *p, size_t len) {
 
   for (i = 0; i < len; i++) {
     unsigned char ch = ((unsigned char *) p)[i];
+    /* Runs of characters that need no escaping go out in one call. */
+    for (cl = i; cl < len; cl++) {
+      ch = ((unsigned char *) p)[cl];
+      if (ch == '"' || ch == '\\' || !isprint(ch)) break;
+    }
+    if (cl > i) {
+      n += out->printer(out, p + i, cl - i);
+      i = cl - 1;
+      continue;
+    }
     if (ch == '"' || ch == '\\') {
       n += out->printer(out, "\\", 1);
       n += out->printer(out, p + i, 1);
@@ -482,6 +649,31 @@ int json_printer_file(struct json_out *out, const char *buf, size_t len) {
   return fwrite(buf, 1, len, out->u.fp);
 }
 
+int json_printer_batch(struct json_out *out, const char *buf, size_t len) WEAK;
+int json_printer_batch(struct json_out *out, const char *buf, size_t len) {
+  struct json_out_batch *b = (struct json_out_batch *) out->u.data;
+  if (b->len + len > sizeof(b->buf)) json_out_batch_flush(b);
+  if (len >= sizeof(b->buf)) return b->dst->printer(b->dst, buf, len);
+  memcpy(b->buf + b->len, buf, len);
+  b->len += len;
+  return len;
+}
+
+void json_out_batch_init(struct json_out_batch *b, struct json_out *dst) WEAK;
+void json_out_batch_init(struct json_out_batch *b, struct json_out *dst) {
+  memset(&b->out, 0, sizeof(b->out));
+  b->out.printer = json_printer_batch;
+  b->out.u.data = b;
+  b->dst = dst;
+  b->len = 0;
+}
+
+void json_out_batch_flush(struct json_out_batch *b) WEAK;
+void json_out_batch_flush(struct json_out_batch *b) {
+  if (b->len > 0) b->dst->printer(b->dst, b->buf, b->len);
+  b->len = 0;
+}
+
 #if JSON_ENABLE_BASE64
 static int b64idx(int c) {
   if (c < 26) {
@@ -562,8 +754,9 @@ int json_vprintf(struct json_out *out, const char *fmt, va_list xap) {
 
   while (*fmt != '\0') {
     if (strchr(":, \r\n\t[]{}\"", *fmt) != NULL) {
-      len += out->printer(out, fmt, 1);
-      fmt++;
+      size_t n = strspn(fmt, ":, \r\n\t[]{}\"");
+      len += out->printer(out, fmt, n);
+      fmt += n;
     } else if (fmt[0] == '%') {
       char buf[21];
       size_t skip = 2;
@@ -589,12 +782,17 @@ int json_vprintf(struct json_out *out, const char *fmt, va_list xap) {
       } else if (fmt[1] == 'H') {
 #if JSON_ENABLE_HEX
         const char *hex = "0123456789abcdef";
-        int i, n = va_arg(ap, int);
+        char hbuf[32];
+        int i, hlen = 0, n = va_arg(ap, int);
         const unsigned char *p = va_arg(ap, const unsigned char *);
         len += out->printer(out, quote, 1);
         for (i = 0; i < n; i++) {
-          len += out->printer(out, &hex[(p[i] >> 4) & 0xf], 1);
-          len += out->printer(out, &hex[p[i] & 0xf], 1);
+          hbuf[hlen++] = hex[(p[i] >> 4) & 0xf];
+          hbuf[hlen++] = hex[p[i] & 0xf];
+          if (hlen == (int) sizeof(hbuf) || i == n - 1) {
+            len += out->printer(out, hbuf, hlen);
+            hlen = 0;
+          }
         }
         len += out->printer(out, quote, 1);
 #endif /* JSON_ENABLE_HEX */
@@ -730,11 +928,10 @@ int json_vprintf(struct json_out *out, const char *fmt, va_list xap) {
       }
       fmt += skip;
     } else if (*fmt == '_' || json_isalpha(*fmt)) {
+      const char *start = fmt;
+      while (*fmt == '_' || json_isalpha(*fmt) || json_isdigit(*fmt)) fmt++;
       len += out->printer(out, quote, 1);
-      while (*fmt == '_' || json_isalpha(*fmt) || json_isdigit(*fmt)) {
-        len += out->printer(out, fmt, 1);
-        fmt++;
-      }
+      len += out->printer(out, start, fmt - start);
       len += out->printer(out, quote, 1);
     } else {
       len += out->printer(out, fmt, 1);
@@ -756,6 +953,31 @@ int json_printf(struct json_out *out, const char *fmt, ...) {
   return n;
 }
 
+static int json_printer_count(struct json_out *out, const char *buf,
+                              size_t len) {
+  (void) out;
+  (void) buf;
+  return len;
+}
+
+int json_vprintf_len(const char *fmt, va_list ap) WEAK;
+int json_vprintf_len(const char *fmt, va_list ap) {
+  struct json_out out;
+  memset(&out, 0, sizeof(out));
+  out.printer = json_printer_count;
+  return json_vprintf(&out, fmt, ap);
+}
+
+int json_printf_len(const char *fmt, ...) WEAK;
+int json_printf_len(const char *fmt, ...) {
+  int n;
+  va_list ap;
+  va_start(ap, fmt);
+  n = json_vprintf_len(fmt, ap);
+  va_end(ap);
+  return n;
+}
+
 int json_printf_array(struct json_out *out, va_list *ap) WEAK;
 int json_printf_array(struct json_out *out, va_list *ap) {
   int len = 0;
@@ -805,21 +1027,411 @@ int cs_win_snprintf(char *str, size_t size, const char *format, ...) {
 }
 #endif /* _WIN32 */
 
+static void json_walk_init(struct frozen *f, const char *json_string,
+                           int json_string_length,
+                           json_walk_callback_t callback,
+                           void *callback_data) {
+  memset(f, 0, sizeof(*f));
+  f->end = json_string + json_string_length;
+  f->cur = json_string;
+  f->callback_data = callback_data;
+  f->callback = callback;
+  f->pruned_len = -1;
+}
+
+static int json_walk_run(struct frozen *f, const char *json_string) {
+  TRY(json_doit(f));
+
+  return f->cur - json_string;
+}
+
 int json_walk(const char *json_string, int json_string_length,
               json_walk_callback_t callback, void *callback_data) WEAK;
 int json_walk(const char *json_string, int json_string_length,
               json_walk_callback_t callback, void *callback_data) {
   struct frozen frozen;
+  json_walk_init(&frozen, json_string, json_string_length, callback,
+                 callback_data);
+  return json_walk_run(&frozen, json_string);
+}
+
+int json_walk_nopath(const char *json_string, int json_string_length,
+                     json_walk_callback_t callback, void *callback_data) WEAK;
+int json_walk_nopath(const char *json_string, int json_string_length,
+                     json_walk_callback_t callback, void *callback_data) {
+  struct frozen frozen;
+  json_walk_init(&frozen, json_string, json_string_length, callback,
+                 callback_data);
+  frozen.no_path = 1;
+  return json_walk_run(&frozen, json_string);
+}
+
+int json_walk_paths(const char *json_string, int json_string_length,
+                    const char *const *paths, int num_paths,
+                    json_walk_callback_t callback, void *callback_data) WEAK;
+int json_walk_paths(const char *json_string, int json_string_length,
+                    const char *const *paths, int num_paths,
+                    json_walk_callback_t callback, void *callback_data) {
+  struct frozen frozen;
+  json_walk_init(&frozen, json_string, json_string_length, callback,
+                 callback_data);
+  frozen.filter = paths;
+  frozen.num_filter = num_paths;
+  return json_walk_run(&frozen, json_string);
+}
+
+enum json_stream_state {
+  JSON_STREAM_VALUE,
+  JSON_STREAM_OBJ_KEY,
+  JSON_STREAM_KEY_STRING,
+  JSON_STREAM_KEY_IDENT,
+  JSON_STREAM_COLON,
+  JSON_STREAM_COMMA,
+  JSON_STREAM_ARR_ELEM,
+  JSON_STREAM_STRING,
+  JSON_STREAM_NUMBER,
+  JSON_STREAM_LITERAL,
+  JSON_STREAM_DONE,
+};
 
-  memset(&frozen, 0, sizeof(frozen));
-  frozen.end = json_string + json_string_length;
-  frozen.cur = json_string;
-  frozen.callback_data = callback_data;
-  frozen.callback = callback;
+static const struct {
+  const char *s;
+  enum json_token_type type;
+} s_json_literals[] = {
+    {"true", JSON_TYPE_TRUE},
+    {"false", JSON_TYPE_FALSE},
+    {"null", JSON_TYPE_NULL},
+};
+
+void json_walk_stream_init(struct json_walk_stream *s,
+                           json_walk_callback_t callback, void *callback_data)
+    WEAK;
+void json_walk_stream_init(struct json_walk_stream *s,
+                           json_walk_callback_t callback,
+                           void *callback_data) {
+  memset(s, 0, sizeof(*s));
+  s->callback = callback;
+  s->callback_data = callback_data;
+  s->state = JSON_STREAM_VALUE;
+  s->name_off = -1;
+}
+
+static int json_stream_append_to_path(struct json_walk_stream *s,
+                                      const char *str, int size) {
+  int n = s->path_len;
+  int left = sizeof(s->path) - n - 1;
+  if (size > left) size = left;
+  memcpy(s->path + n, str, size);
+  s->path[n + size] = '\0';
+  s->path_len += size;
+  return size;
+}
+
+static void json_stream_truncate_path(struct json_walk_stream *s, int len) {
+  s->path_len = len;
+  s->path[len] = '\0';
+}
+
+/* Path length for the children of the innermost container. */
+static int json_stream_base_len(const struct json_walk_stream *s) {
+  int len = s->path_lens[s->depth - 1];
+  if (!s->is_array[s->depth - 1] && len < (int) sizeof(s->path) - 1) len++;
+  return len;
+}
+
+static int json_stream_add_char(struct json_walk_stream *s, char ch) {
+  /* One byte is reserved for the NUL terminator. */
+  if (s->tok_len + 1 >= s->tok_size) {
+    int new_size = (s->tok_size > 0 ? s->tok_size * 2 : 32);
+    char *p = (char *) realloc(s->tok, new_size);
+    if (p == NULL) return JSON_NO_MEMORY;
+    s->tok = p;
+    s->tok_size = new_size;
+  }
+  s->tok[s->tok_len++] = ch;
+  return 0;
+}
+
+static void json_stream_call_back(struct json_walk_stream *s,
+                                  enum json_token_type type, const char *ptr,
+                                  int len) {
+  if (s->callback != NULL &&
+      (s->path_len == 0 || s->path[s->path_len - 1] != '.')) {
+    struct json_token t = {ptr, len, type};
+    s->callback(s->callback_data,
+                (s->name_off >= 0 ? s->path + s->name_off : NULL),
+                (s->name_off >= 0 ? (size_t) s->name_len : 0), s->path, &t);
+    s->name_off = -1;
+    s->name_len = 0;
+  }
+}
+
+/* Called after a value has been parsed. */
+static void json_stream_value_done(struct json_walk_stream *s) {
+  if (s->depth == 0) {
+    s->state = JSON_STREAM_DONE;
+    return;
+  }
+  json_stream_truncate_path(s, json_stream_base_len(s));
+  s->state = JSON_STREAM_COMMA;
+}
+
+static void json_stream_token_done(struct json_walk_stream *s,
+                                   enum json_token_type type) {
+  s->tok[s->tok_len] = '\0';
+  json_stream_call_back(s, type, s->tok, s->tok_len);
+  json_stream_value_done(s);
+}
+
+static int json_stream_container_start(struct json_walk_stream *s,
+                                       int is_array) {
+  if (s->depth == JSON_STREAM_MAX_DEPTH) return JSON_TOO_DEEP;
+  json_stream_call_back(
+      s, (is_array ? JSON_TYPE_ARRAY_START : JSON_TYPE_OBJECT_START), NULL, 0);
+  s->is_array[s->depth] = (unsigned char) is_array;
+  s->path_lens[s->depth] = (unsigned short) s->path_len;
+  s->idx[s->depth] = 0;
+  s->depth++;
+  if (!is_array) json_stream_append_to_path(s, ".", 1);
+  s->state = (is_array ? JSON_STREAM_ARR_ELEM : JSON_STREAM_OBJ_KEY);
+  return 0;
+}
+
+static void json_stream_container_end(struct json_walk_stream *s) {
+  int is_array = s->is_array[s->depth - 1];
+  json_stream_truncate_path(s, s->path_lens[s->depth - 1]);
+  s->depth--;
+  s->name_off = -1;
+  json_stream_call_back(
+      s, (is_array ? JSON_TYPE_ARRAY_END : JSON_TYPE_OBJECT_END), NULL, 0);
+  json_stream_value_done(s);
+}
+
+static void json_stream_key_done(struct json_walk_stream *s) {
+  s->name_off = s->path_len;
+  s->name_len = json_stream_append_to_path(s, s->tok, s->tok_len);
+  s->state = JSON_STREAM_COLON;
+}
+
+/* Same grammar as json_parse_number(), for a complete token. */
+static int json_stream_is_number(const char *p, int len) {
+  const char *end = p + len;
+  if (p < end && *p == '-') p++;
+  if (end - p > 2 && p[0] == '0' && p[1] == 'x') {
+    for (p += 2; p < end; p++) {
+      if (!json_isxdigit(*p)) return 0;
+    }
+    return 1;
+  }
+  if (p == end || !json_isdigit(*p)) return 0;
+  while (p < end && json_isdigit(*p)) p++;
+  if (p < end && *p == '.') {
+    if (++p == end || !json_isdigit(*p)) return 0;
+    while (p < end && json_isdigit(*p)) p++;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    if (p < end && (*p == '+' || *p == '-')) p++;
+    if (p == end || !json_isdigit(*p)) return 0;
+    while (p < end && json_isdigit(*p)) p++;
+  }
+  return p == end;
+}
+
+static int json_stream_is_number_char(int ch) {
+  return json_isxdigit(ch) || ch == '-' || ch == '+' || ch == '.' ||
+         ch == 'x';
+}
+
+/* Starts a value. Returns 1 if `ch` was consumed, 0 if not, or an error. */
+static int json_stream_value_start(struct json_walk_stream *s, int ch) {
+  size_t i;
+  s->tok_len = 0;
+  s->sub = 0;
+  switch (ch) {
+    case '"':
+      s->state = JSON_STREAM_STRING;
+      return 1;
+    case '{':
+      TRY(json_stream_container_start(s, 0));
+      return 1;
+#if JSON_ENABLE_ARRAY
+    case '[':
+      TRY(json_stream_container_start(s, 1));
+      return 1;
+#endif
+    default:
+      break;
+  }
+  if (ch == '-' || json_isdigit(ch)) {
+    s->state = JSON_STREAM_NUMBER;
+    return 0;
+  }
+  for (i = 0; i < sizeof(s_json_literals) / sizeof(s_json_literals[0]); i++) {
+    if (ch == s_json_literals[i].s[0]) {
+      s->sub = (int) i;
+      s->state = JSON_STREAM_LITERAL;
+      return 0;
+    }
+  }
+  return JSON_STRING_INVALID;
+}
+
+/*
+ * Adds a character of a string being parsed, s->sub tracks escapes.
+ * Returns 1 when the closing quote is reached.
+ */
+static int json_stream_string_char(struct json_walk_stream *s, int ch) {
+  if (s->sub == 0) {
+    if (ch == '"') return 1;
+    EXPECT(ch >= 32, JSON_STRING_INVALID); /* No control chars */
+    if (ch == '\\') s->sub = -1;
+  } else if (s->sub < 0) {
+    switch (ch) {
+      case 'u':
+        s->sub = 4;
+        break;
+      case '"':
+      case '\\':
+      case '/':
+      case 'b':
+      case 'f':
+      case 'n':
+      case 'r':
+      case 't':
+        s->sub = 0;
+        break;
+      default:
+        return JSON_STRING_INVALID;
+    }
+  } else {
+    EXPECT(json_isxdigit(ch), JSON_STRING_INVALID);
+    s->sub--;
+  }
+  TRY(json_stream_add_char(s, (char) ch));
+  return 0;
+}
+
+/* Processes one character. Returns 1 if it was consumed, 0 if not. */
+static int json_stream_char(struct json_walk_stream *s, int ch) {
+  int n;
+  switch (s->state) {
+    case JSON_STREAM_VALUE:
+      if (json_isspace(ch)) return 1;
+      return json_stream_value_start(s, ch);
+    case JSON_STREAM_OBJ_KEY:
+      if (json_isspace(ch)) return 1;
+      s->tok_len = 0;
+      s->sub = 0;
+      if (ch == '}') {
+        json_stream_container_end(s);
+        return 1;
+      } else if (ch == '"') {
+        s->state = JSON_STREAM_KEY_STRING;
+        return 1;
+      } else if (json_isalpha(ch)) {
+        s->state = JSON_STREAM_KEY_IDENT;
+        return 0;
+      }
+      return JSON_STRING_INVALID;
+    case JSON_STREAM_KEY_STRING:
+      TRY(n = json_stream_string_char(s, ch));
+      if (n == 1) json_stream_key_done(s);
+      return 1;
+    case JSON_STREAM_KEY_IDENT:
+      if (ch == '_' || json_isalpha(ch) || json_isdigit(ch)) {
+        TRY(json_stream_add_char(s, (char) ch));
+        return 1;
+      }
+      json_stream_key_done(s);
+      return 0;
+    case JSON_STREAM_COLON:
+      if (json_isspace(ch)) return 1;
+      EXPECT(ch == ':', JSON_STRING_INVALID);
+      s->state = JSON_STREAM_VALUE;
+      return 1;
+    case JSON_STREAM_COMMA:
+      /* Like json_walk(), commas between values are optional. */
+      if (json_isspace(ch)) return 1;
+      s->state = (s->is_array[s->depth - 1] ? JSON_STREAM_ARR_ELEM
+                                            : JSON_STREAM_OBJ_KEY);
+      return (ch == ',');
+    case JSON_STREAM_ARR_ELEM: {
+      char buf[20];
+      if (json_isspace(ch)) return 1;
+      if (ch == ']') {
+        json_stream_container_end(s);
+        return 1;
+      }
+      n = snprintf(buf, sizeof(buf), "[%d]", s->idx[s->depth - 1]++);
+      s->name_off = s->path_len + 1;
+      s->name_len = json_stream_append_to_path(s, buf, n) - 2;
+      if (s->name_len < 0) s->name_len = 0;
+      return json_stream_value_start(s, ch);
+    }
+    case JSON_STREAM_STRING:
+      TRY(n = json_stream_string_char(s, ch));
+      if (n == 1) json_stream_token_done(s, JSON_TYPE_STRING);
+      return 1;
+    case JSON_STREAM_NUMBER:
+      if (json_stream_is_number_char(ch)) {
+        TRY(json_stream_add_char(s, (char) ch));
+        return 1;
+      }
+      EXPECT(json_stream_is_number(s->tok, s->tok_len), JSON_STRING_INVALID);
+      json_stream_token_done(s, JSON_TYPE_NUMBER);
+      return 0;
+    case JSON_STREAM_LITERAL: {
+      const char *lit = s_json_literals[s->sub].s;
+      EXPECT(ch == lit[s->tok_len], JSON_STRING_INVALID);
+      TRY(json_stream_add_char(s, (char) ch));
+      if (lit[s->tok_len] == '\0') {
+        json_stream_token_done(s, s_json_literals[s->sub].type);
+      }
+      return 1;
+    }
+    case JSON_STREAM_DONE:
+      break;
+  }
+  return 1;
+}
 
-  TRY(json_doit(&frozen));
+int json_walk_stream_feed(struct json_walk_stream *s, const char *data,
+                          int len) WEAK;
+int json_walk_stream_feed(struct json_walk_stream *s, const char *data,
+                          int len) {
+  int i = 0;
+  while (s->err == 0 && s->state != JSON_STREAM_DONE && i < len) {
+    int n = json_stream_char(s, *(unsigned char *) (data + i));
+    if (n < 0) {
+      s->err = n;
+    } else if (n > 0) {
+      i++;
+      s->consumed++;
+    }
+  }
+  return s->err;
+}
 
-  return frozen.cur - json_string;
+int json_walk_stream_finish(struct json_walk_stream *s) WEAK;
+int json_walk_stream_finish(struct json_walk_stream *s) {
+  int res = s->err;
+  /* A number only ends when something else starts. */
+  if (res == 0 && s->state == JSON_STREAM_NUMBER && s->depth == 0) {
+    if (json_stream_is_number(s->tok, s->tok_len)) {
+      json_stream_token_done(s, JSON_TYPE_NUMBER);
+    } else {
+      res = JSON_STRING_INVALID;
+    }
+  }
+  if (res == 0) {
+    res = (s->state == JSON_STREAM_DONE ? s->consumed
+                                        : JSON_STRING_INCOMPLETE);
+  }
+  free(s->tok);
+  s->tok = NULL;
+  s->tok_size = s->tok_len = 0;
+  return res;
 }
 
 struct scan_array_info {
@@ -855,15 +1467,25 @@ int json_scanf_array_elem(const char *s, int len, const char *path, int idx,
   return info.found ? token->len : -1;
 }
 
+/* A single conversion of the format. */
 struct json_scanf_info {
-  int num_conversions;
-  char *path;
-  const char *fmt;
+  int path_off; /* In json_scanf_ctx::paths. */
+  int path_len;
+  bool allocated; /* Target holds a string malloc'd for an earlier match. */
+  char fmt[20];
   void *target;
   void *user_data;
   int type;
 };
 
+/* All the conversions of the format, satisfied in one walk. */
+struct json_scanf_ctx {
+  char *paths;
+  struct json_scanf_info *infos;
+  int num_infos;
+  int num_conversions;
+};
+
 int json_unescape(const char *src, int slen, char *dst, int dlen) WEAK;
 int json_unescape(const char *src, int slen, char *dst, int dlen) {
   char *send = (char *) src + slen, *dend = dst + dlen, *orig_dst = dst, *p;
@@ -898,31 +1520,27 @@ int json_unescape(const char *src, int slen, char *dst, int dlen) {
   return dst - orig_dst;
 }
 
-static void json_scanf_cb(void *callback_data, const char *name,
-                          size_t name_len, const char *path,
-                          const struct json_token *token) {
-  struct json_scanf_info *info = (struct json_scanf_info *) callback_data;
-  char buf[32]; /* Must be enough to hold numbers */
-
-  (void) name;
-  (void) name_len;
-
-  if (token->ptr == NULL) {
-    /*
-     * We're not interested here in the events for which we have no value;
-     * namely, JSON_TYPE_OBJECT_START and JSON_TYPE_ARRAY_START
-     */
-    return;
+/*
+ * Frees the string stored for an earlier occurrence of a duplicate key, the
+ * caller only gets the last one.
+ */
+static void json_scanf_free_prev(struct json_scanf_info *info, char **dst) {
+  if (info->allocated) {
+    free(*dst);
+    *dst = NULL;
+    info->allocated = false;
   }
+}
 
-  if (strcmp(path, info->path) != 0) {
-    /* It's not the path we're looking for, so, just ignore this callback */
-    return;
-  }
+/* Stores `token` in the target of `info`, returns number of conversions. */
+static int json_scanf_convert(struct json_scanf_info *info,
+                              const struct json_token *token) {
+  int num_conversions = 0;
+  char buf[32]; /* Must be enough to hold numbers */
 
   switch (info->type) {
     case 'B':
-      info->num_conversions++;
+      num_conversions++;
       switch (sizeof(bool)) {
         case sizeof(char):
           *(char *) info->target = (token->type == JSON_TYPE_TRUE ? 1 : 0);
@@ -940,22 +1558,24 @@ static void json_scanf_cb(void *callback_data, const char *name,
         void *p;
         json_scanner_t f;
       } u = {info->target};
-      info->num_conversions++;
+      num_conversions++;
       u.f(token->ptr, token->len, info->user_data);
       break;
     }
     case 'Q': {
       char **dst = (char **) info->target;
+      json_scanf_free_prev(info, dst);
       if (token->type == JSON_TYPE_NULL) {
         *dst = NULL;
       } else {
         int unescaped_len = json_unescape(token->ptr, token->len, NULL, 0);
         if (unescaped_len >= 0 &&
             (*dst = (char *) malloc(unescaped_len + 1)) != NULL) {
-          info->num_conversions++;
+          num_conversions++;
           if (json_unescape(token->ptr, token->len, *dst, unescaped_len) ==
               unescaped_len) {
             (*dst)[unescaped_len] = '\0';
+            info->allocated = true;
           } else {
             free(*dst);
             *dst = NULL;
@@ -968,13 +1588,15 @@ static void json_scanf_cb(void *callback_data, const char *name,
 #if JSON_ENABLE_HEX
       char **dst = (char **) info->user_data;
       int i, len = token->len / 2;
+      json_scanf_free_prev(info, dst);
       *(int *) info->target = len;
       if ((*dst = (char *) malloc(len + 1)) != NULL) {
         for (i = 0; i < len; i++) {
           (*dst)[i] = hexdec(token->ptr + 2 * i);
         }
         (*dst)[len] = '\0';
-        info->num_conversions++;
+        info->allocated = true;
+        num_conversions++;
       }
 #endif /* JSON_ENABLE_HEX */
       break;
@@ -983,17 +1605,19 @@ static void json_scanf_cb(void *callback_data, const char *name,
 #if JSON_ENABLE_BASE64
       char **dst = (char **) info->target;
       int len = token->len * 4 / 3 + 2;
+      json_scanf_free_prev(info, dst);
       if ((*dst = (char *) malloc(len + 1)) != NULL) {
         int n = b64dec(token->ptr, token->len, *dst);
         (*dst)[n] = '\0';
         *(int *) info->user_data = n;
-        info->num_conversions++;
+        info->allocated = true;
+        num_conversions++;
       }
 #endif /* JSON_ENABLE_BASE64 */
       break;
     }
     case 'T':
-      info->num_conversions++;
+      num_conversions++;
       *(struct json_token *) info->target = *token;
       break;
     default:
@@ -1012,7 +1636,7 @@ static void json_scanf_cb(void *callback_data, const char *name,
           } else {
             *((int *) info->target) = (int) r;
           }
-          info->num_conversions++;
+          num_conversions++;
         }
       } else if (info->fmt[1] == 'u' ||
                  (info->fmt[1] == 'l' && info->fmt[2] == 'u')) {
@@ -1024,23 +1648,67 @@ static void json_scanf_cb(void *callback_data, const char *name,
           } else {
             *((unsigned int *) info->target) = (unsigned int) r;
           }
-          info->num_conversions++;
+          num_conversions++;
         }
       } else {
 #if !JSON_MINIMAL
-        info->num_conversions += sscanf(buf, info->fmt, info->target);
+        num_conversions += sscanf(buf, info->fmt, info->target);
 #endif
       }
       break;
   }
+  return num_conversions;
 }
 
-int json_vscanf(const char *s, int len, const char *fmt, va_list ap) WEAK;
-int json_vscanf(const char *s, int len, const char *fmt, va_list ap) {
-  char path[JSON_MAX_PATH_LEN] = "", fmtbuf[20];
-  int i = 0;
+static void json_scanf_cb(void *callback_data, const char *name,
+                          size_t name_len, const char *path,
+                          const struct json_token *token) {
+  struct json_scanf_ctx *ctx = (struct json_scanf_ctx *) callback_data;
+  int i, path_len;
+
+  (void) name;
+  (void) name_len;
+
+  if (token->ptr == NULL) {
+    /*
+     * We're not interested here in the events for which we have no value;
+     * namely, JSON_TYPE_OBJECT_START and JSON_TYPE_ARRAY_START
+     */
+    return;
+  }
+
+  path_len = strlen(path);
+  for (i = 0; i < ctx->num_infos; i++) {
+    struct json_scanf_info *info = &ctx->infos[i];
+    if (info->path_len != path_len ||
+        memcmp(path, ctx->paths + info->path_off, path_len) != 0) {
+      /* It's not the path we're looking for, so, just ignore this callback */
+      continue;
+    }
+    /*
+     * Every occurrence is converted and counted, so the last one of a
+     * duplicate key wins. This is also why the walk can't stop early.
+     */
+    ctx->num_conversions += json_scanf_convert(info, token);
+  }
+}
+
+/*
+ * Compiles `fmt` into a table of conversions, so that the document is
+ * walked only once no matter how many conversions there are.
+ * Returns the number of conversions, 0 if out of memory.
+ */
+static int json_scanf_compile(const char *fmt, va_list ap,
+                              struct json_scanf_ctx *ctx) {
+  char path[JSON_MAX_PATH_LEN] = "", *paths = NULL;
+  int i = 0, n = 0, paths_len = 0;
   char *p = NULL;
-  struct json_scanf_info info = {0, path, fmtbuf, NULL, NULL, 0};
+
+  memset(ctx, 0, sizeof(*ctx));
+  for (p = (char *) fmt; (p = strchr(p, '%')) != NULL; p++) n++;
+  if (n == 0) return 0;
+  ctx->infos = (struct json_scanf_info *) calloc(n, sizeof(*ctx->infos));
+  if (ctx->infos == NULL) return 0;
 
   while (fmt[i] != '\0') {
     if (fmt[i] == '{') {
@@ -1050,13 +1718,25 @@ int json_vscanf(const char *s, int len, const char *fmt, va_list ap) {
       if ((p = strrchr(path, '.')) != NULL) *p = '\0';
       i++;
     } else if (fmt[i] == '%') {
-      info.target = va_arg(ap, void *);
-      info.type = fmt[i + 1];
+      struct json_scanf_info *info = &ctx->infos[ctx->num_infos++];
+      int path_len = strlen(path);
+      char *new_paths = (char *) realloc(paths, paths_len + path_len + 1);
+      if (new_paths == NULL) {
+        ctx->num_infos = 0;
+        break;
+      }
+      paths = new_paths;
+      info->path_off = paths_len;
+      info->path_len = path_len;
+      memcpy(paths + paths_len, path, path_len + 1);
+      paths_len += path_len + 1;
+      info->target = va_arg(ap, void *);
+      info->type = fmt[i + 1];
       switch (fmt[i + 1]) {
         case 'M':
         case 'V':
         case 'H':
-          info.user_data = va_arg(ap, void *);
+          info->user_data = va_arg(ap, void *);
         /* FALLTHROUGH */
         case 'B':
         case 'Q':
@@ -1066,15 +1746,17 @@ int json_vscanf(const char *s, int len, const char *fmt, va_list ap) {
         default: {
           const char *delims = ", \t\r\n]}";
           int conv_len = strcspn(fmt + i + 1, delims) + 1;
-          memcpy(fmtbuf, fmt + i, conv_len);
-          fmtbuf[conv_len] = '\0';
+          if (conv_len >= (int) sizeof(info->fmt)) {
+            conv_len = sizeof(info->fmt) - 1;
+          }
+          memcpy(info->fmt, fmt + i, conv_len);
+          info->fmt[conv_len] = '\0';
           i += conv_len;
           if (fmt[i] != '}')
             i += strspn(fmt + i, delims);
           break;
         }
       }
-      json_walk(s, len, json_scanf_cb, &info);
     } else if (json_isalpha(fmt[i]) || json_get_utf8_char_len(fmt[i]) > 1) {
       char *pe;
       const char *delims = ": \r\n\t";
@@ -1088,7 +1770,33 @@ int json_vscanf(const char *s, int len, const char *fmt, va_list ap) {
       i++;
     }
   }
-  return info.num_conversions;
+
+  ctx->paths = paths;
+  return ctx->num_infos;
+}
+
+static void json_scanf_ctx_free(struct json_scanf_ctx *ctx) {
+  free(ctx->paths);
+  free(ctx->infos);
+}
+
+int json_vscanf(const char *s, int len, const char *fmt, va_list ap) WEAK;
+int json_vscanf(const char *s, int len, const char *fmt, va_list ap) {
+  struct json_scanf_ctx ctx;
+  int i, n = json_scanf_compile(fmt, ap, &ctx);
+  const char **paths = (const char **) calloc(n, sizeof(*paths));
+  if (n > 0 && paths != NULL) {
+    struct frozen frozen;
+    for (i = 0; i < n; i++) paths[i] = ctx.paths + ctx.infos[i].path_off;
+    /* Only the paths of the conversions are built and reported. */
+    json_walk_init(&frozen, s, len, json_scanf_cb, &ctx);
+    frozen.filter = paths;
+    frozen.num_filter = n;
+    json_walk_run(&frozen, s);
+  }
+  free(paths);
+  json_scanf_ctx_free(&ctx);
+  return ctx.num_conversions;
 }
 
 int json_scanf(const char *str, int len, const char *fmt, ...) WEAK;
@@ -1101,6 +1809,214 @@ int json_scanf(const char *str, int len, const char *fmt, ...) {
   return result;
 }
 
+#if JSON_ENABLE_TAPE
+struct json_tape_build {
+  struct json_tape *tape;
+  int open; /* Innermost open container, -1 if none. */
+  int err;
+};
+
+static struct json_tape_entry *json_tape_add(struct json_tape_build *b) {
+  struct json_tape *t = b->tape;
+  if (t->num_entries == t->max_entries) {
+    int n = (t->max_entries > 0 ? t->max_entries * 2 : 32);
+    struct json_tape_entry *ne;
+    if (!t->own_entries && t->entries != NULL) return NULL;
+    ne = (struct json_tape_entry *) realloc(t->entries, n * sizeof(*ne));
+    if (ne == NULL) return NULL;
+    t->entries = ne;
+    t->max_entries = n;
+    t->own_entries = 1;
+  }
+  return &t->entries[t->num_entries++];
+}
+
+static void json_tape_cb(void *callback_data, const char *name,
+                         size_t name_len, const char *path,
+                         const struct json_token *token) {
+  struct json_tape_build *b = (struct json_tape_build *) callback_data;
+  struct json_tape *t = b->tape;
+  struct json_tape_entry *e;
+  (void) path;
+  if (token->type == JSON_TYPE_OBJECT_END ||
+      token->type == JSON_TYPE_ARRAY_END) {
+    /* Close the container, its skip held the parent while it was open. */
+    e = &t->entries[b->open];
+    b->open = e->skip;
+    e->type = token->type;
+    e->ofs = token->ptr - t->json;
+    e->len = token->len;
+    e->skip = t->num_entries - (e - t->entries);
+    return;
+  }
+  if ((e = json_tape_add(b)) == NULL) {
+    b->err = JSON_NO_MEMORY;
+    return;
+  }
+  memset(e, 0, sizeof(*e));
+  e->type = token->type;
+  /* Array elements are named by index, those names are not in the text. */
+  if (name != NULL && b->open >= 0 &&
+      t->entries[b->open].type == JSON_TYPE_OBJECT_START) {
+    e->key_ofs = name - t->json;
+    e->key_len = name_len;
+    e->has_key = 1;
+  }
+  if (token->type == JSON_TYPE_OBJECT_START ||
+      token->type == JSON_TYPE_ARRAY_START) {
+    e->skip = b->open;
+    b->open = e - t->entries;
+  } else {
+    e->ofs = token->ptr - t->json;
+    e->len = token->len;
+    e->skip = 1;
+  }
+}
+
+void json_tape_init(struct json_tape *t, struct json_tape_entry *entries,
+                    int max_entries) WEAK;
+void json_tape_init(struct json_tape *t, struct json_tape_entry *entries,
+                    int max_entries) {
+  memset(t, 0, sizeof(*t));
+  t->entries = entries;
+  t->max_entries = (entries != NULL ? max_entries : 0);
+}
+
+int json_tape_parse(struct json_tape *t, const char *json, int len) WEAK;
+int json_tape_parse(struct json_tape *t, const char *json, int len) {
+  struct frozen frozen;
+  struct json_tape_build b;
+  int res;
+  b.tape = t;
+  b.open = -1;
+  b.err = 0;
+  t->json = json;
+  t->num_entries = 0;
+  json_walk_init(&frozen, json, len, json_tape_cb, &b);
+  /* Only names are needed. */
+  frozen.no_path = 1;
+  frozen.stop = &b.err;
+  res = json_walk_run(&frozen, json);
+  if (b.err != 0) res = b.err;
+  if (res < 0) t->num_entries = 0;
+  return res;
+}
+
+void json_tape_free(struct json_tape *t) WEAK;
+void json_tape_free(struct json_tape *t) {
+  if (t->own_entries) free(t->entries);
+  memset(t, 0, sizeof(*t));
+}
+
+int json_tape_child(const struct json_tape *t, int parent, int prev) WEAK;
+int json_tape_child(const struct json_tape *t, int parent, int prev) {
+  int next;
+  if (parent < 0 || parent >= t->num_entries) return -1;
+  next = (prev < 0 ? parent + 1 : prev + t->entries[prev].skip);
+  return (next < parent + t->entries[parent].skip ? next : -1);
+}
+
+static int json_tape_find_key(const struct json_tape *t, int obj,
+                              const char *key, int key_len) {
+  int i;
+  if (t->entries[obj].type != JSON_TYPE_OBJECT_END) return -1;
+  for (i = json_tape_child(t, obj, -1); i >= 0;
+       i = json_tape_child(t, obj, i)) {
+    const struct json_tape_entry *e = &t->entries[i];
+    if ((int) e->key_len == key_len &&
+        memcmp(t->json + e->key_ofs, key, key_len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int json_tape_elem(const struct json_tape *t, int arr, int idx) WEAK;
+int json_tape_elem(const struct json_tape *t, int arr, int idx) {
+  int i;
+  if (arr < 0 || arr >= t->num_entries || idx < 0 ||
+      t->entries[arr].type != JSON_TYPE_ARRAY_END) {
+    return -1;
+  }
+  for (i = json_tape_child(t, arr, -1); i >= 0 && idx > 0; idx--) {
+    i = json_tape_child(t, arr, i);
+  }
+  return i;
+}
+
+static int json_tape_find_n(const struct json_tape *t, int idx,
+                            const char *path, int path_len) {
+  const char *p = path, *end = path + path_len;
+  while (p < end && idx >= 0) {
+    if (*p == '.') {
+      const char *k = ++p;
+      while (p < end && *p != '.' && *p != '[') p++;
+      idx = json_tape_find_key(t, idx, k, p - k);
+    } else if (*p == '[') {
+      int n = 0;
+      for (p++; p < end && json_isdigit(*p); p++) n = n * 10 + (*p - '0');
+      if (p >= end || *p != ']') return -1;
+      p++;
+      idx = json_tape_elem(t, idx, n);
+    } else {
+      return -1;
+    }
+  }
+  return idx;
+}
+
+int json_tape_find(const struct json_tape *t, int idx, const char *path) WEAK;
+int json_tape_find(const struct json_tape *t, int idx, const char *path) {
+  if (idx < 0 || idx >= t->num_entries) return -1;
+  return json_tape_find_n(t, idx, path, strlen(path));
+}
+
+void json_tape_token(const struct json_tape *t, int idx,
+                     struct json_token *value, struct json_token *key) WEAK;
+void json_tape_token(const struct json_tape *t, int idx,
+                     struct json_token *value, struct json_token *key) {
+  const struct json_tape_entry *e = &t->entries[idx];
+  if (value != NULL) {
+    value->ptr = t->json + e->ofs;
+    value->len = e->len;
+    value->type = (enum json_token_type) e->type;
+  }
+  if (key != NULL) {
+    key->ptr = (e->has_key ? t->json + e->key_ofs : NULL);
+    key->len = e->key_len;
+    key->type = (e->has_key ? JSON_TYPE_STRING : JSON_TYPE_INVALID);
+  }
+}
+
+int json_tape_vscanf(const struct json_tape *t, const char *fmt,
+                     va_list ap) WEAK;
+int json_tape_vscanf(const struct json_tape *t, const char *fmt, va_list ap) {
+  struct json_scanf_ctx ctx;
+  int i, n = json_scanf_compile(fmt, ap, &ctx);
+  for (i = 0; i < n && t->num_entries > 0; i++) {
+    struct json_scanf_info *info = &ctx.infos[i];
+    struct json_token tok;
+    int idx = json_tape_find_n(t, 0, ctx.paths + info->path_off,
+                               info->path_len);
+    if (idx < 0) continue;
+    json_tape_token(t, idx, &tok, NULL);
+    ctx.num_conversions += json_scanf_convert(info, &tok);
+  }
+  json_scanf_ctx_free(&ctx);
+  return ctx.num_conversions;
+}
+
+int json_tape_scanf(const struct json_tape *t, const char *fmt, ...) WEAK;
+int json_tape_scanf(const struct json_tape *t, const char *fmt, ...) {
+  int result;
+  va_list ap;
+  va_start(ap, fmt);
+  result = json_tape_vscanf(t, fmt, ap);
+  va_end(ap);
+  return result;
+}
+#endif /* JSON_ENABLE_TAPE */
+
 int json_vfprintf(const char *file_name, const char *fmt, va_list ap) WEAK;
 int json_vfprintf(const char *file_name, const char *fmt, va_list ap) {
   int res = -1;
@@ -1442,25 +2358,50 @@ void *json_next_elem(const char *s, int len, void *handle, const char *path,
   return json_next(s, len, handle, path, NULL, val, idx);
 }
 
+/* Heap buffer for json_vasprintf, at least doubled when it fills up. */
+struct json_sbuf {
+  char *buf;
+  size_t size;
+  size_t len;
+  int oom;
+};
+
 static int json_sprinter(struct json_out *out, const char *str, size_t len) {
-  size_t old_len = out->u.buf.buf == NULL ? 0 : strlen(out->u.buf.buf);
-  size_t new_len = len + old_len;
-  char *p = (char *) realloc(out->u.buf.buf, new_len + 1);
-  if (p != NULL) {
-    memcpy(p + old_len, str, len);
-    p[new_len] = '\0';
-    out->u.buf.buf = p;
+  struct json_sbuf *sb = (struct json_sbuf *) out->u.data;
+  size_t new_len = sb->len + len;
+  if (sb->oom) return len;
+  if (new_len + 1 > sb->size) {
+    size_t size = sb->size * 2;
+    char *p;
+    if (size < new_len + 1) size = new_len + 1;
+    if (size < 64) size = 64;
+    if ((p = (char *) realloc(sb->buf, size)) == NULL) {
+      sb->oom = 1;
+      return len;
+    }
+    sb->buf = p;
+    sb->size = size;
   }
+  memcpy(sb->buf + sb->len, str, len);
+  sb->len = new_len;
+  sb->buf[new_len] = '\0';
   return len;
 }
 
 char *json_vasprintf(const char *fmt, va_list ap) WEAK;
 char *json_vasprintf(const char *fmt, va_list ap) {
+  struct json_sbuf sb;
   struct json_out out;
+  memset(&sb, 0, sizeof(sb));
   memset(&out, 0, sizeof(out));
   out.printer = json_sprinter;
+  out.u.data = &sb;
   json_vprintf(&out, fmt, ap);
-  return out.u.buf.buf;
+  if (sb.oom) {
+    free(sb.buf);
+    return NULL;
+  }
+  return sb.buf;
 }
 
 char *json_asprintf(const char *fmt, ...) WEAK;
@@ -66,6 +66,8 @@ struct json_token {
 /* Error codes */
 #define JSON_STRING_INVALID -1
 #define JSON_STRING_INCOMPLETE -2
+#define JSON_TOO_DEEP -3
+#define JSON_NO_MEMORY -4
 
 /*
  * Callback-based SAX-like API.
@@ -105,6 +107,23 @@ typedef void (*json_walk_callback_t)(void *callback_data, const char *name,
 int json_walk(const char *json_string, int json_string_length,
               json_walk_callback_t callback, void *callback_data);
 
+/*
+ * Same as `json_walk()`, but paths are not built, `path` is always "".
+ * Faster, for callbacks that only need `name` and the value.
+ */
+int json_walk_nopath(const char *json_string, int json_string_length,
+                     json_walk_callback_t callback, void *callback_data);
+
+/*
+ * Same as `json_walk()`, but `callback` is only invoked for values at
+ * `paths`, e.g. ".foo.bar" or ".baz[1]". For objects and arrays, that is
+ * their start and end. Paths are not built for the parts of the document
+ * that cannot lead to any of `paths`.
+ */
+int json_walk_paths(const char *json_string, int json_string_length,
+                    const char *const *paths, int num_paths,
+                    json_walk_callback_t callback, void *callback_data);
+
 /*
  * JSON generation API.
  * struct json_out abstracts output, allowing alternative printing plugins.
@@ -138,6 +157,33 @@ extern int json_printer_file(struct json_out *, const char *, size_t);
     }                       \
   }
 
+/*
+ * Batching adapter: collects small writes in `buf` and forwards them to
+ * `dst` in chunks of up to JSON_OUT_BATCH_SIZE bytes. Print into `out`
+ * and call `json_out_batch_flush()` when done.
+ *
+ * ```c
+ *   struct json_out_batch b;
+ *   json_out_batch_init(&b, &dst);
+ *   json_printf(&b.out, "{a: %d}", 1);
+ *   json_out_batch_flush(&b);
+ * ```
+ */
+#ifndef JSON_OUT_BATCH_SIZE
+#define JSON_OUT_BATCH_SIZE 256
+#endif
+
+struct json_out_batch {
+  struct json_out out;
+  struct json_out *dst;
+  size_t len;
+  char buf[JSON_OUT_BATCH_SIZE];
+};
+
+extern int json_printer_batch(struct json_out *, const char *, size_t);
+void json_out_batch_init(struct json_out_batch *b, struct json_out *dst);
+void json_out_batch_flush(struct json_out_batch *b);
+
 typedef int (*json_printf_callback_t)(struct json_out *, va_list *ap);
 
 /*
@@ -158,6 +204,14 @@ typedef int (*json_printf_callback_t)(struct json_out *, va_list *ap);
 int json_printf(struct json_out *, const char *fmt, ...);
 int json_vprintf(struct json_out *, const char *fmt, va_list ap);
 
+/*
+ * Returns the number of bytes json_printf would print, without printing.
+ * Can be used to allocate the output buffer up front. %M callbacks are
+ * invoked, so they should print the same output every time.
+ */
+int json_printf_len(const char *fmt, ...);
+int json_vprintf_len(const char *fmt, va_list ap);
+
 /*
  * Same as json_printf, but prints to a file.
  * File is created if does not exist. File is truncated if already exists.
@@ -209,6 +263,9 @@ int json_printf_array(struct json_out *, va_list *ap);
  *    - %M: consumes custom scanning function pointer and
  *       `void *user_data` parameter - see json_scanner_t definition.
  *    - %T: consumes `struct json_token *`, fills it out with matched token.
+ * 4. If a key occurs more than once, every occurrence is converted and
+ *    counted in the return value, the last one wins. Strings allocated
+ *    for the earlier ones are freed.
  *
  * Return number of elements successfully scanned & converted.
  * Negative number means scan error.
@@ -322,6 +379,172 @@ void *json_next_elem(const char *s, int len, void *handle, const char *path,
 #define JSON_ENABLE_HEX !JSON_MINIMAL
 #endif
 
+/*
+ * Scan whitespace and strings 16 or 32 bytes at a time with SSE2, AVX2 or
+ * NEON. Enabled by default when building for a CPU with SSE2 or AVX2, other
+ * targets use the byte by byte code. The NEON backend has not been tested
+ * yet, it is only used if JSON_ENABLE_SIMD is set to 1 explicitly.
+ */
+#ifndef JSON_ENABLE_SIMD
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__AVX2__))
+#define JSON_ENABLE_SIMD 1
+#else
+#define JSON_ENABLE_SIMD 0
+#endif
+#endif
+
+#ifndef JSON_ENABLE_TAPE
+#define JSON_ENABLE_TAPE !JSON_MINIMAL
+#endif
+
+#ifndef JSON_STREAM_MAX_DEPTH
+#define JSON_STREAM_MAX_DEPTH 16
+#endif
+
+/*
+ * Incremental version of `json_walk()`, for input that arrives in chunks,
+ * e.g. is read from a file. Only the current token is kept in memory, so
+ * memory use depends on the longest string in the input rather than on
+ * the input size.
+ *
+ * Callbacks are the same as for `json_walk()`, with these differences:
+ *   - For JSON_TYPE_OBJECT_END and JSON_TYPE_ARRAY_END value is NULL,
+ *     the text of the whole object or array is not available.
+ *   - `name` and the value point to internal buffers that are only valid
+ *     during the callback. The value is NUL-terminated.
+ *   - Nesting depth is limited to JSON_STREAM_MAX_DEPTH.
+ *
+ * ```c
+ * struct json_walk_stream s;
+ * json_walk_stream_init(&s, cb, cb_data);
+ * while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+ *   if (json_walk_stream_feed(&s, buf, n) < 0) break;
+ * }
+ * res = json_walk_stream_finish(&s);
+ * ```
+ */
+struct json_walk_stream {
+  /* Private state, do not access directly. */
+  json_walk_callback_t callback;
+  void *callback_data;
+  int state, sub, err, consumed;
+  char *tok;
+  int tok_len, tok_size;
+  int name_off, name_len;
+  int depth;
+  unsigned char is_array[JSON_STREAM_MAX_DEPTH];
+  unsigned short path_lens[JSON_STREAM_MAX_DEPTH];
+  int idx[JSON_STREAM_MAX_DEPTH];
+  char path[JSON_MAX_PATH_LEN];
+  int path_len;
+};
+
+void json_walk_stream_init(struct json_walk_stream *s,
+                           json_walk_callback_t callback, void *callback_data);
+
+/*
+ * Parses the next `len` bytes of input. Returns 0 or a negative error code,
+ * after an error the rest of the input is ignored. Input after the end of
+ * the top-level value is ignored too.
+ */
+int json_walk_stream_feed(struct json_walk_stream *s, const char *data,
+                          int len);
+
+/*
+ * Signals the end of input and frees the memory used by `s`, must always be
+ * called. Returns the same as `json_walk()` would for the whole input.
+ */
+int json_walk_stream_finish(struct json_walk_stream *s);
+
+#if JSON_ENABLE_TAPE
+/*
+ * Tape: a document parsed once into a flat array of values, for code that
+ * makes many queries against the same document.
+ *
+ * Values are stored in document order. Containers come before their
+ * contents and know the size of their subtree, so lookups skip over
+ * siblings' contents without looking at them. Tokens point into the
+ * original text, which must outlive the tape.
+ *
+ * Entries are either malloc-ed as needed or taken from a fixed array given
+ * to `json_tape_init()`, which suits devices with little RAM: a document
+ * with N values needs N * sizeof(struct json_tape_entry) bytes.
+ */
+struct json_tape_entry {
+  int ofs, len;  /* The value, as in struct json_token. */
+  int key_ofs;   /* The key, for values in objects. */
+  unsigned short key_len;
+  unsigned char type; /* As in struct json_token. */
+  unsigned char has_key;
+  int skip; /* Number of entries in the subtree, including this one. */
+};
+
+struct json_tape {
+  const char *json;
+  struct json_tape_entry *entries;
+  int num_entries;
+  int max_entries;
+  int own_entries;
+};
+
+/*
+ * Initializes the tape. If `entries` is not NULL, at most `max_entries`
+ * from it are used and nothing is allocated, otherwise entries are
+ * malloc-ed.
+ */
+void json_tape_init(struct json_tape *t, struct json_tape_entry *entries,
+                    int max_entries);
+
+/*
+ * Parses `json,len` into the tape, replacing what it held before.
+ * Returns the same as `json_walk()`, or JSON_NO_MEMORY if the entries
+ * run out. On error the tape is left empty.
+ * The root value is entry 0. Objects and arrays have the type of their end
+ * token (JSON_TYPE_OBJECT_END, JSON_TYPE_ARRAY_END), as in `%T` tokens.
+ */
+int json_tape_parse(struct json_tape *t, const char *json, int len);
+
+/* Frees the entries, if they were allocated by the tape. */
+void json_tape_free(struct json_tape *t);
+
+/*
+ * Finds the value at `path` relative to entry `idx`, e.g. ".foo.bar[2]".
+ * Returns the entry index, or -1 if not found.
+ */
+int json_tape_find(const struct json_tape *t, int idx, const char *path);
+
+/* Returns the index of element `idx` of array `arr`, or -1. */
+int json_tape_elem(const struct json_tape *t, int arr, int idx);
+
+/*
+ * Iterates over the contents of object or array `parent`. Returns the first
+ * child if `prev` is negative, the one after `prev` otherwise, -1 when done.
+ *
+ * ```c
+ * for (i = json_tape_child(t, obj, -1); i >= 0;
+ *      i = json_tape_child(t, obj, i)) {
+ *   json_tape_token(t, i, &val, &key);
+ * }
+ * ```
+ */
+int json_tape_child(const struct json_tape *t, int parent, int prev);
+
+/*
+ * Fills `value` and `key` for entry `idx`, either can be NULL. Values
+ * outside of objects have no key, `key->ptr` is set to NULL for them.
+ */
+void json_tape_token(const struct json_tape *t, int idx,
+                     struct json_token *value, struct json_token *key);
+
+/*
+ * Same as `json_scanf()`, but takes the values from the tape. Unlike
+ * `json_scanf()`, if a key occurs more than once, only the first
+ * occurrence is used.
+ */
+int json_tape_scanf(const struct json_tape *t, const char *fmt, ...);
+int json_tape_vscanf(const struct json_tape *t, const char *fmt, va_list ap);
+#endif /* JSON_ENABLE_TAPE */
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -20,13 +20,29 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "common/cs_crc32.h"
 #include "common/cs_dbg.h"
 #include "common/json_utils.h"
 #include "common/mbuf.h"
 #include "common/mg_str.h"
+#include "common/platform.h"
 #include "common/str_util.h"
 
 #include "mgos_config.h"
+#include "mgos_system.h"
+
+#ifndef MGOS_CONF_PARSE_CHUNK_SIZE
+#define MGOS_CONF_PARSE_CHUNK_SIZE 128
+#endif
+
+/* Maximum nesting of schema objects in a config file. */
+#ifndef MGOS_CONF_PARSE_MAX_DEPTH
+#define MGOS_CONF_PARSE_MAX_DEPTH 16
+#endif
+
+#ifndef MGOS_CONF_STR_CHUNK_SIZE
+#define MGOS_CONF_STR_CHUNK_SIZE 128
+#endif
 
 bool mgos_conf_check_access(const struct mg_str key, const char *acl) {
   return mgos_conf_check_access_n(key, mg_mk_str(acl));
@@ -53,64 +69,557 @@ bool mgos_conf_check_access_n(const struct mg_str key, struct mg_str acl) {
   return false;
 }
 
+enum acl_entry_type {
+  ACL_ENTRY_EXACT, /* "foo.bar" */
+  ACL_ENTRY_PREFIX, /* "foo.*" or "*" */
+  ACL_ENTRY_GLOB, /* Anything else, goes to mg_match_prefix_n(). */
+};
+
+struct acl_entry {
+  struct mg_str pat;
+  enum acl_entry_type type;
+  bool allow;
+};
+
+struct mgos_conf_acl {
+  struct mg_str src;
+  int num_entries;
+  struct acl_entry *entries;
+  /* Results for the entries of acl_schema, computed on first use. */
+  const struct mgos_conf_entry *acl_schema;
+  uint8_t *allow_bitmap;
+};
+
+static bool acl_is_literal(const struct mg_str s) {
+  for (size_t i = 0; i < s.len; i++) {
+    switch (s.p[i]) {
+      case '*':
+      case '?':
+      case '$':
+      case '|':
+        return false;
+    }
+  }
+  return true;
+}
+
+struct mgos_conf_acl *mgos_conf_acl_compile(const struct mg_str acl) {
+  struct mgos_conf_acl *cacl =
+      (struct mgos_conf_acl *) calloc(1, sizeof(*cacl));
+  struct mg_str rest, entry;
+  int n = 0;
+  if (cacl == NULL) return NULL;
+  cacl->src = mg_strdup_nul(acl);
+  if (acl.len > 0 && cacl->src.p == NULL) goto err;
+  for (rest = cacl->src; rest.len > 0;) {
+    rest = mg_next_comma_list_entry_n(rest, &entry, NULL);
+    if (rest.p == NULL) break;
+    n++;
+  }
+  if (n > 0) {
+    cacl->entries = (struct acl_entry *) calloc(n, sizeof(*cacl->entries));
+    if (cacl->entries == NULL) goto err;
+  }
+  for (rest = cacl->src; rest.len > 0;) {
+    rest = mg_next_comma_list_entry_n(rest, &entry, NULL);
+    if (rest.p == NULL) break;
+    if (entry.len == 0) continue;
+    struct acl_entry *ae = &cacl->entries[cacl->num_entries++];
+    ae->allow = (entry.p[0] != '-');
+    if (entry.p[0] == '-' || entry.p[0] == '+') {
+      entry.p++;
+      entry.len--;
+    }
+    ae->pat = entry;
+    if (acl_is_literal(entry)) {
+      ae->type = ACL_ENTRY_EXACT;
+    } else if (entry.len > 0 && entry.p[entry.len - 1] == '*' &&
+               acl_is_literal(mg_mk_str_n(entry.p, entry.len - 1))) {
+      ae->type = ACL_ENTRY_PREFIX;
+    } else {
+      ae->type = ACL_ENTRY_GLOB;
+    }
+  }
+  return cacl;
+err:
+  mgos_conf_acl_free(cacl);
+  return NULL;
+}
+
+struct mg_str mgos_conf_acl_get_src(const struct mgos_conf_acl *acl) {
+  return acl->src;
+}
+
+/* Same result as mg_match_prefix_n(ae->pat, key) == key.len. */
+static bool acl_entry_match(const struct acl_entry *ae,
+                            const struct mg_str key) {
+  if (key.len == 0) return (mg_match_prefix_n(ae->pat, key) == 0);
+  switch (ae->type) {
+    case ACL_ENTRY_EXACT:
+      return (key.len == ae->pat.len &&
+              mg_ncasecmp(key.p, ae->pat.p, key.len) == 0);
+    case ACL_ENTRY_PREFIX: {
+      /* "*" matches at least one character and does not cross '/'. */
+      const size_t plen = ae->pat.len - 1;
+      if (key.len <= plen || mg_ncasecmp(key.p, ae->pat.p, plen) != 0) {
+        return false;
+      }
+      return (memchr(key.p + plen, '/', key.len - plen) == NULL);
+    }
+    case ACL_ENTRY_GLOB:
+      break;
+  }
+  return (mg_match_prefix_n(ae->pat, key) == key.len);
+}
+
+bool mgos_conf_acl_check(const struct mgos_conf_acl *acl,
+                         const struct mg_str key) {
+  if (acl == NULL) return false;
+  for (int i = 0; i < acl->num_entries; i++) {
+    const struct acl_entry *ae = &acl->entries[i];
+    if (acl_entry_match(ae, key)) return ae->allow;
+  }
+  return false;
+}
+
+static void acl_fill_bitmap(struct mgos_conf_acl *acl,
+                            const struct mgos_conf_entry *obj,
+                            struct mbuf *path) {
+  const size_t path_len = path->len;
+  for (int i = 1; i <= obj->num_desc; i++) {
+    const struct mgos_conf_entry *e = obj + i;
+    if (path_len > 0) mbuf_append(path, ".", 1);
+    mbuf_append(path, e->key, strlen(e->key));
+    if (mgos_conf_acl_check(acl, mg_mk_str_n(path->buf, path->len))) {
+      int idx = (int) (e - acl->acl_schema);
+      acl->allow_bitmap[idx / 8] |= (1 << (idx % 8));
+    }
+    if (e->type == CONF_TYPE_OBJECT) {
+      acl_fill_bitmap(acl, e, path);
+      i += e->num_desc;
+    }
+    path->len = path_len;
+  }
+}
+
+bool mgos_conf_acl_check_entry(struct mgos_conf_acl *acl,
+                               const struct mgos_conf_entry *schema,
+                               const struct mgos_conf_entry *e) {
+  int idx = (int) (e - schema);
+  if (acl == NULL) return false;
+  if (acl->acl_schema != schema) {
+    struct mbuf path;
+    uint8_t *bm = (uint8_t *) realloc(acl->allow_bitmap,
+                                      (schema->num_desc + 1 + 7) / 8);
+    if (bm == NULL) return false;
+    memset(bm, 0, (schema->num_desc + 1 + 7) / 8);
+    acl->allow_bitmap = bm;
+    acl->acl_schema = schema;
+    if (mgos_conf_acl_check(acl, mg_mk_str_n("", 0))) bm[0] |= 1;
+    mbuf_init(&path, 0);
+    acl_fill_bitmap(acl, schema, &path);
+    mbuf_free(&path);
+  }
+  return (acl->allow_bitmap[idx / 8] & (1 << (idx % 8))) != 0;
+}
+
+void mgos_conf_acl_free(struct mgos_conf_acl *acl) {
+  if (acl == NULL) return;
+  mg_strfree(&acl->src);
+  free(acl->entries);
+  free(acl->allow_bitmap);
+  free(acl);
+}
+
 struct parse_ctx {
   const struct mgos_conf_entry *schema;
-  char *acl;
+  struct mgos_conf_acl *acl;
   void *cfg;
   int offset_adj;
   char **msg;
   bool result;
+  /* Object being parsed, NULL outside of the top level value. */
+  const struct mgos_conf_entry *obj;
+  /*
+   * Objects that were being parsed when the open ones started. A key may be
+   * a dotted path, so the parent in the schema is not necessarily it.
+   */
+  const struct mgos_conf_entry *obj_stack[MGOS_CONF_PARSE_MAX_DEPTH];
+  int depth;
+  /* Nesting depth inside a value that is not in the schema. */
+  int skip_depth;
+  /* For messages, see parse_path(). */
+  struct mbuf path;
 };
 
-const struct mgos_conf_entry *mgos_conf_find_schema_entry_s(
-    const struct mg_str path, const struct mgos_conf_entry *obj) {
-  int i;
-  const char *sep = mg_strchr(path, '.');
-  struct mg_str component =
-      mg_mk_str_n(path.p, (sep == NULL ? path.len : (size_t)(sep - path.p)));
-  for (i = 1; i <= obj->num_desc; i++) {
-    const struct mgos_conf_entry *e = obj + i;
-    if (mg_strcmp(component, mg_mk_str(e->key)) == 0) {
-      if (component.len == path.len) return e;
-      /* This is not the leaf component, so it must be an object. */
-      if (e->type != CONF_TYPE_OBJECT) return NULL;
-      return mgos_conf_find_schema_entry_s(
-          mg_mk_str_n(path.p + component.len + 1, path.len - component.len - 1),
-          e);
+/* Compares a key with a path component, same order as the generator's. */
+static int mgos_conf_key_cmp(const struct mg_str component, const char *key) {
+  size_t key_len = strlen(key);
+  size_t n = (component.len < key_len ? component.len : key_len);
+  int res = memcmp(component.p, key, n);
+  if (res != 0) return res;
+  return (component.len < key_len ? -1 : component.len > key_len);
+}
+
+static const struct mgos_conf_entry *mgos_conf_find_child(
+    const struct mgos_conf_entry *obj, const struct mg_str component) {
+  if (obj->sorted_children != NULL) {
+    const uint16_t *children = obj->sorted_children + 1;
+    int lo = 0, hi = obj->sorted_children[0] - 1;
+    while (lo <= hi) {
+      int mid = (lo + hi) / 2;
+      const struct mgos_conf_entry *e = obj + children[mid];
+      int res = mgos_conf_key_cmp(component, e->key);
+      if (res == 0) return e;
+      if (res < 0) {
+        hi = mid - 1;
+      } else {
+        lo = mid + 1;
+      }
     }
+    return NULL;
+  }
+  for (int i = 1; i <= obj->num_desc; i++) {
+    const struct mgos_conf_entry *e = obj + i;
+    if (mg_strcmp(component, mg_mk_str(e->key)) == 0) return e;
     if (e->type == CONF_TYPE_OBJECT) i += e->num_desc;
   }
   return NULL;
 }
 
+const struct mgos_conf_entry *mgos_conf_find_schema_entry_s(
+    const struct mg_str path, const struct mgos_conf_entry *obj) {
+  struct mg_str rest = path;
+  while (true) {
+    const char *sep = mg_strchr(rest, '.');
+    struct mg_str component =
+        mg_mk_str_n(rest.p, (sep == NULL ? rest.len : (size_t)(sep - rest.p)));
+    const struct mgos_conf_entry *e = mgos_conf_find_child(obj, component);
+    if (e == NULL || component.len == rest.len) return e;
+    /* This is not the leaf component, so it must be an object. */
+    if (e->type != CONF_TYPE_OBJECT) return NULL;
+    rest.p += component.len + 1;
+    rest.len -= component.len + 1;
+    obj = e;
+  }
+}
+
 const struct mgos_conf_entry *mgos_conf_find_schema_entry(
     const char *path, const struct mgos_conf_entry *obj) {
   return mgos_conf_find_schema_entry_s(mg_mk_str(path), obj);
 }
 
+/* Appends the path of `e` relative to `obj`, returns false if not found. */
+static bool mgos_conf_entry_path(const struct mgos_conf_entry *obj,
+                                 const struct mgos_conf_entry *e,
+                                 struct mbuf *out) {
+  for (int i = 1; i <= obj->num_desc; i++) {
+    const struct mgos_conf_entry *ce = obj + i;
+    if (e < ce || e > ce + ce->num_desc) {
+      if (ce->type == CONF_TYPE_OBJECT) i += ce->num_desc;
+      continue;
+    }
+    mbuf_append(out, ce->key, strlen(ce->key));
+    if (e == ce) return true;
+    mbuf_append(out, ".", 1);
+    return mgos_conf_entry_path(ce, e, out);
+  }
+  return false;
+}
+
+/*
+ * String pool. Config strings other than defaults are stored here once per
+ * distinct value and reference counted, so copying a config does not
+ * allocate. Strings are bump-allocated from chunks, a chunk is freed when
+ * the last string in it is. Live strings are indexed by an open addressing
+ * hash table, so interning does not scan the pool.
+ *
+ * Configs may be copied and freed by other tasks (e.g. RPC handlers), so
+ * the pool is protected by a lock. It is created on first use, which is
+ * loading the config on the main task during init.
+ */
+struct conf_str_chunk {
+  struct conf_str_chunk *next;
+  size_t size; /* Size of data. */
+  size_t used; /* Taken from the start of data. */
+  int num_strs;
+  int num_free; /* Free slots before used. */
+  char data[];
+};
+
+/* Precedes each string in a chunk. Strings with no refs are free slots. */
+struct conf_str_hdr {
+  uint16_t refs;
+  uint16_t len;
+};
+
+#define CONF_STR_MAX_LEN 0xffff
+#define CONF_STR_MAX_REFS 0xffff
+#define CONF_STR_ENTRY_SIZE(len) \
+  ((sizeof(struct conf_str_hdr) + (len) + 2) & ~((size_t) 1))
+#define CONF_STR_TAB_MIN_SIZE 16
+
+static struct mgos_rlock_type *s_str_lock = NULL;
+static struct conf_str_chunk *s_str_chunks = NULL;
+/* Hash table of live pooled strings, size is a power of 2. */
+static const char **s_str_tab = NULL;
+static size_t s_str_tab_size = 0, s_str_tab_count = 0;
+
+static void conf_str_lock(void) {
+  if (s_str_lock == NULL) s_str_lock = mgos_rlock_create();
+  mgos_rlock(s_str_lock);
+}
+
+static void conf_str_unlock(void) {
+  mgos_runlock(s_str_lock);
+}
+
+static struct conf_str_chunk *conf_str_chunk(const char *s) {
+  for (struct conf_str_chunk *c = s_str_chunks; c != NULL; c = c->next) {
+    if (s >= c->data && s < c->data + c->used) return c;
+  }
+  return NULL;
+}
+
+static struct conf_str_hdr *conf_str_hdr(const char *s) {
+  return (struct conf_str_hdr *) (s - sizeof(struct conf_str_hdr));
+}
+
+/* FNV-1a. */
+static size_t conf_str_hash(const char *s, size_t len) {
+  uint32_t h = 2166136261U;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (uint8_t) s[i]) * 16777619U;
+  }
+  return h;
+}
+
+static size_t conf_str_tab_idx(const char *s) {
+  return conf_str_hash(s, conf_str_hdr(s)->len) & (s_str_tab_size - 1);
+}
+
+/* Makes room for one more entry, keeps the load factor under 3/4. */
+static bool conf_str_tab_reserve(void) {
+  if ((s_str_tab_count + 1) * 4 <= s_str_tab_size * 3) return true;
+  size_t old_size = s_str_tab_size;
+  const char **old_tab = s_str_tab;
+  size_t size = (old_size > 0 ? old_size * 2 : CONF_STR_TAB_MIN_SIZE);
+  const char **tab = (const char **) calloc(size, sizeof(*tab));
+  if (tab == NULL) return false;
+  s_str_tab = tab;
+  s_str_tab_size = size;
+  for (size_t i = 0; i < old_size; i++) {
+    const char *s = old_tab[i];
+    if (s == NULL) continue;
+    size_t j = conf_str_tab_idx(s);
+    while (tab[j] != NULL) j = (j + 1) & (size - 1);
+    tab[j] = s;
+  }
+  free(old_tab);
+  return true;
+}
+
+static void conf_str_tab_add(const char *s) {
+  size_t i = conf_str_tab_idx(s);
+  while (s_str_tab[i] != NULL) i = (i + 1) & (s_str_tab_size - 1);
+  s_str_tab[i] = s;
+  s_str_tab_count++;
+}
+
+static void conf_str_tab_remove(const char *s) {
+  const size_t mask = s_str_tab_size - 1;
+  size_t i = conf_str_tab_idx(s), j;
+  while (s_str_tab[i] != s) i = (i + 1) & mask;
+  /* Shift back the following entries of the run so lookups still work. */
+  for (j = (i + 1) & mask; s_str_tab[j] != NULL; j = (j + 1) & mask) {
+    size_t k = conf_str_tab_idx(s_str_tab[j]);
+    if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+    s_str_tab[i] = s_str_tab[j];
+    i = j;
+  }
+  s_str_tab[i] = NULL;
+  if (--s_str_tab_count == 0) {
+    free(s_str_tab);
+    s_str_tab = NULL;
+    s_str_tab_size = 0;
+  }
+}
+
+/* Returns a slot for a string of `len`, NULL if out of memory. */
+static struct conf_str_hdr *conf_str_alloc(size_t len,
+                                           struct conf_str_chunk **cp) {
+  const size_t entry_size = CONF_STR_ENTRY_SIZE(len);
+  struct conf_str_chunk *c, *free_c = NULL;
+  struct conf_str_hdr *h;
+  for (c = s_str_chunks; c != NULL; c = c->next) {
+    /* Only chunks with holes are scanned, a fresh pool has none. */
+    for (size_t off = 0; c->num_free > 0 && off < c->used;
+         off += CONF_STR_ENTRY_SIZE(h->len)) {
+      h = (struct conf_str_hdr *) (c->data + off);
+      if (h->refs == 0 && h->len == len) {
+        c->num_free--;
+        *cp = c;
+        return h;
+      }
+    }
+    if (free_c == NULL && c->size - c->used >= entry_size) free_c = c;
+  }
+  if (free_c == NULL) {
+    size_t size = MGOS_CONF_STR_CHUNK_SIZE;
+    if (size < entry_size) size = entry_size;
+    free_c = (struct conf_str_chunk *) malloc(sizeof(*free_c) + size);
+    if (free_c == NULL) return NULL;
+    free_c->size = size;
+    free_c->used = 0;
+    free_c->num_strs = 0;
+    free_c->num_free = 0;
+    free_c->next = s_str_chunks;
+    s_str_chunks = free_c;
+  }
+  h = (struct conf_str_hdr *) (free_c->data + free_c->used);
+  free_c->used += entry_size;
+  *cp = free_c;
+  return h;
+}
+
+/* Returns a reference to a pooled copy of `s`, NULL if out of memory. */
+static const char *conf_str_intern(const char *s, size_t len) {
+  const char *res = NULL;
+  conf_str_lock();
+  if (s_str_tab_size > 0) {
+    const size_t mask = s_str_tab_size - 1;
+    for (size_t i = conf_str_hash(s, len) & mask; s_str_tab[i] != NULL;
+         i = (i + 1) & mask) {
+      struct conf_str_hdr *h = conf_str_hdr(s_str_tab[i]);
+      if (h->len == len && h->refs < CONF_STR_MAX_REFS &&
+          memcmp(h + 1, s, len) == 0) {
+        h->refs++;
+        res = s_str_tab[i];
+        goto out;
+      }
+    }
+  }
+  if (conf_str_tab_reserve()) {
+    struct conf_str_chunk *c;
+    struct conf_str_hdr *h = conf_str_alloc(len, &c);
+    if (h == NULL) goto out;
+    h->refs = 1;
+    h->len = (uint16_t) len;
+    memcpy(h + 1, s, len);
+    ((char *) (h + 1))[len] = '\0';
+    c->num_strs++;
+    res = (const char *) (h + 1);
+    conf_str_tab_add(res);
+  }
+out:
+  conf_str_unlock();
+  return res;
+}
+
+static void conf_str_release(struct conf_str_chunk *c, const char *s) {
+  struct conf_str_hdr *h = conf_str_hdr(s);
+  if (--h->refs > 0) return;
+  conf_str_tab_remove(s);
+  if (--c->num_strs == 0) {
+    struct conf_str_chunk **cp = &s_str_chunks;
+    while (*cp != c) cp = &(*cp)->next;
+    *cp = c->next;
+    free(c);
+    return;
+  }
+  /* The last string in a chunk can be reclaimed right away. */
+  if ((char *) h + CONF_STR_ENTRY_SIZE(h->len) == c->data + c->used) {
+    c->used = (size_t) ((char *) h - c->data);
+  } else {
+    c->num_free++;
+  }
+}
+
+/* Sets `*sp` to a copy of `s`, empty string is stored as NULL. */
+static bool conf_str_set_n(const char **sp, const char *s, size_t len) {
+  const char *ns = NULL;
+  if (len > CONF_STR_MAX_LEN) {
+    ns = mg_strdup_nul(mg_mk_str_n(s, len)).p;
+  } else if (len > 0) {
+    ns = conf_str_intern(s, len);
+  }
+  if (len > 0 && ns == NULL) return false;
+  mgos_conf_free_str(sp);
+  *sp = ns;
+  return true;
+}
+
+void mgos_conf_str_pool_get_stats(struct mgos_conf_str_pool_stats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  conf_str_lock();
+  for (struct conf_str_chunk *c = s_str_chunks; c != NULL; c = c->next) {
+    stats->num_chunks++;
+    stats->size += c->size;
+    stats->used += c->used;
+    stats->num_strs += c->num_strs;
+  }
+  conf_str_unlock();
+}
+
+/* Returns the path of `e` for messages. */
+static const char *parse_path(struct parse_ctx *ctx,
+                              const struct mgos_conf_entry *e) {
+  ctx->path.len = 0;
+  if (e != ctx->schema) mgos_conf_entry_path(ctx->schema, e, &ctx->path);
+  mbuf_append(&ctx->path, "", 1);
+  return ctx->path.buf;
+}
+
+/*
+ * Keys are looked up by name in the object being parsed, so the walker
+ * does not need to build paths.
+ */
 void mgos_conf_parse_cb(void *data, const char *name, size_t name_len,
                         const char *path, const struct json_token *tok) {
   struct parse_ctx *ctx = (struct parse_ctx *) data;
   char *endptr = NULL;
-  if (tok->type == JSON_TYPE_OBJECT_START ||
-      tok->type == JSON_TYPE_OBJECT_END) {
+  bool start = (tok->type == JSON_TYPE_OBJECT_START ||
+                tok->type == JSON_TYPE_ARRAY_START);
+  bool end = (tok->type == JSON_TYPE_OBJECT_END ||
+              tok->type == JSON_TYPE_ARRAY_END);
+  (void) path;
+  if (!ctx->result) return;
+  if (ctx->skip_depth > 0) {
+    if (start) ctx->skip_depth++;
+    if (end) ctx->skip_depth--;
     return;
   }
-  if (!ctx->result) return;
-  const struct mgos_conf_entry *e;
-  if (path[0] == '.') {
-    path++;
-    e = mgos_conf_find_schema_entry(path, ctx->schema);
+  if (tok->type == JSON_TYPE_OBJECT_END) {
+    ctx->obj = ctx->obj_stack[--ctx->depth];
+    return;
+  }
+  const struct mgos_conf_entry *e = ctx->schema;
+  if (ctx->obj != NULL) {
+    e = mgos_conf_find_schema_entry_s(mg_mk_str_n(name, name_len), ctx->obj);
     if (e == NULL) {
-      LOG(LL_DEBUG, ("Unknown key [%s]", path));
+      LOG(LL_DEBUG, ("Unknown key [%.*s]", (int) name_len, name));
+      if (start) ctx->skip_depth = 1;
       return;
     }
-  } else {
-    e = ctx->schema;
   }
+  if (tok->type == JSON_TYPE_OBJECT_START) {
+    if (e->type != CONF_TYPE_OBJECT) {
+      ctx->skip_depth = 1;
+    } else if (ctx->depth == MGOS_CONF_PARSE_MAX_DEPTH) {
+      mg_asprintf(ctx->msg, 0, "[%s] is nested too deeply",
+                  parse_path(ctx, e));
+      ctx->result = false;
+    } else {
+      ctx->obj_stack[ctx->depth++] = ctx->obj;
+      ctx->obj = e;
+    }
+    return;
+  }
+  /* Arrays are checked as values, there are no arrays in the schema. */
+  if (tok->type == JSON_TYPE_ARRAY_START) ctx->skip_depth = 1;
 #ifndef MGOS_BOOT_BUILD
-  if (!mgos_conf_check_access(mg_mk_str(path), ctx->acl)) {
-    LOG(LL_ERROR, ("Not allowed to set [%s]", path));
+  if (!mgos_conf_acl_check_entry(ctx->acl, ctx->schema, e)) {
+    LOG(LL_ERROR, ("Not allowed to set [%s]", parse_path(ctx, e)));
     return;
   }
 #endif
@@ -129,7 +638,8 @@ void mgos_conf_parse_cb(void *data, const char *name, size_t name_len,
       /* fall through */
     case CONF_TYPE_UNSIGNED_INT:
       if (tok->type != JSON_TYPE_NUMBER) {
-        mg_asprintf(ctx->msg, 0, "[%s] is not a number", path);
+        mg_asprintf(ctx->msg, 0, "[%s] is not a number",
+                    parse_path(ctx, e));
         ctx->result = false;
         return;
       }
@@ -154,15 +664,16 @@ void mgos_conf_parse_cb(void *data, const char *name, size_t name_len,
           break;
       }
       if (endptr != tok->ptr + tok->len) {
-        mg_asprintf(ctx->msg, 0, "[%s] failed to parse [%.*s]", path,
-                    (int) tok->len, tok->ptr);
+        mg_asprintf(ctx->msg, 0, "[%s] failed to parse [%.*s]",
+                    parse_path(ctx, e), (int) tok->len, tok->ptr);
         ctx->result = false;
         return;
       }
       break;
     case CONF_TYPE_BOOL: {
       if (tok->type != JSON_TYPE_TRUE && tok->type != JSON_TYPE_FALSE) {
-        mg_asprintf(ctx->msg, 0, "[%s] is not a boolean", path);
+        mg_asprintf(ctx->msg, 0, "[%s] is not a boolean",
+                    parse_path(ctx, e));
         ctx->result = false;
         return;
       }
@@ -171,32 +682,30 @@ void mgos_conf_parse_cb(void *data, const char *name, size_t name_len,
     }
     case CONF_TYPE_STRING: {
       if (tok->type != JSON_TYPE_STRING) {
-        mg_asprintf(ctx->msg, 0, "[%s] is not a string", path);
+        mg_asprintf(ctx->msg, 0, "[%s] is not a string",
+                    parse_path(ctx, e));
         ctx->result = false;
         return;
       }
-      const char **sp = (const char **) vp;
-      char *s = NULL;
-      mgos_conf_free_str(sp);
-      if (tok->len > 0) {
-        s = (char *) malloc(tok->len + 1);
-        if (s == NULL) {
-          mg_asprintf(ctx->msg, 0, "insufficient memory");
-          ctx->result = false;
-          return;
-        }
-        int n = json_unescape(tok->ptr, tok->len, s, tok->len);
-        if (n < 0) {
-          free(s);
-          mg_asprintf(ctx->msg, 0, "[%s] invalid string", path);
-          ctx->result = false;
-          return;
-        }
-        s[n] = '\0';
-      } else {
-        /* Empty string - keep value as NULL. */
+      /* Unescaped value is only needed until it is interned. */
+      char buf[64], *s = buf;
+      if (tok->len > (int) sizeof(buf)) s = (char *) malloc(tok->len);
+      if (s == NULL) {
+        mg_asprintf(ctx->msg, 0, "insufficient memory");
+        ctx->result = false;
+        return;
       }
-      *sp = s;
+      int n = json_unescape(tok->ptr, tok->len, s, tok->len);
+      if (n < 0) {
+        mg_asprintf(ctx->msg, 0, "[%s] invalid string",
+                    parse_path(ctx, e));
+        ctx->result = false;
+      } else if (!conf_str_set_n((const char **) vp, s, n)) {
+        mg_asprintf(ctx->msg, 0, "insufficient memory");
+        ctx->result = false;
+      }
+      if (s != buf) free(s);
+      if (!ctx->result) return;
       break;
     }
     case CONF_TYPE_OBJECT: {
@@ -204,35 +713,57 @@ void mgos_conf_parse_cb(void *data, const char *name, size_t name_len,
       return;
     }
   }
-  LOG(LL_DEBUG, ("Set [%s] = [%.*s]", path, (int) tok->len, tok->ptr));
-  (void) name_len;
-  (void) name;
+  LOG(LL_DEBUG, ("Set [%s] = [%.*s]", parse_path(ctx, e), (int) tok->len,
+                  tok->ptr));
 }
 
-static bool mgos_conf_parse_off(const struct mg_str json, const char *acl,
-                                const struct mgos_conf_entry *schema,
-                                int offset_adj, void *cfg, char **msg) {
+/* Logs the error, if any, and returns the result of parsing. */
+static bool mgos_conf_parse_done(struct parse_ctx *ctx, int ret) {
+  mbuf_free(&ctx->path);
+  if ((!ctx->result || ret <= 0) && *ctx->msg == NULL) {
+    mg_asprintf(ctx->msg, 0, "Invalid JSON");
+  }
+  if (*ctx->msg != NULL) {
+    LOG(LL_ERROR, ("%s", *ctx->msg));
+  }
+  return (ret > 0 && ctx->result == true);
+}
+
+static bool mgos_conf_parse_off_acl(const struct mg_str json,
+                                    struct mgos_conf_acl *acl,
+                                    const struct mgos_conf_entry *schema,
+                                    int offset_adj, void *cfg, char **msg) {
   char *err_msg = NULL;
   struct parse_ctx ctx = {.schema = schema,
+                          .acl = acl,
                           .cfg = cfg,
                           .result = true,
                           .offset_adj = offset_adj,
                           .msg = msg};
   if (msg == NULL) ctx.msg = &err_msg;
-  /* Make a temporary copy, in case it gets overridden while loading. */
-  if (acl != NULL) ctx.acl = strdup(acl);
-  int ret = json_walk(json.p, json.len, mgos_conf_parse_cb, &ctx);
-  if ((!ctx.result || ret <= 0) && *ctx.msg == NULL) {
-    mg_asprintf(ctx.msg, 0, "Invalid JSON");
-  }
-  if (*ctx.msg != NULL) {
-    LOG(LL_ERROR, ("%s", *ctx.msg));
-    if (ctx.msg == &err_msg) {
-      free(err_msg);
-    }
+  int ret = json_walk_nopath(json.p, json.len, mgos_conf_parse_cb, &ctx);
+  bool res = mgos_conf_parse_done(&ctx, ret);
+  free(err_msg);
+  return res;
+}
+
+static bool mgos_conf_parse_off(const struct mg_str json, const char *acl,
+                                const struct mgos_conf_entry *schema,
+                                int offset_adj, void *cfg, char **msg) {
+  struct mgos_conf_acl *cacl = NULL;
+#ifndef MGOS_BOOT_BUILD
+  /* Compiling makes a copy, in case it gets overridden while loading. */
+  cacl = mgos_conf_acl_compile(mg_mk_str(acl));
+  if (cacl == NULL) {
+    if (msg != NULL) mg_asprintf(msg, 0, "insufficient memory");
+    return false;
   }
-  free(ctx.acl);
-  return (ret > 0 && ctx.result == true);
+#else
+  (void) acl;
+#endif
+  bool res = mgos_conf_parse_off_acl(json, cacl, schema, offset_adj, cfg, msg);
+  mgos_conf_acl_free(cacl);
+  return res;
 }
 
 bool mgos_conf_parse(const struct mg_str json, const char *acl,
@@ -258,6 +789,55 @@ bool mgos_conf_parse_sub_msg(const struct mg_str json,
                              msg);
 }
 
+bool mgos_conf_parse_sub_acl(const struct mg_str json,
+                             const struct mgos_conf_entry *sub_schema,
+                             struct mgos_conf_acl *acl, void *sub_cfg,
+                             char **msg) {
+  return mgos_conf_parse_off_acl(json, acl, sub_schema, sub_schema->offset,
+                                 sub_cfg, msg);
+}
+
+bool mgos_conf_parse_file_acl(const char *fname,
+                              const struct mgos_conf_entry *sub_schema,
+                              struct mgos_conf_acl *acl, void *sub_cfg,
+                              char **msg) {
+  char buf[MGOS_CONF_PARSE_CHUNK_SIZE], *err_msg = NULL;
+  struct json_walk_stream ws;
+  struct parse_ctx ctx = {.schema = sub_schema,
+                          .acl = acl,
+                          .cfg = sub_cfg,
+                          .result = true,
+                          .offset_adj = sub_schema->offset,
+                          .msg = msg};
+  size_t n;
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) return false;
+  if (msg == NULL) ctx.msg = &err_msg;
+  json_walk_stream_init(&ws, mgos_conf_parse_cb, &ctx);
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    if (json_walk_stream_feed(&ws, buf, (int) n) < 0 || !ctx.result) break;
+  }
+  fclose(fp);
+  int ret = json_walk_stream_finish(&ws);
+  bool res = mgos_conf_parse_done(&ctx, ret);
+  free(err_msg);
+  return res;
+}
+
+bool mgos_conf_parse_sub_f(const char *fname,
+                           const struct mgos_conf_entry *sub_schema,
+                           const void *cfg) {
+  struct mgos_conf_acl *acl = NULL;
+#ifndef MGOS_BOOT_BUILD
+  acl = mgos_conf_acl_compile(mg_mk_str("*"));
+  if (acl == NULL) return false;
+#endif
+  bool res = mgos_conf_parse_file_acl(fname, sub_schema, acl, (void *) cfg,
+                                      NULL);
+  mgos_conf_acl_free(acl);
+  return res;
+}
+
 struct emit_ctx {
   const void *cfg;
   const void *base;
@@ -458,6 +1038,34 @@ bool mgos_conf_emit_json_out(const void *cfg, const void *base,
   return true;
 }
 
+bool mgos_conf_emit_entries(const void *cfg,
+                            const struct mgos_conf_entry *schema,
+                            const struct mgos_conf_entry *const *entries,
+                            int num_entries, struct mbuf *out) {
+  struct emit_ctx ctx = {.cfg = cfg,
+                         .base = NULL,
+                         .offset_adj = schema->offset,
+                         .pretty = false,
+                         .out = out,
+                         .cb = NULL,
+                         .cb_param = NULL};
+  size_t start = out->len;
+  mbuf_append(out, "{", 1);
+  for (int i = 0; i < num_entries; i++) {
+    const struct mgos_conf_entry *e = entries[i];
+    if (i > 0) mbuf_append(out, ",", 1);
+    mbuf_append(out, "\"", 1);
+    if (e != schema && !mgos_conf_entry_path(schema, e, out)) {
+      out->len = start;
+      return false;
+    }
+    mbuf_append(out, "\":", 2);
+    mgos_conf_emit_entry(&ctx, e, 0);
+  }
+  mbuf_append(out, "}", 1);
+  return true;
+}
+
 bool mgos_conf_copy(const struct mgos_conf_entry *schema, const void *src,
                     void *dst) {
   bool res = true;
@@ -507,6 +1115,295 @@ void mgos_conf_free(const struct mgos_conf_entry *schema, void *cfg) {
   }
 }
 
+bool mgos_conf_equal(const struct mgos_conf_entry *schema, const void *cfg1,
+                     const void *cfg2) {
+  return mgos_conf_value_eq(cfg1, cfg2, schema, schema->offset);
+}
+
+#define CONF_SNAPSHOT_MAGIC 0x50414e53 /* "SNAP" */
+#define CONF_SNAPSHOT_NULL_STR 0xffff
+
+struct conf_snapshot_hdr {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t schema_hash;
+  uint32_t key;
+  uint32_t data_len;
+  uint32_t data_crc;
+};
+
+/* Size of a non-string value in the snapshot, same as in the struct. */
+static size_t conf_value_size(enum mgos_conf_type type) {
+  switch (type) {
+    case CONF_TYPE_INT:
+    case CONF_TYPE_BOOL:
+    case CONF_TYPE_UNSIGNED_INT:
+      return sizeof(int);
+    case CONF_TYPE_FLOAT:
+      return sizeof(float);
+    case CONF_TYPE_DOUBLE:
+      return sizeof(double);
+    case CONF_TYPE_STRING:
+    case CONF_TYPE_OBJECT:
+      break;
+  }
+  return 0;
+}
+
+uint32_t mgos_conf_schema_hash(const struct mgos_conf_entry *schema) {
+  /* Hashing a big schema takes a while, remember the last one. */
+  static const struct mgos_conf_entry *s_schema = NULL;
+  static uint32_t s_hash = 0;
+  if (schema == s_schema) return s_hash;
+  uint32_t hash = 0;
+  for (int i = 0; i <= schema->num_desc; i++) {
+    const struct mgos_conf_entry *e = schema + i;
+    uint32_t v[3] = {(uint32_t) e->type,
+                     (uint32_t) (e->offset - schema->offset), e->num_desc};
+    hash = cs_crc32(hash, v, sizeof(v));
+    hash = cs_crc32(hash, e->key, strlen(e->key) + 1);
+  }
+  s_schema = schema;
+  s_hash = hash;
+  return hash;
+}
+
+static bool snapshot_append(struct mbuf *out, const void *data, size_t len) {
+  return (len == 0 || mbuf_append(out, data, len) == len);
+}
+
+bool mgos_conf_snapshot_save(const struct mgos_conf_entry *schema,
+                             const void *cfg, uint32_t key, struct mbuf *out) {
+  struct conf_snapshot_hdr hdr;
+  size_t hdr_off = out->len;
+  bool res = (schema->type == CONF_TYPE_OBJECT);
+  memset(&hdr, 0, sizeof(hdr));
+  res = res && snapshot_append(out, &hdr, sizeof(hdr));
+  for (int i = 1; res && i <= schema->num_desc; i++) {
+    const struct mgos_conf_entry *e = schema + i;
+    const char *vp = (((const char *) cfg) + (e->offset - schema->offset));
+    if (e->type == CONF_TYPE_STRING) {
+      const char *s = *((const char *const *) vp);
+      size_t len = (s != NULL ? strlen(s) : CONF_SNAPSHOT_NULL_STR);
+      uint16_t len16 = (uint16_t) len;
+      if (s != NULL && len >= CONF_SNAPSHOT_NULL_STR) res = false;
+      res = res && snapshot_append(out, &len16, sizeof(len16));
+      if (s != NULL) res = res && snapshot_append(out, s, len);
+    } else {
+      res = snapshot_append(out, vp, conf_value_size(e->type));
+    }
+  }
+  if (!res) {
+    out->len = hdr_off;
+    return false;
+  }
+  hdr.magic = CONF_SNAPSHOT_MAGIC;
+  hdr.version = MGOS_CONF_SNAPSHOT_VERSION;
+  hdr.schema_hash = mgos_conf_schema_hash(schema);
+  hdr.key = key;
+  hdr.data_len = (uint32_t) (out->len - hdr_off - sizeof(hdr));
+  hdr.data_crc = cs_crc32(0, out->buf + hdr_off + sizeof(hdr), hdr.data_len);
+  memcpy(out->buf + hdr_off, &hdr, sizeof(hdr));
+  return true;
+}
+
+/*
+ * Goes over the values in the snapshot, storing them in `cfg` if `apply`
+ * is set. Returns false if the data does not match the schema.
+ */
+static bool conf_snapshot_walk(const struct mgos_conf_entry *schema,
+                               const struct mg_str data, bool apply,
+                               void *cfg) {
+  const char *p = data.p, *end = data.p + data.len;
+  for (int i = 1; i <= schema->num_desc; i++) {
+    const struct mgos_conf_entry *e = schema + i;
+    char *vp = (((char *) cfg) + (e->offset - schema->offset));
+    if (e->type == CONF_TYPE_STRING) {
+      const char **sp = (const char **) vp;
+      uint16_t len;
+      if ((size_t) (end - p) < sizeof(len)) return false;
+      memcpy(&len, p, sizeof(len));
+      p += sizeof(len);
+      if (len == CONF_SNAPSHOT_NULL_STR) {
+        if (apply) mgos_conf_free_str(sp);
+        continue;
+      }
+      if ((size_t) (end - p) < len) return false;
+      /* Values that did not change keep pointing to the defaults. */
+      if (apply &&
+          (*sp == NULL || strlen(*sp) != len || memcmp(*sp, p, len) != 0) &&
+          !conf_str_set_n(sp, p, len)) {
+        return false;
+      }
+      p += len;
+    } else {
+      size_t size = conf_value_size(e->type);
+      if ((size_t) (end - p) < size) return false;
+      if (apply) memcpy(vp, p, size);
+      p += size;
+    }
+  }
+  return (p == end);
+}
+
+bool mgos_conf_snapshot_load(const struct mg_str data,
+                             const struct mgos_conf_entry *schema,
+                             uint32_t key, void *cfg) {
+  struct conf_snapshot_hdr hdr;
+  if (schema->type != CONF_TYPE_OBJECT || data.len < sizeof(hdr)) {
+    return false;
+  }
+  memcpy(&hdr, data.p, sizeof(hdr));
+  if (hdr.magic != CONF_SNAPSHOT_MAGIC ||
+      hdr.version != MGOS_CONF_SNAPSHOT_VERSION || hdr.key != key ||
+      hdr.data_len != data.len - sizeof(hdr) ||
+      hdr.schema_hash != mgos_conf_schema_hash(schema)) {
+    return false;
+  }
+  const struct mg_str values = mg_mk_str_n(data.p + sizeof(hdr), hdr.data_len);
+  if (cs_crc32(0, values.p, values.len) != hdr.data_crc) return false;
+  /* Check everything before changing anything. */
+  if (!conf_snapshot_walk(schema, values, false /* apply */, cfg)) {
+    return false;
+  }
+  return conf_snapshot_walk(schema, values, true /* apply */, cfg);
+}
+
+/*
+ * Journal record: header, key, value, CRC of all of the above.
+ * Values are stored the same way as in the snapshot.
+ */
+struct conf_journal_rec {
+  uint8_t type;
+  uint8_t key_len;
+  uint16_t val_len;
+};
+
+static bool journal_add_record(struct mbuf *out,
+                               const struct mgos_conf_entry *e,
+                               const struct mg_str key, const char *vp) {
+  struct conf_journal_rec rec;
+  const size_t rec_off = out->len;
+  const char *val = vp;
+  size_t val_len = conf_value_size(e->type);
+  if (e->type == CONF_TYPE_STRING) {
+    val = *((const char *const *) vp);
+    val_len = (val != NULL ? strlen(val) : CONF_SNAPSHOT_NULL_STR);
+    if (val != NULL && val_len >= CONF_SNAPSHOT_NULL_STR) return false;
+  }
+  if (key.len > 0xff) return false;
+  rec.type = (uint8_t) e->type;
+  rec.key_len = (uint8_t) key.len;
+  rec.val_len = (uint16_t) val_len;
+  if (val == NULL) val_len = 0;
+  if (!snapshot_append(out, &rec, sizeof(rec)) ||
+      !snapshot_append(out, key.p, key.len) ||
+      !snapshot_append(out, val, val_len)) {
+    out->len = rec_off;
+    return false;
+  }
+  uint32_t crc = cs_crc32(0, out->buf + rec_off, out->len - rec_off);
+  if (!snapshot_append(out, &crc, sizeof(crc))) {
+    out->len = rec_off;
+    return false;
+  }
+  return true;
+}
+
+static int journal_diff_obj(const struct mgos_conf_entry *schema,
+                            const struct mgos_conf_entry *obj,
+                            const void *cfg, const void *base,
+                            struct mbuf *path, struct mbuf *out) {
+  int num_recs = 0;
+  const size_t path_len = path->len;
+  for (int i = 1; i <= obj->num_desc; i++) {
+    const struct mgos_conf_entry *e = obj + i;
+    int n = 0;
+    if (path_len > 0) mbuf_append(path, ".", 1);
+    mbuf_append(path, e->key, strlen(e->key));
+    if (e->type == CONF_TYPE_OBJECT) {
+      n = journal_diff_obj(schema, e, cfg, base, path, out);
+      i += e->num_desc;
+    } else if (!mgos_conf_value_eq(cfg, base, e, schema->offset)) {
+      const char *vp = (((const char *) cfg) + (e->offset - schema->offset));
+      n = (journal_add_record(out, e, mg_mk_str_n(path->buf, path->len), vp)
+               ? 1
+               : -1);
+    }
+    path->len = path_len;
+    if (n < 0) return -1;
+    num_recs += n;
+  }
+  return num_recs;
+}
+
+int mgos_conf_journal_diff(const struct mgos_conf_entry *schema,
+                           const void *cfg, const void *base,
+                           struct mbuf *out) {
+  struct mbuf path;
+  int res;
+  if (schema->type != CONF_TYPE_OBJECT) return -1;
+  mbuf_init(&path, 0);
+  res = journal_diff_obj(schema, schema, cfg, base, &path, out);
+  mbuf_free(&path);
+  return res;
+}
+
+/* Sets the value from a record that has passed the CRC check. */
+static bool journal_apply_record(const struct conf_journal_rec *rec,
+                                 const struct mg_str key, const char *val,
+                                 const struct mgos_conf_entry *schema,
+                                 struct mgos_conf_acl *acl, void *cfg) {
+  const struct mgos_conf_entry *e = mgos_conf_find_schema_entry_s(key, schema);
+  if (e == NULL || e->type != (enum mgos_conf_type) rec->type ||
+      e->type == CONF_TYPE_OBJECT) {
+    LOG(LL_DEBUG, ("Unknown key [%.*s]", (int) key.len, key.p));
+    return true;
+  }
+#ifndef MGOS_BOOT_BUILD
+  if (!mgos_conf_acl_check_entry(acl, schema, e)) {
+    LOG(LL_ERROR, ("Not allowed to set [%.*s]", (int) key.len, key.p));
+    return true;
+  }
+#else
+  (void) acl;
+#endif
+  char *vp = (((char *) cfg) + (e->offset - schema->offset));
+  if (e->type != CONF_TYPE_STRING) {
+    if (rec->val_len != conf_value_size(e->type)) return true;
+    memcpy(vp, val, rec->val_len);
+    return true;
+  }
+  const char **sp = (const char **) vp;
+  if (rec->val_len == CONF_SNAPSHOT_NULL_STR) {
+    mgos_conf_free_str(sp);
+    return true;
+  }
+  return conf_str_set_n(sp, val, rec->val_len);
+}
+
+size_t mgos_conf_journal_apply(const struct mg_str data,
+                               const struct mgos_conf_entry *schema,
+                               struct mgos_conf_acl *acl, void *cfg) {
+  const char *p = data.p, *end = data.p + data.len;
+  struct conf_journal_rec rec;
+  uint32_t crc;
+  while ((size_t) (end - p) >= sizeof(rec) + sizeof(crc)) {
+    memcpy(&rec, p, sizeof(rec));
+    size_t val_len = (rec.val_len != CONF_SNAPSHOT_NULL_STR ? rec.val_len : 0);
+    size_t rec_len = sizeof(rec) + rec.key_len + val_len;
+    if ((size_t) (end - p) < rec_len + sizeof(crc)) break;
+    memcpy(&crc, p + rec_len, sizeof(crc));
+    if (cs_crc32(0, p, rec_len) != crc) break;
+    const struct mg_str key = mg_mk_str_n(p + sizeof(rec), rec.key_len);
+    if (!journal_apply_record(&rec, key, key.p + key.len, schema, acl, cfg)) {
+      break;
+    }
+    p += rec_len + sizeof(crc);
+  }
+  return (size_t) (p - data.p);
+}
+
 void mgos_conf_set_str(const char **vp, const char *v) {
   if (*vp == v) return;
   mgos_conf_free_str(vp);
@@ -518,26 +1415,30 @@ bool mgos_conf_str_empty(const char *s) {
 }
 
 bool mgos_conf_copy_str(const char *s, const char **copy) {
-  if (*copy != NULL && !mgos_config_is_default_str(*copy)) {
-    free((void *) *copy);
+  if (s != NULL && *s == '\0') s = NULL;
+  if (s != NULL && !mgos_config_is_default_str(s)) {
+    /* Pooled strings are shared, everything else is interned. */
+    conf_str_lock();
+    struct conf_str_chunk *c = conf_str_chunk(s);
+    bool shared = (c != NULL && conf_str_hdr(s)->refs < CONF_STR_MAX_REFS);
+    if (shared) conf_str_hdr(s)->refs++;
+    conf_str_unlock();
+    if (!shared) return conf_str_set_n(copy, s, strlen(s));
   }
-  if (s == NULL || mgos_config_is_default_str(s)) {
-    *copy = (char *) s;
-    return true;
-  }
-  if (*s == '\0') {
-    *copy = NULL;
-    return true;
-  }
-  *copy = strdup(s);
-  return (*copy != NULL);
+  mgos_conf_free_str(copy);
+  *copy = s;
+  return true;
 }
 
 void mgos_conf_free_str(const char **sp) {
-  if (*sp != NULL && !mgos_config_is_default_str(*sp)) {
-    free((void *) *sp);
-  }
+  const char *s = *sp;
   *sp = NULL;
+  if (s == NULL || mgos_config_is_default_str(s)) return;
+  conf_str_lock();
+  struct conf_str_chunk *c = conf_str_chunk(s);
+  if (c != NULL) conf_str_release(c, s);
+  conf_str_unlock();
+  if (c == NULL) free((void *) s);
 }
 
 enum mgos_conf_type mgos_conf_value_type(struct mgos_conf_entry *e) {
@@ -588,6 +1489,56 @@ double mgos_conf_value_double(const void *cfg,
   return 0;
 }
 
+void mgos_conf_value_changed(const void *cfg) WEAK;
+void mgos_conf_value_changed(const void *cfg) {
+  (void) cfg;
+}
+
+bool mgos_conf_value_set_int(void *cfg, const struct mgos_conf_entry *e,
+                             int v) {
+  int *vp = (int *) (((char *) cfg) + e->offset);
+  switch (e->type) {
+    case CONF_TYPE_BOOL:
+      v = (v != 0);
+      /* fall through */
+    case CONF_TYPE_INT:
+    case CONF_TYPE_UNSIGNED_INT:
+      *vp = v;
+      mgos_conf_value_changed(cfg);
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+bool mgos_conf_value_set_double(void *cfg, const struct mgos_conf_entry *e,
+                                double v) {
+  char *vp = (((char *) cfg) + e->offset);
+  switch (e->type) {
+    case CONF_TYPE_FLOAT:
+      *((float *) vp) = (float) v;
+      mgos_conf_value_changed(cfg);
+      return true;
+    case CONF_TYPE_DOUBLE:
+      *((double *) vp) = v;
+      mgos_conf_value_changed(cfg);
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+bool mgos_conf_value_set_string(void *cfg, const struct mgos_conf_entry *e,
+                                const char *v) {
+  const char **vp = (const char **) (((char *) cfg) + e->offset);
+  if (e->type != CONF_TYPE_STRING) return false;
+  if (!conf_str_set_n(vp, v, (v != NULL ? strlen(v) : 0))) return false;
+  mgos_conf_value_changed(cfg);
+  return true;
+}
+
 bool mgos_config_get(const struct mg_str key, struct mg_str *value,
                      const void *cfg, const struct mgos_conf_entry *schema) {
   char **cp;
@@ -693,14 +1644,9 @@ bool mgos_config_set(const struct mg_str key, const struct mg_str value,
       break;
     }
     case CONF_TYPE_STRING: {
-      char **vp = (char **) (((char *) cfg) + e->offset);
-      if (free_strings) free(*vp);
-      if (value.len > 0) {
-        *vp = (char *) mg_strdup_nul(value).p;
-      } else {
-        *vp = NULL;
-      }
-      ret = true;
+      const char **vp = (const char **) (((char *) cfg) + e->offset);
+      if (!free_strings) *vp = NULL;
+      ret = conf_str_set_n(vp, value.p, value.len);
       break;
     }
     case CONF_TYPE_OBJECT: {
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_config_watch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/mbuf.h"
+#include "common/queue.h"
+
+#include "mgos_config.h"
+#include "mgos_mongoose.h"
+#include "mgos_sys_config_internal.h"
+
+union watch_value {
+  int i;
+  float f;
+  double d;
+  const char *s;
+};
+
+struct config_watch {
+  char *key;
+  const struct mgos_conf_entry *e;
+  /* NULL if removed while notifying, freed when done. */
+  mgos_config_watch_cb_t cb;
+  void *arg;
+  /* Last seen values of `e` and its descendants, in schema order. */
+  union watch_value *values;
+  STAILQ_ENTRY(config_watch) next;
+};
+
+static STAILQ_HEAD(s_watches, config_watch)
+    s_watches = STAILQ_HEAD_INITIALIZER(s_watches);
+
+static bool s_notifying = false, s_notify_pending = false;
+/* Set by the setters, changes are checked for from the main loop. */
+static bool s_changed = false, s_changed_cb_added = false;
+
+static const char *value_ptr(const struct mgos_conf_entry *e) {
+  return ((const char *) &mgos_sys_config) +
+         (e->offset - mgos_config_schema()->offset);
+}
+
+static bool watch_value_eq(const struct mgos_conf_entry *e,
+                           const union watch_value *v) {
+  const char *vp = value_ptr(e);
+  switch (e->type) {
+    case CONF_TYPE_INT:
+    case CONF_TYPE_BOOL:
+    case CONF_TYPE_UNSIGNED_INT:
+      return v->i == *((const int *) vp);
+    case CONF_TYPE_FLOAT:
+      return v->f == *((const float *) vp);
+    case CONF_TYPE_DOUBLE:
+      return v->d == *((const double *) vp);
+    case CONF_TYPE_STRING: {
+      const char *s1 = v->s, *s2 = *((const char *const *) vp);
+      if (s1 == NULL) s1 = "";
+      if (s2 == NULL) s2 = "";
+      return (strcmp(s1, s2) == 0);
+    }
+    case CONF_TYPE_OBJECT:
+      break;
+  }
+  return true;
+}
+
+static bool watch_value_store(const struct mgos_conf_entry *e,
+                              union watch_value *v) {
+  const char *vp = value_ptr(e);
+  switch (e->type) {
+    case CONF_TYPE_INT:
+    case CONF_TYPE_BOOL:
+    case CONF_TYPE_UNSIGNED_INT:
+      v->i = *((const int *) vp);
+      break;
+    case CONF_TYPE_FLOAT:
+      v->f = *((const float *) vp);
+      break;
+    case CONF_TYPE_DOUBLE:
+      v->d = *((const double *) vp);
+      break;
+    case CONF_TYPE_STRING:
+      return mgos_conf_copy_str(*((const char *const *) vp), &v->s);
+    case CONF_TYPE_OBJECT:
+      break;
+  }
+  return true;
+}
+
+static void watch_free(struct config_watch *w) {
+  if (w->values != NULL) {
+    for (int i = 0; i <= w->e->num_desc; i++) {
+      if (w->e[i].type == CONF_TYPE_STRING) mgos_conf_free_str(&w->values[i].s);
+    }
+  }
+  free(w->values);
+  free(w->key);
+  free(w);
+}
+
+static void watch_check_value(struct config_watch *w, int idx,
+                              struct mbuf *path) {
+  const struct mgos_conf_entry *e = w->e + idx;
+  union watch_value old = w->values[idx];
+  if (watch_value_eq(e, &old)) return;
+  /* Store first, so that the callback may change the value again. */
+  memset(&w->values[idx], 0, sizeof(w->values[idx]));
+  watch_value_store(e, &w->values[idx]);
+  mbuf_append(path, "", 1);
+  path->len--;
+  if (w->cb != NULL) w->cb(path->buf, e, &old, value_ptr(e), w->arg);
+  if (e->type == CONF_TYPE_STRING) mgos_conf_free_str(&old.s);
+}
+
+static void watch_check_obj(struct config_watch *w, int idx,
+                            struct mbuf *path) {
+  const struct mgos_conf_entry *obj = w->e + idx;
+  const size_t path_len = path->len;
+  for (int i = 1; i <= obj->num_desc; i++) {
+    const struct mgos_conf_entry *e = obj + i;
+    mbuf_append(path, ".", 1);
+    mbuf_append(path, e->key, strlen(e->key));
+    if (e->type == CONF_TYPE_OBJECT) {
+      watch_check_obj(w, idx + i, path);
+      i += e->num_desc;
+    } else {
+      watch_check_value(w, idx + i, path);
+    }
+    path->len = path_len;
+  }
+}
+
+static void watch_check(struct config_watch *w) {
+  struct mbuf path;
+  int i;
+  if (w->cb == NULL) return;
+  /* Quick scan first, keys are only needed when something has changed. */
+  for (i = 0; i <= w->e->num_desc; i++) {
+    if (!watch_value_eq(w->e + i, &w->values[i])) break;
+  }
+  if (i > w->e->num_desc) return;
+  mbuf_init(&path, 0);
+  mbuf_append(&path, w->key, strlen(w->key));
+  if (w->e->type == CONF_TYPE_OBJECT) {
+    watch_check_obj(w, 0, &path);
+  } else {
+    watch_check_value(w, 0, &path);
+  }
+  mbuf_free(&path);
+}
+
+bool mgos_config_watch(const char *key, mgos_config_watch_cb_t cb, void *arg) {
+  const struct mgos_conf_entry *e =
+      mgos_conf_find_schema_entry(key, mgos_config_schema());
+  struct config_watch *w;
+  if (e == NULL || cb == NULL) return false;
+  w = (struct config_watch *) calloc(1, sizeof(*w));
+  if (w == NULL) return false;
+  w->e = e;
+  w->cb = cb;
+  w->arg = arg;
+  w->key = strdup(key);
+  w->values = (union watch_value *) calloc(e->num_desc + 1, sizeof(*w->values));
+  bool res = (w->key != NULL && w->values != NULL);
+  for (int i = 0; res && i <= e->num_desc; i++) {
+    res = watch_value_store(e + i, &w->values[i]);
+  }
+  if (!res) {
+    watch_free(w);
+    return false;
+  }
+  STAILQ_INSERT_TAIL(&s_watches, w, next);
+  return true;
+}
+
+bool mgos_config_unwatch(const char *key, mgos_config_watch_cb_t cb,
+                         void *arg) {
+  struct config_watch *w;
+  STAILQ_FOREACH(w, &s_watches, next) {
+    if (w->cb == cb && w->arg == arg && strcmp(w->key, key) == 0) {
+      if (s_notifying) {
+        /* May be in use, mgos_sys_config_notify_changes() will free it. */
+        w->cb = NULL;
+        return true;
+      }
+      STAILQ_REMOVE(&s_watches, w, config_watch, next);
+      watch_free(w);
+      return true;
+    }
+  }
+  return false;
+}
+
+void mgos_sys_config_notify_changes(void) {
+  struct config_watch *w, *wt;
+  /* Changes made by callbacks are picked up by the outer invocation. */
+  if (s_notifying) {
+    s_notify_pending = true;
+    return;
+  }
+  s_notifying = true;
+  s_changed = false;
+  do {
+    s_notify_pending = false;
+    STAILQ_FOREACH(w, &s_watches, next) {
+      watch_check(w);
+    }
+  } while (s_notify_pending);
+  s_notifying = false;
+  STAILQ_FOREACH_SAFE(w, &s_watches, next, wt) {
+    if (w->cb == NULL) {
+      STAILQ_REMOVE(&s_watches, w, config_watch, next);
+      watch_free(w);
+    }
+  }
+  mgos_sys_config_snapshot_update();
+}
+
+static void config_changed_poll_cb(void *arg) {
+  if (s_changed) mgos_sys_config_notify_changes();
+  (void) arg;
+}
+
+void mgos_sys_config_changed(void) {
+  if (s_changed) return;
+  s_changed = true;
+  if (!s_changed_cb_added) {
+    mgos_add_poll_cb(config_changed_poll_cb, NULL);
+    s_changed_cb_added = true;
+  }
+  mongoose_schedule_poll(false /* from_isr */);
+}
+
+void mgos_conf_value_changed(const void *cfg) {
+  if (cfg == &mgos_sys_config) mgos_sys_config_changed();
+}
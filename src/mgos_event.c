@@ -17,12 +17,18 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include "mgos_event.h"
+#include "mgos_event_internal.h"
 
 #include "common/cs_dbg.h"
 #include "common/queue.h"
 
+#include "mgos_loop_stats.h"
+#include "mgos_mongoose.h"
+#include "mgos_system.h"
+#include "mgos_time.h"
+
 struct handler {
   int ev;
 
@@ -35,9 +41,23 @@ struct handler {
    */
   bool group;
 
+  /* Registration order, handlers are invoked most recently added first. */
+  uint32_t seq;
+
   SLIST_ENTRY(handler) next;
 };
 
+/*
+ * Handlers of one event, or group handlers of one base event number.
+ * Triggering an event only looks at its own list and the group list of its
+ * base, the two are merged by registration order.
+ */
+struct handler_list {
+  int ev;
+  bool group;
+  SLIST_HEAD(handlers, handler) handlers;
+};
+
 struct event {
   int ev;
   const char *name;
@@ -45,8 +65,63 @@ struct event {
 };
 
 static SLIST_HEAD(s_events, event) s_events = SLIST_HEAD_INITIALIZER(s_events);
-static SLIST_HEAD(s_handlers,
-                  handler) s_handlers = SLIST_HEAD_INITIALIZER(s_handlers);
+
+/* Sorted by event number, group lists after the event with the same number. */
+static struct handler_list **s_lists = NULL;
+static int s_num_lists = 0;
+static uint32_t s_handler_seq = 0;
+
+#define EV_BASE(ev) ((ev) & ~0xff)
+
+static int list_cmp(const struct handler_list *l, int ev, bool group) {
+  if (l->ev != ev) return (l->ev < ev ? -1 : 1);
+  return (int) l->group - (int) group;
+}
+
+/* Returns index of the list for `ev` and `group` or where it should be. */
+static int find_list_idx(int ev, bool group) {
+  int lo = 0, hi = s_num_lists;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (list_cmp(s_lists[mid], ev, group) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static struct handler_list *find_list(int ev, bool group) {
+  int i = find_list_idx(ev, group);
+  if (i < s_num_lists && list_cmp(s_lists[i], ev, group) == 0) {
+    return s_lists[i];
+  }
+  return NULL;
+}
+
+static struct handler_list *get_list(int ev, bool group) {
+  int i = find_list_idx(ev, group);
+  if (i < s_num_lists && list_cmp(s_lists[i], ev, group) == 0) {
+    return s_lists[i];
+  }
+  struct handler_list *l = calloc(1, sizeof(*l));
+  if (l == NULL) return NULL;
+  struct handler_list **lists =
+      realloc(s_lists, (s_num_lists + 1) * sizeof(*lists));
+  if (lists == NULL) {
+    free(l);
+    return NULL;
+  }
+  l->ev = ev;
+  l->group = group;
+  SLIST_INIT(&l->handlers);
+  memmove(lists + i + 1, lists + i, (s_num_lists - i) * sizeof(*lists));
+  lists[i] = l;
+  s_lists = lists;
+  s_num_lists++;
+  return l;
+}
 
 bool mgos_event_register_base(int ev, const char *name) {
   struct event *e;
@@ -66,18 +141,20 @@ bool mgos_event_register_base(int ev, const char *name) {
 
 static bool add_handler(int ev, mgos_event_handler_t cb, void *userdata,
                         bool group) {
+  /* When adding a group handler, make sure `ev` is a base event number */
+  if (group) {
+    ev &= ~0xff;
+  }
+  struct handler_list *l = get_list(ev, group);
+  if (l == NULL) return false;
   struct handler *h = calloc(1, sizeof(*h));
   if (h == NULL) return false;
   h->ev = ev;
   h->cb = cb;
   h->userdata = userdata;
   h->group = group;
-
-  /* When adding a group handler, make sure `ev` is a base event number */
-  if (group) {
-    h->ev &= ~0xff;
-  }
-  SLIST_INSERT_HEAD(&s_handlers, h, next);
+  h->seq = s_handler_seq++;
+  SLIST_INSERT_HEAD(&l->handlers, h, next);
   return true;
 }
 
@@ -92,17 +169,16 @@ bool mgos_event_add_group_handler(int evgrp, mgos_event_handler_t cb,
 
 static bool remove_handler(int ev, mgos_event_handler_t cb, void *userdata,
                            bool group) {
+  struct handler_list *l = find_list(ev, group);
   struct handler *ph = NULL, *h = NULL, *th;
-  SLIST_FOREACH_SAFE(h, &s_handlers, next, th) {
-    if (h->ev == ev && h->group == group && h->cb == cb &&
-        h->userdata == userdata) {
-      break;
-    }
+  if (l == NULL) return false;
+  SLIST_FOREACH_SAFE(h, &l->handlers, next, th) {
+    if (h->cb == cb && h->userdata == userdata) break;
     ph = h;
   }
   if (h == NULL) return false;
   if (ph == NULL) {
-    SLIST_REMOVE_HEAD(&s_handlers, next);
+    SLIST_REMOVE_HEAD(&l->handlers, next);
   } else {
     SLIST_REMOVE_AFTER(ph, next);
   }
@@ -121,13 +197,30 @@ bool mgos_event_remove_group_handler(int evgrp, mgos_event_handler_t cb,
 }
 
 int mgos_event_trigger(int ev, void *ev_data) {
-  struct handler *h, *te;
+  struct handler_list *el = find_list(ev, false);
+  struct handler_list *gl = find_list(EV_BASE(ev), true);
+  struct handler *eh = (el != NULL ? SLIST_FIRST(&el->handlers) : NULL);
+  struct handler *gh = (gl != NULL ? SLIST_FIRST(&gl->handlers) : NULL);
   int count = 0;
-  SLIST_FOREACH_SAFE(h, &s_handlers, next, te) {
-    if (h->ev == ev || (h->group && ev >= h->ev && ev <= (h->ev | 0xff))) {
-      h->cb(ev, ev_data, h->userdata);
-      count++;
+  while (eh != NULL || gh != NULL) {
+    /* Next pointers are taken first, so a handler can remove itself. */
+    struct handler *h;
+    if (gh == NULL || (eh != NULL && (int32_t) (eh->seq - gh->seq) > 0)) {
+      h = eh;
+      eh = SLIST_NEXT(eh, next);
+    } else {
+      h = gh;
+      gh = SLIST_NEXT(gh, next);
     }
+#if MGOS_ENABLE_LOOP_STATS
+    int64_t start = mgos_uptime_micros();
+    h->cb(ev, ev_data, h->userdata);
+    mgos_loop_stats_record(MGOS_LOOP_STATS_EVENT_HANDLER,
+                           (uint32_t) (mgos_uptime_micros() - start));
+#else
+    h->cb(ev, ev_data, h->userdata);
+#endif
+    count++;
   }
   if (ev != MGOS_EVENT_LOG) {
     const uint8_t *u = (uint8_t *) &ev;
@@ -137,3 +230,107 @@ int mgos_event_trigger(int ev, void *ev_data) {
   }
   return count;
 }
+
+struct posted_event {
+  int ev;
+  uint8_t flags;
+  uint8_t has_data;
+  union {
+    uint8_t bytes[MGOS_EVENT_POST_MAX_DATA_LEN];
+    /* Make sure copies of structs are properly aligned. */
+    double d;
+    int64_t i;
+    void *p;
+  } data;
+};
+
+struct event_queue {
+  struct posted_event *events;
+  uint16_t head;
+  uint16_t len;
+  struct mgos_event_queue_stats stats;
+  struct mgos_rlock_type *lock;
+};
+
+static struct event_queue *s_queue = NULL;
+
+bool mgos_event_queue_init(void) {
+  struct event_queue *q = calloc(1, sizeof(*q));
+  if (q == NULL) return false;
+  q->events = calloc(MGOS_EVENT_QUEUE_LEN, sizeof(*q->events));
+  if (q->events == NULL) {
+    free(q);
+    return false;
+  }
+  q->lock = mgos_rlock_create();
+  s_queue = q;
+  return true;
+}
+
+bool mgos_event_post(int ev, const void *ev_data, size_t ev_data_len,
+                     int flags) {
+  struct event_queue *q = s_queue;
+  struct posted_event *pe = NULL;
+  bool res = false;
+  if (q == NULL || ev_data_len > MGOS_EVENT_POST_MAX_DATA_LEN) return false;
+  mgos_rlock(q->lock);
+  if (flags & MGOS_EVENT_POST_F_COALESCE) {
+    for (int i = 0; i < q->len; i++) {
+      struct posted_event *qe =
+          &q->events[(q->head + i) % MGOS_EVENT_QUEUE_LEN];
+      if (qe->ev == ev && (qe->flags & MGOS_EVENT_POST_F_COALESCE)) {
+        pe = qe;
+        q->stats.num_coalesced++;
+        break;
+      }
+    }
+  }
+  if (pe == NULL) {
+    if (q->len == MGOS_EVENT_QUEUE_LEN) {
+      q->stats.num_dropped++;
+      goto out;
+    }
+    pe = &q->events[(q->head + q->len) % MGOS_EVENT_QUEUE_LEN];
+    q->len++;
+    if (q->len > q->stats.max_depth) q->stats.max_depth = q->len;
+  }
+  pe->ev = ev;
+  pe->flags = flags;
+  pe->has_data = (ev_data != NULL);
+  if (ev_data != NULL) memcpy(pe->data.bytes, ev_data, ev_data_len);
+  q->stats.num_posted++;
+  res = true;
+out:
+  mgos_runlock(q->lock);
+  if (res) mongoose_schedule_poll(false /* from_isr */);
+  return res;
+}
+
+void mgos_event_dispatch_posted(void) {
+  struct event_queue *q = s_queue;
+  struct posted_event pe;
+  if (q == NULL || q->len == 0) return;
+  mgos_rlock(q->lock);
+  int n = q->len;
+  mgos_runlock(q->lock);
+  while (n-- > 0) {
+    mgos_rlock(q->lock);
+    pe = q->events[q->head];
+    q->head = (q->head + 1) % MGOS_EVENT_QUEUE_LEN;
+    q->len--;
+    q->stats.num_delivered++;
+    mgos_runlock(q->lock);
+    mgos_event_trigger(pe.ev, (pe.has_data ? pe.data.bytes : NULL));
+  }
+}
+
+void mgos_event_get_queue_stats(struct mgos_event_queue_stats *stats) {
+  struct event_queue *q = s_queue;
+  if (q == NULL) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+  mgos_rlock(q->lock);
+  *stats = q->stats;
+  mgos_runlock(q->lock);
+}
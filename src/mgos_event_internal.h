@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#ifndef CS_FW_SRC_MGOS_EVENT_INTERNAL_H_
+#define CS_FW_SRC_MGOS_EVENT_INTERNAL_H_
+
+#include "mgos_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* Allocate the queue used by mgos_event_post(). */
+bool mgos_event_queue_init(void);
+
+/*
+ * Deliver events that have been posted so far.
+ * Called from the main loop, events posted by handlers are delivered on the
+ * next call.
+ */
+void mgos_event_dispatch_posted(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CS_FW_SRC_MGOS_EVENT_INTERNAL_H_ */
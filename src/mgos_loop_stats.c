@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_loop_stats.h"
+
+#if MGOS_ENABLE_LOOP_STATS
+
+#include <string.h>
+
+#include "common/platform.h"
+
+#include "mgos_time.h"
+
+/*
+ * Only 32-bit atomics are used, as not all targets have 64-bit ones.
+ * The total is kept in two halves, the high one takes the carry.
+ */
+struct hist {
+  uint32_t count;
+  uint32_t max_us;
+  uint32_t total_us_lo;
+  uint32_t total_us_hi;
+  uint32_t buckets[MGOS_LOOP_STATS_NUM_BUCKETS];
+};
+
+static struct hist s_hists[MGOS_LOOP_STATS_NUM_HIST];
+
+static const char *const s_hist_names[MGOS_LOOP_STATS_NUM_HIST] = {
+    "iter", "timer_late", "invoke_wait", "event_handler", "idle",
+};
+
+static inline int bucket_idx(uint32_t us) {
+  int i = (us == 0 ? 0 : 32 - __builtin_clz(us));
+  return (i < MGOS_LOOP_STATS_NUM_BUCKETS ? i
+                                          : MGOS_LOOP_STATS_NUM_BUCKETS - 1);
+}
+
+static inline uint32_t atomic_get(const uint32_t *v) {
+  return __atomic_load_n(v, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t atomic_add(uint32_t *v, uint32_t n) {
+  return __atomic_add_fetch(v, n, __ATOMIC_RELAXED);
+}
+
+void mgos_loop_stats_record(enum mgos_loop_stats_hist h, uint32_t us) {
+  struct hist *hs = &s_hists[h];
+  atomic_add(&hs->count, 1);
+  if (atomic_add(&hs->total_us_lo, us) < us) atomic_add(&hs->total_us_hi, 1);
+  uint32_t max_us = atomic_get(&hs->max_us);
+  while (us > max_us &&
+         !__atomic_compare_exchange_n(&hs->max_us, &max_us, us, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+  atomic_add(&hs->buckets[bucket_idx(us)], 1);
+}
+
+static void hist_get(const struct hist *hs,
+                     struct mgos_loop_stats_hist_data *data) {
+  data->count = atomic_get(&hs->count);
+  data->max_us = atomic_get(&hs->max_us);
+  data->total_us = ((uint64_t) atomic_get(&hs->total_us_hi) << 32) |
+                   atomic_get(&hs->total_us_lo);
+  for (int i = 0; i < MGOS_LOOP_STATS_NUM_BUCKETS; i++) {
+    data->buckets[i] = atomic_get(&hs->buckets[i]);
+  }
+}
+
+int64_t mgos_loop_stats_busy_micros(void) WEAK;
+int64_t mgos_loop_stats_busy_micros(void) {
+  return mgos_uptime_micros();
+}
+
+bool mgos_loop_stats_get(enum mgos_loop_stats_hist h,
+                         struct mgos_loop_stats_hist_data *data) {
+  if ((int) h < 0 || h >= MGOS_LOOP_STATS_NUM_HIST) return false;
+  hist_get(&s_hists[h], data);
+  return true;
+}
+
+uint32_t mgos_loop_stats_percentile(
+    const struct mgos_loop_stats_hist_data *data, double p) {
+  uint32_t target = (uint32_t) (data->count * p), n = 0;
+  if (data->count == 0) return 0;
+  if (target >= data->count) target = data->count - 1;
+  for (int i = 0; i < MGOS_LOOP_STATS_NUM_BUCKETS; i++) {
+    n += data->buckets[i];
+    if (n > target) {
+      uint32_t upper = (i == 0 ? 0 : (1U << i) - 1);
+      if (i == MGOS_LOOP_STATS_NUM_BUCKETS - 1 || upper > data->max_us) {
+        upper = data->max_us;
+      }
+      return upper;
+    }
+  }
+  return data->max_us;
+}
+
+static int emit_buckets(struct json_out *out, va_list *ap) {
+  const struct mgos_loop_stats_hist_data *hd =
+      va_arg(*ap, const struct mgos_loop_stats_hist_data *);
+  int len = 0, n = MGOS_LOOP_STATS_NUM_BUCKETS;
+  /* Trailing empty buckets are omitted. */
+  while (n > 0 && hd->buckets[n - 1] == 0) n--;
+  len += json_printf(out, "[");
+  for (int i = 0; i < n; i++) {
+    len += json_printf(out, "%s%u", (i > 0 ? "," : ""),
+                       (unsigned) hd->buckets[i]);
+  }
+  len += json_printf(out, "]");
+  return len;
+}
+
+int mgos_loop_stats_emit_json(struct json_out *out, va_list *ap) {
+  int len = 0;
+  len += json_printf(out, "{");
+  for (int i = 0; i < MGOS_LOOP_STATS_NUM_HIST; i++) {
+    struct mgos_loop_stats_hist_data data;
+    const struct mgos_loop_stats_hist_data *hd = &data;
+    hist_get(&s_hists[i], &data);
+    uint32_t avg =
+        (hd->count > 0 ? (uint32_t) (hd->total_us / hd->count) : 0);
+    len += json_printf(
+        out,
+        "%s%Q: {count: %u, avg_us: %u, max_us: %u, p50_us: %u, "
+        "p90_us: %u, p99_us: %u, buckets: %M}",
+        (i > 0 ? ", " : ""), s_hist_names[i], (unsigned) hd->count,
+        (unsigned) avg, (unsigned) hd->max_us,
+        (unsigned) mgos_loop_stats_percentile(hd, 0.5),
+        (unsigned) mgos_loop_stats_percentile(hd, 0.9),
+        (unsigned) mgos_loop_stats_percentile(hd, 0.99), emit_buckets, hd);
+  }
+  len += json_printf(out, "}");
+  (void) ap;
+  return len;
+}
+
+char *mgos_loop_stats_to_json(void) {
+  return json_asprintf("%M", mgos_loop_stats_emit_json);
+}
+
+void mgos_loop_stats_reset(void) {
+  memset(s_hists, 0, sizeof(s_hists));
+}
+
+#endif /* MGOS_ENABLE_LOOP_STATS */
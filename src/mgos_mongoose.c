@@ -20,8 +20,13 @@
 #include "common/cs_dbg.h"
 #include "common/queue.h"
 
+#include "mgos_event_internal.h"
 #include "mgos_hal.h"
+#include "mgos_loop_stats.h"
+#include "mgos_poll_cb_internal.h"
+#include "mgos_send_buf_internal.h"
 #include "mgos_sys_config.h"
+#include "mgos_time.h"
 #include "mgos_timers_internal.h"
 #include "mgos_utils.h"
 #ifdef MGOS_HAVE_WIFI
@@ -36,25 +41,18 @@ struct mg_mgr s_mgr;
 static bool s_feed_wdt;
 static size_t s_min_free_heap_size;
 
-struct cb_info {
-  mgos_poll_cb_t cb;
-  void *cb_arg;
-  SLIST_ENTRY(cb_info) poll_cbs;
-};
-SLIST_HEAD(s_poll_cbs, cb_info) s_poll_cbs = SLIST_HEAD_INITIALIZER(s_poll_cbs);
-
 IRAM struct mg_mgr *mgos_get_mgr() {
   return &s_mgr;
 }
 
 int mongoose_poll(int ms) {
   int ret = 0;
-  {
-    struct cb_info *ci, *cit;
-    SLIST_FOREACH_SAFE(ci, &s_poll_cbs, poll_cbs, cit) {
-      ci->cb(ci->cb_arg);
-    }
-  }
+#if MGOS_ENABLE_LOOP_STATS
+  int64_t start = mgos_uptime_micros();
+  int64_t busy_start = mgos_loop_stats_busy_micros();
+#endif
+  mgos_event_dispatch_posted();
+  mgos_poll_cbs_run();
 
   if (s_feed_wdt) mgos_wdt_feed();
 
@@ -66,24 +64,17 @@ int mongoose_poll(int ms) {
     LOG(LL_INFO, ("New heap free LWM: %d", (int) s_min_free_heap_size));
   }
 
-  return ret;
-}
-
-void mgos_add_poll_cb(mgos_poll_cb_t cb, void *cb_arg) {
-  struct cb_info *ci = (struct cb_info *) calloc(1, sizeof(*ci));
-  ci->cb = cb;
-  ci->cb_arg = cb_arg;
-  SLIST_INSERT_HEAD(&s_poll_cbs, ci, poll_cbs);
-}
-
-void mgos_remove_poll_cb(mgos_poll_cb_t cb, void *cb_arg) {
-  struct cb_info *ci, *cit;
-  SLIST_FOREACH_SAFE(ci, &s_poll_cbs, poll_cbs, cit) {
-    if (ci->cb == cb && ci->cb_arg == cb_arg) {
-      SLIST_REMOVE(&s_poll_cbs, ci, cb_info, poll_cbs);
-      free(ci);
-    }
+#if MGOS_ENABLE_LOOP_STATS
+  {
+    int64_t total = mgos_uptime_micros() - start;
+    int64_t busy = mgos_loop_stats_busy_micros() - busy_start;
+    if (busy > total) busy = total;
+    mgos_loop_stats_record(MGOS_LOOP_STATS_ITER, (uint32_t) busy);
+    mgos_loop_stats_record(MGOS_LOOP_STATS_IDLE, (uint32_t) (total - busy));
   }
+#endif
+
+  return ret;
 }
 
 void mgos_wdt_set_feed_on_poll(bool enable) {
@@ -102,6 +93,7 @@ static void oplya(struct mg_connection *c, int ev, void *ev_data,
   if (c->flags & MG_F_LISTENING) return;
   if (c->listener != NULL) f = (mg_event_handler_t) c->listener->priv_1.f;
   if (f != NULL) f(c, ev, ev_data, user_data);
+  mgos_send_buf_handle_event(c, ev);
 }
 
 struct mg_connection *mgos_bind(const char *addr, mg_event_handler_t f,
@@ -171,6 +163,7 @@ static void def_http_handler(struct mg_connection *c, int ev, void *p,
     }
   }
 
+  mgos_send_buf_handle_event(c, ev);
   (void) user_data;
   (void) p;
 }
@@ -241,5 +234,6 @@ bool mgos_is_inbound(struct mg_connection *c) {
 
 bool mgos_mongoose_init(void) {
   mg_mgr_init(&s_mgr, NULL);
+  if (!mgos_event_queue_init()) return false;
   return mgos_timers_init() == MGOS_INIT_OK;
 }
@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_poll_cb_internal.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "common/cs_dbg.h"
+#include "common/queue.h"
+
+#include "mgos_time.h"
+
+struct cb_info {
+  mgos_poll_cb_t cb;
+  void *cb_arg;
+  const char *name;
+  enum mgos_poll_cb_prio prio;
+  int min_interval_ms;
+  int64_t last_run_us;
+  int num_consecutive_skips;
+  uint32_t num_calls;
+  uint32_t num_skipped;
+  uint64_t total_us;
+  uint32_t max_us;
+  SLIST_ENTRY(cb_info) poll_cbs;
+};
+/* Sorted by priority. */
+static SLIST_HEAD(s_poll_cbs, cb_info)
+    s_poll_cbs = SLIST_HEAD_INITIALIZER(s_poll_cbs);
+/* Nesting depth of mgos_poll_cbs_run(). */
+static int s_poll_cbs_depth = 0;
+static int s_poll_cb_budget_us = MGOS_POLL_CB_BUDGET_US;
+static int s_poll_cb_log_interval_ms = 0;
+static int64_t s_poll_cb_last_log_us = 0;
+
+static void poll_cb_stats_log(void);
+
+void mgos_poll_cbs_run(void) {
+  struct cb_info *ci, *cit;
+  int64_t start = mgos_uptime_micros(), now = start;
+  s_poll_cbs_depth++;
+  SLIST_FOREACH(ci, &s_poll_cbs, poll_cbs) {
+    if (ci->cb == NULL) continue;
+    if (ci->min_interval_ms > 0 &&
+        now - ci->last_run_us < (int64_t) ci->min_interval_ms * 1000) {
+      continue;
+    }
+    /* Loop is behind, skip the less important stuff. */
+    if (ci->prio >= MGOS_POLL_CB_PRIO_LOW && s_poll_cb_budget_us > 0 &&
+        now - start > s_poll_cb_budget_us &&
+        ci->num_consecutive_skips < MGOS_POLL_CB_MAX_SKIPS) {
+      ci->num_consecutive_skips++;
+      ci->num_skipped++;
+      continue;
+    }
+    ci->num_consecutive_skips = 0;
+    ci->last_run_us = now;
+    ci->cb(ci->cb_arg);
+    int64_t end = mgos_uptime_micros();
+    uint32_t us = (uint32_t) (end - now);
+    ci->num_calls++;
+    ci->total_us += us;
+    if (us > ci->max_us) ci->max_us = us;
+    now = end;
+  }
+  /*
+   * Free the ones removed while we were iterating. A callback may have
+   * re-entered us, outer invocations may still be walking the list.
+   */
+  if (--s_poll_cbs_depth == 0) {
+    SLIST_FOREACH_SAFE(ci, &s_poll_cbs, poll_cbs, cit) {
+      if (ci->cb == NULL) {
+        SLIST_REMOVE(&s_poll_cbs, ci, cb_info, poll_cbs);
+        free(ci);
+      }
+    }
+  }
+  if (s_poll_cb_log_interval_ms > 0 &&
+      now - s_poll_cb_last_log_us >=
+          (int64_t) s_poll_cb_log_interval_ms * 1000) {
+    poll_cb_stats_log();
+    s_poll_cb_last_log_us = now;
+  }
+}
+
+bool mgos_add_poll_cb_opt(mgos_poll_cb_t cb, void *cb_arg,
+                          const struct mgos_poll_cb_opts *opts) {
+  struct cb_info *ci = (struct cb_info *) calloc(1, sizeof(*ci));
+  struct cb_info *prev = NULL, *it;
+  if (ci == NULL) return false;
+  ci->cb = cb;
+  ci->cb_arg = cb_arg;
+  if (opts != NULL) {
+    ci->name = opts->name;
+    ci->prio = opts->prio;
+    ci->min_interval_ms = opts->min_interval_ms;
+    /* Due right away. */
+    ci->last_run_us =
+        mgos_uptime_micros() - (int64_t) ci->min_interval_ms * 1000;
+  } else {
+    ci->prio = MGOS_POLL_CB_PRIO_NORMAL;
+  }
+  /* Callbacks of the same priority still run in LIFO order. */
+  SLIST_FOREACH(it, &s_poll_cbs, poll_cbs) {
+    if (it->prio >= ci->prio) break;
+    prev = it;
+  }
+  if (prev == NULL) {
+    SLIST_INSERT_HEAD(&s_poll_cbs, ci, poll_cbs);
+  } else {
+    SLIST_INSERT_AFTER(prev, ci, poll_cbs);
+  }
+  return true;
+}
+
+void mgos_add_poll_cb(mgos_poll_cb_t cb, void *cb_arg) {
+  mgos_add_poll_cb_opt(cb, cb_arg, NULL);
+}
+
+void mgos_remove_poll_cb(mgos_poll_cb_t cb, void *cb_arg) {
+  struct cb_info *ci, *cit;
+  SLIST_FOREACH_SAFE(ci, &s_poll_cbs, poll_cbs, cit) {
+    if (ci->cb == cb && ci->cb_arg == cb_arg) {
+      if (s_poll_cbs_depth > 0) {
+        /* mgos_poll_cbs_run() will free it. */
+        ci->cb = NULL;
+        continue;
+      }
+      SLIST_REMOVE(&s_poll_cbs, ci, cb_info, poll_cbs);
+      free(ci);
+    }
+  }
+}
+
+int mgos_get_poll_cb_stats(struct mgos_poll_cb_stats *stats, int max_stats) {
+  struct cb_info *ci;
+  int n = 0;
+  SLIST_FOREACH(ci, &s_poll_cbs, poll_cbs) {
+    if (ci->cb == NULL) continue;
+    if (n < max_stats) {
+      struct mgos_poll_cb_stats *st = &stats[n];
+      st->name = ci->name;
+      st->cb = ci->cb;
+      st->cb_arg = ci->cb_arg;
+      st->prio = ci->prio;
+      st->num_calls = ci->num_calls;
+      st->num_skipped = ci->num_skipped;
+      st->total_us = ci->total_us;
+      st->max_us = ci->max_us;
+    }
+    n++;
+  }
+  return n;
+}
+
+void mgos_reset_poll_cb_stats(void) {
+  struct cb_info *ci;
+  SLIST_FOREACH(ci, &s_poll_cbs, poll_cbs) {
+    ci->num_calls = ci->num_skipped = ci->max_us = 0;
+    ci->total_us = 0;
+  }
+}
+
+static void poll_cb_stats_log(void) {
+  struct cb_info *ci;
+  LOG(LL_INFO,
+      ("Poll callbacks in the last %d ms:", s_poll_cb_log_interval_ms));
+  SLIST_FOREACH(ci, &s_poll_cbs, poll_cbs) {
+    if (ci->cb == NULL) continue;
+    LOG(LL_INFO,
+        ("  %s (%p/%p) prio %d: %u calls, %u skipped, total %" PRIu64
+         " us, max %u us",
+         (ci->name ? ci->name : "?"), ci->cb, ci->cb_arg, ci->prio,
+         (unsigned) ci->num_calls, (unsigned) ci->num_skipped, ci->total_us,
+         (unsigned) ci->max_us));
+  }
+  mgos_reset_poll_cb_stats();
+}
+
+void mgos_set_poll_cb_budget(int budget_us) {
+  s_poll_cb_budget_us = budget_us;
+}
+
+void mgos_set_poll_cb_stats_log_interval(int interval_ms) {
+  s_poll_cb_log_interval_ms = interval_ms;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#ifndef CS_FW_SRC_MGOS_POLL_CB_INTERNAL_H_
+#define CS_FW_SRC_MGOS_POLL_CB_INTERNAL_H_
+
+#include "mgos_poll_cb.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Runs the poll callbacks, called at the start of every main loop iteration.
+ * May be re-entered from a callback.
+ */
+void mgos_poll_cbs_run(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CS_FW_SRC_MGOS_POLL_CB_INTERNAL_H_ */
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_send_buf_internal.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "common/queue.h"
+
+#if MG_NET_IF == MG_NET_IF_SOCKET && CS_PLATFORM == CS_P_UNIX
+#define MGOS_SEND_BUF_HAVE_WRITEV 1
+#include <sys/uio.h>
+#else
+#define MGOS_SEND_BUF_HAVE_WRITEV 0
+#endif
+
+struct mgos_send_buf {
+  const char *data;
+  size_t len;
+  mgos_send_buf_free_cb_t free_cb;
+  void *free_cb_arg;
+  int refcnt;
+};
+
+/* A queued range of a buffer. */
+struct send_buf_ref {
+  struct mgos_send_buf *b;
+  size_t off, len;
+  STAILQ_ENTRY(send_buf_ref) next;
+};
+
+/* Connections with something queued. */
+struct conn_send_state {
+  struct mg_connection *c;
+  STAILQ_HEAD(refs, send_buf_ref) refs;
+  size_t pending;
+  bool close_when_done;
+  SLIST_ENTRY(conn_send_state) next;
+};
+
+static SLIST_HEAD(s_send_states, conn_send_state) s_send_states =
+    SLIST_HEAD_INITIALIZER(s_send_states);
+
+struct mgos_send_buf *mgos_send_buf_create(const void *data, size_t len,
+                                           mgos_send_buf_free_cb_t free_cb,
+                                           void *free_cb_arg) {
+  struct mgos_send_buf *b = (struct mgos_send_buf *) calloc(1, sizeof(*b));
+  if (b == NULL) return NULL;
+  b->data = (const char *) data;
+  b->len = len;
+  b->free_cb = free_cb;
+  b->free_cb_arg = free_cb_arg;
+  b->refcnt = 1;
+  return b;
+}
+
+struct mgos_send_buf *mgos_send_buf_ref(struct mgos_send_buf *b) {
+  b->refcnt++;
+  return b;
+}
+
+void mgos_send_buf_unref(struct mgos_send_buf *b) {
+  if (b == NULL || --b->refcnt > 0) return;
+  if (b->free_cb != NULL) b->free_cb((void *) b->data, b->free_cb_arg);
+  free(b);
+}
+
+static struct conn_send_state *find_state(struct mg_connection *c) {
+  struct conn_send_state *st;
+  SLIST_FOREACH(st, &s_send_states, next) {
+    if (st->c == c) return st;
+  }
+  return NULL;
+}
+
+static void free_state(struct conn_send_state *st) {
+  struct send_buf_ref *r, *rt;
+  STAILQ_FOREACH_SAFE(r, &st->refs, next, rt) {
+    mgos_send_buf_unref(r->b);
+    free(r);
+  }
+  SLIST_REMOVE(&s_send_states, st, conn_send_state, next);
+  free(st);
+}
+
+/* Marks n bytes from the head of the queue as sent. */
+static void consume(struct conn_send_state *st, size_t n) {
+  st->pending -= n;
+  while (n > 0) {
+    struct send_buf_ref *r = STAILQ_FIRST(&st->refs);
+    size_t k = (n < r->len ? n : r->len);
+    r->off += k;
+    r->len -= k;
+    n -= k;
+    if (r->len == 0) {
+      STAILQ_REMOVE_HEAD(&st->refs, next);
+      mgos_send_buf_unref(r->b);
+      free(r);
+    }
+  }
+}
+
+/*
+ * Tops the send mbuf up to MGOS_SEND_BUF_CHUNK_SIZE, so at most one chunk
+ * is ever copied.
+ */
+static void send_via_mbuf(struct mg_connection *c,
+                          struct conn_send_state *st) {
+  while (c->send_mbuf.len < MGOS_SEND_BUF_CHUNK_SIZE && st->pending > 0) {
+    struct send_buf_ref *r = STAILQ_FIRST(&st->refs);
+    size_t n = MGOS_SEND_BUF_CHUNK_SIZE - c->send_mbuf.len;
+    if (n > r->len) n = r->len;
+    mg_send(c, r->b->data + r->off, (int) n);
+    consume(st, n);
+  }
+}
+
+#if MGOS_SEND_BUF_HAVE_WRITEV
+static void send_via_writev(struct mg_connection *c,
+                            struct conn_send_state *st) {
+  /* Anything in the send mbuf must go out first. */
+  while (c->send_mbuf.len == 0 && st->pending > 0) {
+    struct iovec iov[MGOS_SEND_BUF_MAX_IOV];
+    struct send_buf_ref *r;
+    size_t total = 0;
+    int n = 0;
+    STAILQ_FOREACH(r, &st->refs, next) {
+      if (n == MGOS_SEND_BUF_MAX_IOV) break;
+      iov[n].iov_base = (void *) (r->b->data + r->off);
+      iov[n].iov_len = r->len;
+      total += r->len;
+      n++;
+    }
+    ssize_t written = writev(c->sock, iov, n);
+    if (written < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        c->flags |= MG_F_CLOSE_IMMEDIATELY;
+        return;
+      }
+      written = 0;
+    }
+    consume(st, (size_t) written);
+    if ((size_t) written < total) {
+      /*
+       * Socket buffer is full. Mongoose only waits for a socket to become
+       * writable if there is something in the send mbuf, so hand it one
+       * chunk. We'll get MG_EV_SEND when it's gone and carry on from there.
+       */
+      send_via_mbuf(c, st);
+      return;
+    }
+  }
+}
+#endif
+
+static void flush(struct mg_connection *c, struct conn_send_state *st) {
+  /* Don't let mongoose close the connection before we're done. */
+  if (c->flags & MG_F_SEND_AND_CLOSE) {
+    c->flags &= ~MG_F_SEND_AND_CLOSE;
+    st->close_when_done = true;
+  }
+  if (!(c->flags & (MG_F_CONNECTING | MG_F_CLOSE_IMMEDIATELY))) {
+#if MGOS_SEND_BUF_HAVE_WRITEV
+    if (!(c->flags & (MG_F_UDP | MG_F_SSL))) {
+      send_via_writev(c, st);
+    } else
+#endif
+    {
+      send_via_mbuf(c, st);
+    }
+  }
+  if (st->pending == 0) {
+    if (st->close_when_done) c->flags |= MG_F_SEND_AND_CLOSE;
+    free_state(st);
+  }
+}
+
+bool mgos_conn_send_buf(struct mg_connection *c, struct mgos_send_buf *b,
+                        size_t offset, size_t len) {
+  struct conn_send_state *st;
+  struct send_buf_ref *r;
+  if (c == NULL || b == NULL || offset > b->len || len > b->len - offset) {
+    return false;
+  }
+  if (len == 0) return true;
+  r = (struct send_buf_ref *) calloc(1, sizeof(*r));
+  if (r == NULL) return false;
+  st = find_state(c);
+  if (st == NULL) {
+    st = (struct conn_send_state *) calloc(1, sizeof(*st));
+    if (st == NULL) {
+      free(r);
+      return false;
+    }
+    st->c = c;
+    STAILQ_INIT(&st->refs);
+    SLIST_INSERT_HEAD(&s_send_states, st, next);
+  }
+  r->b = mgos_send_buf_ref(b);
+  r->off = offset;
+  r->len = len;
+  STAILQ_INSERT_TAIL(&st->refs, r, next);
+  st->pending += len;
+  /* Written out on the next MG_EV_POLL. */
+  mongoose_schedule_poll(false /* from_isr */);
+  return true;
+}
+
+bool mgos_conn_send_owned(struct mg_connection *c, void *data, size_t len,
+                          mgos_send_buf_free_cb_t free_cb, void *free_cb_arg) {
+  struct mgos_send_buf *b =
+      mgos_send_buf_create(data, len, free_cb, free_cb_arg);
+  if (b == NULL) {
+    if (free_cb != NULL) free_cb(data, free_cb_arg);
+    return false;
+  }
+  bool res = mgos_conn_send_buf(c, b, 0, len);
+  mgos_send_buf_unref(b);
+  return res;
+}
+
+size_t mgos_conn_get_send_pending(struct mg_connection *c) {
+  struct conn_send_state *st = find_state(c);
+  return (st != NULL ? st->pending : 0);
+}
+
+void mgos_send_buf_handle_event(struct mg_connection *c, int ev) {
+  struct conn_send_state *st;
+  if (SLIST_EMPTY(&s_send_states)) return;
+  st = find_state(c);
+  if (st == NULL) return;
+  if (ev == MG_EV_CLOSE) {
+    free_state(st);
+  } else {
+    flush(c, st);
+  }
+}
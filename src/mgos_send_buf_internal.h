@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ */
+
+#ifndef CS_FW_SRC_MGOS_SEND_BUF_INTERNAL_H_
+#define CS_FW_SRC_MGOS_SEND_BUF_INTERNAL_H_
+
+#include "mgos_send_buf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Called by the mgos connection wrappers for every event, after the user's
+ * handler. Writes out queued buffers and releases them on MG_EV_CLOSE.
+ */
+void mgos_send_buf_handle_event(struct mg_connection *c, int ev);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CS_FW_SRC_MGOS_SEND_BUF_INTERNAL_H_ */
@@ -28,6 +28,7 @@
 #include "common/str_util.h"
 
 #include "mgos_config_util.h"
+#include "mgos_config_watch.h"
 #include "mgos_debug.h"
 #include "mgos_debug_hal.h"
 #include "mgos_features.h"
@@ -41,14 +42,8 @@
 
 #define PLACEHOLDER_CHAR '?'
 
-/* See also CONF_USER_FILE */
-#define CONF_USER_FILE_NUM_IDX 4
-
 /* FOr backward compatibility */
 #define CONF_USER_FILE_OLD "conf.json"
-#define CONF_VENDOR_FILE "conf_vendor.json"
-
-#define CONF_FILE_TRY_SUFFIX ".try"
 
 /* Must be provided externally, usually auto-generated. */
 extern const char *build_id;
@@ -61,14 +56,6 @@ bool mgos_sys_config_is_initialized(void) {
   return s_initialized;
 }
 
-static mgos_config_validator_fn *s_validators;
-static int s_num_validators;
-
-static bool mgos_sys_config_load_level_internal(struct mgos_config *cfg,
-                                                enum mgos_config_level level,
-                                                bool check_try,
-                                                bool delete_try);
-
 void mgos_expand_mac_address_placeholders(char *str) {
   struct mg_str s = mg_mk_str(str);
   struct mg_str mac = mg_mk_str(mgos_sys_ro_vars_get_mac_address());
@@ -92,10 +79,10 @@ void mgos_expand_placeholders(const struct mg_str src, struct mg_str *str) {
 }
 
 static bool load_config(const char *name, struct mg_str cfg_data,
-                        const char *acl, const struct mgos_conf_entry *schema,
-                        void *cfg) {
+                        struct mgos_conf_acl *acl,
+                        const struct mgos_conf_entry *schema, void *cfg) {
   bool result = true;
-  if (!mgos_conf_parse_sub_msg(cfg_data, schema, acl, cfg, NULL)) {
+  if (!mgos_conf_parse_sub_acl(cfg_data, schema, acl, cfg, NULL)) {
     LOG(LL_ERROR, ("Failed to parse %s", name));
     result = false;
   }
@@ -103,52 +90,15 @@ static bool load_config(const char *name, struct mg_str cfg_data,
   return result;
 }
 
-static bool load_config_file(const char *filename, const char *acl,
-                             bool check_try, bool delete_try,
-                             const struct mgos_conf_entry *schema, void *cfg) {
-  char *data = NULL;
-  size_t size;
-  bool result = false;
-  struct stat st;
-  char tfn_buf[32], *try_filename = tfn_buf;
-  // See if we have "${filename}.try" and prefer that.
-  // Delete the file immediately after loading.
-  if (check_try &&
-      mg_asprintf(&try_filename, sizeof(tfn_buf), "%s%s", filename,
-                  CONF_FILE_TRY_SUFFIX) > 0 &&
-      stat(try_filename, &st) == 0) {
-    filename = try_filename;
-  } else {
-    if (try_filename != tfn_buf) free(try_filename);
-    try_filename = NULL;
-  }
-  if (stat(filename, &st) != 0) {
-    goto out;
-  }
-  LOG(LL_DEBUG, ("Loading %s", filename));
-  data = cs_read_file(filename, &size);
-  if (data == NULL) {
-    goto out;
-  }
-  result = load_config(filename, mg_mk_str_n(data, size), acl, schema, cfg);
-
-out:
-  free(data);
-  if (try_filename != NULL) {
-    if (delete_try) remove(try_filename);
-    if (try_filename != tfn_buf) free(try_filename);
-  }
-  return result;
-}
-
 /*
  * Parse config JSON from a VFS device.
  * `spec` should specify device name and offset (`name,offset`).
  * `offset` is optional and defaults to 0.
  * JSON data must be terminated with NUL or 0xff.
  */
-void mgos_conf_parse_dev(const char *spec, const char *acl,
-                         const struct mgos_conf_entry *schema, void *cfg) {
+void mgos_sys_config_parse_dev(const char *spec, struct mgos_conf_acl *acl,
+                               const struct mgos_conf_entry *schema,
+                               void *cfg) {
   char *data = NULL, *data2 = NULL;
   struct mg_str entry, dev_name = MG_NULL_STR, s;
   struct mgos_vfs_dev *dev = NULL;
@@ -213,146 +163,12 @@ out:
   return;
 }
 
-#define PARSE_CONFIG_DEV_LEVEL(l)                                          \
-  if (i == l) {                                                            \
-    mgos_conf_parse_dev(CS_STRINGIFY_MACRO(MGOS_CONFIG_DEV_##l), acl, sch, \
-                        cfg);                                              \
-  }
-static bool mgos_sys_config_load_level_internal(struct mgos_config *cfg,
-                                                enum mgos_config_level level,
-                                                bool check_try,
-                                                bool delete_try) {
-  int i;
-  char fname[sizeof(CONF_USER_FILE) + 10];
-  memset(cfg, 0, sizeof(*cfg));
-  if (level > MGOS_CONFIG_LEVEL_USER) return false;
-  memcpy(fname, CONF_USER_FILE, sizeof(CONF_USER_FILE));
-  // Start with compiled-in defaults.
-  mgos_config_set_defaults(cfg);
-  const char *acl = "*";
-  const struct mgos_conf_entry *sch = mgos_config_schema();
-  for (i = 1; i <= (int) level; i++) {
-#ifdef MGOS_CONFIG_DEV_1
-    PARSE_CONFIG_DEV_LEVEL(1);
-#endif
-#ifdef MGOS_CONFIG_DEV_2
-    PARSE_CONFIG_DEV_LEVEL(2);
-#endif
-#ifdef MGOS_CONFIG_DEV_3
-    PARSE_CONFIG_DEV_LEVEL(3);
-#endif
-#ifdef MGOS_CONFIG_DEV_4
-    PARSE_CONFIG_DEV_LEVEL(4);
-#endif
-#ifdef MGOS_CONFIG_DEV_5
-    PARSE_CONFIG_DEV_LEVEL(5);
-#endif
-#ifdef MGOS_CONFIG_DEV_6
-    PARSE_CONFIG_DEV_LEVEL(6);
-#endif
-#ifdef MGOS_CONFIG_DEV_7
-    PARSE_CONFIG_DEV_LEVEL(7);
-#endif
-#ifdef MGOS_CONFIG_DEV_8
-    PARSE_CONFIG_DEV_LEVEL(8);
-#endif
-    fname[CONF_USER_FILE_NUM_IDX] = '0' + i;
-    /* Backward compat: load conf_vendor.json at level 5.5 */
-    if (i == 6) {
-      load_config_file(CONF_VENDOR_FILE, cfg->conf_acl, false, false, sch, cfg);
-      acl = cfg->conf_acl;
-    }
-    if (!load_config_file(fname, acl, check_try, delete_try, sch, cfg)) {
-      // Nothing to do, all the overlays are optional.
-    }
-    acl = cfg->conf_acl;
-  }
-  return true;
-}
-
-bool mgos_sys_config_load_level(struct mgos_config *cfg,
-                                enum mgos_config_level level) {
-  return mgos_sys_config_load_level_internal(cfg, level, true /* check_try */,
-                                             false /* delete_try */);
-}
-
-bool load_config_defaults(struct mgos_config *cfg) {
-  return mgos_sys_config_load_level_internal(cfg, MGOS_CONFIG_LEVEL_VENDOR_8,
-                                             true /* check_try */,
-                                             false /* delete_try */);
-}
-
-bool mgos_config_validate(const struct mgos_config *cfg, char **msg) {
-  *msg = NULL;
-  for (int i = 0; i < s_num_validators; i++) {
-    if (!s_validators[i](cfg, msg)) return false;
-  }
-  return true;
-}
-
-bool mgos_sys_config_save_level(const struct mgos_config *cfg,
-                                enum mgos_config_level level, bool try_once,
-                                char **msg) {
-  bool result = false;
-  char fname[sizeof(CONF_USER_FILE) + 10];
-  char try_fname[sizeof(CONF_USER_FILE) + 10];
-  struct mgos_config *defaults = calloc(1, sizeof(*defaults));
-  char *ptr = NULL;
-  if (defaults == NULL) goto clean;
-  if (level > MGOS_CONFIG_LEVEL_USER) goto clean;
-  if (msg == NULL) msg = &ptr;
-  if (!mgos_config_validate(cfg, msg)) goto clean;
-  if (!mgos_sys_config_load_level(
-          defaults, (enum mgos_config_level)(((int) level) - 1))) {
-    *msg = strdup("failed to load defaults");
-    goto clean;
-  }
-  snprintf(fname, sizeof(fname), "%s", CONF_USER_FILE);
-  snprintf(try_fname, sizeof(try_fname), "%s%s", CONF_USER_FILE,
-           CONF_FILE_TRY_SUFFIX);
-  fname[CONF_USER_FILE_NUM_IDX] = '0' + level;
-  try_fname[CONF_USER_FILE_NUM_IDX] = '0' + level;
-  if (try_once) {
-    strncpy(fname, try_fname, sizeof(fname));
-  } else {
-    /* Delete stale try file that may be there. */
-    remove(try_fname);
-  }
-  if (mgos_conf_emit_f(cfg, defaults, mgos_config_schema(), true /* pretty */,
-                       fname)) {
-    LOG(LL_INFO, ("Saved to %s", fname));
-    result = true;
-  } else {
-    *msg = strdup("failed to write file");
-  }
-clean:
-  free(ptr);
-  if (defaults != NULL) {
-    mgos_conf_free(mgos_config_schema(), defaults);
-    free(defaults);
-  }
-  return result;
-}
-
-bool mgos_sys_config_save(const struct mgos_config *cfg, bool try_once,
-                          char **msg) {
-  return mgos_sys_config_save_level(cfg, MGOS_CONFIG_LEVEL_USER, try_once, msg);
-}
-
-bool save_cfg(const struct mgos_config *cfg, char **msg) {
-  return mgos_sys_config_save_level(cfg, MGOS_CONFIG_LEVEL_USER, false, msg);
-}
-
-void mgos_config_reset(int level) {
-  int i;
-  char fname[sizeof(CONF_USER_FILE)];
-  memcpy(fname, CONF_USER_FILE, sizeof(fname));
-  for (i = MGOS_CONFIG_LEVEL_USER; i >= level && i > 0; i--) {
-    fname[CONF_USER_FILE_NUM_IDX] = '0' + i;
-    if (remove(fname) == 0) {
-      LOG(LL_INFO, ("Removed %s", fname));
-    }
-  }
+void mgos_conf_parse_dev(const char *spec, const char *acl,
+                         const struct mgos_conf_entry *schema, void *cfg) {
+  struct mgos_conf_acl *cacl = mgos_conf_acl_compile(mg_mk_str(acl));
+  if (cacl == NULL) return;
+  mgos_sys_config_parse_dev(spec, cacl, schema, cfg);
+  mgos_conf_acl_free(cacl);
 }
 
 void mbedtls_debug_set_threshold(int threshold);
@@ -377,9 +193,7 @@ enum mgos_init_result mgos_sys_config_init(void) {
     mgos_gpio_set_pull(gpio, MGOS_GPIO_PULL_UP);
     if (mgos_gpio_read(gpio) == 0) {
       LOG(LL_WARN, ("Factory reset requested via GPIO%d", gpio));
-      if (remove(CONF_USER_FILE) == 0) {
-        LOG(LL_WARN, ("Removed %s", CONF_USER_FILE));
-      }
+      mgos_config_reset(MGOS_CONFIG_LEVEL_USER);
       /* Continue as if nothing happened, no reboot necessary. */
     }
   }
@@ -389,9 +203,8 @@ enum mgos_init_result mgos_sys_config_init(void) {
     rename(CONF_USER_FILE_OLD, CONF_USER_FILE);
   }
   /* Successfully loaded system config. Try overrides - they are optional. */
-  load_config_file(CONF_USER_FILE, mgos_sys_config_get_conf_acl(),
-                   true /* check_try */, true /* delete_try */,
-                   mgos_config_schema(), &mgos_sys_config);
+  mgos_sys_config_load_user(&mgos_sys_config, true /* check_try */,
+                            true /* delete_try */);
 
   s_initialized = true;
 
@@ -487,17 +300,12 @@ enum mgos_init_result mgos_sys_config_init(void) {
   return MGOS_INIT_OK;
 }
 
-void mgos_sys_config_register_validator(mgos_config_validator_fn fn) {
-  s_validators = (mgos_config_validator_fn *) realloc(
-      s_validators, (s_num_validators + 1) * sizeof(*s_validators));
-  if (s_validators == NULL) return;
-  s_validators[s_num_validators++] = fn;
-}
-
 bool mgos_config_apply_s(const struct mg_str json, bool save) {
   bool res =
       mgos_conf_parse(json, mgos_sys_config_get_conf_acl(), &mgos_sys_config);
-  if (save) save_cfg(&mgos_sys_config, NULL);
+  /* Even if parsing failed, some values may have been applied. */
+  mgos_sys_config_notify_changes();
+  if (save) mgos_sys_config_save(&mgos_sys_config, false, NULL);
   return res;
 }
 
@@ -0,0 +1,589 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_sys_config_internal.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "common/cs_crc32.h"
+#include "common/cs_dbg.h"
+#include "common/cs_file.h"
+#include "common/str_util.h"
+
+#include "mgos_config_util.h"
+#include "mgos_time.h"
+
+/* See also CONF_USER_FILE */
+#define CONF_USER_FILE_NUM_IDX 4
+
+/* For backward compatibility */
+#define CONF_VENDOR_FILE "conf_vendor.json"
+
+#define CONF_FILE_TRY_SUFFIX ".try"
+
+/*
+ * Snapshot of the config loaded up to MGOS_CONFIG_LEVEL_VENDOR_8.
+ * Not used with config on devices, there's no cheap way to tell if it changed.
+ */
+#if MGOS_ENABLE_CONFIG_SNAPSHOT &&                                        \
+    !(defined(MGOS_CONFIG_DEV_1) || defined(MGOS_CONFIG_DEV_2) ||         \
+      defined(MGOS_CONFIG_DEV_3) || defined(MGOS_CONFIG_DEV_4) ||         \
+      defined(MGOS_CONFIG_DEV_5) || defined(MGOS_CONFIG_DEV_6) ||         \
+      defined(MGOS_CONFIG_DEV_7) || defined(MGOS_CONFIG_DEV_8))
+#define CONF_SNAPSHOT_FILE "conf_snap.bin"
+#endif
+
+/*
+ * Journal of changes to the user level, applied on top of CONF_USER_FILE.
+ * Saves are appended to it until it grows over MGOS_CONFIG_JOURNAL_MAX_SIZE,
+ * then CONF_USER_FILE is rewritten and the journal starts over.
+ * Off by default: until the journal is folded back, CONF_USER_FILE alone does
+ * not have the latest settings, so firmware without journal support (e.g.
+ * after a rollback) and tools that read the file don't see them.
+ */
+#if MGOS_ENABLE_CONFIG_JOURNAL
+#define CONF_JOURNAL_FILE "conf9.jnl"
+#define CONF_JOURNAL_MAGIC 0x4c4e524a /* "JRNL" */
+#ifndef MGOS_CONFIG_JOURNAL_MAX_SIZE
+#define MGOS_CONFIG_JOURNAL_MAX_SIZE 1024
+#endif
+
+struct conf_journal_hdr {
+  uint32_t magic;
+  /* CRC of the CONF_USER_FILE the journal applies to. */
+  uint32_t base_crc;
+};
+#endif
+
+#ifdef CONF_SNAPSHOT_FILE
+/* Must be provided externally, usually auto-generated. */
+extern const char *build_id;
+#endif
+
+static mgos_config_validator_fn *s_validators;
+static int s_num_validators;
+
+static bool load_config_file(const char *filename, struct mgos_conf_acl *acl,
+                             bool check_try, bool delete_try,
+                             const struct mgos_conf_entry *schema, void *cfg) {
+  bool result = false;
+  struct stat st;
+  char tfn_buf[32], *try_filename = tfn_buf;
+  // See if we have "${filename}.try" and prefer that.
+  // Delete the file immediately after loading.
+  if (check_try &&
+      mg_asprintf(&try_filename, sizeof(tfn_buf), "%s%s", filename,
+                  CONF_FILE_TRY_SUFFIX) > 0 &&
+      stat(try_filename, &st) == 0) {
+    filename = try_filename;
+  } else {
+    if (try_filename != tfn_buf) free(try_filename);
+    try_filename = NULL;
+  }
+  if (stat(filename, &st) != 0) {
+    goto out;
+  }
+  LOG(LL_DEBUG, ("Loading %s", filename));
+  /* Streamed, large files don't need a contiguous buffer. */
+  result = mgos_conf_parse_file_acl(filename, schema, acl, cfg, NULL);
+  if (!result) LOG(LL_ERROR, ("Failed to parse %s", filename));
+
+out:
+  if (try_filename != NULL) {
+    if (delete_try) remove(try_filename);
+    if (try_filename != tfn_buf) free(try_filename);
+  }
+  return result;
+}
+
+/*
+ * Returns `acl` if it was compiled from `acl_str`, otherwise compiles
+ * `acl_str` and frees `acl`. The ACL is usually the same for all the levels,
+ * so per-entry results computed for the previous level can be reused.
+ */
+static struct mgos_conf_acl *update_acl(struct mgos_conf_acl *acl,
+                                        const char *acl_str) {
+  if (acl != NULL &&
+      mg_strcmp(mgos_conf_acl_get_src(acl), mg_mk_str(acl_str)) == 0) {
+    return acl;
+  }
+  mgos_conf_acl_free(acl);
+  return mgos_conf_acl_compile(mg_mk_str(acl_str));
+}
+
+#if defined(CONF_SNAPSHOT_FILE) || defined(CONF_JOURNAL_FILE)
+static bool file_crc(const char *fname, uint32_t *crc) {
+  char buf[128];
+  size_t n;
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) return false;
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    *crc = cs_crc32(*crc, buf, n);
+  }
+  fclose(fp);
+  return true;
+}
+#endif
+
+#ifdef CONF_SNAPSHOT_FILE
+/*
+ * Adds size and mtime of a layer file to the snapshot key. If the filesystem
+ * does not keep mtime, the contents are hashed instead.
+ * Returns false if there is a .try file, those are one-offs.
+ */
+static bool snapshot_key_add_file(const char *fname, uint32_t *key) {
+  struct stat st;
+  char try_fname[sizeof(CONF_VENDOR_FILE) + sizeof(CONF_FILE_TRY_SUFFIX)];
+  uint32_t v[2] = {0xffffffff, 0};
+  snprintf(try_fname, sizeof(try_fname), "%s%s", fname, CONF_FILE_TRY_SUFFIX);
+  if (stat(try_fname, &st) == 0) return false;
+  if (stat(fname, &st) == 0) {
+    v[0] = (uint32_t) st.st_size;
+    v[1] = (uint32_t) st.st_mtime;
+  }
+  if (v[1] == 0 && v[0] != 0xffffffff && !file_crc(fname, &v[1])) {
+    return false;
+  }
+  *key = cs_crc32(*key, fname, strlen(fname));
+  *key = cs_crc32(*key, v, sizeof(v));
+  return true;
+}
+
+/*
+ * Computes the key identifying the inputs of the snapshot: firmware build
+ * and all the layer files. Returns false if the snapshot must not be used.
+ */
+static bool get_snapshot_key(uint32_t *key) {
+  char fname[sizeof(CONF_USER_FILE)];
+  memcpy(fname, CONF_USER_FILE, sizeof(fname));
+  *key = cs_crc32(0, build_id, strlen(build_id));
+  for (int i = 1; i <= (int) MGOS_CONFIG_LEVEL_VENDOR_8; i++) {
+    fname[CONF_USER_FILE_NUM_IDX] = '0' + i;
+    if (!snapshot_key_add_file(fname, key)) return false;
+  }
+  return snapshot_key_add_file(CONF_VENDOR_FILE, key);
+}
+
+/*
+ * The last snapshot read or written can be kept in memory. Saving the user
+ * level needs the vendor level config to diff against, this way it is restored
+ * without touching the filesystem (other than for computing the key).
+ * A cached snapshot stays on the heap for as long as the firmware runs, so
+ * only snapshots of up to MGOS_CONFIG_SNAPSHOT_CACHE_MAX_SIZE bytes are kept.
+ * The default of 0 disables the cache.
+ */
+#ifndef MGOS_CONFIG_SNAPSHOT_CACHE_MAX_SIZE
+#define MGOS_CONFIG_SNAPSHOT_CACHE_MAX_SIZE 0
+#endif
+static struct mbuf s_snapshot;
+
+static bool load_snapshot(struct mgos_config *cfg, uint32_t key) {
+  size_t size;
+  const struct mgos_conf_entry *sch = mgos_config_schema();
+  if (s_snapshot.len > 0 &&
+      mgos_conf_snapshot_load(mg_mk_str_n(s_snapshot.buf, s_snapshot.len),
+                              sch, key, cfg)) {
+    return true;
+  }
+  mbuf_free(&s_snapshot);
+  char *data = cs_read_file(CONF_SNAPSHOT_FILE, &size);
+  if (data == NULL) return false;
+  bool res = mgos_conf_snapshot_load(mg_mk_str_n(data, size), sch, key, cfg);
+  if (res && size <= MGOS_CONFIG_SNAPSHOT_CACHE_MAX_SIZE) {
+    s_snapshot.buf = data;
+    s_snapshot.len = s_snapshot.size = size;
+  } else {
+    free(data);
+  }
+  return res;
+}
+
+static void save_snapshot(const struct mgos_config *cfg, uint32_t key) {
+  struct mbuf mb;
+  mbuf_init(&mb, 0);
+  if (mgos_conf_snapshot_save(mgos_config_schema(), cfg, key, &mb)) {
+    FILE *fp = fopen(CONF_SNAPSHOT_FILE, "wb");
+    if (fp != NULL) {
+      /* Partially written file will fail the CRC check. */
+      if (fwrite(mb.buf, 1, mb.len, fp) != mb.len) {
+        LOG(LL_ERROR, ("Failed to write %s", CONF_SNAPSHOT_FILE));
+      }
+      fclose(fp);
+    }
+    mbuf_free(&s_snapshot);
+    if (mb.len <= MGOS_CONFIG_SNAPSHOT_CACHE_MAX_SIZE) {
+      mbuf_trim(&mb);
+      mbuf_move(&mb, &s_snapshot);
+    }
+  }
+  mbuf_free(&mb);
+}
+
+static void drop_snapshot(void) {
+  mbuf_free(&s_snapshot);
+  remove(CONF_SNAPSHOT_FILE);
+}
+#endif /* CONF_SNAPSHOT_FILE */
+
+#ifdef CONF_JOURNAL_FILE
+/*
+ * Applies the journal on top of the user level config in `cfg`.
+ * Returns false if the journal exists but cannot be used in full: it was
+ * written for a different CONF_USER_FILE or the last record is damaged.
+ * On success `size` is set to the size of the journal file.
+ */
+static bool load_journal(struct mgos_conf_acl *acl, struct mgos_config *cfg,
+                         size_t *size) {
+  struct conf_journal_hdr hdr;
+  uint32_t base_crc = 0;
+  size_t len = 0, good_len;
+  bool res = false;
+  char *data = cs_read_file(CONF_JOURNAL_FILE, &len);
+  *size = 0;
+  if (data == NULL) return true;
+  file_crc(CONF_USER_FILE, &base_crc);
+  if (len >= sizeof(hdr)) memcpy(&hdr, data, sizeof(hdr));
+  if (len < sizeof(hdr) || hdr.magic != CONF_JOURNAL_MAGIC ||
+      hdr.base_crc != base_crc) {
+    LOG(LL_WARN, ("Ignoring stale %s", CONF_JOURNAL_FILE));
+    goto out;
+  }
+  /* A save that was interrupted leaves a damaged record at the end. */
+  good_len = mgos_conf_journal_apply(
+      mg_mk_str_n(data + sizeof(hdr), len - sizeof(hdr)), mgos_config_schema(),
+      acl, cfg);
+  if (good_len != len - sizeof(hdr)) {
+    LOG(LL_WARN, ("%s is damaged at %d", CONF_JOURNAL_FILE,
+                  (int) (sizeof(hdr) + good_len)));
+    goto out;
+  }
+  *size = len;
+  res = true;
+out:
+  free(data);
+  return res;
+}
+
+/*
+ * The user level as it was last loaded or saved, along with the size of the
+ * journal file. Saves are diffed against it, so CONF_USER_FILE and the journal
+ * don't have to be read back. NULL if the state of the files is not known,
+ * in which case the next save writes out CONF_USER_FILE in full.
+ */
+static struct mgos_config *s_saved;
+static size_t s_journal_size;
+
+static void set_saved(const struct mgos_config *cfg, size_t journal_size) {
+  const struct mgos_conf_entry *sch = mgos_config_schema();
+  if (s_saved != NULL) mgos_conf_free(sch, s_saved);
+  if (cfg != NULL && s_saved == NULL) s_saved = calloc(1, sizeof(*s_saved));
+  if (cfg == NULL || s_saved == NULL || !mgos_conf_copy(sch, cfg, s_saved)) {
+    if (s_saved != NULL) mgos_conf_free(sch, s_saved);
+    free(s_saved);
+    s_saved = NULL;
+  }
+  s_journal_size = journal_size;
+}
+
+/*
+ * Saves the user level by appending the changes since the last save to the
+ * journal. Returns false if CONF_USER_FILE needs to be written out instead.
+ */
+static bool save_journal(const struct mgos_config *cfg) {
+  bool res = false;
+  size_t jsize = s_journal_size;
+  struct mbuf recs;
+  FILE *fp = NULL;
+  if (s_saved == NULL) return false;
+  mbuf_init(&recs, 0);
+  if (mgos_conf_journal_diff(mgos_config_schema(), cfg, s_saved, &recs) < 0) {
+    goto out;
+  }
+  if (recs.len == 0) {
+    res = true;
+    goto out;
+  }
+  if (jsize + recs.len > MGOS_CONFIG_JOURNAL_MAX_SIZE) goto out;
+  fp = fopen(CONF_JOURNAL_FILE, (jsize == 0 ? "wb" : "ab"));
+  if (fp == NULL) goto out;
+  res = true;
+  if (jsize == 0) {
+    struct conf_journal_hdr hdr = {.magic = CONF_JOURNAL_MAGIC, .base_crc = 0};
+    file_crc(CONF_USER_FILE, &hdr.base_crc);
+    res = (fwrite(&hdr, 1, sizeof(hdr), fp) == sizeof(hdr));
+    jsize += sizeof(hdr);
+  }
+  res = res && (fwrite(recs.buf, 1, recs.len, fp) == recs.len);
+  fclose(fp);
+  if (res) {
+    LOG(LL_INFO, ("Saved %d bytes to %s", (int) recs.len, CONF_JOURNAL_FILE));
+    set_saved(cfg, jsize + recs.len);
+  } else {
+    /* Partially written, CONF_USER_FILE will be rewritten next time. */
+    set_saved(NULL, 0);
+  }
+out:
+  mbuf_free(&recs);
+  return res;
+}
+#endif /* CONF_JOURNAL_FILE */
+
+/* Loads CONF_USER_FILE and the journal, unless a .try file was used. */
+static void load_user_config(struct mgos_conf_acl *acl, bool check_try,
+                             bool delete_try, struct mgos_config *cfg) {
+#ifdef CONF_JOURNAL_FILE
+  struct stat st;
+  size_t jsize;
+  bool use_journal =
+      !(check_try && stat(CONF_USER_FILE CONF_FILE_TRY_SUFFIX, &st) == 0);
+#endif
+  load_config_file(CONF_USER_FILE, acl, check_try, delete_try,
+                   mgos_config_schema(), cfg);
+#ifdef CONF_JOURNAL_FILE
+  if (use_journal && load_journal(acl, cfg, &jsize)) {
+    set_saved(cfg, jsize);
+  } else {
+    set_saved(NULL, 0);
+  }
+#endif
+}
+
+bool mgos_sys_config_load_user(struct mgos_config *cfg, bool check_try,
+                               bool delete_try) {
+  struct mgos_conf_acl *acl = update_acl(NULL, cfg->conf_acl);
+  if (acl == NULL) return false;
+  load_user_config(acl, check_try, delete_try, cfg);
+  mgos_conf_acl_free(acl);
+  return true;
+}
+
+#define PARSE_CONFIG_DEV_LEVEL(l)                                          \
+  if (i == l) {                                                            \
+    mgos_sys_config_parse_dev(CS_STRINGIFY_MACRO(MGOS_CONFIG_DEV_##l), acl, \
+                              sch, cfg);                                   \
+  }
+bool mgos_sys_config_load_level_internal(struct mgos_config *cfg,
+                                         enum mgos_config_level level,
+                                         bool check_try, bool delete_try) {
+  int i;
+  char fname[sizeof(CONF_USER_FILE) + 10];
+  memset(cfg, 0, sizeof(*cfg));
+  if (level > MGOS_CONFIG_LEVEL_USER) return false;
+  memcpy(fname, CONF_USER_FILE, sizeof(CONF_USER_FILE));
+  // Start with compiled-in defaults.
+  mgos_config_set_defaults(cfg);
+  const struct mgos_conf_entry *sch = mgos_config_schema();
+#ifdef CONF_SNAPSHOT_FILE
+  int64_t start = mgos_uptime_micros();
+  uint32_t snap_key = 0;
+  bool use_snapshot = (level == MGOS_CONFIG_LEVEL_VENDOR_8 &&
+                       get_snapshot_key(&snap_key));
+  if (use_snapshot) {
+    if (load_snapshot(cfg, snap_key)) {
+      LOG(LL_DEBUG, ("Loaded config snapshot in %d us",
+                     (int) (mgos_uptime_micros() - start)));
+      return true;
+    }
+    /* May have been partially applied. */
+    mgos_conf_free(sch, cfg);
+    memset(cfg, 0, sizeof(*cfg));
+    mgos_config_set_defaults(cfg);
+  }
+#endif
+  struct mgos_conf_acl *acl = update_acl(NULL, "*");
+  if (acl == NULL) return false;
+  for (i = 1; i <= (int) level; i++) {
+#ifdef MGOS_CONFIG_DEV_1
+    PARSE_CONFIG_DEV_LEVEL(1);
+#endif
+#ifdef MGOS_CONFIG_DEV_2
+    PARSE_CONFIG_DEV_LEVEL(2);
+#endif
+#ifdef MGOS_CONFIG_DEV_3
+    PARSE_CONFIG_DEV_LEVEL(3);
+#endif
+#ifdef MGOS_CONFIG_DEV_4
+    PARSE_CONFIG_DEV_LEVEL(4);
+#endif
+#ifdef MGOS_CONFIG_DEV_5
+    PARSE_CONFIG_DEV_LEVEL(5);
+#endif
+#ifdef MGOS_CONFIG_DEV_6
+    PARSE_CONFIG_DEV_LEVEL(6);
+#endif
+#ifdef MGOS_CONFIG_DEV_7
+    PARSE_CONFIG_DEV_LEVEL(7);
+#endif
+#ifdef MGOS_CONFIG_DEV_8
+    PARSE_CONFIG_DEV_LEVEL(8);
+#endif
+    fname[CONF_USER_FILE_NUM_IDX] = '0' + i;
+    /* Backward compat: load conf_vendor.json at level 5.5 */
+    if (i == 6) {
+      acl = update_acl(acl, cfg->conf_acl);
+      if (acl == NULL) return false;
+      load_config_file(CONF_VENDOR_FILE, acl, false, false, sch, cfg);
+      acl = update_acl(acl, cfg->conf_acl);
+      if (acl == NULL) return false;
+    }
+    if (i == MGOS_CONFIG_LEVEL_USER) {
+      load_user_config(acl, check_try, delete_try, cfg);
+    } else if (!load_config_file(fname, acl, check_try, delete_try, sch,
+                                 cfg)) {
+      // Nothing to do, all the overlays are optional.
+    }
+    acl = update_acl(acl, cfg->conf_acl);
+    if (acl == NULL) return false;
+  }
+  mgos_conf_acl_free(acl);
+#ifdef CONF_SNAPSHOT_FILE
+  if (use_snapshot) {
+    LOG(LL_DEBUG, ("Loaded config files in %d us",
+                   (int) (mgos_uptime_micros() - start)));
+    save_snapshot(cfg, snap_key);
+  }
+#endif
+  return true;
+}
+
+bool mgos_sys_config_load_level(struct mgos_config *cfg,
+                                enum mgos_config_level level) {
+  return mgos_sys_config_load_level_internal(cfg, level, true /* check_try */,
+                                             false /* delete_try */);
+}
+
+bool load_config_defaults(struct mgos_config *cfg) {
+  return mgos_sys_config_load_level_internal(cfg, MGOS_CONFIG_LEVEL_VENDOR_8,
+                                             true /* check_try */,
+                                             false /* delete_try */);
+}
+
+void mgos_sys_config_register_validator(mgos_config_validator_fn fn) {
+  s_validators = (mgos_config_validator_fn *) realloc(
+      s_validators, (s_num_validators + 1) * sizeof(*s_validators));
+  if (s_validators == NULL) return;
+  s_validators[s_num_validators++] = fn;
+}
+
+bool mgos_config_validate(const struct mgos_config *cfg, char **msg) {
+  *msg = NULL;
+  for (int i = 0; i < s_num_validators; i++) {
+    if (!s_validators[i](cfg, msg)) return false;
+  }
+  return true;
+}
+
+bool mgos_sys_config_save_level(const struct mgos_config *cfg,
+                                enum mgos_config_level level, bool try_once,
+                                char **msg) {
+  bool result = false;
+  char fname[sizeof(CONF_USER_FILE) + 10];
+  char try_fname[sizeof(CONF_USER_FILE) + 10];
+  struct mgos_config *defaults = NULL;
+  char *ptr = NULL;
+  if (level > MGOS_CONFIG_LEVEL_USER) goto clean;
+  if (msg == NULL) msg = &ptr;
+  if (!mgos_config_validate(cfg, msg)) goto clean;
+  snprintf(fname, sizeof(fname), "%s", CONF_USER_FILE);
+  snprintf(try_fname, sizeof(try_fname), "%s%s", CONF_USER_FILE,
+           CONF_FILE_TRY_SUFFIX);
+  fname[CONF_USER_FILE_NUM_IDX] = '0' + level;
+  try_fname[CONF_USER_FILE_NUM_IDX] = '0' + level;
+  if (try_once) {
+    strncpy(fname, try_fname, sizeof(fname));
+  } else {
+    /* Delete stale try file that may be there. */
+    remove(try_fname);
+  }
+#ifdef CONF_JOURNAL_FILE
+  /* Journal records are not diffed against the defaults. */
+  if (level == MGOS_CONFIG_LEVEL_USER && !try_once && save_journal(cfg)) {
+    result = true;
+    goto clean;
+  }
+#endif
+  defaults = calloc(1, sizeof(*defaults));
+  if (defaults == NULL) goto clean;
+  if (!mgos_sys_config_load_level(
+          defaults, (enum mgos_config_level)(((int) level) - 1))) {
+    *msg = strdup("failed to load defaults");
+    goto clean;
+  }
+  if (mgos_conf_emit_f(cfg, defaults, mgos_config_schema(), true /* pretty */,
+                       fname)) {
+    LOG(LL_INFO, ("Saved to %s", fname));
+#ifdef CONF_SNAPSHOT_FILE
+    /* Size and mtime may stay the same if saved twice in a second. */
+    if (level <= MGOS_CONFIG_LEVEL_VENDOR_8) drop_snapshot();
+#endif
+#ifdef CONF_JOURNAL_FILE
+    if (level == MGOS_CONFIG_LEVEL_USER && !try_once) {
+      /* Already stale, as CONF_USER_FILE has changed. */
+      remove(CONF_JOURNAL_FILE);
+      set_saved(cfg, 0);
+    } else if (!try_once) {
+      /* The user level is applied on top of this one and has to be redone. */
+      set_saved(NULL, 0);
+    }
+#endif
+    result = true;
+  } else {
+    *msg = strdup("failed to write file");
+  }
+clean:
+  free(ptr);
+  if (defaults != NULL) {
+    mgos_conf_free(mgos_config_schema(), defaults);
+    free(defaults);
+  }
+  return result;
+}
+
+bool mgos_sys_config_save(const struct mgos_config *cfg, bool try_once,
+                          char **msg) {
+  return mgos_sys_config_save_level(cfg, MGOS_CONFIG_LEVEL_USER, try_once, msg);
+}
+
+bool save_cfg(const struct mgos_config *cfg, char **msg) {
+  return mgos_sys_config_save_level(cfg, MGOS_CONFIG_LEVEL_USER, false, msg);
+}
+
+void mgos_config_reset(int level) {
+  int i;
+  char fname[sizeof(CONF_USER_FILE)];
+  memcpy(fname, CONF_USER_FILE, sizeof(fname));
+  for (i = MGOS_CONFIG_LEVEL_USER; i >= level && i > 0; i--) {
+    fname[CONF_USER_FILE_NUM_IDX] = '0' + i;
+    if (remove(fname) == 0) {
+      LOG(LL_INFO, ("Removed %s", fname));
+    }
+  }
+#ifdef CONF_JOURNAL_FILE
+  if (level <= MGOS_CONFIG_LEVEL_USER) {
+    remove(CONF_JOURNAL_FILE);
+    set_saved(NULL, 0);
+  }
+#endif
+#ifdef CONF_SNAPSHOT_FILE
+  if (level <= MGOS_CONFIG_LEVEL_VENDOR_8) drop_snapshot();
+#endif
+}
+
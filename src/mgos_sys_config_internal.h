@@ -16,6 +16,26 @@ extern "C" {
 
 enum mgos_init_result mgos_sys_config_init(void);
 
+/*
+ * Loads config levels up to `level` into `cfg`. If `check_try` is set,
+ * .try files are preferred and with `delete_try` they are removed once used.
+ */
+bool mgos_sys_config_load_level_internal(struct mgos_config *cfg,
+                                         enum mgos_config_level level,
+                                         bool check_try, bool delete_try);
+
+/* Applies the user level on top of the vendor levels already in `cfg`. */
+bool mgos_sys_config_load_user(struct mgos_config *cfg, bool check_try,
+                               bool delete_try);
+
+/* Parses config JSON from a VFS device, see mgos_conf_parse_dev(). */
+void mgos_sys_config_parse_dev(const char *spec, struct mgos_conf_acl *acl,
+                               const struct mgos_conf_entry *schema,
+                               void *cfg);
+
+/* Publishes a new config snapshot if snapshots are in use. */
+void mgos_sys_config_snapshot_update(void);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_sys_config_snapshot.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mgos_config_util.h"
+#include "mgos_sys_config_internal.h"
+#include "mgos_system.h"
+
+struct snapshot {
+  int refs;
+  uint32_t gen;
+  struct mgos_config cfg;
+  /* Followed by the strings. */
+};
+
+/* Everything else is only touched by the main task. */
+static struct mgos_rlock_type *s_lock = NULL;
+static struct snapshot *s_cur = NULL;
+
+static struct snapshot *snapshot_of(const struct mgos_config *cfg) {
+  return (struct snapshot *) (((char *) cfg) -
+                              offsetof(struct snapshot, cfg));
+}
+
+static const char **str_ptr(struct mgos_config *cfg,
+                            const struct mgos_conf_entry *schema,
+                            const struct mgos_conf_entry *e) {
+  return (const char **) (((char *) cfg) + (e->offset - schema->offset));
+}
+
+static bool needs_copy(const char *s) {
+  return (s != NULL && !mgos_config_is_default_str(s));
+}
+
+static struct snapshot *snapshot_create(uint32_t gen) {
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  size_t size = sizeof(struct snapshot);
+  for (int i = 1; i <= schema->num_desc; i++) {
+    const struct mgos_conf_entry *e = schema + i;
+    if (e->type != CONF_TYPE_STRING) continue;
+    const char *s = *str_ptr(&mgos_sys_config, schema, e);
+    if (needs_copy(s)) size += strlen(s) + 1;
+  }
+  struct snapshot *sn = (struct snapshot *) malloc(size);
+  if (sn == NULL) return NULL;
+  sn->refs = 1;
+  sn->gen = gen;
+  memcpy(&sn->cfg, &mgos_sys_config, sizeof(sn->cfg));
+  char *p = (char *) (sn + 1);
+  for (int i = 1; i <= schema->num_desc; i++) {
+    const struct mgos_conf_entry *e = schema + i;
+    if (e->type != CONF_TYPE_STRING) continue;
+    const char **sp = str_ptr(&sn->cfg, schema, e);
+    if (!needs_copy(*sp)) continue;
+    size_t len = strlen(*sp) + 1;
+    memcpy(p, *sp, len);
+    *sp = p;
+    p += len;
+  }
+  return sn;
+}
+
+static void snapshot_unref(struct snapshot *sn) {
+  mgos_rlock(s_lock);
+  bool last = (--sn->refs == 0);
+  mgos_runlock(s_lock);
+  if (last) free(sn);
+}
+
+const struct mgos_config *mgos_sys_config_snapshot_get(void) {
+  struct snapshot *sn;
+  if (s_lock == NULL) return NULL;
+  mgos_rlock(s_lock);
+  sn = s_cur;
+  if (sn != NULL) sn->refs++;
+  mgos_runlock(s_lock);
+  return (sn != NULL ? &sn->cfg : NULL);
+}
+
+void mgos_sys_config_snapshot_put(const struct mgos_config *cfg) {
+  if (cfg == NULL) return;
+  snapshot_unref(snapshot_of(cfg));
+}
+
+uint32_t mgos_sys_config_snapshot_gen(const struct mgos_config *cfg) {
+  return snapshot_of(cfg)->gen;
+}
+
+bool mgos_sys_config_snapshot_publish(void) {
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct snapshot *sn, *old;
+  if (s_lock == NULL) {
+    s_lock = mgos_rlock_create();
+    if (s_lock == NULL) return false;
+  }
+  /* s_cur is only replaced by the main task, no need to lock to read it. */
+  if (s_cur != NULL &&
+      mgos_conf_equal(schema, &s_cur->cfg, &mgos_sys_config)) {
+    return true;
+  }
+  sn = snapshot_create(s_cur != NULL ? s_cur->gen + 1 : 1);
+  if (sn == NULL) return false;
+  mgos_rlock(s_lock);
+  old = s_cur;
+  s_cur = sn;
+  mgos_runlock(s_lock);
+  if (old != NULL) snapshot_unref(old);
+  return true;
+}
+
+void mgos_sys_config_snapshot_update(void) {
+  if (s_lock == NULL) return;
+  mgos_sys_config_snapshot_publish();
+}
@@ -19,8 +19,10 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "common/cs_dbg.h"
+#include "common/platform.h"
 
 #include "mgos_debug.h"
 #include "mgos_event.h"
@@ -62,6 +64,22 @@ void mgos_system_restart_after(int delay_ms) {
   mgos_set_timer(delay_ms, 0 /*repeat*/, reboot_timer_cb, NULL);
 }
 
+/*
+ * Platforms with at most one background task run background callbacks in
+ * order anyway.
+ */
+bool mgos_invoke_cb_key(mgos_cb_t cb, void *arg, uintptr_t key) WEAK;
+bool mgos_invoke_cb_key(mgos_cb_t cb, void *arg, uintptr_t key) {
+  (void) key;
+  return mgos_invoke_cb(cb, arg, MGOS_INVOKE_CB_F_BG_TASK);
+}
+
+bool mgos_get_bg_cb_stats(struct mgos_bg_cb_stats *stats) WEAK;
+bool mgos_get_bg_cb_stats(struct mgos_bg_cb_stats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  return false;
+}
+
 int mgos_itoa(int value, char *out, int base) {
   if (base == 10 && value < 0) {
     *(out++) = '-';
@@ -17,10 +17,9 @@
 
 #include "mgos_timers_internal.h"
 
-#include "common/queue.h"
-
 #include "mgos_event.h"
 #include "mgos_features.h"
+#include "mgos_loop_stats.h"
 #include "mgos_mongoose.h"
 #include "mgos_mongoose_internal.h"
 #include "mgos_system.h"
@@ -37,6 +36,30 @@
 #define MGOS_SW_TIMER_MASK ((uintptr_t) -1)
 #endif
 
+/*
+ * Software timer ID is a slot number tagged with the slot's generation.
+ * Generation lives in the upper 16 bits (the ones covered by
+ * MGOS_SW_TIMER_MASK) and is never 0, so SW timer IDs never collide with
+ * HW timer IDs and stale IDs of cleared timers are detected without a scan.
+ */
+#ifdef __LP64__
+#define MGOS_SW_TIMER_GEN_SHIFT 48
+#else
+#define MGOS_SW_TIMER_GEN_SHIFT 16
+#endif
+#define MGOS_SW_TIMER_SLOT_MASK \
+  ((((uintptr_t) 1) << MGOS_SW_TIMER_GEN_SHIFT) - 1)
+
+/* Max number of due timers dispatched per MG_EV_TIMER, 0 - no limit. */
+#ifndef MGOS_SW_TIMER_DISPATCH_BUDGET
+#define MGOS_SW_TIMER_DISPATCH_BUDGET 16
+#endif
+
+/* Timers that fire later than this are counted as late. */
+#ifndef MGOS_SW_TIMER_LATE_MS
+#define MGOS_SW_TIMER_LATE_MS 10
+#endif
+
 #ifndef IRAM
 #define IRAM
 #endif
@@ -46,72 +69,248 @@ struct timer_info {
   double next_invocation;
   timer_callback cb;
   void *cb_arg;
-  LIST_ENTRY(timer_info) entries;
+  /* Insertion order, breaks ties between timers with the same deadline. */
+  uint32_t seq;
+  /* Index in timer_data::heap, -1 if not in the heap. */
+  int heap_idx;
+  /* Index in timer_data::slots. */
+  int slot;
+  /*
+   * Set while the timer is in the dispatch batch. A timer cleared while
+   * dispatching has cb reset to NULL and is freed by the dispatcher.
+   */
+  bool dispatching;
+  struct timer_info *dispatch_next;
+};
+
+struct timer_slot {
+  struct timer_info *ti;
+  /* Next free slot when ti is NULL, -1 terminates the free list. */
+  int next_free;
+  uint16_t gen;
 };
 
 struct timer_data {
-  struct timer_info *current;
   struct mg_connection *nc;
-  LIST_HEAD(timers, timer_info) timers;
+  /* Binary min-heap ordered by next_invocation. */
+  struct timer_info **heap;
+  int heap_len;
+  int heap_size;
+  /* ID -> timer map. */
+  struct timer_slot *slots;
+  int num_slots;
+  int free_slot;
+  uint32_t seq;
+  int dispatch_budget;
+  struct mgos_sw_timer_stats stats;
 };
 
 static struct timer_data *s_timer_data = NULL;
 static struct mgos_rlock_type *s_timer_data_lock = NULL;
 
-static void schedule_next_timer(struct timer_data *td, double now) {
-  struct timer_info *ti;
-  struct timer_info *min_ti = NULL;
-  LIST_FOREACH(ti, &td->timers, entries) {
-    if (min_ti == NULL || ti->next_invocation < min_ti->next_invocation) {
-      min_ti = ti;
+static inline bool timer_before(const struct timer_info *a,
+                                const struct timer_info *b) {
+  if (a->next_invocation != b->next_invocation) {
+    return a->next_invocation < b->next_invocation;
+  }
+  return (int32_t)(a->seq - b->seq) < 0;
+}
+
+static inline void heap_set(struct timer_data *td, int i,
+                            struct timer_info *ti) {
+  td->heap[i] = ti;
+  ti->heap_idx = i;
+}
+
+static void heap_sift_up(struct timer_data *td, int i) {
+  struct timer_info *ti = td->heap[i];
+  while (i > 0) {
+    int pi = (i - 1) / 2;
+    if (!timer_before(ti, td->heap[pi])) break;
+    heap_set(td, i, td->heap[pi]);
+    i = pi;
+  }
+  heap_set(td, i, ti);
+}
+
+static void heap_sift_down(struct timer_data *td, int i) {
+  struct timer_info *ti = td->heap[i];
+  while (true) {
+    int ci = 2 * i + 1;
+    if (ci >= td->heap_len) break;
+    if (ci + 1 < td->heap_len && timer_before(td->heap[ci + 1], td->heap[ci])) {
+      ci++;
+    }
+    if (!timer_before(td->heap[ci], ti)) break;
+    heap_set(td, i, td->heap[ci]);
+    i = ci;
+  }
+  heap_set(td, i, ti);
+}
+
+static bool heap_push(struct timer_data *td, struct timer_info *ti) {
+  if (td->heap_len == td->heap_size) {
+    int new_size = (td->heap_size > 0 ? td->heap_size * 2 : 8);
+    struct timer_info **new_heap = (struct timer_info **) realloc(
+        td->heap, new_size * sizeof(*new_heap));
+    if (new_heap == NULL) return false;
+    td->heap = new_heap;
+    td->heap_size = new_size;
+  }
+  heap_set(td, td->heap_len++, ti);
+  heap_sift_up(td, ti->heap_idx);
+  return true;
+}
+
+static void heap_remove(struct timer_data *td, struct timer_info *ti) {
+  int i = ti->heap_idx;
+  struct timer_info *last = td->heap[--td->heap_len];
+  ti->heap_idx = -1;
+  if (last == ti) return;
+  heap_set(td, i, last);
+  if (i > 0 && timer_before(last, td->heap[(i - 1) / 2])) {
+    heap_sift_up(td, i);
+  } else {
+    heap_sift_down(td, i);
+  }
+}
+
+static mgos_timer_id slot_alloc(struct timer_data *td, struct timer_info *ti) {
+  if (td->free_slot < 0) {
+    int new_num = (td->num_slots > 0 ? td->num_slots * 2 : 8);
+    if ((uintptr_t) new_num > MGOS_SW_TIMER_SLOT_MASK + 1) {
+      new_num = (int) (MGOS_SW_TIMER_SLOT_MASK + 1);
     }
+    if (new_num <= td->num_slots) return MGOS_INVALID_TIMER_ID;
+    struct timer_slot *new_slots = (struct timer_slot *) realloc(
+        td->slots, new_num * sizeof(*new_slots));
+    if (new_slots == NULL) return MGOS_INVALID_TIMER_ID;
+    for (int i = new_num - 1; i >= td->num_slots; i--) {
+      new_slots[i].ti = NULL;
+      new_slots[i].gen = 1;
+      new_slots[i].next_free = td->free_slot;
+      td->free_slot = i;
+    }
+    td->slots = new_slots;
+    td->num_slots = new_num;
   }
-  td->current = min_ti;
-  if (min_ti != NULL) {
-    double diff = min_ti->next_invocation - now;
+  int slot = td->free_slot;
+  struct timer_slot *ts = &td->slots[slot];
+  td->free_slot = ts->next_free;
+  ts->ti = ti;
+  ti->slot = slot;
+  return (((mgos_timer_id) ts->gen) << MGOS_SW_TIMER_GEN_SHIFT) |
+         (mgos_timer_id) slot;
+}
+
+static void slot_free(struct timer_data *td, struct timer_info *ti) {
+  struct timer_slot *ts = &td->slots[ti->slot];
+  ts->ti = NULL;
+  if (++ts->gen == 0) ts->gen = 1;
+  ts->next_free = td->free_slot;
+  td->free_slot = ti->slot;
+}
+
+static struct timer_info *timer_lookup(struct timer_data *td,
+                                       mgos_timer_id id) {
+  uintptr_t slot = (id & MGOS_SW_TIMER_SLOT_MASK);
+  uintptr_t gen = (id >> MGOS_SW_TIMER_GEN_SHIFT);
+  if (slot >= (uintptr_t) td->num_slots) return NULL;
+  const struct timer_slot *ts = &td->slots[slot];
+  if (ts->ti == NULL || ts->gen != gen) return NULL;
+  return ts->ti;
+}
+
+static void schedule_next_timer(struct timer_data *td, double now) {
+  if (td->heap_len > 0) {
+    double diff = td->heap[0]->next_invocation - now;
     td->nc->ev_timer_time = mg_time() + diff;
   } else {
     td->nc->ev_timer_time = 0;
   }
 }
 
+/*
+ * Takes due timers off the heap (one-shot) or reschedules them (repeating)
+ * and returns them as a list in deadline order. Must be called with the lock
+ * held.
+ */
+static struct timer_info *collect_due_timers(struct timer_data *td,
+                                             double now) {
+  struct timer_info *head = NULL, **tail = &head;
+  int n = 0;
+  while (td->heap_len > 0 &&
+         (td->dispatch_budget <= 0 || n < td->dispatch_budget)) {
+    struct timer_info *ti = td->heap[0];
+    /* Dispatching check stops a 0-interval repeating timer from looping. */
+    if (ti->next_invocation > now || ti->dispatching) break;
+    const double late_ms = (now - ti->next_invocation) * 1000;
+    td->stats.num_fired++;
+#if MGOS_ENABLE_LOOP_STATS
+    mgos_loop_stats_record(MGOS_LOOP_STATS_TIMER_LATE,
+                           (uint32_t) (late_ms * 1000));
+#endif
+    if (late_ms >= MGOS_SW_TIMER_LATE_MS) {
+      td->stats.num_late++;
+      td->stats.late_ms_total += late_ms;
+      if (late_ms > td->stats.late_ms_max) td->stats.late_ms_max = late_ms;
+    }
+    if (ti->interval_ms >= 0) {
+      const double intvl = (ti->interval_ms / 1000.0);
+      ti->next_invocation += intvl;
+      /* Polling loop was delayed, re-sync the invocation. */
+      if (ti->next_invocation < now) ti->next_invocation = now + intvl;
+      ti->seq = td->seq++;
+      heap_sift_down(td, 0);
+    } else {
+      heap_remove(td, ti);
+    }
+    ti->dispatching = true;
+    ti->dispatch_next = NULL;
+    *tail = ti;
+    tail = &ti->dispatch_next;
+    n++;
+  }
+  return head;
+}
+
 static void mgos_timer_ev(struct mg_connection *nc, int ev, void *ev_data,
                           void *user_data) {
   if (ev != MG_EV_TIMER) return;
-  timer_callback cb = NULL;
-  void *cb_arg = NULL;
-  {
+  struct timer_data *td = (struct timer_data *) user_data;
+  struct timer_info *ti, *next;
+  mgos_rlock(s_timer_data_lock);
+  const double now = mgos_uptime();
+  ti = collect_due_timers(td, now);
+  schedule_next_timer(td, now);
+  mgos_runlock(s_timer_data_lock);
+  for (; ti != NULL; ti = next) {
+    timer_callback cb;
+    void *cb_arg;
+    bool release = false;
+    /* Earlier callbacks in the batch may have cleared this timer. */
     mgos_rlock(s_timer_data_lock);
-    struct timer_data *td = (struct timer_data *) user_data;
-    struct timer_info *ti = td->current;
-    /* Current can be NULL if it was the first to fire but was cleared. */
-    const double now = mgos_uptime();
-    if (ti != NULL && ti->next_invocation <= now) {
-      cb = ti->cb;
-      cb_arg = ti->cb_arg;
-      if (ti->interval_ms >= 0) {
-        const double intvl = (ti->interval_ms / 1000.0);
-        ti->next_invocation += intvl;
-        /* Polling loop was delayed, re-sync the invocation. */
-        if (ti->next_invocation < now) ti->next_invocation = now + intvl;
-        ti = NULL;
-      } else {
-        LIST_REMOVE(ti, entries);
-      }
-    } else {
-      ti = NULL;
+    next = ti->dispatch_next;
+    cb = ti->cb;
+    cb_arg = ti->cb_arg;
+    ti->dispatching = false;
+    if (cb == NULL) {
+      release = true;
+    } else if (ti->interval_ms < 0) {
+      slot_free(td, ti);
+      release = true;
     }
-    schedule_next_timer(td, now);
     mgos_runlock(s_timer_data_lock);
-    if (ti != NULL) free(ti);
+    if (release) free(ti);
+    if (cb != NULL) cb(cb_arg);
   }
-  if (cb != NULL) cb(cb_arg);
   (void) ev_data;
   (void) nc;
 }
 
 mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb,
                              void *arg) {
+  mgos_timer_id id;
   struct timer_info *ti = (struct timer_info *) calloc(1, sizeof(*ti));
   if (ti == NULL) return MGOS_INVALID_TIMER_ID;
   if (flags & MGOS_TIMER_REPEAT) {
@@ -126,30 +325,43 @@ mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb,
   ti->cb_arg = arg;
   {
     mgos_rlock(s_timer_data_lock);
-    LIST_INSERT_HEAD(&s_timer_data->timers, ti, entries);
-    schedule_next_timer(s_timer_data, now);
+    ti->seq = s_timer_data->seq++;
+    id = slot_alloc(s_timer_data, ti);
+    if (id != MGOS_INVALID_TIMER_ID && !heap_push(s_timer_data, ti)) {
+      slot_free(s_timer_data, ti);
+      id = MGOS_INVALID_TIMER_ID;
+    }
+    if (id != MGOS_INVALID_TIMER_ID) schedule_next_timer(s_timer_data, now);
     mgos_runlock(s_timer_data_lock);
   }
+  if (id == MGOS_INVALID_TIMER_ID) {
+    free(ti);
+    return MGOS_INVALID_TIMER_ID;
+  }
   mongoose_schedule_poll(false /* from_isr */);
-  return (mgos_timer_id) ti;
+  return id;
 }
 
 static void mgos_clear_sw_timer(mgos_timer_id id) {
-  struct timer_info *ti = (struct timer_info *) id, *ti2;
   mgos_rlock(s_timer_data_lock);
-  LIST_FOREACH(ti2, &s_timer_data->timers, entries) {
-    if (ti2 == ti) break;
-  }
-  if (ti2 == NULL) {
+  struct timer_info *ti = timer_lookup(s_timer_data, id);
+  if (ti == NULL) {
     /* Not a valid timer */
     mgos_runlock(s_timer_data_lock);
     return;
   }
-  LIST_REMOVE(ti, entries);
-  if (s_timer_data->current == ti) {
+  bool was_first = (ti->heap_idx == 0);
+  if (ti->heap_idx >= 0) heap_remove(s_timer_data, ti);
+  slot_free(s_timer_data, ti);
+  if (was_first) {
     schedule_next_timer(s_timer_data, mgos_uptime());
     /* Removing a timer can only push back invocation, no need to do a poll. */
   }
+  if (ti->dispatching) {
+    /* Dispatcher holds a reference, it will free the timer. */
+    ti->cb = NULL;
+    ti = NULL;
+  }
   mgos_runlock(s_timer_data_lock);
   free(ti);
 }
@@ -167,12 +379,9 @@ IRAM void mgos_clear_timer(mgos_timer_id id) {
 }
 
 bool mgos_get_timer_info(mgos_timer_id id, struct mgos_timer_info *info) {
-  struct timer_info *ti = (struct timer_info *) id, *ti2;
   mgos_rlock(s_timer_data_lock);
-  LIST_FOREACH(ti2, &s_timer_data->timers, entries) {
-    if (ti2 == ti) break;
-  }
-  if (ti2 == NULL) {
+  struct timer_info *ti = timer_lookup(s_timer_data, id);
+  if (ti == NULL) {
     /* Not a valid timer */
     mgos_runlock(s_timer_data_lock);
     return false;
@@ -185,6 +394,40 @@ bool mgos_get_timer_info(mgos_timer_id id, struct mgos_timer_info *info) {
   return true;
 }
 
+void mgos_set_sw_timer_dispatch_budget(int max_timers) {
+  mgos_rlock(s_timer_data_lock);
+  s_timer_data->dispatch_budget = max_timers;
+  mgos_runlock(s_timer_data_lock);
+}
+
+void mgos_get_sw_timer_stats(struct mgos_sw_timer_stats *stats) {
+  mgos_rlock(s_timer_data_lock);
+  *stats = s_timer_data->stats;
+  mgos_runlock(s_timer_data_lock);
+}
+
+void mgos_reset_sw_timer_stats(void) {
+  mgos_rlock(s_timer_data_lock);
+  memset(&s_timer_data->stats, 0, sizeof(s_timer_data->stats));
+  mgos_runlock(s_timer_data_lock);
+}
+
+int mgos_get_sw_timer_next_due_ms(void) {
+  int res = -1;
+  mgos_rlock(s_timer_data_lock);
+  if (s_timer_data->heap_len > 0) {
+    double diff_ms =
+        (s_timer_data->heap[0]->next_invocation - mgos_uptime()) * 1000;
+    res = 0;
+    if (diff_ms > 0) {
+      res = (int) diff_ms;
+      if (res < diff_ms) res++; /* Round up, don't wake up too early. */
+    }
+  }
+  mgos_runlock(s_timer_data_lock);
+  return res;
+}
+
 static void mgos_poll_cb(void *arg) {
   struct timer_data *td = (struct timer_data *) arg;
   mgos_rlock(s_timer_data_lock);
@@ -204,6 +447,8 @@ enum mgos_init_result mgos_timers_init(void) {
   struct timer_data *td = (struct timer_data *) calloc(1, sizeof(*td));
   struct mg_add_sock_opts opts;
   memset(&opts, 0, sizeof(opts));
+  td->free_slot = -1;
+  td->dispatch_budget = MGOS_SW_TIMER_DISPATCH_BUDGET;
   td->nc =
       mg_add_sock_opt(mgos_get_mgr(), INVALID_SOCKET, mgos_timer_ev, td, opts);
   if (td->nc == NULL) {
@@ -16,6 +16,13 @@ extern "C" {
 
 enum mgos_init_result mgos_timers_init(void);
 
+/*
+ * Returns the number of milliseconds until the earliest software timer is
+ * due (0 if already due), or -1 if there are no software timers.
+ * Lets a platform main loop sleep until there is work to do.
+ */
+int mgos_get_sw_timer_next_due_ms(void);
+
 /* Initialize uptime */
 void mgos_uptime_init(void);
 
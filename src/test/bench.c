@@ -0,0 +1,674 @@
+/*
+ * Copyright (c) 2014-2016 Cesanta Software Limited
+ * All rights reserved
+ */
+
+/*
+ * Benchmarks of core modules. These only print timings and are not part of
+ * the unit tests, run them with "make bench".
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "common/cs_dbg.h"
+#include "common/cs_file.h"
+#include "common/json_utils.h"
+
+#include "frozen.h"
+
+#include "mgos_config_util.h"
+#include "mgos_event_internal.h"
+#include "mgos_sys_config_snapshot.h"
+#include "mgos_timers_internal.h"
+#include "ubuntu_cb_queue.h"
+
+#include "mgos_config.h"
+#include "rpa_queue.h"
+#include "test_hal.h"
+#include "test_main.h"
+#include "test_util.h"
+
+#define CONFIG_BENCH_ITERS 2000
+
+static double config_load_time(const char *json,
+                               const struct mgos_conf_entry *schema,
+                               char **emitted) {
+  struct mgos_config conf;
+  struct mbuf mb;
+  double start = cs_time();
+  for (int i = 0; i < CONFIG_BENCH_ITERS; i++) {
+    mgos_config_set_defaults(&conf);
+    mgos_conf_parse_sub_msg(mg_mk_str(json), schema, "*", &conf, NULL);
+    if (i < CONFIG_BENCH_ITERS - 1) mgos_conf_free(schema, &conf);
+  }
+  double elapsed = cs_time() - start;
+  mbuf_init(&mb, 0);
+  mgos_conf_emit_cb(&conf, NULL, schema, false, &mb, NULL, NULL);
+  mbuf_append(&mb, "", 1);
+  *emitted = mb.buf;
+  mgos_conf_free(schema, &conf);
+  return elapsed * 1e6 / CONFIG_BENCH_ITERS;
+}
+
+static const char *bench_config_load(void) {
+  size_t size;
+  char *json = cs_read_file("build/mgos_config.json", &size);
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  char *emitted_idx = NULL, *emitted_lin = NULL;
+  ASSERT_PTRNE(json, NULL);
+
+  /* Same schema without the index, to compare with a linear scan. */
+  const int n = schema->num_desc + 1;
+  struct mgos_conf_entry *linear =
+      (struct mgos_conf_entry *) malloc(n * sizeof(*linear));
+  memcpy(linear, schema, n * sizeof(*linear));
+  for (int i = 0; i < n; i++) linear[i].sorted_children = NULL;
+
+  cs_log_set_level(LL_NONE);
+  double t_idx = config_load_time(json, schema, &emitted_idx);
+  double t_lin = config_load_time(json, linear, &emitted_lin);
+  ASSERT_STREQ(emitted_idx, emitted_lin);
+  printf("    %d keys: load %.2f us, linear scan %.2f us\n", n, t_idx,
+         t_lin);
+
+  free(emitted_idx);
+  free(emitted_lin);
+  free(linear);
+  free(json);
+  return NULL;
+}
+
+static const char *bench_config_snapshot(void) {
+  size_t size;
+  char *json = cs_read_file("data/overrides.json", &size);
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct mgos_config conf;
+  struct mbuf snap;
+  ASSERT_PTRNE(json, NULL);
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&conf);
+  ASSERT(mgos_conf_parse(mg_mk_str_n(json, size), "*", &conf));
+  mbuf_init(&snap, 0);
+  ASSERT(mgos_conf_snapshot_save(schema, &conf, 123, &snap));
+  const struct mg_str data = mg_mk_str_n(snap.buf, snap.len);
+  mgos_config_free(&conf);
+
+  double start = cs_time();
+  for (int i = 0; i < CONFIG_BENCH_ITERS; i++) {
+    mgos_config_set_defaults(&conf);
+    mgos_conf_snapshot_load(data, schema, 123, &conf);
+    mgos_conf_free(schema, &conf);
+  }
+  double t_snap = (cs_time() - start) * 1e6 / CONFIG_BENCH_ITERS;
+  char *emitted = NULL;
+  double t_json = config_load_time(json, schema, &emitted);
+  printf("    JSON %d bytes: %.2f us, snapshot %d bytes: %.2f us\n",
+         (int) size, t_json, (int) snap.len, t_snap);
+
+  free(emitted);
+  mbuf_free(&snap);
+  free(json);
+  return NULL;
+}
+
+/* Typed accessors against the string API. */
+static const char *bench_config_typed(void) {
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  const char *keys[] = {"wifi.ap.ssid", "debug.level", "debug.test_f1",
+                        "test.bar2.baz.bazaar"};
+  const struct mgos_conf_entry *ents[ARRAY_SIZE(keys)];
+  const int iters = 20000;
+  struct mgos_config conf;
+  struct mbuf mb;
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&conf);
+  for (size_t i = 0; i < ARRAY_SIZE(keys); i++) {
+    ents[i] = mgos_conf_find_schema_entry(keys[i], schema);
+    ASSERT_PTRNE(ents[i], NULL);
+  }
+  ASSERT(mgos_conf_value_set_string(&conf, ents[0], "ap1"));
+
+  double start = cs_time();
+  for (int i = 0; i < iters; i++) {
+    struct mg_str v;
+    for (size_t j = 0; j < ARRAY_SIZE(keys); j++) {
+      mgos_config_get(mg_mk_str(keys[j]), &v, &conf, schema);
+      mgos_config_set(mg_mk_str(keys[j]), v, &conf, schema, true);
+      free((void *) v.p);
+    }
+  }
+  double t_str = cs_time() - start;
+  start = cs_time();
+  for (int i = 0; i < iters; i++) {
+    mgos_conf_value_set_string(&conf, ents[0],
+                               mgos_conf_value_string(&conf, ents[0]));
+    mgos_conf_value_set_int(&conf, ents[1],
+                            mgos_conf_value_int(&conf, ents[1]));
+    mgos_conf_value_set_double(&conf, ents[2],
+                               mgos_conf_value_float(&conf, ents[2]));
+    mgos_conf_value_set_int(&conf, ents[3],
+                            mgos_conf_value_int(&conf, ents[3]));
+  }
+  double t_typed = cs_time() - start;
+  printf("    get+set 4 keys: string %.2f us, typed %.2f us\n",
+         t_str * 1e6 / iters, t_typed * 1e6 / iters);
+
+  mbuf_init(&mb, 0);
+  start = cs_time();
+  for (int i = 0; i < iters; i++) {
+    mb.len = 0;
+    mgos_conf_emit_entries(&conf, schema, ents, ARRAY_SIZE(ents), &mb);
+  }
+  double t_emit = cs_time() - start;
+  printf("    emit 4 keys: %.2f us\n", t_emit * 1e6 / iters);
+
+  mbuf_free(&mb);
+  mgos_config_free(&conf);
+  return NULL;
+}
+
+/*
+ * What saving the user level involves: getting the vendor level config to
+ * diff against and emitting the difference. Vendor level is loaded from
+ * the file or restored from a snapshot kept in memory.
+ */
+static const char *bench_config_save(void) {
+  const char *vendor_file = "data/overrides.json";
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct mgos_conf_acl *acl = mgos_conf_acl_compile(mg_mk_str("*"));
+  struct mgos_config cfg, base;
+  struct mbuf snap, diff_json, diff_snap;
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&cfg);
+  ASSERT(mgos_conf_parse_file_acl(vendor_file, schema, acl, &cfg, NULL));
+  mbuf_init(&snap, 0);
+  ASSERT(mgos_conf_snapshot_save(schema, &cfg, 1, &snap));
+  cfg.wifi.ap.channel = 11;
+  mgos_conf_set_str(&cfg.wifi.sta.pass, "new pass");
+
+  mbuf_init(&diff_json, 0);
+  mbuf_init(&diff_snap, 0);
+  double start = cs_time();
+  for (int i = 0; i < CONFIG_BENCH_ITERS; i++) {
+    diff_json.len = 0;
+    mgos_config_set_defaults(&base);
+    mgos_conf_parse_file_acl(vendor_file, schema, acl, &base, NULL);
+    mgos_conf_emit_cb(&cfg, &base, schema, false, &diff_json, NULL, NULL);
+    mgos_conf_free(schema, &base);
+  }
+  double t_json = (cs_time() - start) * 1e6 / CONFIG_BENCH_ITERS;
+  start = cs_time();
+  for (int i = 0; i < CONFIG_BENCH_ITERS; i++) {
+    diff_snap.len = 0;
+    mgos_config_set_defaults(&base);
+    mgos_conf_snapshot_load(mg_mk_str_n(snap.buf, snap.len), schema, 1, &base);
+    mgos_conf_emit_cb(&cfg, &base, schema, false, &diff_snap, NULL, NULL);
+    mgos_conf_free(schema, &base);
+  }
+  double t_snap = (cs_time() - start) * 1e6 / CONFIG_BENCH_ITERS;
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(diff_json.buf, diff_json.len),
+                      mg_mk_str_n(diff_snap.buf, diff_snap.len)),
+            0);
+  mbuf_append(&diff_snap, "", 1);
+  ASSERT_PTRNE(strstr(diff_snap.buf, "\"channel\":11"), NULL);
+  ASSERT_PTRNE(strstr(diff_snap.buf, "\"pass\":\"new pass\""), NULL);
+  ASSERT_PTREQ(strstr(diff_snap.buf, "ssid"), NULL);
+  printf("    diff from file: %.2f us, from snapshot (%d bytes): %.2f us\n",
+         t_json, (int) snap.len, t_snap);
+
+  mbuf_free(&diff_json);
+  mbuf_free(&diff_snap);
+  mbuf_free(&snap);
+  mgos_config_free(&cfg);
+  mgos_conf_acl_free(acl);
+  return NULL;
+}
+
+/*
+ * Compares json_scanf() with all the conversions at once against one
+ * json_scanf() per conversion, which is what each call used to cost.
+ */
+static const char *bench_json_scanf(void) {
+  const char *fmt =
+      "{f0: %d, f1: %d, f2: %d, f3: %d, f4: %d, f5: %d, f6: %d, f7: %d, "
+      "f8: %d, f9: %d, f10: %d, f11: %d, f12: %d, f13: %d, f14: %d}";
+  const int sizes[] = {256, 2048, 8192};
+  const int counts[] = {1, 5, 15};
+  for (size_t si = 0; si < ARRAY_SIZE(sizes); si++) {
+    struct mbuf mb;
+    int v[15], iters = 50000 / sizes[si];
+    mbuf_init(&mb, 0);
+    mbuf_append(&mb, "{\"pad\": [", 9);
+    while ((int) mb.len < sizes[si] - 200) mbuf_append(&mb, "123, ", 5);
+    mbuf_append(&mb, "0]", 2);
+    for (int i = 0; i < 15; i++) {
+      char buf[20];
+      int n = snprintf(buf, sizeof(buf), ", \"f%d\": %d", i, i + 100);
+      mbuf_append(&mb, buf, n);
+    }
+    mbuf_append(&mb, "}", 1);
+    for (size_t ci = 0; ci < ARRAY_SIZE(counts); ci++) {
+      const int nf = counts[ci];
+      memset(v, 0, sizeof(v));
+      double start = cs_time();
+      for (int it = 0; it < iters; it++) {
+        if (nf == 1) {
+          ASSERT_EQ(json_scanf(mb.buf, mb.len, "{f0: %d}", &v[0]), 1);
+        } else if (nf == 5) {
+          ASSERT_EQ(json_scanf(mb.buf, mb.len,
+                               "{f0: %d, f1: %d, f2: %d, f3: %d, f4: %d}",
+                               &v[0], &v[1], &v[2], &v[3], &v[4]),
+                    5);
+        } else {
+          ASSERT_EQ(json_scanf(mb.buf, mb.len, fmt, &v[0], &v[1], &v[2],
+                               &v[3], &v[4], &v[5], &v[6], &v[7], &v[8],
+                               &v[9], &v[10], &v[11], &v[12], &v[13], &v[14]),
+                    15);
+        }
+      }
+      double t_one = (cs_time() - start) * 1e6 / iters;
+      for (int i = 0; i < nf; i++) ASSERT_EQ(v[i], i + 100);
+      start = cs_time();
+      for (int it = 0; it < iters; it++) {
+        for (int i = 0; i < nf; i++) {
+          char f[20];
+          snprintf(f, sizeof(f), "{f%d: %%d}", i);
+          json_scanf(mb.buf, mb.len, f, &v[i]);
+        }
+      }
+      double t_per = (cs_time() - start) * 1e6 / iters;
+      printf("    %5d bytes, %2d fields: %8.2f us, walk per field %8.2f us\n",
+             (int) mb.len, nf, t_one, t_per);
+    }
+    mbuf_free(&mb);
+  }
+  return NULL;
+}
+
+/* Lookups in a parsed tape against re-parsing the text for each. */
+static const char *bench_json_tape(void) {
+  struct json_tape t;
+  struct json_token tok;
+  struct mbuf mb;
+  const int num = 200, iters = 20;
+  int i, n;
+  mbuf_init(&mb, 0);
+  mbuf_append(&mb, "{\"v\": [", 7);
+  for (i = 0; i < num; i++) {
+    char buf[50];
+    n = snprintf(buf, sizeof(buf), "%s{\"id\": %d, \"s\": \"item\"}",
+                 (i > 0 ? ", " : ""), i);
+    mbuf_append(&mb, buf, n);
+  }
+  mbuf_append(&mb, "]}", 2);
+  double start = cs_time();
+  for (int it = 0; it < iters; it++) {
+    for (i = 0; i < num; i += 10) {
+      ASSERT(json_scanf_array_elem(mb.buf, mb.len, ".v", i, &tok) > 0);
+    }
+  }
+  double t_text = (cs_time() - start) * 1e6 / iters;
+  start = cs_time();
+  for (int it = 0; it < iters; it++) {
+    json_tape_init(&t, NULL, 0);
+    ASSERT(json_tape_parse(&t, mb.buf, mb.len) > 0);
+    int v = json_tape_find(&t, 0, ".v");
+    for (i = 0; i < num; i += 10) ASSERT(json_tape_elem(&t, v, i) > 0);
+    json_tape_free(&t);
+  }
+  double t_tape = (cs_time() - start) * 1e6 / iters;
+  printf("    %d lookups in %d bytes: text %.2f us, tape %.2f us\n", num / 10,
+         (int) mb.len, t_text, t_tape);
+  mbuf_free(&mb);
+  return NULL;
+}
+
+static void json_count_cb(void *data, const char *name, size_t name_len,
+                          const char *path, const struct json_token *tok) {
+  (*(int *) data)++;
+  (void) name;
+  (void) name_len;
+  (void) path;
+  (void) tok;
+}
+
+/* Walks `json` over and over for a while, returns MB/s. */
+static double json_walk_mbps(const struct mbuf *json, int *num_tokens) {
+  int iters = 0;
+  double start = cs_time(), elapsed;
+  do {
+    *num_tokens = 0;
+    if (json_walk(json->buf, json->len, json_count_cb, num_tokens) !=
+        (int) json->len) {
+      return -1;
+    }
+    iters++;
+  } while ((elapsed = cs_time() - start) < 0.1);
+  return json->len * iters / elapsed / 1e6;
+}
+
+static const char *bench_json_walk(void) {
+  struct mbuf pretty, compact;
+  int num_tokens;
+  mbuf_init(&pretty, 0);
+  mbuf_init(&compact, 0);
+  /* Records as a cloud sync would send them, pretty-printed. */
+  mbuf_append(&pretty, "[\n", 2);
+  for (int i = 0; pretty.len < 512 * 1024; i++) {
+    char buf[400];
+    int n = snprintf(buf, sizeof(buf),
+                     "%s  {\n    \"id\": \"device-%08d\",\n"
+                     "    \"name\": \"Temperature sensor in room %d\",\n"
+                     "    \"description\": \"Reports every 60 seconds, "
+                     "\\\"calibrated\\\" on site\",\n"
+                     "    \"tags\": [\"indoor\", \"floor-%d\"],\n"
+                     "    \"enabled\": true,\n"
+                     "    \"value\": %d.%02d\n  }",
+                     (i > 0 ? ",\n" : ""), i, i, i % 10, i % 40, i % 100);
+    mbuf_append(&pretty, buf, n);
+  }
+  mbuf_append(&pretty, "\n]", 2);
+  /* Compact and mostly numbers, where strings are short. */
+  mbuf_append(&compact, "[", 1);
+  for (int i = 0; compact.len < 512 * 1024; i++) {
+    char buf[100];
+    int n = snprintf(buf, sizeof(buf), "%s{\"t\":%d,\"v\":[%d,%d,%d]}",
+                     (i > 0 ? "," : ""), 1500000000 + i, i % 97, i % 1000,
+                     -i);
+    mbuf_append(&compact, buf, n);
+  }
+  mbuf_append(&compact, "]", 1);
+
+  double mbps = json_walk_mbps(&pretty, &num_tokens);
+  ASSERT(mbps > 0);
+  ASSERT(num_tokens > 10000);
+  printf("    %s: pretty %d KB %.1f MB/s",
+         (JSON_ENABLE_SIMD ? "SIMD" : "scalar"), (int) (pretty.len / 1024),
+         mbps);
+  mbps = json_walk_mbps(&compact, &num_tokens);
+  ASSERT(mbps > 0);
+  printf(", compact %d KB %.1f MB/s\n", (int) (compact.len / 1024), mbps);
+
+  mbuf_free(&pretty);
+  mbuf_free(&compact);
+  return NULL;
+}
+
+/* Prints `n` telemetry records, consumes int n. */
+static int json_printf_records(struct json_out *out, va_list *ap) {
+  int len = 0, n = va_arg(*ap, int);
+  static const int vals[] = {1, 2, 3};
+  for (int i = 0; i < n; i++) {
+    len += json_printf(out, "%s{id: %d, name: %Q, ok: %B, v: %M, h: %H}",
+                       (i > 0 ? ", " : ""), i, "sensor \"a\"\n", i % 2,
+                       json_printf_array, vals, sizeof(vals), sizeof(vals[0]),
+                       "%d", 2, "\x01\xff");
+  }
+  return len;
+}
+
+/* Printers into empty buffers, as a status handler would start. */
+static const char *bench_json_printf(void) {
+  const char *fmt = "{records: [%M], n: %d}";
+  const int num_records = 500, iters = 20;
+  struct json_out_batch b;
+  struct json_out out;
+  struct mbuf ref, mb;
+  double t_mbuf = 0, t_batch = 0, t_two = 0, t_as = 0;
+  size_t mbuf_size = 0, two_size = 0;
+  int n = json_printf_len(fmt, json_printf_records, num_records, 123);
+  mbuf_init(&ref, 0);
+  mbuf_init(&mb, 0);
+  for (int i = 0; i < iters; i++) {
+    mbuf_free(&ref);
+    double start = cs_time();
+    out = (struct json_out) JSON_OUT_MBUF(&ref);
+    json_printf(&out, fmt, json_printf_records, num_records, 123);
+    t_mbuf += cs_time() - start;
+    mbuf_size = ref.size;
+    mbuf_free(&ref);
+    start = cs_time();
+    json_out_batch_init(&b, &out);
+    json_printf(&b.out, fmt, json_printf_records, num_records, 123);
+    json_out_batch_flush(&b);
+    t_batch += cs_time() - start;
+    mbuf_free(&mb);
+    start = cs_time();
+    mg_json_printf_mbuf(&mb, fmt, json_printf_records, num_records, 123);
+    t_two += cs_time() - start;
+    two_size = mb.size;
+    start = cs_time();
+    free(json_asprintf(fmt, json_printf_records, num_records, 123));
+    t_as += cs_time() - start;
+  }
+  printf("    %d bytes: mbuf printer %.1f us (size %d), batched %.1f us, "
+         "two-pass %.1f us (size %d), json_asprintf %.1f us\n",
+         n, t_mbuf * 1e6 / iters, (int) mbuf_size, t_batch * 1e6 / iters,
+         t_two * 1e6 / iters, (int) two_size, t_as * 1e6 / iters);
+
+  mbuf_free(&ref);
+  mbuf_free(&mb);
+  return NULL;
+}
+
+#define BENCH_GRP MGOS_EVENT_BASE('B', 'N', 0)
+
+static void ev_nop_cb(int ev, void *ev_data, void *userdata) {
+  (*((int *) userdata))++;
+  (void) ev;
+  (void) ev_data;
+}
+
+/* Measures trigger rate as the number of unrelated handlers grows. */
+static const char *bench_events(void) {
+  static const int counts[] = {10, 100, 1000};
+  const int num_triggers = 100000;
+  int num_calls = 0;
+  ASSERT(mgos_event_add_handler(BENCH_GRP + 1, ev_nop_cb, &num_calls));
+  ASSERT(mgos_event_add_group_handler(BENCH_GRP, ev_nop_cb, &num_calls));
+  for (size_t k = 0; k < ARRAY_SIZE(counts); k++) {
+    const int n = counts[k];
+    /* Spread other handlers over 10 groups, one of them the triggered one. */
+    for (int i = 0; i < n; i++) {
+      int ev = MGOS_EVENT_BASE('B', 'N', i % 10) + 2 + i / 10;
+      ASSERT(mgos_event_add_handler(ev, ev_nop_cb, &num_calls));
+    }
+    num_calls = 0;
+    double start = cs_time();
+    for (int i = 0; i < num_triggers; i++) {
+      mgos_event_trigger(BENCH_GRP + 1, NULL);
+    }
+    double elapsed = cs_time() - start;
+    ASSERT_EQ(num_calls, 2 * num_triggers);
+    printf("    %5d handlers: %.0f triggers/s\n", n + 2,
+           num_triggers / elapsed);
+    for (int i = 0; i < n; i++) {
+      int ev = MGOS_EVENT_BASE('B', 'N', i % 10) + 2 + i / 10;
+      ASSERT(mgos_event_remove_handler(ev, ev_nop_cb, &num_calls));
+    }
+  }
+  ASSERT(mgos_event_remove_handler(BENCH_GRP + 1, ev_nop_cb, &num_calls));
+  ASSERT(mgos_event_remove_group_handler(BENCH_GRP, ev_nop_cb, &num_calls));
+  return NULL;
+}
+
+static int s_num_bench_timer_calls = 0;
+
+static void nop_timer_cb(void *arg) {
+  s_num_bench_timer_calls++;
+  (void) arg;
+}
+
+/* Measures set/clear/fire throughput for different numbers of timers. */
+static const char *bench_timers(void) {
+  static const int counts[] = {10, 100, 1000, 10000};
+  for (size_t k = 0; k < ARRAY_SIZE(counts); k++) {
+    const int n = counts[k];
+    mgos_timer_id *ids = (mgos_timer_id *) calloc(n, sizeof(*ids));
+    ASSERT_PTRNE(ids, NULL);
+    test_hal_set_uptime(1000);
+
+    double start = cs_time();
+    for (int i = 0; i < n; i++) {
+      ids[i] = mgos_set_timer(1 + rand() % 10000, 0, nop_timer_cb, NULL);
+      ASSERT_NE(ids[i], MGOS_INVALID_TIMER_ID);
+    }
+    const double set_time = cs_time() - start;
+
+    start = cs_time();
+    for (int i = 0; i < n; i++) mgos_clear_timer(ids[i]);
+    const double clear_time = cs_time() - start;
+
+    for (int i = 0; i < n; i++) {
+      mgos_set_timer(1 + rand() % 10000, 0, nop_timer_cb, NULL);
+    }
+    s_num_bench_timer_calls = 0;
+    test_hal_set_uptime(2000);
+    start = cs_time();
+    while (s_num_bench_timer_calls < n) test_hal_poll();
+    const double fire_time = cs_time() - start;
+
+    printf("    %5d timers: set %.2f us, clear %.2f us, fire %.2f us\n", n,
+           set_time * 1e6 / n, clear_time * 1e6 / n, fire_time * 1e6 / n);
+    free(ids);
+  }
+  return NULL;
+}
+
+#define Q_BENCH_NUM_PRODUCERS 4
+#define Q_BENCH_NUM_ITEMS 50000
+
+struct q_bench {
+  bool (*push)(struct q_bench *b, void (*cb)(void *), void *arg);
+  void (*drain)(struct q_bench *b);
+  struct ubuntu_cb_queue *q;
+  rpa_queue_t *rq;
+  int num_done;
+  double lat_total, lat_max;
+};
+
+struct q_bench_cb_info {
+  void (*cb)(void *arg);
+  void *cb_arg;
+};
+
+static struct q_bench *s_q_bench;
+
+static uint64_t q_bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void q_bench_cb(void *arg) {
+  double lat = (q_bench_now_ns() - (uint64_t) (uintptr_t) arg) / 1000.0;
+  s_q_bench->lat_total += lat;
+  if (lat > s_q_bench->lat_max) s_q_bench->lat_max = lat;
+  s_q_bench->num_done++;
+}
+
+static bool q_bench_push_ring(struct q_bench *b, void (*cb)(void *),
+                              void *arg) {
+  return ubuntu_cb_queue_push(b->q, cb, arg);
+}
+
+static void q_bench_drain_ring(struct q_bench *b) {
+  ubuntu_cb_queue_run(b->q);
+}
+
+/* This is what ubuntu_main.c used to do. */
+static bool q_bench_push_rpa(struct q_bench *b, void (*cb)(void *),
+                             void *arg) {
+  struct q_bench_cb_info *cbi =
+      (struct q_bench_cb_info *) calloc(1, sizeof(*cbi));
+  if (cbi == NULL) return false;
+  cbi->cb = cb;
+  cbi->cb_arg = arg;
+  if (!rpa_queue_trypush(b->rq, cbi)) {
+    free(cbi);
+    return false;
+  }
+  return true;
+}
+
+static void q_bench_drain_rpa(struct q_bench *b) {
+  struct q_bench_cb_info *cbi = NULL;
+  while (rpa_queue_trypop(b->rq, (void **) &cbi)) {
+    cbi->cb(cbi->cb_arg);
+    free(cbi);
+  }
+}
+
+static void *q_bench_producer(void *arg) {
+  struct q_bench *b = (struct q_bench *) arg;
+  for (int i = 0; i < Q_BENCH_NUM_ITEMS; i++) {
+    while (!b->push(b, q_bench_cb, (void *) (uintptr_t) q_bench_now_ns())) {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static const char *q_bench_run(const char *name, struct q_bench *b) {
+  pthread_t producers[Q_BENCH_NUM_PRODUCERS];
+  const int total = Q_BENCH_NUM_PRODUCERS * Q_BENCH_NUM_ITEMS;
+  s_q_bench = b;
+  double start = cs_time();
+  for (int i = 0; i < Q_BENCH_NUM_PRODUCERS; i++) {
+    ASSERT_EQ(pthread_create(&producers[i], NULL, q_bench_producer, b), 0);
+  }
+  while (b->num_done < total) {
+    int num_done = b->num_done;
+    b->drain(b);
+    /* Let producers run if we're sharing a CPU with them. */
+    if (b->num_done == num_done) sched_yield();
+  }
+  double elapsed = cs_time() - start;
+  for (int i = 0; i < Q_BENCH_NUM_PRODUCERS; i++) {
+    pthread_join(producers[i], NULL);
+  }
+  printf("    %s: %.2fM cb/s, latency avg %.1f us max %.0f us\n", name,
+         total / elapsed / 1e6, b->lat_total / total, b->lat_max);
+  return NULL;
+}
+
+/* Cross-thread invoke throughput and latency, inline ring vs rpa_queue. */
+static const char *bench_ubuntu_cb_queue(void) {
+  const char *msg;
+  struct q_bench ring = {.push = q_bench_push_ring,
+                         .drain = q_bench_drain_ring};
+  struct q_bench rpa = {.push = q_bench_push_rpa, .drain = q_bench_drain_rpa};
+  ring.q = ubuntu_cb_queue_create(32);
+  ASSERT_PTRNE(ring.q, NULL);
+  ASSERT(rpa_queue_create(&rpa.rq, 32));
+  if ((msg = q_bench_run("rpa_queue", &rpa)) != NULL) return msg;
+  if ((msg = q_bench_run("cb_queue ", &ring)) != NULL) return msg;
+  rpa_queue_destroy(rpa.rq);
+  ubuntu_cb_queue_destroy(ring.q);
+  return NULL;
+}
+
+void tests_setup(void) {
+  mgos_event_queue_init();
+  mgos_timers_init();
+}
+
+const char *tests_run(const char *filter) {
+  RUN_TEST(bench_config_load);
+  RUN_TEST(bench_config_snapshot);
+  RUN_TEST(bench_config_typed);
+  RUN_TEST(bench_config_save);
+  RUN_TEST(bench_json_scanf);
+  RUN_TEST(bench_json_tape);
+  RUN_TEST(bench_json_walk);
+  RUN_TEST(bench_json_printf);
+  RUN_TEST(bench_events);
+  RUN_TEST(bench_timers);
+  RUN_TEST(bench_ubuntu_cb_queue);
+  return NULL;
+}
+
+void tests_teardown(void) {
+}
@@ -1,7 +1,7 @@
 /* clang-format off */
 /*
  * Generated file - do not edit.
- * Command: ../../tools/mgos_gen_config.py --c_name=mgos_config --c_global_name=mgos_sys_config --dest_dir=./build data/sys_conf_wifi.yaml data/sys_conf_http.yaml data/sys_conf_debug.yaml data/sys_conf_overrides.yaml
+ * Command: ../../tools/mgos_gen_config.py --c_name=mgos_config --c_global_name=mgos_sys_config --c_global_changed_cb=mgos_sys_config_changed --dest_dir=./build data/sys_conf_wifi.yaml data/sys_conf_http.yaml data/sys_conf_debug.yaml data/sys_conf_overrides.yaml
  */
 
 #include "mgos_config.h"
@@ -12,25 +12,54 @@
 
 #include "mgos_config_util.h"
 
+/* Strings */
+static const char mgos_config_str_table[] =
+  /* 0 */ "*\0"
+  /* 2 */ "192.168.4.200\0"
+  /* 16 */ "Quote \" me \\\\ please\0"
+  /* 37 */ "mg_foo.c=4\0"
+  /* 48 */ "p2\0"
+  /* 51 */ "p6\0"
+  /* 54 */ "so\012many\012lines\012\0"
+  /* 69 */ "uart1\0"
+  /* 75 */ "\320\274\320\260\320\273\320\276\320\262\320\260\321\202\320\276 \320\261\321\203\320\264\320\265\321\202\0"
+  "";
+
 
 /* struct mgos_config */
+static const uint16_t mgos_config_schema_idx_[] = {
+    6, 44, 15, 11, 12, 27, 1,
+    2, 4, 1,
+    2, 2, 1,
+    5, 4, 5, 1, 3, 2,
+    2, 1, 2,
+    11, 2, 11, 3, 1, 4, 5, 6, 7, 8, 9, 10,
+    0,
+    2, 1, 9,
+    4, 6, 1, 3, 2,
+    2, 1, 2,
+    1, 1,
+    4, 6, 1, 3, 2,
+    2, 1, 2,
+    1, 1,
+};
 static const struct mgos_conf_entry mgos_config_schema_[] = {
-    {.type = CONF_TYPE_OBJECT, .key = "", .offset = 0, .num_desc = 43},
-    {.type = CONF_TYPE_OBJECT, .key = "wifi", .offset = offsetof(struct mgos_config, wifi), .num_desc = 9},
-    {.type = CONF_TYPE_OBJECT, .key = "sta", .offset = offsetof(struct mgos_config, wifi.sta), .num_desc = 2},
+    {.type = CONF_TYPE_OBJECT, .key = "", .offset = 0, .num_desc = 44, .sorted_children = &mgos_config_schema_idx_[0]},
+    {.type = CONF_TYPE_OBJECT, .key = "wifi", .offset = offsetof(struct mgos_config, wifi), .num_desc = 9, .sorted_children = &mgos_config_schema_idx_[7]},
+    {.type = CONF_TYPE_OBJECT, .key = "sta", .offset = offsetof(struct mgos_config, wifi.sta), .num_desc = 2, .sorted_children = &mgos_config_schema_idx_[10]},
     {.type = CONF_TYPE_STRING, .key = "ssid", .offset = offsetof(struct mgos_config, wifi.sta.ssid)},
     {.type = CONF_TYPE_STRING, .key = "pass", .offset = offsetof(struct mgos_config, wifi.sta.pass)},
-    {.type = CONF_TYPE_OBJECT, .key = "ap", .offset = offsetof(struct mgos_config, wifi.ap), .num_desc = 5},
+    {.type = CONF_TYPE_OBJECT, .key = "ap", .offset = offsetof(struct mgos_config, wifi.ap), .num_desc = 5, .sorted_children = &mgos_config_schema_idx_[13]},
     {.type = CONF_TYPE_BOOL, .key = "enable", .offset = offsetof(struct mgos_config, wifi.ap.enable)},
     {.type = CONF_TYPE_STRING, .key = "ssid", .offset = offsetof(struct mgos_config, wifi.ap.ssid)},
     {.type = CONF_TYPE_STRING, .key = "pass", .offset = offsetof(struct mgos_config, wifi.ap.pass)},
     {.type = CONF_TYPE_INT, .key = "channel", .offset = offsetof(struct mgos_config, wifi.ap.channel)},
     {.type = CONF_TYPE_STRING, .key = "dhcp_end", .offset = offsetof(struct mgos_config, wifi.ap.dhcp_end)},
     {.type = CONF_TYPE_INT, .key = "foo", .offset = offsetof(struct mgos_config, foo)},
-    {.type = CONF_TYPE_OBJECT, .key = "http", .offset = offsetof(struct mgos_config, http), .num_desc = 2},
+    {.type = CONF_TYPE_OBJECT, .key = "http", .offset = offsetof(struct mgos_config, http), .num_desc = 2, .sorted_children = &mgos_config_schema_idx_[19]},
     {.type = CONF_TYPE_BOOL, .key = "enable", .offset = offsetof(struct mgos_config, http.enable)},
     {.type = CONF_TYPE_INT, .key = "port", .offset = offsetof(struct mgos_config, http.port)},
-    {.type = CONF_TYPE_OBJECT, .key = "debug", .offset = offsetof(struct mgos_config, debug), .num_desc = 11},
+    {.type = CONF_TYPE_OBJECT, .key = "debug", .offset = offsetof(struct mgos_config, debug), .num_desc = 11, .sorted_children = &mgos_config_schema_idx_[22]},
     {.type = CONF_TYPE_INT, .key = "level", .offset = offsetof(struct mgos_config, debug.level)},
     {.type = CONF_TYPE_STRING, .key = "dest", .offset = offsetof(struct mgos_config, debug.dest)},
     {.type = CONF_TYPE_STRING, .key = "file_level", .offset = offsetof(struct mgos_config, debug.file_level)},
@@ -41,32 +70,37 @@ static const struct mgos_conf_entry mgos_config_schema_[] = {
     {.type = CONF_TYPE_FLOAT, .key = "test_f2", .offset = offsetof(struct mgos_config, debug.test_f2)},
     {.type = CONF_TYPE_FLOAT, .key = "test_f3", .offset = offsetof(struct mgos_config, debug.test_f3)},
     {.type = CONF_TYPE_UNSIGNED_INT, .key = "test_ui", .offset = offsetof(struct mgos_config, debug.test_ui)},
-    {.type = CONF_TYPE_OBJECT, .key = "empty", .offset = offsetof(struct mgos_config, debug.empty), .num_desc = 0},
-    {.type = CONF_TYPE_OBJECT, .key = "test", .offset = offsetof(struct mgos_config, test), .num_desc = 16},
-    {.type = CONF_TYPE_OBJECT, .key = "bar1", .offset = offsetof(struct mgos_config, test.bar1), .num_desc = 7},
+    {.type = CONF_TYPE_OBJECT, .key = "empty", .offset = offsetof(struct mgos_config, debug.empty), .num_desc = 0, .sorted_children = &mgos_config_schema_idx_[34]},
+    {.type = CONF_TYPE_OBJECT, .key = "test", .offset = offsetof(struct mgos_config, test), .num_desc = 16, .sorted_children = &mgos_config_schema_idx_[35]},
+    {.type = CONF_TYPE_OBJECT, .key = "bar1", .offset = offsetof(struct mgos_config, test.bar1), .num_desc = 7, .sorted_children = &mgos_config_schema_idx_[38]},
     {.type = CONF_TYPE_BOOL, .key = "enable", .offset = offsetof(struct mgos_config, test.bar1.enable)},
     {.type = CONF_TYPE_INT, .key = "param1", .offset = offsetof(struct mgos_config, test.bar1.param1)},
-    {.type = CONF_TYPE_OBJECT, .key = "inner", .offset = offsetof(struct mgos_config, test.bar1.inner), .num_desc = 2},
+    {.type = CONF_TYPE_OBJECT, .key = "inner", .offset = offsetof(struct mgos_config, test.bar1.inner), .num_desc = 2, .sorted_children = &mgos_config_schema_idx_[43]},
     {.type = CONF_TYPE_STRING, .key = "param2", .offset = offsetof(struct mgos_config, test.bar1.inner.param2)},
     {.type = CONF_TYPE_INT, .key = "param3", .offset = offsetof(struct mgos_config, test.bar1.inner.param3)},
-    {.type = CONF_TYPE_OBJECT, .key = "baz", .offset = offsetof(struct mgos_config, test.bar1.baz), .num_desc = 1},
+    {.type = CONF_TYPE_OBJECT, .key = "baz", .offset = offsetof(struct mgos_config, test.bar1.baz), .num_desc = 1, .sorted_children = &mgos_config_schema_idx_[46]},
     {.type = CONF_TYPE_BOOL, .key = "bazaar", .offset = offsetof(struct mgos_config, test.bar1.baz.bazaar)},
-    {.type = CONF_TYPE_OBJECT, .key = "bar2", .offset = offsetof(struct mgos_config, test.bar2), .num_desc = 7},
+    {.type = CONF_TYPE_OBJECT, .key = "bar2", .offset = offsetof(struct mgos_config, test.bar2), .num_desc = 7, .sorted_children = &mgos_config_schema_idx_[48]},
     {.type = CONF_TYPE_BOOL, .key = "enable", .offset = offsetof(struct mgos_config, test.bar2.enable)},
     {.type = CONF_TYPE_INT, .key = "param1", .offset = offsetof(struct mgos_config, test.bar2.param1)},
-    {.type = CONF_TYPE_OBJECT, .key = "inner", .offset = offsetof(struct mgos_config, test.bar2.inner), .num_desc = 2},
+    {.type = CONF_TYPE_OBJECT, .key = "inner", .offset = offsetof(struct mgos_config, test.bar2.inner), .num_desc = 2, .sorted_children = &mgos_config_schema_idx_[53]},
     {.type = CONF_TYPE_STRING, .key = "param2", .offset = offsetof(struct mgos_config, test.bar2.inner.param2)},
     {.type = CONF_TYPE_INT, .key = "param3", .offset = offsetof(struct mgos_config, test.bar2.inner.param3)},
-    {.type = CONF_TYPE_OBJECT, .key = "baz", .offset = offsetof(struct mgos_config, test.bar2.baz), .num_desc = 1},
+    {.type = CONF_TYPE_OBJECT, .key = "baz", .offset = offsetof(struct mgos_config, test.bar2.baz), .num_desc = 1, .sorted_children = &mgos_config_schema_idx_[56]},
     {.type = CONF_TYPE_BOOL, .key = "bazaar", .offset = offsetof(struct mgos_config, test.bar2.baz.bazaar)},
+    {.type = CONF_TYPE_STRING, .key = "conf_acl", .offset = offsetof(struct mgos_config, conf_acl)},
 };
 
 /* struct mgos_config_boo */
+static const uint16_t mgos_config_boo_schema_idx_[] = {
+    3, 1, 2, 3,
+    1, 1,
+};
 static const struct mgos_conf_entry mgos_config_boo_schema_[] = {
-    {.type = CONF_TYPE_OBJECT, .key = "", .offset = 0, .num_desc = 4},
+    {.type = CONF_TYPE_OBJECT, .key = "", .offset = 0, .num_desc = 4, .sorted_children = &mgos_config_boo_schema_idx_[0]},
     {.type = CONF_TYPE_INT, .key = "param5", .offset = offsetof(struct mgos_config_boo, param5)},
     {.type = CONF_TYPE_STRING, .key = "param6", .offset = offsetof(struct mgos_config_boo, param6)},
-    {.type = CONF_TYPE_OBJECT, .key = "sub", .offset = offsetof(struct mgos_config_boo, sub), .num_desc = 1},
+    {.type = CONF_TYPE_OBJECT, .key = "sub", .offset = offsetof(struct mgos_config_boo, sub), .num_desc = 1, .sorted_children = &mgos_config_boo_schema_idx_[4]},
     {.type = CONF_TYPE_INT, .key = "param7", .offset = offsetof(struct mgos_config_boo, sub.param7)},
 };
 
@@ -77,7 +111,7 @@ const struct mgos_conf_entry *mgos_config_wifi_sta_get_schema(void) {
 
 void mgos_config_wifi_sta_set_defaults(struct mgos_config_wifi_sta *cfg) {
   cfg->ssid = NULL;
-  cfg->pass = "so\nmany\nlines\n";
+  cfg->pass = (mgos_config_str_table + 54);
 }
 bool mgos_config_wifi_sta_parse_f(const char *fname, struct mgos_config_wifi_sta *cfg) {
   size_t len;
@@ -95,10 +129,10 @@ const struct mgos_conf_entry *mgos_config_wifi_ap_get_schema(void) {
 
 void mgos_config_wifi_ap_set_defaults(struct mgos_config_wifi_ap *cfg) {
   cfg->enable = false;
-  cfg->ssid = "Quote \" me \\\\ please";
-  cfg->pass = "\u043c\u0430\u043b\u043e\u0432\u0430\u0442\u043e \u0431\u0443\u0434\u0435\u0442";
+  cfg->ssid = (mgos_config_str_table + 16);
+  cfg->pass = (mgos_config_str_table + 75);
   cfg->channel = 6;
-  cfg->dhcp_end = "192.168.4.200";
+  cfg->dhcp_end = (mgos_config_str_table + 2);
 }
 bool mgos_config_wifi_ap_parse_f(const char *fname, struct mgos_config_wifi_ap *cfg) {
   size_t len;
@@ -169,8 +203,8 @@ const struct mgos_conf_entry *mgos_config_debug_get_schema(void) {
 
 void mgos_config_debug_set_defaults(struct mgos_config_debug *cfg) {
   cfg->level = 2;
-  cfg->dest = "uart1";
-  cfg->file_level = "mg_foo.c=4";
+  cfg->dest = (mgos_config_str_table + 69);
+  cfg->file_level = (mgos_config_str_table + 37);
   cfg->test_d1 = 2.0;
   cfg->test_d2 = 0.0;
   cfg->test_d3 = 0.0001;
@@ -212,7 +246,7 @@ const struct mgos_conf_entry *mgos_config_bar_inner_get_schema(void) {
 }
 
 void mgos_config_bar_inner_set_defaults(struct mgos_config_bar_inner *cfg) {
-  cfg->param2 = "p2";
+  cfg->param2 = (mgos_config_str_table + 48);
   cfg->param3 = 3333;
 }
 bool mgos_config_bar_inner_parse_f(const char *fname, struct mgos_config_bar_inner *cfg) {
@@ -267,7 +301,7 @@ const struct mgos_conf_entry *mgos_config_test_bar1_inner_get_schema(void) {
 }
 
 void mgos_config_test_bar1_inner_set_defaults(struct mgos_config_bar_inner *cfg) {
-  cfg->param2 = "p2";
+  cfg->param2 = (mgos_config_str_table + 48);
   cfg->param3 = 3333;
 }
 bool mgos_config_test_bar1_inner_parse_f(const char *fname, struct mgos_config_bar_inner *cfg) {
@@ -322,7 +356,7 @@ const struct mgos_conf_entry *mgos_config_test_bar2_inner_get_schema(void) {
 }
 
 void mgos_config_test_bar2_inner_set_defaults(struct mgos_config_bar_inner *cfg) {
-  cfg->param2 = "p2";
+  cfg->param2 = (mgos_config_str_table + 48);
   cfg->param3 = 3333;
 }
 bool mgos_config_test_bar2_inner_parse_f(const char *fname, struct mgos_config_bar_inner *cfg) {
@@ -413,7 +447,7 @@ const struct mgos_conf_entry *mgos_config_boo_get_schema(void) {
 
 void mgos_config_boo_set_defaults(struct mgos_config_boo *cfg) {
   cfg->param5 = 333;
-  cfg->param6 = "p6";
+  cfg->param6 = (mgos_config_str_table + 51);
   mgos_config_boo_sub_set_defaults(&cfg->sub);
 }
 bool mgos_config_boo_parse_f(const char *fname, struct mgos_config_boo *cfg) {
@@ -436,6 +470,7 @@ void mgos_config_set_defaults(struct mgos_config *cfg) {
   mgos_config_http_set_defaults(&cfg->http);
   mgos_config_debug_set_defaults(&cfg->debug);
   mgos_config_test_set_defaults(&cfg->test);
+  cfg->conf_acl = (mgos_config_str_table + 0);
 }
 bool mgos_config_parse_f(const char *fname, struct mgos_config *cfg) {
   size_t len;
@@ -464,7 +499,7 @@ void mgos_config_set_wifi_sta_ssid(struct mgos_config *cfg, const char * v) { mg
 
 /* wifi.sta.pass */
 const char * mgos_config_get_wifi_sta_pass(const struct mgos_config *cfg) { return cfg->wifi.sta.pass; }
-const char * mgos_config_get_default_wifi_sta_pass(void) { return "so\nmany\nlines\n"; }
+const char * mgos_config_get_default_wifi_sta_pass(void) { return (mgos_config_str_table + 54); }
 void mgos_config_set_wifi_sta_pass(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->wifi.sta.pass, v); }
 
 /* wifi.ap */
@@ -477,12 +512,12 @@ void mgos_config_set_wifi_ap_enable(struct mgos_config *cfg, int v) { cfg->wifi.
 
 /* wifi.ap.ssid */
 const char * mgos_config_get_wifi_ap_ssid(const struct mgos_config *cfg) { return cfg->wifi.ap.ssid; }
-const char * mgos_config_get_default_wifi_ap_ssid(void) { return "Quote \" me \\\\ please"; }
+const char * mgos_config_get_default_wifi_ap_ssid(void) { return (mgos_config_str_table + 16); }
 void mgos_config_set_wifi_ap_ssid(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->wifi.ap.ssid, v); }
 
 /* wifi.ap.pass */
 const char * mgos_config_get_wifi_ap_pass(const struct mgos_config *cfg) { return cfg->wifi.ap.pass; }
-const char * mgos_config_get_default_wifi_ap_pass(void) { return "\u043c\u0430\u043b\u043e\u0432\u0430\u0442\u043e \u0431\u0443\u0434\u0435\u0442"; }
+const char * mgos_config_get_default_wifi_ap_pass(void) { return (mgos_config_str_table + 75); }
 void mgos_config_set_wifi_ap_pass(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->wifi.ap.pass, v); }
 
 /* wifi.ap.channel */
@@ -492,7 +527,7 @@ void mgos_config_set_wifi_ap_channel(struct mgos_config *cfg, int v) { cfg->wifi
 
 /* wifi.ap.dhcp_end */
 const char * mgos_config_get_wifi_ap_dhcp_end(const struct mgos_config *cfg) { return cfg->wifi.ap.dhcp_end; }
-const char * mgos_config_get_default_wifi_ap_dhcp_end(void) { return "192.168.4.200"; }
+const char * mgos_config_get_default_wifi_ap_dhcp_end(void) { return (mgos_config_str_table + 2); }
 void mgos_config_set_wifi_ap_dhcp_end(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->wifi.ap.dhcp_end, v); }
 
 /* foo */
@@ -523,12 +558,12 @@ void mgos_config_set_debug_level(struct mgos_config *cfg, int v) { cfg->debug.le
 
 /* debug.dest */
 const char * mgos_config_get_debug_dest(const struct mgos_config *cfg) { return cfg->debug.dest; }
-const char * mgos_config_get_default_debug_dest(void) { return "uart1"; }
+const char * mgos_config_get_default_debug_dest(void) { return (mgos_config_str_table + 69); }
 void mgos_config_set_debug_dest(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->debug.dest, v); }
 
 /* debug.file_level */
 const char * mgos_config_get_debug_file_level(const struct mgos_config *cfg) { return cfg->debug.file_level; }
-const char * mgos_config_get_default_debug_file_level(void) { return "mg_foo.c=4"; }
+const char * mgos_config_get_default_debug_file_level(void) { return (mgos_config_str_table + 37); }
 void mgos_config_set_debug_file_level(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->debug.file_level, v); }
 
 /* debug.test_d1 */
@@ -590,7 +625,7 @@ const struct mgos_config_bar_inner *mgos_config_get_test_bar1_inner(const struct
 
 /* test.bar1.inner.param2 */
 const char * mgos_config_get_test_bar1_inner_param2(const struct mgos_config *cfg) { return cfg->test.bar1.inner.param2; }
-const char * mgos_config_get_default_test_bar1_inner_param2(void) { return "p2"; }
+const char * mgos_config_get_default_test_bar1_inner_param2(void) { return (mgos_config_str_table + 48); }
 void mgos_config_set_test_bar1_inner_param2(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->test.bar1.inner.param2, v); }
 
 /* test.bar1.inner.param3 */
@@ -624,7 +659,7 @@ const struct mgos_config_bar_inner *mgos_config_get_test_bar2_inner(const struct
 
 /* test.bar2.inner.param2 */
 const char * mgos_config_get_test_bar2_inner_param2(const struct mgos_config *cfg) { return cfg->test.bar2.inner.param2; }
-const char * mgos_config_get_default_test_bar2_inner_param2(void) { return "p2"; }
+const char * mgos_config_get_default_test_bar2_inner_param2(void) { return (mgos_config_str_table + 48); }
 void mgos_config_set_test_bar2_inner_param2(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->test.bar2.inner.param2, v); }
 
 /* test.bar2.inner.param3 */
@@ -639,33 +674,24 @@ const struct mgos_config_baz *mgos_config_get_test_bar2_baz(const struct mgos_co
 int mgos_config_get_test_bar2_baz_bazaar(const struct mgos_config *cfg) { return cfg->test.bar2.baz.bazaar; }
 int mgos_config_get_default_test_bar2_baz_bazaar(void) { return true; }
 void mgos_config_set_test_bar2_baz_bazaar(struct mgos_config *cfg, int v) { cfg->test.bar2.baz.bazaar = v; }
+
+/* conf_acl */
+const char * mgos_config_get_conf_acl(const struct mgos_config *cfg) { return cfg->conf_acl; }
+const char * mgos_config_get_default_conf_acl(void) { return (mgos_config_str_table + 0); }
+void mgos_config_set_conf_acl(struct mgos_config *cfg, const char * v) { mgos_conf_set_str(&cfg->conf_acl, v); }
 bool mgos_sys_config_get(const struct mg_str key, struct mg_str *value) {
   return mgos_config_get(key, value, &mgos_sys_config, mgos_config_schema());
 }
 bool mgos_sys_config_set(const struct mg_str key, const struct mg_str value, bool free_strings) {
-  return mgos_config_set(key, value, &mgos_sys_config, mgos_config_schema(), free_strings);
+  bool res = mgos_config_set(key, value, &mgos_sys_config, mgos_config_schema(), free_strings);
+  if (res) mgos_sys_config_changed();
+  return res;
 }
 
 const struct mgos_conf_entry *mgos_config_schema(void) {
   return mgos_config_get_schema();
 }
 
-/* Strings */
-static const char *mgos_config_str_table[] = {
-  "192.168.4.200",
-  "Quote \" me \\\\ please",
-  "mg_foo.c=4",
-  "p2",
-  "p6",
-  "so\nmany\nlines\n",
-  "uart1",
-  "\u043c\u0430\u043b\u043e\u0432\u0430\u0442\u043e \u0431\u0443\u0434\u0435\u0442",
-};
-
 bool mgos_config_is_default_str(const char *s) {
-  int num_str = (sizeof(mgos_config_str_table) / sizeof(mgos_config_str_table[0]));
-  for (int i = 0; i < num_str; i++) {
-    if (mgos_config_str_table[i] == s) return true;
-  }
-  return false;
+  return (s >= mgos_config_str_table && s < mgos_config_str_table + sizeof(mgos_config_str_table));
 }
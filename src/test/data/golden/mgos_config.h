@@ -1,7 +1,7 @@
 /* clang-format off */
 /*
  * Generated file - do not edit.
- * Command: ../../tools/mgos_gen_config.py --c_name=mgos_config --c_global_name=mgos_sys_config --dest_dir=./build data/sys_conf_wifi.yaml data/sys_conf_http.yaml data/sys_conf_debug.yaml data/sys_conf_overrides.yaml
+ * Command: ../../tools/mgos_gen_config.py --c_name=mgos_config --c_global_name=mgos_sys_config --c_global_changed_cb=mgos_sys_config_changed --dest_dir=./build data/sys_conf_wifi.yaml data/sys_conf_http.yaml data/sys_conf_debug.yaml data/sys_conf_overrides.yaml
  */
 
 #pragma once
@@ -482,6 +482,7 @@ struct mgos_config {
   struct mgos_config_http http;
   struct mgos_config_debug debug;
   struct mgos_config_test test;
+  const char * conf_acl;
 };
 const struct mgos_conf_entry *mgos_config_get_schema(void);
 void mgos_config_set_defaults(struct mgos_config *cfg);
@@ -504,6 +505,7 @@ static inline void mgos_config_free(struct mgos_config *cfg) {
 }
 
 extern struct mgos_config mgos_sys_config;
+void mgos_sys_config_changed(void);
 
 /* wifi */
 #define MGOS_CONFIG_HAVE_WIFI
@@ -525,7 +527,7 @@ const char * mgos_config_get_default_wifi_sta_ssid(void);
 static inline const char * mgos_sys_config_get_wifi_sta_ssid(void) { return mgos_config_get_wifi_sta_ssid(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_wifi_sta_ssid(void) { return mgos_config_get_default_wifi_sta_ssid(); }
 void mgos_config_set_wifi_sta_ssid(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_wifi_sta_ssid(const char * v) { mgos_config_set_wifi_sta_ssid(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_wifi_sta_ssid(const char * v) { mgos_config_set_wifi_sta_ssid(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* wifi.sta.pass */
 #define MGOS_CONFIG_HAVE_WIFI_STA_PASS
@@ -535,7 +537,7 @@ const char * mgos_config_get_default_wifi_sta_pass(void);
 static inline const char * mgos_sys_config_get_wifi_sta_pass(void) { return mgos_config_get_wifi_sta_pass(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_wifi_sta_pass(void) { return mgos_config_get_default_wifi_sta_pass(); }
 void mgos_config_set_wifi_sta_pass(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_wifi_sta_pass(const char * v) { mgos_config_set_wifi_sta_pass(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_wifi_sta_pass(const char * v) { mgos_config_set_wifi_sta_pass(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* wifi.ap */
 #define MGOS_CONFIG_HAVE_WIFI_AP
@@ -551,7 +553,7 @@ int mgos_config_get_default_wifi_ap_enable(void);
 static inline int mgos_sys_config_get_wifi_ap_enable(void) { return mgos_config_get_wifi_ap_enable(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_wifi_ap_enable(void) { return mgos_config_get_default_wifi_ap_enable(); }
 void mgos_config_set_wifi_ap_enable(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_wifi_ap_enable(int v) { mgos_config_set_wifi_ap_enable(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_wifi_ap_enable(int v) { mgos_config_set_wifi_ap_enable(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* wifi.ap.ssid */
 #define MGOS_CONFIG_HAVE_WIFI_AP_SSID
@@ -561,7 +563,7 @@ const char * mgos_config_get_default_wifi_ap_ssid(void);
 static inline const char * mgos_sys_config_get_wifi_ap_ssid(void) { return mgos_config_get_wifi_ap_ssid(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_wifi_ap_ssid(void) { return mgos_config_get_default_wifi_ap_ssid(); }
 void mgos_config_set_wifi_ap_ssid(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_wifi_ap_ssid(const char * v) { mgos_config_set_wifi_ap_ssid(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_wifi_ap_ssid(const char * v) { mgos_config_set_wifi_ap_ssid(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* wifi.ap.pass */
 #define MGOS_CONFIG_HAVE_WIFI_AP_PASS
@@ -571,7 +573,7 @@ const char * mgos_config_get_default_wifi_ap_pass(void);
 static inline const char * mgos_sys_config_get_wifi_ap_pass(void) { return mgos_config_get_wifi_ap_pass(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_wifi_ap_pass(void) { return mgos_config_get_default_wifi_ap_pass(); }
 void mgos_config_set_wifi_ap_pass(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_wifi_ap_pass(const char * v) { mgos_config_set_wifi_ap_pass(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_wifi_ap_pass(const char * v) { mgos_config_set_wifi_ap_pass(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* wifi.ap.channel */
 #define MGOS_CONFIG_HAVE_WIFI_AP_CHANNEL
@@ -581,7 +583,7 @@ int mgos_config_get_default_wifi_ap_channel(void);
 static inline int mgos_sys_config_get_wifi_ap_channel(void) { return mgos_config_get_wifi_ap_channel(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_wifi_ap_channel(void) { return mgos_config_get_default_wifi_ap_channel(); }
 void mgos_config_set_wifi_ap_channel(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_wifi_ap_channel(int v) { mgos_config_set_wifi_ap_channel(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_wifi_ap_channel(int v) { mgos_config_set_wifi_ap_channel(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* wifi.ap.dhcp_end */
 #define MGOS_CONFIG_HAVE_WIFI_AP_DHCP_END
@@ -591,7 +593,7 @@ const char * mgos_config_get_default_wifi_ap_dhcp_end(void);
 static inline const char * mgos_sys_config_get_wifi_ap_dhcp_end(void) { return mgos_config_get_wifi_ap_dhcp_end(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_wifi_ap_dhcp_end(void) { return mgos_config_get_default_wifi_ap_dhcp_end(); }
 void mgos_config_set_wifi_ap_dhcp_end(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_wifi_ap_dhcp_end(const char * v) { mgos_config_set_wifi_ap_dhcp_end(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_wifi_ap_dhcp_end(const char * v) { mgos_config_set_wifi_ap_dhcp_end(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* foo */
 #define MGOS_CONFIG_HAVE_FOO
@@ -601,7 +603,7 @@ int mgos_config_get_default_foo(void);
 static inline int mgos_sys_config_get_foo(void) { return mgos_config_get_foo(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_foo(void) { return mgos_config_get_default_foo(); }
 void mgos_config_set_foo(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_foo(int v) { mgos_config_set_foo(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_foo(int v) { mgos_config_set_foo(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* http */
 #define MGOS_CONFIG_HAVE_HTTP
@@ -617,7 +619,7 @@ int mgos_config_get_default_http_enable(void);
 static inline int mgos_sys_config_get_http_enable(void) { return mgos_config_get_http_enable(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_http_enable(void) { return mgos_config_get_default_http_enable(); }
 void mgos_config_set_http_enable(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_http_enable(int v) { mgos_config_set_http_enable(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_http_enable(int v) { mgos_config_set_http_enable(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* http.port */
 #define MGOS_CONFIG_HAVE_HTTP_PORT
@@ -627,7 +629,7 @@ int mgos_config_get_default_http_port(void);
 static inline int mgos_sys_config_get_http_port(void) { return mgos_config_get_http_port(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_http_port(void) { return mgos_config_get_default_http_port(); }
 void mgos_config_set_http_port(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_http_port(int v) { mgos_config_set_http_port(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_http_port(int v) { mgos_config_set_http_port(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug */
 #define MGOS_CONFIG_HAVE_DEBUG
@@ -643,7 +645,7 @@ int mgos_config_get_default_debug_level(void);
 static inline int mgos_sys_config_get_debug_level(void) { return mgos_config_get_debug_level(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_debug_level(void) { return mgos_config_get_default_debug_level(); }
 void mgos_config_set_debug_level(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_debug_level(int v) { mgos_config_set_debug_level(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_level(int v) { mgos_config_set_debug_level(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.dest */
 #define MGOS_CONFIG_HAVE_DEBUG_DEST
@@ -653,7 +655,7 @@ const char * mgos_config_get_default_debug_dest(void);
 static inline const char * mgos_sys_config_get_debug_dest(void) { return mgos_config_get_debug_dest(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_debug_dest(void) { return mgos_config_get_default_debug_dest(); }
 void mgos_config_set_debug_dest(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_debug_dest(const char * v) { mgos_config_set_debug_dest(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_dest(const char * v) { mgos_config_set_debug_dest(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.file_level */
 #define MGOS_CONFIG_HAVE_DEBUG_FILE_LEVEL
@@ -663,7 +665,7 @@ const char * mgos_config_get_default_debug_file_level(void);
 static inline const char * mgos_sys_config_get_debug_file_level(void) { return mgos_config_get_debug_file_level(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_debug_file_level(void) { return mgos_config_get_default_debug_file_level(); }
 void mgos_config_set_debug_file_level(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_debug_file_level(const char * v) { mgos_config_set_debug_file_level(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_file_level(const char * v) { mgos_config_set_debug_file_level(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.test_d1 */
 #define MGOS_CONFIG_HAVE_DEBUG_TEST_D1
@@ -673,7 +675,7 @@ double mgos_config_get_default_debug_test_d1(void);
 static inline double mgos_sys_config_get_debug_test_d1(void) { return mgos_config_get_debug_test_d1(&mgos_sys_config); }
 static inline double mgos_sys_config_get_default_debug_test_d1(void) { return mgos_config_get_default_debug_test_d1(); }
 void mgos_config_set_debug_test_d1(struct mgos_config *cfg, double v);
-static inline void mgos_sys_config_set_debug_test_d1(double v) { mgos_config_set_debug_test_d1(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_test_d1(double v) { mgos_config_set_debug_test_d1(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.test_d2 */
 #define MGOS_CONFIG_HAVE_DEBUG_TEST_D2
@@ -683,7 +685,7 @@ double mgos_config_get_default_debug_test_d2(void);
 static inline double mgos_sys_config_get_debug_test_d2(void) { return mgos_config_get_debug_test_d2(&mgos_sys_config); }
 static inline double mgos_sys_config_get_default_debug_test_d2(void) { return mgos_config_get_default_debug_test_d2(); }
 void mgos_config_set_debug_test_d2(struct mgos_config *cfg, double v);
-static inline void mgos_sys_config_set_debug_test_d2(double v) { mgos_config_set_debug_test_d2(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_test_d2(double v) { mgos_config_set_debug_test_d2(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.test_d3 */
 #define MGOS_CONFIG_HAVE_DEBUG_TEST_D3
@@ -693,7 +695,7 @@ double mgos_config_get_default_debug_test_d3(void);
 static inline double mgos_sys_config_get_debug_test_d3(void) { return mgos_config_get_debug_test_d3(&mgos_sys_config); }
 static inline double mgos_sys_config_get_default_debug_test_d3(void) { return mgos_config_get_default_debug_test_d3(); }
 void mgos_config_set_debug_test_d3(struct mgos_config *cfg, double v);
-static inline void mgos_sys_config_set_debug_test_d3(double v) { mgos_config_set_debug_test_d3(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_test_d3(double v) { mgos_config_set_debug_test_d3(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.test_f1 */
 #define MGOS_CONFIG_HAVE_DEBUG_TEST_F1
@@ -703,7 +705,7 @@ float mgos_config_get_default_debug_test_f1(void);
 static inline float mgos_sys_config_get_debug_test_f1(void) { return mgos_config_get_debug_test_f1(&mgos_sys_config); }
 static inline float mgos_sys_config_get_default_debug_test_f1(void) { return mgos_config_get_default_debug_test_f1(); }
 void mgos_config_set_debug_test_f1(struct mgos_config *cfg, float v);
-static inline void mgos_sys_config_set_debug_test_f1(float v) { mgos_config_set_debug_test_f1(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_test_f1(float v) { mgos_config_set_debug_test_f1(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.test_f2 */
 #define MGOS_CONFIG_HAVE_DEBUG_TEST_F2
@@ -713,7 +715,7 @@ float mgos_config_get_default_debug_test_f2(void);
 static inline float mgos_sys_config_get_debug_test_f2(void) { return mgos_config_get_debug_test_f2(&mgos_sys_config); }
 static inline float mgos_sys_config_get_default_debug_test_f2(void) { return mgos_config_get_default_debug_test_f2(); }
 void mgos_config_set_debug_test_f2(struct mgos_config *cfg, float v);
-static inline void mgos_sys_config_set_debug_test_f2(float v) { mgos_config_set_debug_test_f2(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_test_f2(float v) { mgos_config_set_debug_test_f2(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.test_f3 */
 #define MGOS_CONFIG_HAVE_DEBUG_TEST_F3
@@ -723,7 +725,7 @@ float mgos_config_get_default_debug_test_f3(void);
 static inline float mgos_sys_config_get_debug_test_f3(void) { return mgos_config_get_debug_test_f3(&mgos_sys_config); }
 static inline float mgos_sys_config_get_default_debug_test_f3(void) { return mgos_config_get_default_debug_test_f3(); }
 void mgos_config_set_debug_test_f3(struct mgos_config *cfg, float v);
-static inline void mgos_sys_config_set_debug_test_f3(float v) { mgos_config_set_debug_test_f3(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_test_f3(float v) { mgos_config_set_debug_test_f3(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.test_ui */
 #define MGOS_CONFIG_HAVE_DEBUG_TEST_UI
@@ -733,7 +735,7 @@ unsigned int mgos_config_get_default_debug_test_ui(void);
 static inline unsigned int mgos_sys_config_get_debug_test_ui(void) { return mgos_config_get_debug_test_ui(&mgos_sys_config); }
 static inline unsigned int mgos_sys_config_get_default_debug_test_ui(void) { return mgos_config_get_default_debug_test_ui(); }
 void mgos_config_set_debug_test_ui(struct mgos_config *cfg, unsigned int v);
-static inline void mgos_sys_config_set_debug_test_ui(unsigned int v) { mgos_config_set_debug_test_ui(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_debug_test_ui(unsigned int v) { mgos_config_set_debug_test_ui(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* debug.empty */
 #define MGOS_CONFIG_HAVE_DEBUG_EMPTY
@@ -761,7 +763,7 @@ int mgos_config_get_default_test_bar1_enable(void);
 static inline int mgos_sys_config_get_test_bar1_enable(void) { return mgos_config_get_test_bar1_enable(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar1_enable(void) { return mgos_config_get_default_test_bar1_enable(); }
 void mgos_config_set_test_bar1_enable(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar1_enable(int v) { mgos_config_set_test_bar1_enable(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar1_enable(int v) { mgos_config_set_test_bar1_enable(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar1.param1 */
 #define MGOS_CONFIG_HAVE_TEST_BAR1_PARAM1
@@ -771,7 +773,7 @@ int mgos_config_get_default_test_bar1_param1(void);
 static inline int mgos_sys_config_get_test_bar1_param1(void) { return mgos_config_get_test_bar1_param1(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar1_param1(void) { return mgos_config_get_default_test_bar1_param1(); }
 void mgos_config_set_test_bar1_param1(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar1_param1(int v) { mgos_config_set_test_bar1_param1(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar1_param1(int v) { mgos_config_set_test_bar1_param1(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar1.inner */
 #define MGOS_CONFIG_HAVE_TEST_BAR1_INNER
@@ -787,7 +789,7 @@ const char * mgos_config_get_default_test_bar1_inner_param2(void);
 static inline const char * mgos_sys_config_get_test_bar1_inner_param2(void) { return mgos_config_get_test_bar1_inner_param2(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_test_bar1_inner_param2(void) { return mgos_config_get_default_test_bar1_inner_param2(); }
 void mgos_config_set_test_bar1_inner_param2(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_test_bar1_inner_param2(const char * v) { mgos_config_set_test_bar1_inner_param2(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar1_inner_param2(const char * v) { mgos_config_set_test_bar1_inner_param2(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar1.inner.param3 */
 #define MGOS_CONFIG_HAVE_TEST_BAR1_INNER_PARAM3
@@ -797,7 +799,7 @@ int mgos_config_get_default_test_bar1_inner_param3(void);
 static inline int mgos_sys_config_get_test_bar1_inner_param3(void) { return mgos_config_get_test_bar1_inner_param3(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar1_inner_param3(void) { return mgos_config_get_default_test_bar1_inner_param3(); }
 void mgos_config_set_test_bar1_inner_param3(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar1_inner_param3(int v) { mgos_config_set_test_bar1_inner_param3(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar1_inner_param3(int v) { mgos_config_set_test_bar1_inner_param3(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar1.baz */
 #define MGOS_CONFIG_HAVE_TEST_BAR1_BAZ
@@ -813,7 +815,7 @@ int mgos_config_get_default_test_bar1_baz_bazaar(void);
 static inline int mgos_sys_config_get_test_bar1_baz_bazaar(void) { return mgos_config_get_test_bar1_baz_bazaar(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar1_baz_bazaar(void) { return mgos_config_get_default_test_bar1_baz_bazaar(); }
 void mgos_config_set_test_bar1_baz_bazaar(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar1_baz_bazaar(int v) { mgos_config_set_test_bar1_baz_bazaar(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar1_baz_bazaar(int v) { mgos_config_set_test_bar1_baz_bazaar(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar2 */
 #define MGOS_CONFIG_HAVE_TEST_BAR2
@@ -829,7 +831,7 @@ int mgos_config_get_default_test_bar2_enable(void);
 static inline int mgos_sys_config_get_test_bar2_enable(void) { return mgos_config_get_test_bar2_enable(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar2_enable(void) { return mgos_config_get_default_test_bar2_enable(); }
 void mgos_config_set_test_bar2_enable(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar2_enable(int v) { mgos_config_set_test_bar2_enable(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar2_enable(int v) { mgos_config_set_test_bar2_enable(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar2.param1 */
 #define MGOS_CONFIG_HAVE_TEST_BAR2_PARAM1
@@ -839,7 +841,7 @@ int mgos_config_get_default_test_bar2_param1(void);
 static inline int mgos_sys_config_get_test_bar2_param1(void) { return mgos_config_get_test_bar2_param1(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar2_param1(void) { return mgos_config_get_default_test_bar2_param1(); }
 void mgos_config_set_test_bar2_param1(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar2_param1(int v) { mgos_config_set_test_bar2_param1(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar2_param1(int v) { mgos_config_set_test_bar2_param1(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar2.inner */
 #define MGOS_CONFIG_HAVE_TEST_BAR2_INNER
@@ -855,7 +857,7 @@ const char * mgos_config_get_default_test_bar2_inner_param2(void);
 static inline const char * mgos_sys_config_get_test_bar2_inner_param2(void) { return mgos_config_get_test_bar2_inner_param2(&mgos_sys_config); }
 static inline const char * mgos_sys_config_get_default_test_bar2_inner_param2(void) { return mgos_config_get_default_test_bar2_inner_param2(); }
 void mgos_config_set_test_bar2_inner_param2(struct mgos_config *cfg, const char * v);
-static inline void mgos_sys_config_set_test_bar2_inner_param2(const char * v) { mgos_config_set_test_bar2_inner_param2(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar2_inner_param2(const char * v) { mgos_config_set_test_bar2_inner_param2(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar2.inner.param3 */
 #define MGOS_CONFIG_HAVE_TEST_BAR2_INNER_PARAM3
@@ -865,7 +867,7 @@ int mgos_config_get_default_test_bar2_inner_param3(void);
 static inline int mgos_sys_config_get_test_bar2_inner_param3(void) { return mgos_config_get_test_bar2_inner_param3(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar2_inner_param3(void) { return mgos_config_get_default_test_bar2_inner_param3(); }
 void mgos_config_set_test_bar2_inner_param3(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar2_inner_param3(int v) { mgos_config_set_test_bar2_inner_param3(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar2_inner_param3(int v) { mgos_config_set_test_bar2_inner_param3(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 /* test.bar2.baz */
 #define MGOS_CONFIG_HAVE_TEST_BAR2_BAZ
@@ -881,7 +883,17 @@ int mgos_config_get_default_test_bar2_baz_bazaar(void);
 static inline int mgos_sys_config_get_test_bar2_baz_bazaar(void) { return mgos_config_get_test_bar2_baz_bazaar(&mgos_sys_config); }
 static inline int mgos_sys_config_get_default_test_bar2_baz_bazaar(void) { return mgos_config_get_default_test_bar2_baz_bazaar(); }
 void mgos_config_set_test_bar2_baz_bazaar(struct mgos_config *cfg, int v);
-static inline void mgos_sys_config_set_test_bar2_baz_bazaar(int v) { mgos_config_set_test_bar2_baz_bazaar(&mgos_sys_config, v); }
+static inline void mgos_sys_config_set_test_bar2_baz_bazaar(int v) { mgos_config_set_test_bar2_baz_bazaar(&mgos_sys_config, v); mgos_sys_config_changed(); }
+
+/* conf_acl */
+#define MGOS_CONFIG_HAVE_CONF_ACL
+#define MGOS_SYS_CONFIG_HAVE_CONF_ACL
+const char * mgos_config_get_conf_acl(const struct mgos_config *cfg);
+const char * mgos_config_get_default_conf_acl(void);
+static inline const char * mgos_sys_config_get_conf_acl(void) { return mgos_config_get_conf_acl(&mgos_sys_config); }
+static inline const char * mgos_sys_config_get_default_conf_acl(void) { return mgos_config_get_default_conf_acl(); }
+void mgos_config_set_conf_acl(struct mgos_config *cfg, const char * v);
+static inline void mgos_sys_config_set_conf_acl(const char * v) { mgos_config_set_conf_acl(&mgos_sys_config, v); mgos_sys_config_changed(); }
 
 bool mgos_sys_config_get(const struct mg_str key, struct mg_str *value);
 bool mgos_sys_config_set(const struct mg_str key, const struct mg_str value, bool free_strings);
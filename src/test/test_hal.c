@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test_hal.h"
+
+#include <stdlib.h>
+
+#include "common/platform.h"
+
+#include "mgos_init.h"
+#include "mgos_mongoose.h"
+#include "mgos_poll_cb_internal.h"
+#include "mgos_system.h"
+#include "mgos_time.h"
+#include "mgos_timers.h"
+
+const char *build_id = "test";
+
+static struct mg_mgr s_mgr;
+static bool s_mgr_initialized = false;
+static double s_uptime = 0;
+
+
+void test_hal_set_uptime(double uptime) {
+  s_uptime = uptime;
+}
+
+void test_hal_poll(void) {
+  mgos_poll_cbs_run();
+  mg_mgr_poll(mgos_get_mgr(), 0);
+}
+
+double mgos_uptime(void) {
+  return s_uptime;
+}
+
+int64_t mgos_uptime_micros(void) {
+  return (int64_t) (s_uptime * 1000000);
+}
+
+struct mg_mgr *mgos_get_mgr(void) {
+  if (!s_mgr_initialized) {
+    mg_mgr_init(&s_mgr, NULL);
+    s_mgr_initialized = true;
+  }
+  return &s_mgr;
+}
+
+void mongoose_schedule_poll(bool from_isr) {
+  (void) from_isr;
+}
+
+/* Tests are single-threaded, locks only need to exist. */
+struct mgos_rlock_type {
+  int count;
+};
+
+struct mgos_rlock_type *mgos_rlock_create(void) {
+  return (struct mgos_rlock_type *) calloc(1, sizeof(struct mgos_rlock_type));
+}
+
+void mgos_rlock(struct mgos_rlock_type *l) {
+  l->count++;
+}
+
+void mgos_runlock(struct mgos_rlock_type *l) {
+  l->count--;
+}
+
+void mgos_rlock_destroy(struct mgos_rlock_type *l) {
+  free(l);
+}
+
+enum mgos_init_result mgos_hw_timers_init(void) {
+  return MGOS_INIT_OK;
+}
+
+void mgos_clear_hw_timer(mgos_timer_id id) {
+  (void) id;
+}
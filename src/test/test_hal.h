@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2014-2018 Cesanta Software Limited
+ * All rights reserved
+ *
+ * Licensed under the Apache License, Version 2.0 (the ""License"");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an ""AS IS"" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host implementation of the bits of HAL that core modules under test
+ * depend on. Uptime is a manually advanced clock so tests are deterministic.
+ */
+
+#ifndef CS_FW_SRC_TEST_TEST_HAL_H_
+#define CS_FW_SRC_TEST_TEST_HAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Set the value returned by mgos_uptime(). */
+void test_hal_set_uptime(double uptime);
+
+/* Run one iteration of the Mongoose event manager. */
+void test_hal_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CS_FW_SRC_TEST_TEST_HAL_H_ */
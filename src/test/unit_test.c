@@ -3,6 +3,17 @@
  * All rights reserved
  */
 
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <utime.h>
+
 #include "common/cs_dbg.h"
 #include "common/cs_file.h"
 #include "common/cs_hex.h"
@@ -10,9 +21,21 @@
 #include "frozen.h"
 
 #include "mgos_config_util.h"
-#include "mgos_event.h"
+#include "mgos_config_watch.h"
+#include "mgos_event_internal.h"
+#include "mgos_loop_stats.h"
+#include "mgos_poll_cb_internal.h"
+#include "mgos_send_buf_internal.h"
+#include "mgos_sys_config.h"
+#include "mgos_sys_config_snapshot.h"
+#include "mgos_time.h"
+#include "mgos_timers_internal.h"
+#include "ubuntu_bg_pool.h"
+#include "ubuntu_cb_queue.h"
 
 #include "mgos_config.h"
+#include "rpa_queue.h"
+#include "test_hal.h"
 #include "test_main.h"
 #include "test_util.h"
 
@@ -68,8 +91,8 @@ static const char *test_config(void) {
   ASSERT(mgos_config_debug_copy(&conf.debug, &conf_debug));
   ASSERT_PTREQ(conf.debug.dest,
                conf_debug.dest);  // Shared const pointers.
-  ASSERT_PTRNE(conf.debug.file_level,
-               conf_debug.file_level);  // Duplicated heap values.
+  ASSERT_PTREQ(conf.debug.file_level,
+               conf_debug.file_level);  // Pooled values are shared too.
   ASSERT_STREQ(conf.debug.file_level, conf_debug.file_level);
   ASSERT_EQ(conf.debug.level, conf_debug.level);
   ASSERT_EQ(conf.debug.test_d1, conf_debug.test_d1);
@@ -167,6 +190,214 @@ static const char *test_config(void) {
 #error test.bar1 is not abstract, MGOS_CONFIG_HAVE_TEST_BAR1 must be defined
 #endif
 
+static const char *test_config_acl(void) {
+  static const char *acls[] = {
+      "*",         "-wifi.sta.pass,wifi.*,-*", "+debug.level,-*",
+      "WIFI.AP.*", "-foo,*.ssid,http.*|foo",   "wifi.*.pass,-*",
+      "",          ",,-debug.*,,*",            "debug.level$,debug.l?vel",
+      "wifi.**",
+  };
+  static const char *keys[] = {
+      "",          "wifi",      "wifi.sta", "wifi.sta.ssid", "wifi.sta.pass",
+      "wifi.ap.x", "wifi.", "foo", "foob", "http.port", "debug.level",
+      "debug.leve", "a/b", "wifi.a/b",
+  };
+  for (size_t i = 0; i < ARRAY_SIZE(acls); i++) {
+    struct mgos_conf_acl *acl = mgos_conf_acl_compile(mg_mk_str(acls[i]));
+    ASSERT_PTRNE(acl, NULL);
+    struct mg_str src = mgos_conf_acl_get_src(acl);
+    ASSERT_EQ(mg_vcmp(&src, acls[i]), 0);
+    for (size_t j = 0; j < ARRAY_SIZE(keys); j++) {
+      const struct mg_str key = mg_mk_str(keys[j]);
+      if (mgos_conf_acl_check(acl, key) !=
+          mgos_conf_check_access_n(key, mg_mk_str(acls[i]))) {
+        printf("ACL [%s] key [%s]\n", acls[i], keys[j]);
+        FAIL("ACL mismatch", __LINE__);
+      }
+    }
+    mgos_conf_acl_free(acl);
+  }
+
+  /* Cached per-entry results. */
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct mgos_conf_acl *acl =
+      mgos_conf_acl_compile(mg_mk_str("-wifi.sta.pass,wifi.*,-*"));
+  ASSERT(!mgos_conf_acl_check_entry(acl, schema, schema));
+  ASSERT(!mgos_conf_acl_check_entry(acl, schema, schema + 1)); /* wifi */
+  ASSERT(mgos_conf_acl_check_entry(acl, schema, schema + 2));  /* wifi.sta */
+  ASSERT(mgos_conf_acl_check_entry(acl, schema, schema + 3));  /* ssid */
+  ASSERT(!mgos_conf_acl_check_entry(acl, schema, schema + 4)); /* pass */
+  ASSERT(!mgos_conf_acl_check_entry(acl, schema, schema + 11)); /* foo */
+  mgos_conf_acl_free(acl);
+  /* Relative to a sub-schema, keys are "sta.ssid", etc. */
+  acl = mgos_conf_acl_compile(mg_mk_str("sta.ssid,-*"));
+  ASSERT(mgos_conf_acl_check_entry(acl, schema + 1, schema + 3));
+  ASSERT(!mgos_conf_acl_check_entry(acl, schema + 1, schema + 4));
+  ASSERT(!mgos_conf_acl_check_entry(acl, schema, schema + 3));
+  mgos_conf_acl_free(acl);
+
+  struct mgos_config conf;
+  mgos_config_set_defaults(&conf);
+  const char *json =
+      "{\"wifi\": {\"sta\": {\"ssid\": \"s\", \"pass\": \"p\"}}, "
+      "\"foo\": 42}";
+  cs_log_set_level(LL_NONE);
+  ASSERT(mgos_conf_parse(mg_mk_str(json), "-wifi.sta.pass,wifi.*,-*", &conf));
+  ASSERT_STREQ(conf.wifi.sta.ssid, "s");
+  ASSERT_STREQ(conf.wifi.sta.pass, "so\nmany\nlines\n");
+  ASSERT_EQ(conf.foo, 123);
+  mgos_config_free(&conf);
+  return NULL;
+}
+
+static const char *test_config_find(void) {
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct mgos_config conf, conf2;
+  struct mbuf mb1, mb2;
+  size_t size;
+  char *json = cs_read_file("build/mgos_config.json", &size);
+  ASSERT_PTRNE(json, NULL);
+
+  /* Same schema without the index, lookups fall back to a linear scan. */
+  const int n = schema->num_desc + 1;
+  struct mgos_conf_entry *linear =
+      (struct mgos_conf_entry *) malloc(n * sizeof(*linear));
+  memcpy(linear, schema, n * sizeof(*linear));
+  for (int i = 0; i < n; i++) linear[i].sorted_children = NULL;
+
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("test.bar2.baz.bazaar", schema),
+               schema + 43);
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("test.bar2.baz.bazaar", linear),
+               linear + 43);
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("debug", schema), schema + 15);
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("debug.levelx", schema), NULL);
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("debug.level.x", schema), NULL);
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("a", schema), NULL);
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("zzz", schema), NULL);
+  ASSERT_PTREQ(mgos_conf_find_schema_entry("ap.ssid", schema + 1),
+               schema + 7);
+
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&conf);
+  mgos_config_set_defaults(&conf2);
+  ASSERT(mgos_conf_parse_sub_msg(mg_mk_str(json), schema, "*", &conf, NULL));
+  ASSERT(mgos_conf_parse_sub_msg(mg_mk_str(json), linear, "*", &conf2, NULL));
+  mbuf_init(&mb1, 0);
+  mbuf_init(&mb2, 0);
+  mgos_conf_emit_cb(&conf, NULL, schema, false, &mb1, NULL, NULL);
+  mgos_conf_emit_cb(&conf2, NULL, schema, false, &mb2, NULL, NULL);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(mb1.buf, mb1.len),
+                      mg_mk_str_n(mb2.buf, mb2.len)),
+            0);
+
+  mbuf_free(&mb1);
+  mbuf_free(&mb2);
+  mgos_config_free(&conf);
+  mgos_config_free(&conf2);
+  free(linear);
+  free(json);
+  return NULL;
+}
+
+static const char *test_config_typed(void) {
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  const char *keys[] = {"wifi.ap.ssid", "debug.level", "debug.test_f1",
+                        "test.bar2.baz.bazaar", "wifi.sta"};
+  const struct mgos_conf_entry *ents[ARRAY_SIZE(keys)];
+  struct mgos_config conf;
+  struct mbuf mb;
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&conf);
+  for (size_t i = 0; i < ARRAY_SIZE(keys); i++) {
+    ents[i] = mgos_conf_find_schema_entry(keys[i], schema);
+    ASSERT_PTRNE(ents[i], NULL);
+  }
+  ASSERT(mgos_conf_value_set_string(&conf, ents[0], "ap1"));
+  ASSERT_STREQ(mgos_conf_value_string(&conf, ents[0]), "ap1");
+  ASSERT_STREQ(conf.wifi.ap.ssid, "ap1");
+  ASSERT(mgos_conf_value_set_int(&conf, ents[1], 3));
+  ASSERT_EQ(conf.debug.level, 3);
+  ASSERT(mgos_conf_value_set_double(&conf, ents[2], 1.5));
+  ASSERT_EQ(mgos_conf_value_float(&conf, ents[2]), 1.5);
+  ASSERT(mgos_conf_value_set_int(&conf, ents[3], 5));
+  ASSERT_EQ(mgos_conf_value_int(&conf, ents[3]), 1);
+  /* Type mismatch. */
+  ASSERT(!mgos_conf_value_set_int(&conf, ents[0], 1));
+  ASSERT(!mgos_conf_value_set_double(&conf, ents[1], 1));
+  ASSERT(!mgos_conf_value_set_string(&conf, ents[4], "x"));
+  ASSERT(mgos_conf_value_set_string(&conf, ents[0], NULL));
+  ASSERT_PTREQ(conf.wifi.ap.ssid, NULL);
+
+  mbuf_init(&mb, 0);
+  mbuf_append(&mb, "x", 1);
+  ASSERT(mgos_conf_emit_entries(&conf, schema, ents, ARRAY_SIZE(ents), &mb));
+  mbuf_append(&mb, "", 1);
+  ASSERT_STREQ(mb.buf,
+               "x{\"wifi.ap.ssid\":\"\",\"debug.level\":3,"
+               "\"debug.test_f1\":1.500000,\"test.bar2.baz.bazaar\":true,"
+               "\"wifi.sta\":{\"ssid\":\"\","
+               "\"pass\":\"so\\nmany\\nlines\\n\"}}");
+  mb.len = 1;
+  ents[4] = mgos_config_boo_get_schema() + 1;
+  ASSERT(!mgos_conf_emit_entries(&conf, schema, ents, ARRAY_SIZE(ents), &mb));
+  ASSERT_EQ(mb.len, 1);
+
+  mbuf_free(&mb);
+  mgos_config_free(&conf);
+  return NULL;
+}
+
+static const char *test_config_snapshot(void) {
+  size_t size;
+  char *json = cs_read_file("data/overrides.json", &size);
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct mgos_config conf, conf2;
+  struct mbuf snap, mb1, mb2;
+  ASSERT_PTRNE(json, NULL);
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&conf);
+  ASSERT(mgos_conf_parse(mg_mk_str_n(json, size), "*", &conf));
+  mbuf_init(&snap, 0);
+  ASSERT(mgos_conf_snapshot_save(schema, &conf, 123, &snap));
+  const struct mg_str data = mg_mk_str_n(snap.buf, snap.len);
+
+  mgos_config_set_defaults(&conf2);
+  const char *dhcp_end = conf2.wifi.ap.dhcp_end;
+  ASSERT(mgos_conf_snapshot_load(data, schema, 123, &conf2));
+  mbuf_init(&mb1, 0);
+  mbuf_init(&mb2, 0);
+  mgos_conf_emit_cb(&conf, NULL, schema, false, &mb1, NULL, NULL);
+  mgos_conf_emit_cb(&conf2, NULL, schema, false, &mb2, NULL, NULL);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(mb1.buf, mb1.len),
+                      mg_mk_str_n(mb2.buf, mb2.len)),
+            0);
+  ASSERT_PTREQ(conf2.wifi.ap.dhcp_end, dhcp_end); /* Default, not copied. */
+  ASSERT_PTREQ(conf2.wifi.ap.pass, NULL);
+  ASSERT_STREQ(conf2.wifi.sta.ssid, "cookadoodadoo");
+  ASSERT_EQ(conf2.debug.test_d2, 111.0);
+  ASSERT_EQ(conf2.debug.test_f2, 11.5);
+  mgos_config_free(&conf2);
+
+  /* Wrong key or schema, damaged data: rejected, config is not touched. */
+  mgos_config_set_defaults(&conf2);
+  ASSERT(!mgos_conf_snapshot_load(data, schema, 124, &conf2));
+  ASSERT(!mgos_conf_snapshot_load(data, schema + 1, 123, &conf2.wifi));
+  ASSERT(!mgos_conf_snapshot_load(mg_mk_str_n(data.p, data.len - 1), schema,
+                                  123, &conf2));
+  snap.buf[snap.len - 1] ^= 1;
+  ASSERT(!mgos_conf_snapshot_load(data, schema, 123, &conf2));
+  snap.buf[snap.len - 1] ^= 1;
+  ASSERT_EQ(conf2.debug.level, 2);
+  ASSERT_NE(mgos_conf_schema_hash(schema), mgos_conf_schema_hash(schema + 1));
+
+  mbuf_free(&mb1);
+  mbuf_free(&mb2);
+  mbuf_free(&snap);
+  mgos_config_free(&conf);
+  free(json);
+  return NULL;
+}
+
 static const char *test_json_scanf(void) {
   int a = 0;
   bool b = false;
@@ -180,6 +411,831 @@ static const char *test_json_scanf(void) {
   else
     ASSERT(c == false);
 
+  {
+    const char *str2 =
+        "{\"x\": {\"a\": 1, \"s\": \"q\\\"\", \"y\": {\"b\": 2.5}}, "
+        "\"arr\": [1, 2], \"n\": 0x10, \"z\": 3}";
+    int xa = 0, n = 0, z = 0, z2 = 0;
+    double yb = 0;
+    char *qs = NULL;
+    struct json_token arr = JSON_INVALID_TOKEN;
+    /* Conversions in any order, the same path twice, a missing key. */
+    ASSERT_EQ(json_scanf(str2, strlen(str2),
+                         "{z: %d, x: {y: {b: %lf}, a: %d, s: %Q}, "
+                         "arr: %T, n: %d, nope: %d, z: %d}",
+                         &z, &yb, &xa, &qs, &arr, &n, &c, &z2),
+              7);
+    ASSERT_EQ(z, 3);
+    ASSERT_EQ(z2, 3);
+    ASSERT_EQ(yb, 2.5);
+    ASSERT_EQ(xa, 1);
+    ASSERT_STREQ(qs, "q\"");
+    ASSERT_EQ(arr.type, JSON_TYPE_ARRAY_END);
+    ASSERT_EQ(mg_strcmp(mg_mk_str_n(arr.ptr, arr.len), mg_mk_str("[1, 2]")),
+              0);
+    ASSERT_EQ(n, 16);
+    free(qs);
+    ASSERT_EQ(json_scanf(str2, strlen(str2), "{}"), 0);
+  }
+
+  {
+    /* Duplicate keys: every occurrence counts, the last one wins. */
+    const char *str3 =
+        "{\"a\": 1, \"b\": \"x\", \"a\": 2, \"b\": \"y\", \"c\": 5}";
+    int da = 0, dc = 0;
+    char *db = NULL;
+    ASSERT_EQ(json_scanf(str3, strlen(str3), "{a: %d, b: %Q}", &da, &db), 4);
+    ASSERT_EQ(da, 2);
+    ASSERT_STREQ(db, "y");
+    free(db);
+    db = NULL;
+    ASSERT_EQ(
+        json_scanf(str3, strlen(str3), "{a: %d, b: %Q, c: %d}", &da, &db, &dc),
+        5);
+    ASSERT_EQ(da, 2);
+    ASSERT_STREQ(db, "y");
+    ASSERT_EQ(dc, 5);
+    free(db);
+    db = NULL;
+    /* A duplicate after all the other keys is still picked up. */
+    const char *str4 = "{\"a\": 1, \"b\": \"x\", \"a\": 3}";
+    ASSERT_EQ(json_scanf(str4, strlen(str4), "{a: %d, b: %Q}", &da, &db), 3);
+    ASSERT_EQ(da, 3);
+    ASSERT_STREQ(db, "x");
+    free(db);
+  }
+
+  return NULL;
+}
+
+static const char *test_config_str_pool(void) {
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  const struct mg_str json = mg_mk_str(
+      "{wifi: {sta: {ssid: \"same\", pass: \"same\"}, ap: {ssid: \"ap\"}}}");
+  struct mgos_conf_str_pool_stats st0, st;
+  struct mgos_config cfg, cfg2;
+  mgos_conf_str_pool_get_stats(&st0);
+  ASSERT(mgos_config_is_default_str(mgos_config_get_default_debug_dest()));
+  ASSERT(!mgos_config_is_default_str("uart1"));
+
+  /* Identical values share storage. */
+  mgos_config_set_defaults(&cfg);
+  ASSERT(mgos_conf_parse(json, "*", &cfg));
+  ASSERT_PTREQ(cfg.wifi.sta.ssid, cfg.wifi.sta.pass);
+  mgos_conf_str_pool_get_stats(&st);
+  ASSERT_EQ(st.num_strs - st0.num_strs, 2);
+
+  /* Copies don't allocate, parsing the same values again doesn't either. */
+  memset(&cfg2, 0, sizeof(cfg2));
+  ASSERT(mgos_conf_copy(schema, &cfg, &cfg2));
+  ASSERT_PTREQ(cfg2.wifi.ap.ssid, cfg.wifi.ap.ssid);
+  mgos_config_free(&cfg2);
+  mgos_config_set_defaults(&cfg2);
+  ASSERT(mgos_conf_parse(json, "*", &cfg2));
+  ASSERT_PTREQ(cfg2.wifi.ap.ssid, cfg.wifi.ap.ssid);
+  mgos_conf_str_pool_get_stats(&st);
+  ASSERT_EQ(st.num_strs - st0.num_strs, 2);
+
+  /* Changing a shared value does not affect other users. */
+  mgos_conf_set_str(&cfg2.wifi.ap.ssid, "ap2");
+  ASSERT_STREQ(cfg.wifi.ap.ssid, "ap");
+  ASSERT_STREQ(cfg2.wifi.ap.ssid, "ap2");
+  mgos_conf_set_str(&cfg2.wifi.ap.ssid, "");
+  ASSERT_PTREQ(cfg2.wifi.ap.ssid, NULL);
+  mgos_config_free(&cfg2);
+  mgos_config_free(&cfg);
+  mgos_conf_str_pool_get_stats(&st);
+  ASSERT_EQ(st.num_strs, st0.num_strs);
+  ASSERT_EQ(st.num_chunks, st0.num_chunks);
+
+  /* Lots of values, some of them freed and interned again. */
+  {
+    const char *ss[500], *ss2[500];
+    char buf[16];
+    for (int i = 0; i < 500; i++) {
+      snprintf(buf, sizeof(buf), "s%d", i);
+      ss[i] = ss2[i] = NULL;
+      ASSERT(mgos_conf_copy_str(buf, &ss[i]));
+    }
+    for (int i = 0; i < 500; i += 2) mgos_conf_free_str(&ss[i]);
+    for (int i = 0; i < 500; i++) {
+      snprintf(buf, sizeof(buf), "s%d", i);
+      ASSERT(mgos_conf_copy_str(buf, &ss2[i]));
+      if (i % 2 == 1) ASSERT_PTREQ(ss2[i], ss[i]);
+      ASSERT_STREQ(ss2[i], buf);
+    }
+    mgos_conf_str_pool_get_stats(&st);
+    ASSERT_EQ(st.num_strs - st0.num_strs, 500);
+    for (int i = 0; i < 500; i++) {
+      mgos_conf_free_str(&ss[i]);
+      mgos_conf_free_str(&ss2[i]);
+    }
+  }
+  mgos_conf_str_pool_get_stats(&st);
+  ASSERT_EQ(st.num_strs, st0.num_strs);
+  ASSERT_EQ(st.num_chunks, st0.num_chunks);
+  return NULL;
+}
+
+static const char *test_config_journal(void) {
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct mgos_conf_acl *acl = mgos_conf_acl_compile(mg_mk_str("*"));
+  struct mgos_conf_acl *wifi_acl = mgos_conf_acl_compile(mg_mk_str("wifi.*"));
+  struct mgos_config cfg, cfg2, defaults;
+  struct mbuf jnl, mb1, mb2;
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&defaults);
+  mgos_config_set_defaults(&cfg);
+  ASSERT(mgos_conf_parse_file_acl("data/overrides.json", schema, acl, &cfg,
+                                  NULL));
+  cfg.debug.test_d2 = 1.0 / 3;
+  mbuf_init(&jnl, 0);
+  ASSERT_EQ(mgos_conf_journal_diff(schema, &cfg, &defaults, &jnl), 8);
+
+  /* Replaying the journal on top of the base gets the same config. */
+  mgos_config_set_defaults(&cfg2);
+  const struct mg_str data = mg_mk_str_n(jnl.buf, jnl.len);
+  ASSERT_EQ(mgos_conf_journal_apply(data, schema, acl, &cfg2), data.len);
+  mbuf_init(&mb1, 0);
+  mbuf_init(&mb2, 0);
+  mgos_conf_emit_cb(&cfg, NULL, schema, false, &mb1, NULL, NULL);
+  mgos_conf_emit_cb(&cfg2, NULL, schema, false, &mb2, NULL, NULL);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(mb1.buf, mb1.len),
+                      mg_mk_str_n(mb2.buf, mb2.len)),
+            0);
+  ASSERT(cfg2.debug.test_d2 == 1.0 / 3); /* Exactly. */
+  ASSERT_EQ(mgos_conf_journal_diff(schema, &cfg, &cfg2, &jnl), 0);
+  mgos_config_free(&cfg2);
+
+  /* Damaged record stops the replay, what came before it is applied. */
+  mgos_config_set_defaults(&cfg2);
+  size_t good_len = mgos_conf_journal_apply(
+      mg_mk_str_n(data.p, data.len - 1), schema, acl, &cfg2);
+  ASSERT(good_len > 0 && good_len < data.len);
+  ASSERT_STREQ(cfg2.wifi.sta.ssid, "cookadoodadoo");
+  ASSERT(cfg2.debug.test_d2 == 1.0 / 3);
+  ASSERT_EQ(cfg2.debug.test_f2, 123.0); /* The last record. */
+  mgos_config_free(&cfg2);
+
+  /* Records not allowed by the ACL are skipped. */
+  mgos_config_set_defaults(&cfg2);
+  ASSERT_EQ(mgos_conf_journal_apply(data, schema, wifi_acl, &cfg2), data.len);
+  ASSERT_STREQ(cfg2.wifi.sta.ssid, "cookadoodadoo");
+  ASSERT_EQ(cfg2.debug.level, 2);
+  mgos_config_free(&cfg2);
+
+  /* Changing one setting: a record vs the whole diff. */
+  jnl.len = mb1.len = 0;
+  mgos_config_set_defaults(&cfg2);
+  mgos_conf_copy(schema, &cfg, &cfg2);
+  cfg2.wifi.ap.channel = 11;
+  ASSERT_EQ(mgos_conf_journal_diff(schema, &cfg2, &cfg, &jnl), 1);
+  mgos_conf_emit_cb(&cfg2, &defaults, schema, true, &mb1, NULL, NULL);
+  ASSERT_LT(jnl.len, mb1.len);
+  mgos_config_free(&cfg2);
+
+  mbuf_free(&jnl);
+  mbuf_free(&mb1);
+  mbuf_free(&mb2);
+  mgos_config_free(&cfg);
+  mgos_config_free(&defaults);
+  mgos_conf_acl_free(acl);
+  mgos_conf_acl_free(wifi_acl);
+  return NULL;
+}
+
+static bool write_file(const char *name, const char *data) {
+  FILE *fp = fopen(name, "w");
+  if (fp == NULL) return false;
+  fputs(data, fp);
+  fclose(fp);
+  return true;
+}
+
+static int file_size(const char *name) {
+  struct stat st;
+  return (stat(name, &st) == 0 ? (int) st.st_size : -1);
+}
+
+/* Config files are loaded from and saved to the current directory. */
+static void remove_config_files(void) {
+  remove("conf1.json");
+  remove("conf1.json.try");
+  remove("conf9.json");
+  remove("conf9.json.try");
+  remove("conf9.jnl");
+  remove("conf_snap.bin");
+}
+
+static const char *test_sys_config_journal(void) {
+  struct mgos_config cfg, cfg2;
+  int size;
+  cs_log_set_level(LL_NONE);
+  mkdir("build/fs", 0755);
+  ASSERT_EQ(chdir("build/fs"), 0);
+  remove_config_files();
+
+  /* Saves are appended to the journal, a reload gets them back. */
+  ASSERT(mgos_sys_config_load_level(&cfg, MGOS_CONFIG_LEVEL_USER));
+  cfg.http.port = 8080;
+  ASSERT(mgos_sys_config_save(&cfg, false, NULL));
+  ASSERT_GT(file_size("conf9.jnl"), 0);
+  ASSERT_EQ(file_size("conf9.json"), -1);
+  mgos_config_set_wifi_sta_ssid(&cfg, "journal");
+  ASSERT(mgos_sys_config_save(&cfg, false, NULL));
+  size = file_size("conf9.jnl");
+  ASSERT(mgos_sys_config_save(&cfg, false, NULL)); /* Nothing to add. */
+  ASSERT_EQ(file_size("conf9.jnl"), size);
+  ASSERT(mgos_sys_config_load_level(&cfg2, MGOS_CONFIG_LEVEL_USER));
+  ASSERT_EQ(cfg2.http.port, 8080);
+  ASSERT_STREQ(cfg2.wifi.sta.ssid, "journal");
+  mgos_config_free(&cfg2);
+
+  /* .try file is used instead of both CONF_USER_FILE and the journal. */
+  ASSERT(write_file("conf9.json.try", "{\"http\": {\"port\": 1234}}"));
+  ASSERT(mgos_sys_config_load_level(&cfg2, MGOS_CONFIG_LEVEL_USER));
+  ASSERT_EQ(cfg2.http.port, 1234);
+  ASSERT(cfg2.wifi.sta.ssid == NULL);
+  mgos_config_free(&cfg2);
+  remove("conf9.json.try");
+
+  /* Damaged last record: the records before it are still applied. */
+  ASSERT_EQ(truncate("conf9.jnl", size - 1), 0);
+  ASSERT(mgos_sys_config_load_level(&cfg2, MGOS_CONFIG_LEVEL_USER));
+  ASSERT_EQ(cfg2.http.port, 8080);
+  ASSERT(cfg2.wifi.sta.ssid == NULL);
+  mgos_config_free(&cfg2);
+  /* The next save writes out CONF_USER_FILE and drops the journal. */
+  ASSERT(mgos_sys_config_save(&cfg, false, NULL));
+  ASSERT_GT(file_size("conf9.json"), 0);
+  ASSERT_EQ(file_size("conf9.jnl"), -1);
+  ASSERT(mgos_sys_config_load_level(&cfg2, MGOS_CONFIG_LEVEL_USER));
+  ASSERT_EQ(cfg2.http.port, 8080);
+  ASSERT_STREQ(cfg2.wifi.sta.ssid, "journal");
+  mgos_config_free(&cfg2);
+
+  /* Journal written for a different CONF_USER_FILE is ignored. */
+  cfg.http.port = 8081;
+  ASSERT(mgos_sys_config_save(&cfg, false, NULL));
+  ASSERT_GT(file_size("conf9.jnl"), 0);
+  ASSERT(write_file("conf9.json", "{\"debug\": {\"level\": 3}}"));
+  ASSERT(mgos_sys_config_load_level(&cfg2, MGOS_CONFIG_LEVEL_USER));
+  ASSERT_EQ(cfg2.http.port, 80);
+  ASSERT_EQ(cfg2.debug.level, 3);
+  ASSERT(cfg2.wifi.sta.ssid == NULL);
+  mgos_config_free(&cfg2);
+  ASSERT(mgos_sys_config_save(&cfg, false, NULL));
+  ASSERT_EQ(file_size("conf9.jnl"), -1);
+  ASSERT(mgos_sys_config_load_level(&cfg2, MGOS_CONFIG_LEVEL_USER));
+  ASSERT_EQ(cfg2.http.port, 8081);
+  ASSERT_EQ(cfg2.debug.level, 2);
+  mgos_config_free(&cfg2);
+
+  mgos_config_reset(MGOS_CONFIG_LEVEL_USER);
+  ASSERT_EQ(file_size("conf9.json"), -1);
+  remove_config_files();
+  ASSERT_EQ(chdir("../.."), 0);
+  mgos_config_free(&cfg);
+  return NULL;
+}
+
+static const char *test_sys_config_snapshot(void) {
+  struct mgos_config cfg;
+  struct utimbuf ut = {.actime = 1000000, .modtime = 1000000};
+  cs_log_set_level(LL_NONE);
+  mkdir("build/fs", 0755);
+  ASSERT_EQ(chdir("build/fs"), 0);
+  remove_config_files();
+
+  /* Loading the files writes the snapshot. */
+  ASSERT(write_file("conf1.json", "{\"http\": {\"port\": 1001}}"));
+  ASSERT_EQ(utime("conf1.json", &ut), 0);
+  ASSERT(mgos_sys_config_load_level(&cfg, MGOS_CONFIG_LEVEL_VENDOR_8));
+  ASSERT_EQ(cfg.http.port, 1001);
+  mgos_config_free(&cfg);
+  ASSERT_GT(file_size("conf_snap.bin"), 0);
+
+  /* As long as size and mtime of the files are the same, it is used. */
+  ASSERT(write_file("conf1.json", "{\"http\": {\"port\": 1002}}"));
+  ASSERT_EQ(utime("conf1.json", &ut), 0);
+  ASSERT(mgos_sys_config_load_level(&cfg, MGOS_CONFIG_LEVEL_VENDOR_8));
+  ASSERT_EQ(cfg.http.port, 1001);
+  mgos_config_free(&cfg);
+
+  /* Changed mtime invalidates the snapshot. */
+  ut.modtime++;
+  ASSERT_EQ(utime("conf1.json", &ut), 0);
+  ASSERT(mgos_sys_config_load_level(&cfg, MGOS_CONFIG_LEVEL_VENDOR_8));
+  ASSERT_EQ(cfg.http.port, 1002);
+  mgos_config_free(&cfg);
+
+  /* .try file bypasses it and does not replace it. */
+  ASSERT(write_file("conf1.json.try", "{\"http\": {\"port\": 1003}}"));
+  ASSERT(mgos_sys_config_load_level(&cfg, MGOS_CONFIG_LEVEL_VENDOR_8));
+  ASSERT_EQ(cfg.http.port, 1003);
+  mgos_config_free(&cfg);
+  remove("conf1.json.try");
+  ASSERT(write_file("conf1.json", "{\"http\": {\"port\": 1004}}"));
+  ASSERT_EQ(utime("conf1.json", &ut), 0);
+  ASSERT(mgos_sys_config_load_level(&cfg, MGOS_CONFIG_LEVEL_VENDOR_8));
+  ASSERT_EQ(cfg.http.port, 1002);
+  mgos_config_free(&cfg);
+
+  /* Damaged snapshot is not used, the files are loaded from scratch. */
+  FILE *fp = fopen("conf_snap.bin", "r+b");
+  ASSERT(fp != NULL);
+  ASSERT_EQ(fseek(fp, -1, SEEK_END), 0);
+  int c = fgetc(fp);
+  ASSERT_EQ(fseek(fp, -1, SEEK_END), 0);
+  fputc(c ^ 0xff, fp);
+  fclose(fp);
+  ASSERT(mgos_sys_config_load_level(&cfg, MGOS_CONFIG_LEVEL_VENDOR_8));
+  ASSERT_EQ(cfg.http.port, 1004);
+  ASSERT_EQ(cfg.debug.level, 2);
+  ASSERT_STREQ(cfg.wifi.ap.dhcp_end, "192.168.4.200");
+  mgos_config_free(&cfg);
+
+  mgos_config_reset(MGOS_CONFIG_LEVEL_VENDOR_1);
+  ASSERT_EQ(file_size("conf_snap.bin"), -1);
+  remove_config_files();
+  ASSERT_EQ(chdir("../.."), 0);
+  return NULL;
+}
+
+static void config_watch_cb(const char *key, const struct mgos_conf_entry *e,
+                            const void *old_value, const void *new_value,
+                            void *arg) {
+  struct mbuf *mb = (struct mbuf *) arg;
+  char buf[100];
+  int n;
+  if (e->type == CONF_TYPE_STRING) {
+    const char *ov = *((const char *const *) old_value);
+    const char *nv = *((const char *const *) new_value);
+    n = snprintf(buf, sizeof(buf), "%s:%s->%s;", key, (ov ? ov : "NULL"),
+                 (nv ? nv : "NULL"));
+  } else {
+    n = snprintf(buf, sizeof(buf), "%s:%d->%d;", key,
+                 *((const int *) old_value), *((const int *) new_value));
+  }
+  mbuf_append(mb, buf, n);
+}
+
+static void config_unwatch_cb(const char *key, const struct mgos_conf_entry *e,
+                              const void *old_value, const void *new_value,
+                              void *arg) {
+  (*((int *) arg))++;
+  mgos_config_unwatch("wifi.ap", config_unwatch_cb, arg);
+  mgos_config_unwatch("debug.level", config_unwatch_cb, arg);
+  (void) key;
+  (void) e;
+  (void) old_value;
+  (void) new_value;
+}
+
+static const char *test_config_watch(void) {
+  struct mbuf w1, w2;
+  mbuf_init(&w1, 0);
+  mbuf_init(&w2, 0);
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&mgos_sys_config);
+  ASSERT(mgos_config_watch("wifi.ap", config_watch_cb, &w1));
+  ASSERT(mgos_config_watch("debug.level", config_watch_cb, &w2));
+  ASSERT(!mgos_config_watch("debug.nope", config_watch_cb, &w2));
+
+  ASSERT(mgos_conf_parse(
+      mg_mk_str("{wifi: {ap: {channel: 6, dhcp_end: \"x\", pass: \"\"}, "
+                "sta: {ssid: \"y\"}}, debug: {level: 3}}"),
+      "*", &mgos_sys_config));
+  mgos_sys_config_notify_changes();
+  mbuf_append(&w1, "", 1);
+  mbuf_append(&w2, "", 1);
+  ASSERT_STREQ(w1.buf,
+               "wifi.ap.pass:маловато будет->NULL;"
+               "wifi.ap.dhcp_end:192.168.4.200->x;");
+  ASSERT_STREQ(w2.buf, "debug.level:2->3;");
+
+  /* Nothing changed, nothing reported. */
+  w1.len = w2.len = 0;
+  mgos_sys_config_notify_changes();
+  ASSERT_EQ(w1.len, 0);
+  mgos_conf_set_str(&mgos_sys_config.wifi.ap.pass, "");
+  mgos_sys_config_notify_changes();
+  ASSERT_EQ(w1.len, 0);
+
+  ASSERT(mgos_config_unwatch("debug.level", config_watch_cb, &w2));
+  ASSERT(!mgos_config_unwatch("debug.level", config_watch_cb, &w2));
+  mgos_sys_config.debug.level = 4;
+  mgos_sys_config.wifi.ap.channel = 7;
+  mgos_sys_config_notify_changes();
+  ASSERT_EQ(w2.len, 0);
+  mbuf_append(&w1, "", 1);
+  ASSERT_STREQ(w1.buf, "wifi.ap.channel:6->7;");
+
+  /* Setters schedule a check from the main loop, changes are reported once. */
+  w1.len = 0;
+  mgos_sys_config_set_wifi_ap_channel(8);
+  mgos_sys_config_set_wifi_ap_channel(9);
+  ASSERT_EQ(w1.len, 0);
+  test_hal_poll();
+  mbuf_append(&w1, "", 1);
+  ASSERT_STREQ(w1.buf, "wifi.ap.channel:7->9;");
+  w1.len = 0;
+  ASSERT(mgos_sys_config_set(mg_mk_str("wifi.ap.channel"), mg_mk_str("10"),
+                             false));
+  test_hal_poll();
+  mbuf_append(&w1, "", 1);
+  ASSERT_STREQ(w1.buf, "wifi.ap.channel:9->10;");
+  w1.len = 0;
+  ASSERT(mgos_conf_value_set_string(
+      &mgos_sys_config,
+      mgos_conf_find_schema_entry("wifi.ap.dhcp_end", mgos_config_schema()),
+      "y"));
+  test_hal_poll();
+  mbuf_append(&w1, "", 1);
+  ASSERT_STREQ(w1.buf, "wifi.ap.dhcp_end:x->y;");
+  w1.len = 0;
+  test_hal_poll();
+  ASSERT_EQ(w1.len, 0);
+
+  /* Callbacks can remove watches, including the one being notified. */
+  int n = 0;
+  ASSERT(mgos_config_watch("wifi.ap", config_unwatch_cb, &n));
+  ASSERT(mgos_config_watch("debug.level", config_unwatch_cb, &n));
+  mgos_sys_config.wifi.ap.channel = 11;
+  mgos_sys_config.wifi.ap.enable = true;
+  mgos_sys_config.debug.level = 1;
+  mgos_sys_config_notify_changes();
+  ASSERT_EQ(n, 1);
+  mgos_sys_config.debug.level = 2;
+  mgos_sys_config_notify_changes();
+  ASSERT_EQ(n, 1);
+  mbuf_append(&w1, "", 1);
+  ASSERT_STREQ(w1.buf,
+               "wifi.ap.enable:0->1;wifi.ap.channel:10->11;");
+
+  ASSERT(mgos_config_unwatch("wifi.ap", config_watch_cb, &w1));
+  mbuf_free(&w1);
+  mbuf_free(&w2);
+  mgos_config_free(&mgos_sys_config);
+  return NULL;
+}
+
+static const char *test_config_snapshot_publish(void) {
+  const struct mgos_config *s1, *s2;
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&mgos_sys_config);
+  ASSERT_PTREQ(mgos_sys_config_snapshot_get(), NULL);
+  /* Notifications do not publish until snapshots are in use. */
+  mgos_sys_config_notify_changes();
+  ASSERT_PTREQ(mgos_sys_config_snapshot_get(), NULL);
+
+  mgos_conf_set_str(&mgos_sys_config.wifi.sta.ssid, "net1");
+  ASSERT(mgos_sys_config_snapshot_publish());
+  s1 = mgos_sys_config_snapshot_get();
+  ASSERT(s1 != NULL);
+  ASSERT_EQ(mgos_sys_config_snapshot_gen(s1), 1);
+  ASSERT_STREQ(s1->wifi.sta.ssid, "net1");
+  ASSERT(s1->wifi.sta.ssid != mgos_sys_config.wifi.sta.ssid);
+  /* Default strings are shared. */
+  ASSERT_PTREQ(s1->wifi.ap.ssid, mgos_sys_config.wifi.ap.ssid);
+
+  /* Writers do not affect readers holding an older snapshot. */
+  mgos_conf_set_str(&mgos_sys_config.wifi.sta.ssid, "net2");
+  mgos_sys_config.debug.level = 3;
+  mgos_sys_config_notify_changes();
+  ASSERT_STREQ(s1->wifi.sta.ssid, "net1");
+  ASSERT_EQ(s1->debug.level, 2);
+  s2 = mgos_sys_config_snapshot_get();
+  ASSERT_EQ(mgos_sys_config_snapshot_gen(s2), 2);
+  ASSERT_STREQ(s2->wifi.sta.ssid, "net2");
+  ASSERT_EQ(s2->debug.level, 3);
+  mgos_sys_config_snapshot_put(s1);
+
+  /* Nothing changed, the same snapshot stays current. */
+  mgos_sys_config_notify_changes();
+  ASSERT(mgos_sys_config_snapshot_publish());
+  s1 = mgos_sys_config_snapshot_get();
+  ASSERT_PTREQ(s1, s2);
+  mgos_sys_config_snapshot_put(s1);
+  mgos_sys_config_snapshot_put(s2);
+
+  mgos_config_free(&mgos_sys_config);
+  return NULL;
+}
+
+static const char *test_json_tape(void) {
+  const char *json =
+      "{\"a\": {\"b\": [10, {\"c\": \"x\\\"y\"}, [], true]}, "
+      "d: null, \"e\": -1.5, \"a\": 2}";
+  struct json_tape t;
+  struct json_tape_entry arena[11];
+  struct json_token tok, key;
+  int i, n, d = 0;
+  char *c = NULL;
+  double e = 0;
+
+  json_tape_init(&t, NULL, 0);
+  ASSERT_EQ(json_tape_parse(&t, json, strlen(json)), (int) strlen(json));
+  ASSERT_EQ(t.num_entries, 11);
+  ASSERT_EQ(t.entries[0].type, JSON_TYPE_OBJECT_END);
+  ASSERT_EQ(t.entries[0].skip, 11);
+  i = json_tape_find(&t, 0, ".a.b[1].c");
+  ASSERT(i > 0);
+  json_tape_token(&t, i, &tok, &key);
+  ASSERT_EQ(tok.type, JSON_TYPE_STRING);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(tok.ptr, tok.len), mg_mk_str("x\\\"y")), 0);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(key.ptr, key.len), mg_mk_str("c")), 0);
+  i = json_tape_find(&t, 0, ".a.b");
+  ASSERT_EQ(json_tape_find(&t, i, "[3]"), json_tape_elem(&t, i, 3));
+  json_tape_token(&t, json_tape_elem(&t, i, 3), &tok, &key);
+  ASSERT_EQ(tok.type, JSON_TYPE_TRUE);
+  ASSERT_PTREQ(key.ptr, NULL);
+  ASSERT_EQ(json_tape_elem(&t, i, 4), -1);
+  ASSERT_EQ(json_tape_elem(&t, 0, 0), -1);
+  ASSERT_EQ(json_tape_find(&t, 0, ".a.b[1].d"), -1);
+  ASSERT_EQ(json_tape_find(&t, 0, ".a.b.c"), -1);
+  ASSERT_EQ(json_tape_find(&t, 0, ".a.b[x]"), -1);
+  ASSERT_EQ(json_tape_find(&t, 0, ".a.b[2]"), json_tape_elem(&t, i, 2));
+  ASSERT_EQ(json_tape_child(&t, json_tape_elem(&t, i, 2), -1), -1);
+  /* First of the duplicate keys. */
+  json_tape_token(&t, json_tape_find(&t, 0, ".a"), &tok, NULL);
+  ASSERT_EQ(tok.type, JSON_TYPE_OBJECT_END);
+
+  for (n = 0, i = json_tape_child(&t, 0, -1); i >= 0;
+       i = json_tape_child(&t, 0, i)) {
+    n++;
+  }
+  ASSERT_EQ(n, 4);
+
+  ASSERT_EQ(json_tape_scanf(&t, "{e: %lf, d: %d, a: {b: %T}, x: %d}", &e, &d,
+                            &tok, &n),
+            2);
+  ASSERT_EQ(e, -1.5);
+  ASSERT_EQ(tok.type, JSON_TYPE_ARRAY_END);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(tok.ptr, tok.len),
+                      mg_mk_str("[10, {\"c\": \"x\\\"y\"}, [], true]")),
+            0);
+
+  /* Parse errors and running out of a fixed arena leave the tape empty. */
+  ASSERT_EQ(json_tape_parse(&t, "{\"a\": [1, }", 11), JSON_STRING_INVALID);
+  ASSERT_EQ(t.num_entries, 0);
+  ASSERT_EQ(json_tape_find(&t, 0, ""), -1);
+  json_tape_free(&t);
+
+  json_tape_init(&t, arena, 10);
+  ASSERT_EQ(json_tape_parse(&t, json, strlen(json)), JSON_NO_MEMORY);
+  ASSERT_EQ(t.num_entries, 0);
+  json_tape_init(&t, arena, 11);
+  ASSERT_EQ(json_tape_parse(&t, json, strlen(json)), (int) strlen(json));
+  ASSERT_PTREQ(t.entries, arena);
+  ASSERT_EQ(json_tape_find(&t, 0, ".a.b[0]"), 3);
+  ASSERT_EQ(json_tape_scanf(&t, "{d: %Q, e: %lf}", &c, &e), 1);
+  ASSERT_PTREQ(c, NULL);
+  json_tape_free(&t);
+  return NULL;
+}
+
+static void json_record_cb(void *data, const char *name, size_t name_len,
+                           const char *path, const struct json_token *tok) {
+  struct mbuf *mb = (struct mbuf *) data;
+  char buf[300];
+  int n = snprintf(buf, sizeof(buf), "%d [%.*s] [%s]", tok->type,
+                   (int) name_len, (name != NULL ? name : "-"), path);
+  mbuf_append(mb, buf, n);
+  if (tok->type != JSON_TYPE_OBJECT_END && tok->type != JSON_TYPE_ARRAY_END &&
+      tok->ptr != NULL) {
+    mbuf_append(mb, " ", 1);
+    mbuf_append(mb, tok->ptr, tok->len);
+  }
+  mbuf_append(mb, "\n", 1);
+}
+
+/* Walks `json` in chunks of `chunk` bytes, records the callbacks. */
+static int json_walk_stream_record(const char *json, int chunk,
+                                   struct mbuf *mb) {
+  struct json_walk_stream ws;
+  int len = (int) strlen(json);
+  json_walk_stream_init(&ws, json_record_cb, mb);
+  for (int i = 0; i < len; i += chunk) {
+    json_walk_stream_feed(&ws, json + i, (len - i < chunk ? len - i : chunk));
+  }
+  return json_walk_stream_finish(&ws);
+}
+
+static const char *test_json_walk_stream(void) {
+  size_t size;
+  char *cfg_json = cs_read_file("build/mgos_config.json", &size);
+  char *overrides = cs_read_file("data/overrides.json", &size);
+  const char *inputs[] = {
+      cfg_json,
+      overrides,
+      " { \"foo\": 123, \"bar\": [ 1, 2, { \"baz\": true } ] } ",
+      "{a: -1.5e+3, b: 0x1F, c: [[], {}, null, false], d: \"\\u0041\\\"\"}",
+      "[\"x\" \"y\",]",
+      "\"str\"",
+      "42",
+      "{\"a\":1}trailing",
+  };
+  ASSERT_PTRNE(cfg_json, NULL);
+  ASSERT_PTRNE(overrides, NULL);
+  for (size_t i = 0; i < ARRAY_SIZE(inputs); i++) {
+    static const int chunks[] = {1, 2, 7, 100000};
+    struct mbuf expected;
+    mbuf_init(&expected, 0);
+    int ret =
+        json_walk(inputs[i], strlen(inputs[i]), json_record_cb, &expected);
+    ASSERT_GT(ret, 0);
+    for (size_t j = 0; j < ARRAY_SIZE(chunks); j++) {
+      struct mbuf mb;
+      mbuf_init(&mb, 0);
+      ASSERT_EQ(json_walk_stream_record(inputs[i], chunks[j], &mb), ret);
+      if (mg_strcmp(mg_mk_str_n(mb.buf, mb.len),
+                    mg_mk_str_n(expected.buf, expected.len)) != 0) {
+        printf("input %d chunk %d:\n%.*s\nvs\n%.*s\n", (int) i, chunks[j],
+               (int) mb.len, mb.buf, (int) expected.len, expected.buf);
+        FAIL("stream mismatch", __LINE__);
+      }
+      mbuf_free(&mb);
+    }
+    mbuf_free(&expected);
+  }
+
+  const char *bad[] = {"{\"a\": tru}", "{\"a\": 1.}", "{\"a\": \"\\x\"}",
+                       "{1: 2}", "{\"a\" 1}", "-"};
+  for (size_t i = 0; i < ARRAY_SIZE(bad); i++) {
+    struct mbuf mb;
+    mbuf_init(&mb, 0);
+    ASSERT_EQ(json_walk_stream_record(bad[i], 1, &mb), JSON_STRING_INVALID);
+    mbuf_free(&mb);
+  }
+  const char *incomplete[] = {"", "  ", "{\"a\": 1", "[1, 2", "\"abc"};
+  for (size_t i = 0; i < ARRAY_SIZE(incomplete); i++) {
+    struct mbuf mb;
+    mbuf_init(&mb, 0);
+    ASSERT_EQ(json_walk_stream_record(incomplete[i], 1, &mb),
+              JSON_STRING_INCOMPLETE);
+    mbuf_free(&mb);
+  }
+
+  /* Config loaded from a file in chunks. */
+  struct mgos_config conf, conf2;
+  struct mbuf mb1, mb2;
+  const struct mgos_conf_entry *schema = mgos_config_schema();
+  struct mgos_conf_acl *acl = mgos_conf_acl_compile(mg_mk_str("*"));
+  cs_log_set_level(LL_NONE);
+  mgos_config_set_defaults(&conf);
+  mgos_config_set_defaults(&conf2);
+  ASSERT(mgos_conf_parse(mg_mk_str(overrides), "*", &conf));
+  ASSERT(mgos_conf_parse_file_acl("data/overrides.json", schema, acl, &conf2,
+                                  NULL));
+  ASSERT(!mgos_conf_parse_file_acl("data/nonexistent.json", schema, acl,
+                                   &conf2, NULL));
+  mbuf_init(&mb1, 0);
+  mbuf_init(&mb2, 0);
+  mgos_conf_emit_cb(&conf, NULL, schema, false, &mb1, NULL, NULL);
+  mgos_conf_emit_cb(&conf2, NULL, schema, false, &mb2, NULL, NULL);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(mb1.buf, mb1.len),
+                      mg_mk_str_n(mb2.buf, mb2.len)),
+            0);
+  ASSERT_STREQ(conf2.wifi.sta.ssid, "cookadoodadoo");
+
+  /* After a dotted key with an object value, keys go back to its object. */
+  const char *dotted =
+      "{\"wifi.ap\": {\"channel\": 11}, \"debug\": {\"level\": 3}, "
+      "\"foo\": 77}";
+  ASSERT(mgos_conf_parse(mg_mk_str(dotted), "*", &conf));
+  ASSERT_EQ(conf.wifi.ap.channel, 11);
+  ASSERT_EQ(conf.debug.level, 3);
+  ASSERT_EQ(conf.foo, 77);
+  FILE *fp = fopen("build/dotted.json", "w");
+  ASSERT(fp != NULL);
+  fputs(dotted, fp);
+  fclose(fp);
+  ASSERT(mgos_conf_parse_file_acl("build/dotted.json", schema, acl, &conf2,
+                                  NULL));
+  ASSERT_EQ(conf2.wifi.ap.channel, 11);
+  ASSERT_EQ(conf2.debug.level, 3);
+  ASSERT_EQ(conf2.foo, 77);
+
+  mbuf_free(&mb1);
+  mbuf_free(&mb2);
+  mgos_conf_acl_free(acl);
+  mgos_config_free(&conf);
+  mgos_config_free(&conf2);
+  free(cfg_json);
+  free(overrides);
+  return NULL;
+}
+
+static const char *test_json_walk_modes(void) {
+  const char *json =
+      "{\"a\": {\"b\": 1, \"c\": [10, {\"d\": \"x\"}, 12]}, "
+      "\"e\": [[1], 2], \"f\": true}";
+  struct mbuf mb;
+  mbuf_init(&mb, 0);
+
+  int ret = json_walk_nopath(json, strlen(json), json_record_cb, &mb);
+  ASSERT_EQ(ret, (int) strlen(json));
+  mbuf_append(&mb, "", 1);
+  ASSERT_STREQ(mb.buf,
+               "6 [] []\n6 [a] []\n2 [b] [] 1\n8 [c] []\n2 [0] [] 10\n"
+               "6 [1] []\n1 [d] [] x\n7 [] []\n2 [2] [] 12\n9 [] []\n"
+               "7 [] []\n8 [e] []\n8 [0] []\n2 [0] [] 1\n9 [] []\n"
+               "2 [1] [] 2\n9 [] []\n3 [f] [] true\n7 [] []\n");
+
+  const char *paths[] = {".a.c[1].d", ".e[1]", ".a.b", ".nope"};
+  mb.len = 0;
+  ret = json_walk_paths(json, strlen(json), paths, ARRAY_SIZE(paths),
+                        json_record_cb, &mb);
+  ASSERT_EQ(ret, (int) strlen(json));
+  mbuf_append(&mb, "", 1);
+  ASSERT_STREQ(mb.buf,
+               "2 [b] [.a.b] 1\n1 [d] [.a.c[1].d] x\n2 [1] [.e[1]] 2\n");
+
+  /* Containers get both start and end. */
+  paths[0] = ".a.c";
+  mb.len = 0;
+  ret = json_walk_paths(json, strlen(json), paths, 1, json_record_cb, &mb);
+  ASSERT_EQ(ret, (int) strlen(json));
+  mbuf_append(&mb, "", 1);
+  ASSERT_STREQ(mb.buf, "8 [c] [.a.c]\n9 [] [.a.c]\n");
+
+  mbuf_free(&mb);
+  return NULL;
+}
+
+/* Prints `n` telemetry records, consumes int n. */
+static int json_printf_records(struct json_out *out, va_list *ap) {
+  int len = 0, n = va_arg(*ap, int);
+  static const int vals[] = {1, 2, 3};
+  for (int i = 0; i < n; i++) {
+    len += json_printf(out, "%s{id: %d, name: %Q, ok: %B, v: %M, h: %H}",
+                       (i > 0 ? ", " : ""), i, "sensor \"a\"\n", i % 2,
+                       json_printf_array, vals, sizeof(vals), sizeof(vals[0]),
+                       "%d", 2, "\x01\xff");
+  }
+  return len;
+}
+
+/* Prints one more byte every time it is called. */
+static int json_printf_growing(struct json_out *out, va_list *ap) {
+  static int n = 0;
+  (void) ap;
+  n++;
+  return json_printf(out, "%.*Q", n, "xxxxxxxxxxxxxxxx");
+}
+
+static const char *test_json_printf_fast(void) {
+  const char *fmt = "{records: [%M], n: %d}";
+  const int num_records = 500;
+  struct mbuf ref, mb;
+  mbuf_init(&ref, 0);
+  mbuf_init(&mb, 0);
+  struct json_out out = JSON_OUT_MBUF(&ref);
+  int n = json_printf(&out, fmt, json_printf_records, num_records, 123);
+  ASSERT_EQ(n, (int) ref.len);
+  ASSERT_EQ(json_printf_len(fmt, json_printf_records, num_records, 123), n);
+
+  char *s = json_asprintf(fmt, json_printf_records, num_records, 123);
+  ASSERT_PTRNE(s, NULL);
+  ASSERT_EQ(mg_strcmp(mg_mk_str(s), mg_mk_str_n(ref.buf, ref.len)), 0);
+  free(s);
+
+  mbuf_append(&mb, "x", 1);
+  ASSERT_EQ(mg_json_printf_mbuf(&mb, fmt, json_printf_records, num_records,
+                                123),
+            n);
+  ASSERT_EQ((int) mb.len, n + 1);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(mb.buf + 1, mb.len - 1),
+                      mg_mk_str_n(ref.buf, ref.len)),
+            0);
+
+  /* Batching adapter, with a batch smaller and larger than the writes. */
+  struct json_out_batch b;
+  mb.len = 0;
+  out = (struct json_out) JSON_OUT_MBUF(&mb);
+  json_out_batch_init(&b, &out);
+  ASSERT_EQ(json_printf(&b.out, fmt, json_printf_records, num_records, 123),
+            n);
+  ASSERT_EQ(json_printf(&b.out, "%.*Q", JSON_OUT_BATCH_SIZE * 2, ref.buf),
+            (int) json_printf_len("%.*Q", JSON_OUT_BATCH_SIZE * 2, ref.buf));
+  json_out_batch_flush(&b);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(mb.buf, n), mg_mk_str_n(ref.buf, ref.len)),
+            0);
+  ASSERT_EQ(mb.buf[n], '"');
+
+  /* json_asprintf formats in one pass, %M callbacks run once. */
+  s = json_asprintf("[%M]", json_printf_growing);
+  ASSERT_STREQ(s, "[\"x\"]");
+  free(s);
+  /* Output that changes between the passes is still printed in full. */
+  mb.len = 0;
+  ASSERT_EQ(mg_json_printf_mbuf(&mb, "[%M]", json_printf_growing), 8);
+  ASSERT_EQ(mg_strcmp(mg_mk_str_n(mb.buf, mb.len), mg_mk_str("[\"xxxx\"]")),
+            0);
+
+  mbuf_free(&ref);
+  mbuf_free(&mb);
   return NULL;
 }
 
@@ -313,6 +1369,767 @@ static const char *test_events(void) {
   ASSERT_EQ(flags2, EV_FLAG_GRP2_EV2);
   ASSERT_EQ(flags3, 0);
 
+  flags1 = flags2 = flags3 = 0;
+  ASSERT_EQ(mgos_event_trigger(GRP3_EV0, NULL), 2);
+  ASSERT_EQ(flags3, EV_FLAG_GRP3_EV0);
+
+  ASSERT(mgos_event_remove_handler(GRP3_EV0, ev_cb, &flags3));
+  ASSERT(!mgos_event_remove_handler(GRP3_EV0, ev_cb, &flags3));
+  ASSERT(mgos_event_remove_group_handler(GRP3, ev_cb, &flags3));
+  ASSERT_EQ(mgos_event_trigger(GRP3_EV0, NULL), 0);
+  ASSERT(mgos_event_remove_group_handler(GRP2, ev_cb, &flags2));
+  ASSERT(mgos_event_remove_handler(GRP2_EV2, ev_cb, &flags1));
+  ASSERT(mgos_event_remove_handler(GRP1_EV1, ev_cb, &flags1));
+  ASSERT(mgos_event_remove_handler(GRP1_EV2, ev_cb, &flags1));
+
+  return NULL;
+}
+
+#define GRP4 MGOS_EVENT_BASE('G', '0', '4')
+
+static char s_ev_order[MGOS_EVENT_QUEUE_LEN + 1];
+static int s_num_ev_calls = 0;
+
+static void ev_order_cb(int ev, void *ev_data, void *userdata) {
+  s_ev_order[s_num_ev_calls++] = *((char *) userdata);
+  (void) ev;
+  (void) ev_data;
+}
+
+static void ev_remove_self_cb(int ev, void *ev_data, void *userdata) {
+  ev_order_cb(ev, ev_data, userdata);
+  mgos_event_remove_handler(ev, ev_remove_self_cb, userdata);
+}
+
+static const char *test_events_order(void) {
+  /* Handlers are invoked in reverse order of registration. */
+  ASSERT(mgos_event_add_handler(GRP4 + 1, ev_order_cb, "a"));
+  ASSERT(mgos_event_add_group_handler(GRP4, ev_order_cb, "b"));
+  ASSERT(mgos_event_add_handler(GRP4 + 2, ev_order_cb, "c"));
+  ASSERT(mgos_event_add_handler(GRP4 + 1, ev_order_cb, "d"));
+  s_num_ev_calls = 0;
+  ASSERT_EQ(mgos_event_trigger(GRP4 + 1, NULL), 3);
+  ASSERT_EQ(s_num_ev_calls, 3);
+  ASSERT_STREQ_NZ(s_ev_order, "dba");
+
+  /* The base event number is an event of its own, not the group. */
+  ASSERT(mgos_event_add_handler(GRP4, ev_order_cb, "e"));
+  s_num_ev_calls = 0;
+  ASSERT_EQ(mgos_event_trigger(GRP4, NULL), 2);
+  ASSERT_STREQ_NZ(s_ev_order, "eb");
+  ASSERT(!mgos_event_remove_group_handler(GRP4, ev_order_cb, "e"));
+  ASSERT(!mgos_event_remove_handler(GRP4, ev_order_cb, "b"));
+  ASSERT(mgos_event_remove_handler(GRP4, ev_order_cb, "e"));
+
+  /* A handler may remove itself. */
+  ASSERT(mgos_event_add_handler(GRP4 + 1, ev_remove_self_cb, "f"));
+  s_num_ev_calls = 0;
+  ASSERT_EQ(mgos_event_trigger(GRP4 + 1, NULL), 4);
+  ASSERT_STREQ_NZ(s_ev_order, "fdba");
+  s_num_ev_calls = 0;
+  ASSERT_EQ(mgos_event_trigger(GRP4 + 1, NULL), 3);
+  ASSERT_STREQ_NZ(s_ev_order, "dba");
+
+  ASSERT(mgos_event_remove_handler(GRP4 + 1, ev_order_cb, "a"));
+  ASSERT(mgos_event_remove_group_handler(GRP4, ev_order_cb, "b"));
+  ASSERT(mgos_event_remove_handler(GRP4 + 2, ev_order_cb, "c"));
+  ASSERT(mgos_event_remove_handler(GRP4 + 1, ev_order_cb, "d"));
+  s_num_ev_calls = 0;
+  ASSERT_EQ(mgos_event_trigger(GRP4 + 1, NULL), 0);
+  return NULL;
+}
+
+static int s_posted_ev_sum = 0;
+
+static void ev_posted_cb(int ev, void *ev_data, void *userdata) {
+  s_ev_order[s_num_ev_calls++] = (char) (ev - GRP4);
+  if (ev_data != NULL) s_posted_ev_sum += *((int *) ev_data);
+  (void) userdata;
+}
+
+static const char *test_events_post(void) {
+  struct mgos_event_queue_stats stats;
+  int v;
+  ASSERT(mgos_event_add_group_handler(GRP4, ev_posted_cb, NULL));
+  s_num_ev_calls = 0;
+
+  /* Posted events are delivered from the main loop, in order. */
+  v = 1;
+  ASSERT(mgos_event_post(GRP4 + 'a', &v, sizeof(v), 0));
+  v = 10;
+  ASSERT(mgos_event_post(GRP4 + 'b', &v, sizeof(v),
+                         MGOS_EVENT_POST_F_COALESCE));
+  ASSERT(mgos_event_post(GRP4 + 'c', NULL, 0, 0));
+  /* Latest wins, position in the queue is retained. */
+  v = 100;
+  ASSERT(mgos_event_post(GRP4 + 'b', &v, sizeof(v),
+                         MGOS_EVENT_POST_F_COALESCE));
+  /* Non-coalescing events are always queued. */
+  v = 1000;
+  ASSERT(mgos_event_post(GRP4 + 'a', &v, sizeof(v), 0));
+  ASSERT_EQ(s_num_ev_calls, 0);
+  ASSERT(!mgos_event_post(GRP4 + 'x', &v, MGOS_EVENT_POST_MAX_DATA_LEN + 1, 0));
+
+  mgos_event_dispatch_posted();
+  ASSERT_EQ(s_num_ev_calls, 4);
+  ASSERT_STREQ_NZ(s_ev_order, "abca");
+  ASSERT_EQ(s_posted_ev_sum, 1101);
+  mgos_event_get_queue_stats(&stats);
+  ASSERT_EQ(stats.num_posted, 5);
+  ASSERT_EQ(stats.num_coalesced, 1);
+  ASSERT_EQ(stats.num_dropped, 0);
+  ASSERT_EQ(stats.num_delivered, 4);
+  ASSERT_EQ(stats.max_depth, 4);
+
+  /* Overflow. */
+  for (int i = 0; i < MGOS_EVENT_QUEUE_LEN; i++) {
+    ASSERT(mgos_event_post(GRP4, NULL, 0, 0));
+  }
+  ASSERT(!mgos_event_post(GRP4, NULL, 0, 0));
+  mgos_event_get_queue_stats(&stats);
+  ASSERT_EQ(stats.num_dropped, 1);
+  ASSERT_EQ(stats.max_depth, MGOS_EVENT_QUEUE_LEN);
+  s_num_ev_calls = 0;
+  mgos_event_dispatch_posted();
+  ASSERT_EQ(s_num_ev_calls, MGOS_EVENT_QUEUE_LEN);
+
+  ASSERT(mgos_event_remove_group_handler(GRP4, ev_posted_cb, NULL));
+  return NULL;
+}
+
+static int s_timer_order[8];
+static int s_num_timer_calls = 0;
+
+static void timer_cb(void *arg) {
+  if (s_num_timer_calls < (int) ARRAY_SIZE(s_timer_order)) {
+    s_timer_order[s_num_timer_calls] = (int) (intptr_t) arg;
+  }
+  s_num_timer_calls++;
+}
+
+static void fire_due_timers(int max_polls) {
+  for (int i = 0; i < max_polls; i++) test_hal_poll();
+}
+
+static const char *test_timers(void) {
+  struct mgos_timer_info ti;
+  test_hal_set_uptime(100);
+  s_num_timer_calls = 0;
+
+  mgos_timer_id t30 = mgos_set_timer(30, 0, timer_cb, (void *) 30);
+  mgos_timer_id t10 = mgos_set_timer(10, 0, timer_cb, (void *) 10);
+  mgos_timer_id t20 = mgos_set_timer(20, 0, timer_cb, (void *) 20);
+  mgos_timer_id t15 = mgos_set_timer(15, 0, timer_cb, (void *) 15);
+  mgos_timer_id tr =
+      mgos_set_timer(25, MGOS_TIMER_REPEAT, timer_cb, (void *) 25);
+  ASSERT_NE(t30, MGOS_INVALID_TIMER_ID);
+  ASSERT_NE(t10, MGOS_INVALID_TIMER_ID);
+  ASSERT_NE(t20, MGOS_INVALID_TIMER_ID);
+  ASSERT_NE(t15, MGOS_INVALID_TIMER_ID);
+  ASSERT_NE(tr, MGOS_INVALID_TIMER_ID);
+
+  ASSERT(mgos_get_timer_info(t20, &ti));
+  ASSERT(ti.msecs_left >= 19 && ti.msecs_left <= 20);
+  ASSERT_EQ(ti.interval_ms, -1);
+  ASSERT_PTREQ(ti.cb_arg, (void *) 20);
+  ASSERT(mgos_get_timer_info(tr, &ti));
+  ASSERT_EQ(ti.interval_ms, 25);
+
+  mgos_clear_timer(t15);
+  ASSERT(!mgos_get_timer_info(t15, &ti));
+  /* Clearing a stale id is a no-op. */
+  mgos_clear_timer(t15);
+  ASSERT(mgos_get_sw_timer_next_due_ms() >= 10 &&
+         mgos_get_sw_timer_next_due_ms() <= 11);
+
+  /* Nothing is due yet. */
+  fire_due_timers(3);
+  ASSERT_EQ(s_num_timer_calls, 0);
+
+  /* Timers fire in deadline order. */
+  test_hal_set_uptime(100.026);
+  fire_due_timers(5);
+  ASSERT_EQ(s_num_timer_calls, 3);
+  ASSERT_EQ(s_timer_order[0], 10);
+  ASSERT_EQ(s_timer_order[1], 20);
+  ASSERT_EQ(s_timer_order[2], 25);
+  ASSERT(!mgos_get_timer_info(t10, &ti));
+  ASSERT(mgos_get_timer_info(tr, &ti));
+  ASSERT(mgos_get_timer_info(t30, &ti));
+
+  /* Repeating timer was rescheduled and fires after t30. */
+  test_hal_set_uptime(100.051);
+  fire_due_timers(5);
+  ASSERT_EQ(s_num_timer_calls, 5);
+  ASSERT_EQ(s_timer_order[3], 30);
+  ASSERT_EQ(s_timer_order[4], 25);
+
+  /* A freed slot is reused under a different id. */
+  mgos_timer_id t40 = mgos_set_timer(40, 0, timer_cb, (void *) 40);
+  ASSERT_NE(t40, t10);
+  ASSERT_NE(t40, t30);
+  ASSERT(!mgos_get_timer_info(t10, &ti));
+  ASSERT(!mgos_get_timer_info(t30, &ti));
+  mgos_clear_timer(t40);
+  mgos_clear_timer(tr);
+  ASSERT(!mgos_get_timer_info(tr, &ti));
+
+  return NULL;
+}
+
+static mgos_timer_id s_timer_to_clear = MGOS_INVALID_TIMER_ID;
+
+static void clearing_timer_cb(void *arg) {
+  timer_cb(arg);
+  mgos_clear_timer(s_timer_to_clear);
+}
+
+static const char *test_timers_batch(void) {
+  struct mgos_sw_timer_stats stats;
+  test_hal_set_uptime(200);
+  s_num_timer_calls = 0;
+  mgos_reset_sw_timer_stats();
+
+  /* All due timers fire in one iteration, in deadline order. */
+  mgos_set_timer(40, 0, timer_cb, (void *) 4);
+  mgos_set_timer(10, 0, timer_cb, (void *) 1);
+  mgos_set_timer(30, 0, timer_cb, (void *) 3);
+  mgos_set_timer(20, 0, timer_cb, (void *) 2);
+  test_hal_set_uptime(200.1);
+  test_hal_poll();
+  ASSERT_EQ(s_num_timer_calls, 4);
+  for (int i = 0; i < 4; i++) ASSERT_EQ(s_timer_order[i], i + 1);
+  mgos_get_sw_timer_stats(&stats);
+  ASSERT_EQ(stats.num_fired, 4);
+  ASSERT_EQ(stats.num_late, 4);
+  ASSERT(stats.late_ms_max > 89 && stats.late_ms_max < 91);
+
+  /* Budget limits the number of callbacks per iteration. */
+  s_num_timer_calls = 0;
+  mgos_set_sw_timer_dispatch_budget(2);
+  for (intptr_t i = 1; i <= 5; i++) {
+    mgos_set_timer(i, 0, timer_cb, (void *) i);
+  }
+  test_hal_set_uptime(200.2);
+  test_hal_poll();
+  ASSERT_EQ(s_num_timer_calls, 2);
+  test_hal_poll();
+  ASSERT_EQ(s_num_timer_calls, 4);
+  test_hal_poll();
+  ASSERT_EQ(s_num_timer_calls, 5);
+  for (int i = 0; i < 5; i++) ASSERT_EQ(s_timer_order[i], i + 1);
+  mgos_set_sw_timer_dispatch_budget(0);
+
+  /* A timer cleared by an earlier callback in the same batch does not fire. */
+  s_num_timer_calls = 0;
+  mgos_set_timer(10, 0, clearing_timer_cb, (void *) 1);
+  s_timer_to_clear = mgos_set_timer(20, 0, timer_cb, (void *) 2);
+  mgos_timer_id tr =
+      mgos_set_timer(30, MGOS_TIMER_REPEAT, timer_cb, (void *) 3);
+  test_hal_set_uptime(200.3);
+  test_hal_poll();
+  ASSERT_EQ(s_num_timer_calls, 2);
+  ASSERT_EQ(s_timer_order[0], 1);
+  ASSERT_EQ(s_timer_order[1], 3);
+
+  /* Same for a repeating timer. */
+  s_num_timer_calls = 0;
+  mgos_set_timer(1, 0, clearing_timer_cb, (void *) 1);
+  s_timer_to_clear = tr;
+  test_hal_set_uptime(200.4);
+  test_hal_poll();
+  ASSERT_EQ(s_num_timer_calls, 1);
+  struct mgos_timer_info ti;
+  ASSERT(!mgos_get_timer_info(tr, &ti));
+  s_timer_to_clear = MGOS_INVALID_TIMER_ID;
+
+  mgos_set_sw_timer_dispatch_budget(16);
+  return NULL;
+}
+
+static char s_poll_order[32];
+static int s_num_poll_calls = 0;
+
+static void poll_rec_cb(void *arg) {
+  s_poll_order[s_num_poll_calls++] = (char) (intptr_t) arg;
+}
+
+/* Takes 30 ms, more than the default budget. */
+static void poll_slow_cb(void *arg) {
+  poll_rec_cb(arg);
+  test_hal_set_uptime(mgos_uptime() + 0.03);
+}
+
+/* Removes callbacks the outer run is yet to visit, then re-enters it. */
+static void poll_reenter_cb(void *arg) {
+  poll_rec_cb(arg);
+  mgos_remove_poll_cb(poll_rec_cb, (void *) 'n');
+  mgos_remove_poll_cb(poll_reenter_cb, arg);
+  mgos_poll_cbs_run();
+}
+
+static void poll_cbs_run_rec(void) {
+  memset(s_poll_order, 0, sizeof(s_poll_order));
+  s_num_poll_calls = 0;
+  mgos_poll_cbs_run();
+}
+
+static uint32_t poll_cb_num_skipped(void *arg) {
+  struct mgos_poll_cb_stats st[16];
+  int n = mgos_get_poll_cb_stats(st, ARRAY_SIZE(st));
+  for (int i = 0; i < n && i < (int) ARRAY_SIZE(st); i++) {
+    if (st[i].cb_arg == arg) return st[i].num_skipped;
+  }
+  return 0xffffffff;
+}
+
+static const char *test_poll_cbs(void) {
+  struct mgos_poll_cb_opts low = {.name = "low", .prio = MGOS_POLL_CB_PRIO_LOW};
+  struct mgos_poll_cb_opts high = {.prio = MGOS_POLL_CB_PRIO_HIGH};
+  test_hal_set_uptime(300);
+  /* Higher priority first, same priority in LIFO order. */
+  ASSERT(mgos_add_poll_cb_opt(poll_rec_cb, (void *) 'l', &low));
+  mgos_add_poll_cb(poll_rec_cb, (void *) 'n');
+  ASSERT(mgos_add_poll_cb_opt(poll_rec_cb, (void *) 'h', &high));
+  mgos_add_poll_cb(poll_rec_cb, (void *) 'm');
+  poll_cbs_run_rec();
+  ASSERT_STREQ(s_poll_order, "hmnl");
+
+  /* Over budget: low priority ones are skipped, but not forever. */
+  mgos_reset_poll_cb_stats();
+  ASSERT(mgos_add_poll_cb_opt(poll_slow_cb, (void *) 's', &high));
+  for (int i = 0; i < MGOS_POLL_CB_MAX_SKIPS; i++) {
+    poll_cbs_run_rec();
+    ASSERT_STREQ(s_poll_order, "shmn");
+  }
+  ASSERT_EQ(poll_cb_num_skipped((void *) 'l'), MGOS_POLL_CB_MAX_SKIPS);
+  poll_cbs_run_rec();
+  ASSERT_STREQ(s_poll_order, "shmnl");
+  mgos_remove_poll_cb(poll_slow_cb, (void *) 's');
+  poll_cbs_run_rec();
+  ASSERT_STREQ(s_poll_order, "hmnl");
+
+  /* Removed while both runs walk the list, freed after the outer one. */
+  ASSERT(mgos_add_poll_cb_opt(poll_reenter_cb, (void *) 'r', &high));
+  poll_cbs_run_rec();
+  ASSERT_STREQ(s_poll_order, "rhmlhml");
+  poll_cbs_run_rec();
+  ASSERT_STREQ(s_poll_order, "hml");
+  ASSERT_EQ(poll_cb_num_skipped((void *) 'n'), 0xffffffff);
+
+  mgos_remove_poll_cb(poll_rec_cb, (void *) 'h');
+  mgos_remove_poll_cb(poll_rec_cb, (void *) 'm');
+  mgos_remove_poll_cb(poll_rec_cb, (void *) 'l');
+  poll_cbs_run_rec();
+  ASSERT_STREQ(s_poll_order, "");
+  return NULL;
+}
+
+static int s_num_q_calls = 0;
+
+static void q_cb(void *arg) {
+  s_ev_order[s_num_q_calls++] = (char) (intptr_t) arg;
+}
+
+static void q_push_cb(void *arg) {
+  q_cb((void *) 'p');
+  ubuntu_cb_queue_push((struct ubuntu_cb_queue *) arg, q_cb, (void *) 'x');
+}
+
+static const char *test_ubuntu_cb_queue(void) {
+  struct ubuntu_cb_queue *q = ubuntu_cb_queue_create(3);
+  struct pollfd pfd;
+  ASSERT_PTRNE(q, NULL);
+  pfd.fd = ubuntu_cb_queue_get_fd(q);
+  pfd.events = POLLIN;
+  ASSERT_EQ(poll(&pfd, 1, 0), 0);
+
+  /* Capacity is rounded up to 4. */
+  ASSERT(ubuntu_cb_queue_push(q, q_cb, (void *) 'a'));
+  ASSERT_EQ(poll(&pfd, 1, 0), 1);
+  ASSERT(ubuntu_cb_queue_push(q, q_cb, (void *) 'b'));
+  ASSERT(ubuntu_cb_queue_push(q, q_cb, (void *) 'c'));
+  ASSERT(ubuntu_cb_queue_push(q, q_cb, (void *) 'd'));
+  ASSERT(!ubuntu_cb_queue_push(q, q_cb, (void *) 'e'));
+  memset(s_ev_order, 0, sizeof(s_ev_order));
+  s_num_q_calls = 0;
+  ASSERT_EQ(ubuntu_cb_queue_run(q), 4);
+  ASSERT_STREQ(s_ev_order, "abcd");
+  ASSERT_EQ(poll(&pfd, 1, 0), 0);
+
+  /* Wraps around; callbacks that enqueue more can't keep run() spinning. */
+  ASSERT(ubuntu_cb_queue_push(q, q_push_cb, q));
+  ASSERT_EQ(ubuntu_cb_queue_run(q), 2);
+  ASSERT_STREQ(s_ev_order, "abcdpx");
+  s_num_q_calls = 0;
+  ASSERT(ubuntu_cb_queue_push(q, q_push_cb, q));
+  ASSERT(ubuntu_cb_queue_push(q, q_push_cb, q));
+  ASSERT(ubuntu_cb_queue_push(q, q_push_cb, q));
+  ASSERT_EQ(ubuntu_cb_queue_run(q), 4);
+  /* Remaining entries are signalled. */
+  ASSERT_EQ(poll(&pfd, 1, 0), 1);
+  ASSERT_EQ(ubuntu_cb_queue_run(q), 2);
+  ASSERT_EQ(poll(&pfd, 1, 0), 0);
+  ASSERT_EQ(ubuntu_cb_queue_run(q), 0);
+
+  /* Wakeups are coalesced until the next drain. */
+  ASSERT(ubuntu_cb_queue_wakeup(q));
+  ASSERT(!ubuntu_cb_queue_wakeup(q));
+  ASSERT(ubuntu_cb_queue_push(q, q_cb, (void *) 'y'));
+  ASSERT_EQ(poll(&pfd, 1, 0), 1);
+  ASSERT_EQ(ubuntu_cb_queue_run(q), 1);
+  ASSERT_EQ(poll(&pfd, 1, 0), 0);
+  ASSERT(ubuntu_cb_queue_wakeup(q));
+
+  ubuntu_cb_queue_destroy(q);
+  return NULL;
+}
+
+static atomic_int s_num_xt_calls;
+
+static void q_xt_cb(void *arg) {
+  (void) arg;
+  atomic_fetch_add(&s_num_xt_calls, 1);
+}
+
+/* Invokes a callback, waits for it to run, then invokes another one. */
+static void *q_xt_thread(void *arg) {
+  struct ubuntu_cb_queue *q = (struct ubuntu_cb_queue *) arg;
+  ubuntu_cb_queue_push(q, q_xt_cb, NULL);
+  while (atomic_load(&s_num_xt_calls) < 1) usleep(100);
+  ubuntu_cb_queue_push(q, q_xt_cb, NULL);
+  return NULL;
+}
+
+/*
+ * Consumer loop as in ubuntu_main.c: the wakeup fd is also read by mongoose,
+ * which uses recv(). Both invokes must be noticed without hitting the poll
+ * timeout.
+ */
+static const char *test_ubuntu_cb_queue_cross_thread(void) {
+  struct ubuntu_cb_queue *q = ubuntu_cb_queue_create(8);
+  struct pollfd pfd;
+  pthread_t t;
+  ASSERT_PTRNE(q, NULL);
+  pfd.fd = ubuntu_cb_queue_get_fd(q);
+  pfd.events = POLLIN;
+  atomic_store(&s_num_xt_calls, 0);
+  double start = cs_time();
+  ASSERT_EQ(pthread_create(&t, NULL, q_xt_thread, q), 0);
+  for (int i = 0; i < 10 && atomic_load(&s_num_xt_calls) < 2; i++) {
+    char buf[16];
+    if (poll(&pfd, 1, 1000) == 1) {
+      ASSERT_GT(recv(pfd.fd, buf, sizeof(buf), MSG_DONTWAIT), 0);
+    }
+    ubuntu_cb_queue_run(q);
+  }
+  double elapsed = cs_time() - start;
+  pthread_join(t, NULL);
+  ASSERT_EQ(atomic_load(&s_num_xt_calls), 2);
+  ASSERT_LT(elapsed, 0.5);
+  ubuntu_cb_queue_destroy(q);
+  return NULL;
+}
+
+#define BG_NUM_KEYS 4
+#define BG_NUM_KEYED 200
+#define BG_NUM_FREE 50
+
+struct bg_key_state {
+  int n;
+  int vals[BG_NUM_KEYED];
+};
+
+static struct bg_key_state s_bg_keys[BG_NUM_KEYS];
+static atomic_int s_bg_blocked;
+
+static void bg_keyed_cb(void *arg) {
+  int v = (int) (intptr_t) arg;
+  struct bg_key_state *ks = &s_bg_keys[v % BG_NUM_KEYS];
+  ks->vals[ks->n++] = v / BG_NUM_KEYS;
+}
+
+static void bg_nop_cb(void *arg) {
+  (void) arg;
+}
+
+static void bg_count_cb(void *arg) {
+  (*((int *) arg))++;
+}
+
+static void bg_block_cb(void *arg) {
+  while (s_bg_blocked) usleep(1000);
+  (void) arg;
+}
+
+static bool bg_wait_run(uint32_t num_run) {
+  struct ubuntu_bg_pool_stats st;
+  for (int i = 0; i < 5000; i++) {
+    ubuntu_bg_pool_get_stats(&st);
+    if (st.num_run >= num_run) return true;
+    usleep(1000);
+  }
+  return false;
+}
+
+static const char *test_ubuntu_bg_pool(void) {
+  struct ubuntu_bg_pool_stats st;
+  ASSERT(ubuntu_bg_pool_init(4));
+  ASSERT(!ubuntu_bg_pool_init(4));
+
+  /* Callbacks with the same key run in order. */
+  memset(s_bg_keys, 0, sizeof(s_bg_keys));
+  for (int i = 0; i < BG_NUM_KEYED * BG_NUM_KEYS; i++) {
+    while (!ubuntu_bg_pool_submit(bg_keyed_cb, (void *) (intptr_t) i,
+                                  1 + i % BG_NUM_KEYS)) {
+      usleep(100);
+    }
+  }
+  ubuntu_bg_pool_get_stats(&st);
+  ASSERT(bg_wait_run(st.num_submitted - st.num_rejected));
+  for (int k = 0; k < BG_NUM_KEYS; k++) {
+    ASSERT_EQ(s_bg_keys[k].n, BG_NUM_KEYED);
+    for (int i = 0; i < BG_NUM_KEYED; i++) {
+      ASSERT_EQ(s_bg_keys[k].vals[i], i);
+    }
+  }
+
+  /* A slow callback doesn't hold up the rest: they get stolen. */
+  ubuntu_bg_pool_reset_stats();
+  s_bg_blocked = 1;
+  ASSERT(ubuntu_bg_pool_submit(bg_block_cb, NULL, 0));
+  for (int i = 0; i < BG_NUM_FREE; i++) {
+    ASSERT(ubuntu_bg_pool_submit(bg_nop_cb, NULL, 0));
+  }
+  ASSERT(bg_wait_run(BG_NUM_FREE));
+  ubuntu_bg_pool_get_stats(&st);
+  ASSERT_EQ(st.num_workers, 4);
+  ASSERT_EQ(st.num_submitted, BG_NUM_FREE + 1);
+  ASSERT_EQ(st.num_rejected, 0);
+  ASSERT_EQ(st.num_run, BG_NUM_FREE);
+  ASSERT(st.num_stolen > 0);
+  ASSERT_EQ(st.queue_depth, 0);
+  ASSERT(st.max_queue_depth > 0);
+  ASSERT(st.wait_us_max > 0 && st.wait_us_total >= st.wait_us_max);
+  s_bg_blocked = 0;
+  ASSERT(bg_wait_run(BG_NUM_FREE + 1));
+
+  /* Stopping runs what's been queued. */
+  int count = 0;
+  for (int i = 0; i < BG_NUM_FREE; i++) {
+    ASSERT(ubuntu_bg_pool_submit(bg_count_cb, &count, 1));
+  }
+  ubuntu_bg_pool_stop();
+  ASSERT_EQ(count, BG_NUM_FREE);
+  ASSERT(!ubuntu_bg_pool_submit(bg_nop_cb, NULL, 0));
+  return NULL;
+}
+
+#define SEND_BUF_TEST_LEN (256 * 1024)
+
+static int s_num_send_buf_frees = 0;
+
+static void send_buf_free_cb(void *data, void *arg) {
+  free(data);
+  (*((int *) arg))++;
+}
+
+static void send_buf_test_ev(struct mg_connection *c, int ev, void *ev_data,
+                             void *user_data) {
+  (void) c;
+  (void) ev;
+  (void) ev_data;
+  (void) user_data;
+}
+
+/*
+ * Pumps data from c to fd, doing what mongoose would do with the send mbuf.
+ * Returns the peak size of the send mbuf.
+ */
+static size_t send_buf_pump(struct mg_connection *c, int fd, char *rx,
+                            size_t *rx_len) {
+  size_t peak = c->send_mbuf.size;
+  while (mgos_conn_get_send_pending(c) > 0 || c->send_mbuf.len > 0) {
+    mgos_send_buf_handle_event(c, MG_EV_POLL);
+    if (c->send_mbuf.size > peak) peak = c->send_mbuf.size;
+    if (c->send_mbuf.len > 0) {
+      ssize_t n = write(c->sock, c->send_mbuf.buf, c->send_mbuf.len);
+      if (n > 0) mbuf_remove(&c->send_mbuf, n);
+    }
+    ssize_t n = read(fd, rx + *rx_len, SEND_BUF_TEST_LEN * 2 - *rx_len);
+    if (n > 0) *rx_len += n;
+  }
+  for (;;) {
+    ssize_t n = read(fd, rx + *rx_len, SEND_BUF_TEST_LEN * 2 - *rx_len);
+    if (n <= 0) break;
+    *rx_len += n;
+  }
+  return peak;
+}
+
+static const char *test_send_buf(void) {
+  int sv[2];
+  struct mg_add_sock_opts opts;
+  size_t rx_len = 0, peak_zc, peak_chunked, peak_mg_send;
+  char *data, *rx = (char *) malloc(SEND_BUF_TEST_LEN * 2);
+  ASSERT_PTRNE(rx, NULL);
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+  fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+  fcntl(sv[1], F_SETFL, fcntl(sv[1], F_GETFL) | O_NONBLOCK);
+  memset(&opts, 0, sizeof(opts));
+  struct mg_connection *c =
+      mg_add_sock_opt(mgos_get_mgr(), sv[0], send_buf_test_ev, NULL, opts);
+  ASSERT_PTRNE(c, NULL);
+
+  /* One buffer queued as two ranges plus an owned one, all in order. */
+  s_num_send_buf_frees = 0;
+  data = (char *) malloc(SEND_BUF_TEST_LEN);
+  for (int i = 0; i < SEND_BUF_TEST_LEN; i++) data[i] = (char) (i * 7);
+  struct mgos_send_buf *b = mgos_send_buf_create(
+      data, SEND_BUF_TEST_LEN, send_buf_free_cb, &s_num_send_buf_frees);
+  ASSERT_PTRNE(b, NULL);
+  ASSERT(!mgos_conn_send_buf(c, b, 1, SEND_BUF_TEST_LEN));
+  ASSERT(mgos_conn_send_buf(c, b, 0, 100));
+  ASSERT(mgos_conn_send_buf(c, b, 100, SEND_BUF_TEST_LEN - 100));
+  mgos_send_buf_unref(b);
+  char *tail = strdup("tail");
+  ASSERT(mgos_conn_send_owned(c, tail, 4, send_buf_free_cb,
+                              &s_num_send_buf_frees));
+  ASSERT_EQ(mgos_conn_get_send_pending(c), SEND_BUF_TEST_LEN + 4);
+  c->flags |= MG_F_SEND_AND_CLOSE;
+  mgos_send_buf_handle_event(c, MG_EV_POLL);
+  /* Held back while data is pending. */
+  ASSERT_EQ(c->flags & MG_F_SEND_AND_CLOSE, 0);
+  ASSERT_EQ(s_num_send_buf_frees, 0);
+  peak_zc = send_buf_pump(c, sv[1], rx, &rx_len);
+  ASSERT_EQ(s_num_send_buf_frees, 2);
+  ASSERT(c->flags & MG_F_SEND_AND_CLOSE);
+  c->flags &= ~MG_F_SEND_AND_CLOSE;
+  ASSERT_EQ(rx_len, SEND_BUF_TEST_LEN + 4);
+  for (int i = 0; i < SEND_BUF_TEST_LEN; i++) {
+    if (rx[i] != (char) (i * 7)) ASSERT_EQ(i, -1);
+  }
+  ASSERT_EQ(memcmp(rx + SEND_BUF_TEST_LEN, "tail", 4), 0);
+
+  /* Without writev (SSL), data goes through the mbuf one chunk at a time. */
+  rx_len = 0;
+  c->flags |= MG_F_SSL;
+  data = (char *) malloc(SEND_BUF_TEST_LEN);
+  memset(data, 'x', SEND_BUF_TEST_LEN);
+  ASSERT(mgos_conn_send_owned(c, data, SEND_BUF_TEST_LEN, send_buf_free_cb,
+                              &s_num_send_buf_frees));
+  peak_chunked = send_buf_pump(c, sv[1], rx, &rx_len);
+  c->flags &= ~MG_F_SSL;
+  ASSERT_EQ(rx_len, SEND_BUF_TEST_LEN);
+  ASSERT_EQ(s_num_send_buf_frees, 3);
+  mbuf_free(&c->send_mbuf);
+
+  /* Closing releases whatever is still queued. */
+  data = (char *) malloc(SEND_BUF_TEST_LEN);
+  ASSERT(mgos_conn_send_owned(c, data, SEND_BUF_TEST_LEN, send_buf_free_cb,
+                              &s_num_send_buf_frees));
+  mgos_send_buf_handle_event(c, MG_EV_CLOSE);
+  ASSERT_EQ(s_num_send_buf_frees, 4);
+  ASSERT_EQ(mgos_conn_get_send_pending(c), 0);
+
+  /* For comparison: plain mg_send() copies everything. */
+  rx_len = 0;
+  data = (char *) malloc(SEND_BUF_TEST_LEN);
+  memset(data, 'y', SEND_BUF_TEST_LEN);
+  mg_send(c, data, SEND_BUF_TEST_LEN);
+  peak_mg_send = send_buf_pump(c, sv[1], rx, &rx_len);
+  free(data);
+  ASSERT_EQ(rx_len, SEND_BUF_TEST_LEN);
+  mbuf_free(&c->send_mbuf);
+
+  ASSERT(peak_mg_send >= SEND_BUF_TEST_LEN);
+  ASSERT(peak_zc <= MGOS_SEND_BUF_CHUNK_SIZE * 2);
+  ASSERT(peak_chunked <= MGOS_SEND_BUF_CHUNK_SIZE * 2);
+
+  c->flags |= MG_F_CLOSE_IMMEDIATELY;
+  close(sv[1]);
+  free(rx);
+  return NULL;
+}
+
+#define LOOP_STATS_NUM_THREADS 4
+#define LOOP_STATS_NUM_SAMPLES 20000
+
+static void *loop_stats_thread(void *arg) {
+  for (int i = 0; i < LOOP_STATS_NUM_SAMPLES; i++) {
+    mgos_loop_stats_record(MGOS_LOOP_STATS_EVENT_HANDLER, 0x10000000);
+  }
+  return arg;
+}
+
+static const char *test_loop_stats(void) {
+  struct mgos_loop_stats_hist_data hd;
+  mgos_loop_stats_reset();
+  for (int i = 0; i < 90; i++) mgos_loop_stats_record(MGOS_LOOP_STATS_ITER, 5);
+  for (int i = 0; i < 9; i++) mgos_loop_stats_record(MGOS_LOOP_STATS_ITER, 100);
+  mgos_loop_stats_record(MGOS_LOOP_STATS_ITER, 0);
+  mgos_loop_stats_record(MGOS_LOOP_STATS_ITER, 0xffffffff);
+  ASSERT(mgos_loop_stats_get(MGOS_LOOP_STATS_ITER, &hd));
+  ASSERT_EQ(hd.count, 101);
+  ASSERT_EQ(hd.max_us, 0xffffffff);
+  ASSERT_EQ(hd.buckets[0], 1);
+  ASSERT_EQ(hd.buckets[3], 90); /* 4 - 7 */
+  ASSERT_EQ(hd.buckets[7], 9);  /* 64 - 127 */
+  ASSERT_EQ(hd.buckets[MGOS_LOOP_STATS_NUM_BUCKETS - 1], 1);
+  ASSERT_EQ(mgos_loop_stats_percentile(&hd, 0.5), 7);
+  ASSERT_EQ(mgos_loop_stats_percentile(&hd, 0.95), 127);
+  ASSERT_EQ(mgos_loop_stats_percentile(&hd, 1), 0xffffffff);
+  ASSERT_EQ64(hd.total_us, 90 * 5 + 9 * 100 + (uint64_t) 0xffffffff);
+
+  /* Without a platform clock, all of the iteration counts as work. */
+  test_hal_set_uptime(400);
+  ASSERT_EQ(mgos_loop_stats_busy_micros(), 400000000);
+
+  /* Event handlers are timed. */
+  uint32_t flags = 0;
+  ASSERT(mgos_event_add_handler(GRP1_EV0, ev_cb, &flags));
+  int num_handlers = mgos_event_trigger(GRP1_EV0, NULL);
+  ASSERT(num_handlers > 0);
+  ASSERT(mgos_loop_stats_get(MGOS_LOOP_STATS_EVENT_HANDLER, &hd));
+  ASSERT_EQ(hd.count, num_handlers);
+  ASSERT(mgos_event_remove_handler(GRP1_EV0, ev_cb, &flags));
+
+  char *json = mgos_loop_stats_to_json();
+  ASSERT_PTRNE(json, NULL);
+  unsigned int count = 0, p50 = 0, hcount = 0;
+  ASSERT_EQ(json_scanf(json, strlen(json),
+                       "{iter: {count: %u, p50_us: %u}, "
+                       "event_handler: {count: %u}}",
+                       &count, &p50, &hcount),
+            3);
+  ASSERT_EQ(count, 101);
+  ASSERT_EQ(p50, 7);
+  ASSERT_EQ(hcount, num_handlers);
+  ASSERT(strstr(json, "\"buckets\": [1,0,0,90,0,0,0,9,") != NULL);
+  ASSERT(strstr(json, "\"idle\": {\"count\": 0,") != NULL);
+  free(json);
+
+  /* Recording from several threads at once loses nothing. */
+  pthread_t threads[LOOP_STATS_NUM_THREADS];
+  mgos_loop_stats_reset();
+  for (int i = 0; i < LOOP_STATS_NUM_THREADS; i++) {
+    ASSERT_EQ(pthread_create(&threads[i], NULL, loop_stats_thread, NULL), 0);
+  }
+  for (int i = 0; i < LOOP_STATS_NUM_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  ASSERT(mgos_loop_stats_get(MGOS_LOOP_STATS_EVENT_HANDLER, &hd));
+  ASSERT_EQ(hd.count, LOOP_STATS_NUM_THREADS * LOOP_STATS_NUM_SAMPLES);
+  ASSERT_EQ64(hd.total_us, (uint64_t) LOOP_STATS_NUM_THREADS *
+                               LOOP_STATS_NUM_SAMPLES * 0x10000000);
+  ASSERT_EQ(hd.max_us, 0x10000000);
+  ASSERT_EQ(hd.buckets[MGOS_LOOP_STATS_NUM_BUCKETS - 1],
+            LOOP_STATS_NUM_THREADS * LOOP_STATS_NUM_SAMPLES);
+
+  mgos_loop_stats_reset();
+  ASSERT(mgos_loop_stats_get(MGOS_LOOP_STATS_ITER, &hd));
+  ASSERT_EQ(hd.count, 0);
+  ASSERT_EQ(mgos_loop_stats_percentile(&hd, 0.5), 0);
   return NULL;
 }
 
@@ -350,12 +2167,38 @@ static const char *test_cs_hex(void) {
 }
 
 void tests_setup(void) {
+  mgos_event_queue_init();
+  mgos_timers_init();
 }
 
 const char *tests_run(const char *filter) {
   RUN_TEST(test_config);
+  RUN_TEST(test_config_acl);
+  RUN_TEST(test_config_find);
+  RUN_TEST(test_config_snapshot);
+  RUN_TEST(test_config_typed);
+  RUN_TEST(test_config_str_pool);
+  RUN_TEST(test_config_journal);
+  RUN_TEST(test_sys_config_journal);
+  RUN_TEST(test_sys_config_snapshot);
+  RUN_TEST(test_config_watch);
+  RUN_TEST(test_config_snapshot_publish);
   RUN_TEST(test_json_scanf);
+  RUN_TEST(test_json_walk_stream);
+  RUN_TEST(test_json_walk_modes);
+  RUN_TEST(test_json_printf_fast);
+  RUN_TEST(test_json_tape);
   RUN_TEST(test_events);
+  RUN_TEST(test_events_order);
+  RUN_TEST(test_events_post);
+  RUN_TEST(test_timers);
+  RUN_TEST(test_timers_batch);
+  RUN_TEST(test_poll_cbs);
+  RUN_TEST(test_ubuntu_cb_queue);
+  RUN_TEST(test_ubuntu_cb_queue_cross_thread);
+  RUN_TEST(test_ubuntu_bg_pool);
+  RUN_TEST(test_send_buf);
+  RUN_TEST(test_loop_stats);
   RUN_TEST(test_cs_hex);
   return NULL;
 }
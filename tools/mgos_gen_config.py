@@ -60,6 +60,9 @@
 # static inline void myconfig_global_set_foo_frombulate(int         val) { myconfig_set_foo_frombulate(&myconfig_global, val); }
 # ....
 #
+# With --c_global_changed_cb=<function>, setters of the global instance call
+# the given function (`void function(void)`) after setting the value.
+#
 # If default value is not specified when an entry is defined, a zero-value
 # is assumed: false for booleans, 0 for ints and an empty string for strings.
 # These two definitions are equivalent:
@@ -86,6 +89,7 @@ import sys
 parser = argparse.ArgumentParser(description="Create C config boilerplate from a YAML schema")
 parser.add_argument("--c_name", required=True, help="name of the top-level C struct")
 parser.add_argument("--c_global_name", required=False, help="name for the global instance, also will be used as a prefix for its accessors")
+parser.add_argument("--c_global_changed_cb", required=False, help="function to call after a setter of the global instance")
 parser.add_argument("--dest_dir", default=".", help="base path of generated files")
 parser.add_argument("schema_files", nargs="+", help="YAML schema files")
 
@@ -113,6 +117,23 @@ def EscapeCString(s):
     return s
 
 
+# Escapes a string for use in a C literal so that every byte of its UTF-8
+# encoding is a single character in the literal, regardless of the compiler's
+# execution character set. Octal escapes are used as they are never longer
+# than 3 digits.
+def EscapeCBytes(s):
+    res = []
+    for b in bytearray(s.encode("utf-8")):
+        c = chr(b)
+        if c in "\\\"?":
+            res.append("\\" + c)
+        elif 0x20 <= b < 0x7f:
+            res.append(c)
+        else:
+            res.append("\\%03o" % b)
+    return '"%s"' % "".join(res)
+
+
 class SchemaEntry:
     V_INT = "i"
     V_UNSIGNED_INT = "ui"
@@ -238,13 +259,17 @@ class SchemaEntry:
         else:
             return self.schema.FindEntry(self.vtype).GetCType(struct_prefix)
 
-    def GetCDefaultValue(self):
+    def GetCDefaultValue(self, str_table=None):
         if self.vtype == SchemaEntry.V_OBJECT:
             raise TypeError("shouldn't happen")
         elif self.vtype == SchemaEntry.V_BOOL:
             return "true" if self.default else "false"
         elif self.vtype == SchemaEntry.V_STRING:
-            return EscapeCString(self.default) if self.default else "NULL"
+            if not self.default:
+                return "NULL"
+            if str_table:
+                return str_table.GetRef(self.default)
+            return EscapeCString(self.default)
         else:
             return self.default
 
@@ -418,8 +443,9 @@ class Gen:
 
 
 class StructDefGen(Gen):
-    def __init__(self, struct_name):
+    def __init__(self, struct_name, str_table=None):
         self._struct_name = struct_name
+        self._str_table = str_table
         self._obj_type = "struct %s" % struct_name
         self._objs = []
         self._fields = []
@@ -510,9 +536,9 @@ class StructDefGen(Gen):
                         embedded_ctypes[k] = v + len(lines) + 1
                     lines.extend(ll)
                 else:
-                    lines.append(
-                        '    {.type = %s, .key = "%s", .offset = offsetof(%s, %s)},'
-                        % (SchemaEntry._CONF_TYPES[fe.vtype], fe.key, top_ctype, field_top_path))
+                    lines.append((fe.key, None,
+                        '.type = %s, .key = "%s", .offset = offsetof(%s, %s)'
+                        % (SchemaEntry._CONF_TYPES[fe.vtype], fe.key, top_ctype, field_top_path)))
         if obj_path != top_path:
             if len(top_path) > 0:
                 sub_path = obj_path[len(top_path)+1:]
@@ -522,10 +548,44 @@ class StructDefGen(Gen):
         else:
             obj_key = ""
             obj_offset = "0"
-        hdr = '    {.type = %s, .key = "%s", .offset = %s, .num_desc = %d},' % (
-                SchemaEntry._CONF_TYPES[SchemaEntry.V_OBJECT], obj_key, obj_offset, len(lines))
+        hdr = (obj_key, len(lines), '.type = %s, .key = "%s", .offset = %s, .num_desc = %d' % (
+                SchemaEntry._CONF_TYPES[SchemaEntry.V_OBJECT], obj_key, obj_offset, len(lines)))
         return [hdr] + lines, embedded_ctypes
 
+    # Renders schema entries returned by _GetSchemaLines. For each object,
+    # its direct children are listed in the index array sorted by key
+    # (count first, then indices relative to the object), so lookups can
+    # do a binary search instead of scanning the whole subtree.
+    @staticmethod
+    def _RenderSchema(var_name, entries):
+        index, idx_pos = [], {}
+        for i, (_, num_desc, _) in enumerate(entries):
+            if num_desc is None:
+                continue
+            children, j = [], i + 1
+            while j <= i + num_desc:
+                children.append(j - i)
+                if entries[j][1] is not None:
+                    j += entries[j][1]
+                j += 1
+            children.sort(key=lambda ci: entries[i + ci][0].encode("utf-8"))
+            idx_pos[i] = len(index)
+            index.append(len(children))
+            index.extend(children)
+        lines = ["static const uint16_t %sidx_[] = {" % var_name]
+        for _, pos in sorted(idx_pos.items()):
+            n = index[pos]
+            lines.append("    %s" % " ".join("%d," % v for v in index[pos:pos + n + 1]))
+        lines.append("};")
+        lines.append("static const struct mgos_conf_entry %s[] = {" % var_name)
+        for i, (_, num_desc, fields) in enumerate(entries):
+            if num_desc is None:
+                lines.append("    {%s}," % fields)
+            else:
+                lines.append("    {%s, .sorted_children = &%sidx_[%d]}," % (fields, var_name, idx_pos[i]))
+        lines.append("};")
+        return lines
+
     def GetSourceLines(self):
         self._Finalize()
 
@@ -539,15 +599,13 @@ class StructDefGen(Gen):
             lines.append("")
             lines.append("/* %s */" % obj_type)
             var_name = "%s%s_schema_" % (self._struct_name, "_" + oe.GetIdentifierName() if oe else "")
-            lines.append("static const struct mgos_conf_entry %s[] = {" % var_name)
             oe_path = oe.path if oe else ""
             oe_key = oe.key if oe else ""
             ll, ect = self._GetSchemaLines(oe_path, obj_type, oe_path, oe_key)
-            lines.extend(ll)
+            lines.extend(self._RenderSchema(var_name, ll))
             schema_by_ctype[obj_type] = (var_name, 0)
             for ctype, index in ect.items():
                 schema_by_ctype[ctype] = (var_name, index)
-            lines.append("};")
 
         for oe, _, obj_type, fields in self._objs:
             lines.append("")
@@ -567,7 +625,7 @@ class StructDefGen(Gen):
                     lines.append("  %s_%s_set_defaults(&cfg->%s);" % (
                         self._struct_name, fe.GetIdentifierName(), fe.key))
                 else:
-                    lines.append("  cfg->%s = %s;" % (fe.key, fe.GetCDefaultValue()))
+                    lines.append("  cfg->%s = %s;" % (fe.key, fe.GetCDefaultValue(self._str_table)))
             if len(fields) == 0:
                 lines.append("  (void) cfg;")
             lines.append("}")
@@ -586,9 +644,11 @@ class StructDefGen(Gen):
 # is not None, then header will additionally contain static inline functions
 # to access a global config instance, allocated globally in the source.
 class AccessorsGen(Gen):
-    def __init__(self, struct_name, c_global_name):
+    def __init__(self, struct_name, c_global_name, str_table=None, changed_cb=None):
         self._struct_name = struct_name
+        self._str_table = str_table
         self._c_global_name = c_global_name
+        self._changed_cb = changed_cb if c_global_name else None
         self._entries = []
         self._getters = []
         self._setters = []
@@ -605,6 +665,9 @@ class AccessorsGen(Gen):
 
         if self._c_global_name:
             lines.append("extern struct %s %s;" % (self._struct_name, self._c_global_name))
+        if self._changed_cb:
+            lines.append("void %s(void);" % self._changed_cb)
+        changed = " %s();" % self._changed_cb if self._changed_cb else ""
 
         for e in self._entries:
             iname = e.GetIdentifierName()
@@ -639,8 +702,8 @@ class AccessorsGen(Gen):
                 lines.append("void %s_set_%s(struct %s *cfg, %s%sv);" % (
                     self._struct_name, e.GetIdentifierName(), self._struct_name, const, ctype))
                 if self._c_global_name:
-                    lines.append("static inline void %s_set_%s(%s%sv) { %s_set_%s(&%s, v); }" % (
-                        self._c_global_name, iname, const, ctype, self._struct_name, iname, self._c_global_name))
+                    lines.append("static inline void %s_set_%s(%s%sv) { %s_set_%s(&%s, v);%s }" % (
+                        self._c_global_name, iname, const, ctype, self._struct_name, iname, self._c_global_name, changed))
 
         if self._c_global_name:
             lines.append("")
@@ -679,7 +742,7 @@ class AccessorsGen(Gen):
                     const, ctype, self._struct_name, e.GetIdentifierName(), self._struct_name, amp, e.path))
                 if e.vtype != SchemaEntry.V_OBJECT:
                     lines.append("%s%s%s_get_default_%s(void) { return %s; }" % (
-                        const, ctype, self._struct_name, e.GetIdentifierName(), e.GetCDefaultValue()));
+                        const, ctype, self._struct_name, e.GetIdentifierName(), e.GetCDefaultValue(self._str_table)));
 
             if setter and not e.IsAbstract():
                 if e.vtype == SchemaEntry.V_STRING:
@@ -694,46 +757,64 @@ class AccessorsGen(Gen):
             lines.append("  return mgos_config_get(key, value, &%s, %s_schema());" % (self._c_global_name, self._struct_name))
             lines.append("}")
             lines.append("bool %s_set(const struct mg_str key, const struct mg_str value, bool free_strings) {" % self._c_global_name,)
-            lines.append("  return mgos_config_set(key, value, &%s, %s_schema(), free_strings);" % (self._c_global_name, self._struct_name))
+            if self._changed_cb:
+                lines.append("  bool res = mgos_config_set(key, value, &%s, %s_schema(), free_strings);" % (self._c_global_name, self._struct_name))
+                lines.append("  if (res) %s();" % self._changed_cb)
+                lines.append("  return res;")
+            else:
+                lines.append("  return mgos_config_set(key, value, &%s, %s_schema(), free_strings);" % (self._c_global_name, self._struct_name))
             lines.append("}")
 
         return lines
 
 
+# Default string values are stored back to back in a single array,
+# so telling whether a string is a default is a range check.
 class StringTableGen(Gen):
     def __init__(self, struct_name):
         self._struct_name = struct_name
+        self._stn = "%s_str_table" % struct_name
         self._str_table = set()
+        self._offsets = None
 
     def Value(self, e):
         if e.vtype == SchemaEntry.V_STRING and e.default:
             self._str_table.add(e.default)
 
+    def _GetOffsets(self):
+        if self._offsets is None:
+            self._offsets, off = {}, 0
+            for s in sorted(self._str_table):
+                self._offsets[s] = off
+                off += len(s.encode("utf-8")) + 1
+        return self._offsets
+
+    # Returns C expression for the default value `s`.
+    def GetRef(self, s):
+        return "(%s + %d)" % (self._stn, self._GetOffsets()[s])
+
     def GetHeaderLines(self):
         return ["bool %s_is_default_str(const char *s);" % self._struct_name]
 
-    def GetSourceLines(self):
-        stn = "%s_str_table" % self._struct_name
-        lines = ["static const char *%s[] = {" % stn]
+    def GetTableLines(self):
+        lines = ["static const char %s[] =" % self._stn]
+        offsets = self._GetOffsets()
         for s in sorted(self._str_table):
-            lines.append("  %s," % EscapeCString(s))
-        lines.append("""\
-}};
+            lines.append("  /* %d */ %s\\0\"" % (offsets[s], EscapeCBytes(s)[:-1]))
+        lines.append("  \"\";")
+        return lines
 
+    def GetSourceLines(self):
+        return ["""\
 bool {name}_is_default_str(const char *s) {{
-  int num_str = (sizeof({stn}) / sizeof({stn}[0]));
-  for (int i = 0; i < num_str; i++) {{
-    if ({stn}[i] == s) return true;
-  }}
-  return false;
-}}""".format(name=self._struct_name, stn=stn))
-        return lines
+  return (s >= {stn} && s < {stn} + sizeof({stn}));
+}}""".format(name=self._struct_name, stn=self._stn)]
 
 
 # Writes C header file.
 class HWriter:
-    def __init__(self, struct_name, c_global_name):
-        self._acc_gen = AccessorsGen(struct_name, c_global_name)
+    def __init__(self, struct_name, c_global_name, changed_cb=None):
+        self._acc_gen = AccessorsGen(struct_name, c_global_name, changed_cb=changed_cb)
         self._struct_def_gen = StructDefGen(struct_name)
         self._str_table_gen = StringTableGen(struct_name)
         self._struct_name = struct_name
@@ -794,10 +875,10 @@ const struct mgos_conf_entry *{name}_schema(void);
 
 # Writes C source file with schema definition
 class CWriter:
-    def __init__(self, struct_name, c_global_name):
-        self._acc_gen = AccessorsGen(struct_name, c_global_name)
-        self._struct_def_gen = StructDefGen(struct_name)
+    def __init__(self, struct_name, c_global_name, changed_cb=None):
         self._str_table_gen = StringTableGen(struct_name)
+        self._acc_gen = AccessorsGen(struct_name, c_global_name, self._str_table_gen, changed_cb)
+        self._struct_def_gen = StructDefGen(struct_name, self._str_table_gen)
         self._struct_name = struct_name
         self._schema_lines = []
         self._start_indices = []
@@ -847,6 +928,9 @@ class CWriter:
 
 #include "mgos_config_util.h"
 
+/* Strings */
+{str_table_lines}
+
 {struct_def_lines}
 
 {accessor_lines}
@@ -855,8 +939,7 @@ const struct mgos_conf_entry *{name}_schema(void) {{
   return {name}_get_schema();
 }}
 
-/* Strings */
-{str_table_lines}
+{is_default_str_lines}
 """.format(cmd=" ".join(sys.argv),
            name=self._struct_name,
            num_entries=len(self._schema_lines) + 1,
@@ -864,7 +947,8 @@ const struct mgos_conf_entry *{name}_schema(void) {{
            schema_lines="\n".join(self._schema_lines),
            struct_def_lines="\n".join(self._struct_def_gen.GetSourceLines()),
            accessor_lines="\n".join(self._acc_gen.GetSourceLines()),
-           str_table_lines="\n".join(self._str_table_gen.GetSourceLines()))
+           str_table_lines="\n".join(self._str_table_gen.GetTableLines()),
+           is_default_str_lines="\n".join(self._str_table_gen.GetSourceLines()))
 
 
 @contextlib. contextmanager
@@ -909,13 +993,13 @@ if __name__ == "__main__":
     with open_with_temp(jsfn) as jsf:
         jsf.write(str(jsw))
 
-    hw = HWriter(args.c_name, args.c_global_name)
+    hw = HWriter(args.c_name, args.c_global_name, args.c_global_changed_cb)
     schema.Walk(hw)
     hfn = os.path.join(args.dest_dir, "%s.h" % args.c_name)
     with open_with_temp(hfn) as hf:
         hf.write(str(hw))
 
-    cw = CWriter(args.c_name, args.c_global_name)
+    cw = CWriter(args.c_name, args.c_global_name, args.c_global_changed_cb)
     schema.Walk(cw)
     cfn = os.path.join(args.dest_dir, "%s.c" % args.c_name)
     with open_with_temp(cfn) as cf:
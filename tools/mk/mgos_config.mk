@@ -11,6 +11,7 @@ $(MGOS_CONFIG_C): $(MGOS_CONF_SCHEMA) $(APP_CONF_SCHEMA) $(GSC_TOOL)
 	$(vecho) "GEN   $@"
 	$(Q) $(PYTHON3) $(GSC_TOOL) \
 	  --c_name=mgos_config --c_global_name=mgos_sys_config \
+	  --c_global_changed_cb=mgos_sys_config_changed \
 	  --dest_dir=$(dir $@) $(MGOS_CONF_SCHEMA) $(APP_CONF_SCHEMA)
 
 $(MGOS_RO_VARS_C): $(MGOS_RO_VARS_SCHEMA) $(GSC_TOOL)
@@ -1,11 +1,16 @@
 MGOS_ENABLE_BITBANG ?= 1
+MGOS_ENABLE_CONFIG_JOURNAL ?= 0
+MGOS_ENABLE_CONFIG_SNAPSHOT ?= 0
 MGOS_ENABLE_DEBUG_UDP ?= 1
+MGOS_ENABLE_LOOP_STATS ?= 0
 MGOS_ENABLE_SYS_SERVICE ?= 1
 
 MGOS_DEBUG_UART ?= 0
 MGOS_EARLY_DEBUG_LEVEL ?= LL_INFO
 MGOS_DEBUG_UART_BAUD_RATE ?= 115200
-MGOS_SRCS += mgos_debug.c mgos_mongoose.c mgos_net.c
+MGOS_SRCS += mgos_config_watch.c mgos_debug.c mgos_mongoose.c mgos_net.c \
+             mgos_poll_cb.c mgos_send_buf.c mgos_sys_config_file.c \
+             mgos_sys_config_snapshot.c
 
 MGOS_FEATURES ?=
 MGOS_FEATURES += -DMGOS_DEBUG_UART=$(MGOS_DEBUG_UART) \
@@ -23,8 +28,24 @@ ifeq "$(MGOS_ENABLE_BITBANG)" "1"
   MGOS_FEATURES += -DMGOS_ENABLE_BITBANG
 endif
 
+ifeq "$(MGOS_ENABLE_CONFIG_JOURNAL)" "1"
+  MGOS_FEATURES += -DMGOS_ENABLE_CONFIG_JOURNAL
+endif
+
+ifeq "$(MGOS_ENABLE_CONFIG_SNAPSHOT)" "1"
+  MGOS_FEATURES += -DMGOS_ENABLE_CONFIG_SNAPSHOT
+endif
+
+ifeq "$(MGOS_ENABLE_LOOP_STATS)" "1"
+  MGOS_SRCS += mgos_loop_stats.c
+  MGOS_FEATURES += -DMGOS_ENABLE_LOOP_STATS
+endif
+
 # Export all the feature switches.
 # This is required for needed make invocations (i.e. ESP32 IDF)
 export MGOS_ENABLE_BITBANG
+export MGOS_ENABLE_CONFIG_JOURNAL
+export MGOS_ENABLE_CONFIG_SNAPSHOT
 export MGOS_ENABLE_DEBUG_UDP
+export MGOS_ENABLE_LOOP_STATS
 export MGOS_ENABLE_SYS_SERVICE